@@ -0,0 +1,814 @@
+/* dasbench -- acquisition benchmarks against any backend, as JSON
+ *
+ * usage: dasbench [-b netbsd|wdf|dev[:prefix]|replay:file] [-s scenario,...]
+ *                 [-c count] [-n samples] [-t ms] [-B boards] [-w file]
+ *
+ * Backends: netbsd and wdf are das.c and the das1 driver on emulated
+ * boards, through the shims dasdrive uses; dev is a real board through
+ * /dev/das<unit> (or prefix<unit>); replay plays back a file of samples
+ * that -w wrote, at the pacer rate.
+ *
+ * Scenarios, each point sampling for -t ms with the pacer at -c and
+ * reads of -n samples unless it varies them:
+ *   max       counts from 1 kHz up; the fastest with nothing dropped,
+ *             no tick missed and 98% of the nominal rate read is
+ *             max_sustained_hz
+ *   readsize  reads of 1 to 4096 samples
+ *   stall     the reader sleeps 0 to 400 ms, STALL_FIRST_MS in and then
+ *             every STALL_EVERY_MS
+ *   readers   1, 2 and 4 threads reading the one open
+ *   boards    1, 2 and -B boards, a reader each
+ *   mapped    the mapped sample ring instead of read, where there is one
+ *   batch     CTR1 reads through REGISTER_BATCH, 1 to 256 to a call, with
+ *             the board idle; 1 is an ioctl per register
+ *   parser    dasstream.h on a made up record stream, with no records, a
+ *             TIME record every 1024 samples or a record every 16, fed
+ *             64 and 4096 words at a time, and a word at a time loop on
+ *             the same stream for comparison; no backend involved
+ *   ring      dasring.h's producer and consumer on two threads, slots
+ *             of 64, 512 and 4096 samples, 8 of them, no backend
+ *   latest    channel 0's newest sample in a loop while it samples with
+ *             nobody reading, by DAS_GET_LATEST and from the mapped
+ *             latest page, where the backend has them
+ *
+ * Each point reports samples and bytes per second, reads (event waits
+ * for mapped) per sample, samples the driver dropped, how long each
+ * read took (p50, p99, p99.9, max), and on emulated boards the ticks
+ * the board missed and the ISR's mean host cost.  batch reports calls,
+ * accesses and the host ns of each; on the shims an ioctl is a call,
+ * not a kernel crossing, so what batching saves there is a floor.
+ * parser and ring report words a second and ns a word; ring also
+ * counts the times each side found nothing to do and yielded, the
+ * only system calls it makes.  latest reports calls and ns a call,
+ * and how many calls found a newer sample than the one before.
+ *
+ * The Makefile also builds the drivers with generic acquisition and
+ * with tracing off or at DAS_TL_INTR; each build says which it is in
+ * "build".
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "dasio.h"
+#include "dasstream.h"
+#include "dasring.h"
+#include "dasemu.h"
+#include "shim/dasshim.h"
+#include "shim/dasdrv.h"
+
+#ifndef DASBENCH_BUILD
+#define DASBENCH_BUILD "default"
+#endif
+
+#define STALL_FIRST_MS 100
+#define STALL_EVERY_MS 500
+#define MAP_WORDS 4096
+#define MAXREADER 4
+#define PARSE_WORDS (1 << 20)
+#define RING_NSLOT 8
+
+static const char *scenarios[] = {
+  "max", "readsize", "stall", "readers", "boards", "mapped", "batch",
+  "parser", "ring", "latest"
+};
+#define NSCEN (sizeof(scenarios) / sizeof(scenarios[0]))
+
+struct point {
+  const char *pt_scen;
+  unsigned int pt_count, pt_nread, pt_readers, pt_boards, pt_stall;
+  int pt_mapped;
+};
+
+struct reader {
+  const struct point *rd_pt;
+  void *rd_h;
+  uint64_t rd_end;
+  uint32_t *rd_buf;
+  uint64_t *rd_lat;
+  size_t rd_nlat, rd_maxlat;
+  uint64_t rd_samples, rd_calls;
+  int rd_error;
+  FILE *rd_rec;
+  pthread_t rd_thread;
+};
+
+struct meas {
+  uint64_t ms_ns, ms_samples, ms_calls, ms_overrun;
+  uint64_t ms_missed, ms_isrs, ms_isr_ns;
+  uint64_t *ms_lat;
+  size_t ms_nlat;
+  int ms_error;
+};
+
+static const struct dasdrv *drv;
+static int emu, nboard = 4, first = 1;
+static unsigned int run_ms = 1000;
+static FILE *rec;
+
+static uint64_t
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+cmp64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static double
+pct(const uint64_t *v, size_t n, double p)
+{
+  return n ? v[(size_t)(p * (n - 1))] / 1000.0 : 0;
+}
+
+static void *
+reader_run(void *arg)
+{
+  struct reader *rd = arg;
+  const struct point *pt = rd->rd_pt;
+  size_t len = pt->pt_nread * sizeof(uint32_t);
+  uint64_t t, stall = now() + STALL_FIRST_MS * 1000000ULL;
+  struct timespec ts;
+  ssize_t n;
+  int waited;
+
+  while ((t = now()) < rd->rd_end) {
+    if (pt->pt_mapped) {
+      n = (*drv->dd_map_read)(rd->rd_h, rd->rd_buf, len, &waited);
+      rd->rd_calls += waited;
+    }
+    else {
+      n = (*drv->dd_read)(rd->rd_h, rd->rd_buf, len);
+      rd->rd_calls++;
+    }
+    if (n < 0) {
+      rd->rd_error = -n;
+      break;
+    }
+    if (n == 0 && !pt->pt_mapped)
+      break;
+    if (rd->rd_nlat == rd->rd_maxlat) {
+      rd->rd_maxlat = rd->rd_maxlat ? 2 * rd->rd_maxlat : 1024;
+      rd->rd_lat = realloc(rd->rd_lat, rd->rd_maxlat * sizeof(*rd->rd_lat));
+      if (rd->rd_lat == NULL) {
+	rd->rd_error = ENOMEM;
+	break;
+      }
+    }
+    rd->rd_lat[rd->rd_nlat++] = now() - t;
+    rd->rd_samples += n / sizeof(uint32_t);
+    if (rd->rd_rec != NULL)
+      (void)fwrite(rd->rd_buf, 1, n, rd->rd_rec);
+    if (pt->pt_stall && now() >= stall) {
+      ts.tv_sec = pt->pt_stall / 1000;
+      ts.tv_nsec = (pt->pt_stall % 1000) * 1000000L;
+      nanosleep(&ts, NULL);
+      stall += STALL_EVERY_MS * 1000000ULL;
+    }
+  }
+  return NULL;
+}
+
+/* Board counters on emulated boards: missed ticks, ISR calls and cost */
+static void
+board_counts(int boards, uint64_t *missed, uint64_t *isrs, uint64_t *isr_ns)
+{
+  struct dasshim_board *sb;
+  int b;
+
+  *missed = *isrs = *isr_ns = 0;
+  for (b = 0; emu && b < boards; b++) {
+    sb = dasshim_board(b);
+    dasshim_lock(sb);
+    *missed += sb->sb_emu.de_stats.es_missed;
+    *isrs += sb->sb_isrs;
+    *isr_ns += sb->sb_isr_ns;
+    dasshim_unlock(sb);
+  }
+}
+
+static void
+run_point(const struct point *pt, struct meas *ms)
+{
+  struct reader rd[DASSHIM_MAXBOARD * MAXREADER];
+  struct dasdrv_stats dv0[DASSHIM_MAXBOARD], dv;
+  uint64_t missed, isrs, isr_ns, t0;
+  void *h[DASSHIM_MAXBOARD];
+  uint32_t junk[256];
+  unsigned int b, i, nrd = 0, nopen = 0;
+  size_t n;
+  int error = 0;
+
+  memset(ms, 0, sizeof(*ms));
+  memset(rd, 0, sizeof(rd));
+  memset(dv0, 0, sizeof(dv0));
+  board_counts(pt->pt_boards, &missed, &isrs, &isr_ns);
+  for (b = 0; b < pt->pt_boards && error == 0; b++) {
+    error = (*drv->dd_open)(b, O_RDWR, &h[b]);
+    if (error)
+      break;
+    nopen++;
+    // das1 keeps its ring across opens; what the last point left is
+    // not this one's
+    while ((*drv->dd_read)(h[b], junk, sizeof(junk)) > 0)
+      ;
+    error = (*drv->dd_pacer)(h[b], pt->pt_count);
+    if (error == 0 && pt->pt_mapped)
+      error = (*drv->dd_map)(h[b], MAP_WORDS);
+    if (error == 0)
+      error = (*drv->dd_stats)(h[b], &dv0[b]);
+  }
+  for (b = 0; b < nopen && error == 0; b++)
+    error = (*drv->dd_start)(h[b]);
+
+  t0 = now();
+  for (b = 0; b < nopen && error == 0; b++) {
+    for (i = 0; i < pt->pt_readers; i++, nrd++) {
+      rd[nrd].rd_pt = pt;
+      rd[nrd].rd_h = h[b];
+      rd[nrd].rd_end = t0 + run_ms * 1000000ULL;
+      rd[nrd].rd_rec = b == 0 && i == 0 && !pt->pt_mapped ? rec : NULL;
+      rd[nrd].rd_buf = malloc(pt->pt_nread * sizeof(uint32_t));
+      if (rd[nrd].rd_buf == NULL ||
+	  pthread_create(&rd[nrd].rd_thread, NULL, reader_run, &rd[nrd])) {
+	free(rd[nrd].rd_buf);
+	error = ENOMEM;
+	break;
+      }
+    }
+  }
+  for (i = 0; i < nrd; i++) {
+    pthread_join(rd[i].rd_thread, NULL);
+    if (error == 0)
+      error = rd[i].rd_error;
+    ms->ms_samples += rd[i].rd_samples;
+    ms->ms_calls += rd[i].rd_calls;
+    ms->ms_nlat += rd[i].rd_nlat;
+  }
+  ms->ms_ns = now() - t0;
+
+  // the counts before the stop, so a drain is not counted as lost
+  for (b = 0; b < nopen; b++) {
+    if ((*drv->dd_stats)(h[b], &dv) == 0)
+      ms->ms_overrun += dv.dv_overrun - dv0[b].dv_overrun;
+    (void)(*drv->dd_stop)(h[b]);
+    if (pt->pt_mapped)
+      (void)(*drv->dd_map)(h[b], 0);
+    (void)(*drv->dd_close)(h[b]);
+  }
+  board_counts(pt->pt_boards, &ms->ms_missed, &ms->ms_isrs, &ms->ms_isr_ns);
+  ms->ms_missed -= missed;
+  ms->ms_isrs -= isrs;
+  ms->ms_isr_ns -= isr_ns;
+
+  ms->ms_lat = malloc((ms->ms_nlat ? ms->ms_nlat : 1) * sizeof(uint64_t));
+  for (i = 0, n = 0; i < nrd; i++) {
+    if (ms->ms_lat != NULL)
+      memcpy(ms->ms_lat + n, rd[i].rd_lat, rd[i].rd_nlat * sizeof(uint64_t));
+    n += rd[i].rd_nlat;
+    free(rd[i].rd_lat);
+    free(rd[i].rd_buf);
+  }
+  if (ms->ms_lat == NULL) {
+    ms->ms_nlat = 0;
+    error = error ? error : ENOMEM;
+  }
+  qsort(ms->ms_lat, ms->ms_nlat, sizeof(uint64_t), cmp64);
+  ms->ms_error = error;
+}
+
+static void
+print_point(const struct point *pt, const struct meas *ms)
+{
+  double secs = ms->ms_ns / 1e9;
+
+  printf("%s    {\"scenario\": \"%s\", \"rate_hz\": %.1f, \"count\": %u, "
+	 "\"read_samples\": %u, \"readers\": %u, \"boards\": %u, "
+	 "\"stall_ms\": %u, \"mapped\": %s,\n",
+	 first ? "" : ",\n", pt->pt_scen,
+	 (double)DASEMU_TICK_HZ / pt->pt_count, pt->pt_count, pt->pt_nread,
+	 pt->pt_readers, pt->pt_boards, pt->pt_stall,
+	 pt->pt_mapped ? "true" : "false");
+  first = 0;
+  if (ms->ms_error)
+    printf("     \"error\": \"%s\",\n", strerror(ms->ms_error));
+  printf("     \"seconds\": %.3f, \"samples\": %llu, \"samples_s\": %.1f, "
+	 "\"bytes_s\": %.1f,\n", secs, (unsigned long long)ms->ms_samples,
+	 secs > 0 ? ms->ms_samples / secs : 0,
+	 secs > 0 ? ms->ms_samples * sizeof(uint32_t) / secs : 0);
+  printf("     \"syscalls\": %llu, \"syscalls_per_sample\": %.4f, "
+	 "\"overruns\": %llu,\n", (unsigned long long)ms->ms_calls,
+	 ms->ms_samples ? (double)ms->ms_calls / ms->ms_samples : 0,
+	 (unsigned long long)ms->ms_overrun);
+  printf("     \"read_us\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, "
+	 "\"max\": %.1f}", pct(ms->ms_lat, ms->ms_nlat, 0.50),
+	 pct(ms->ms_lat, ms->ms_nlat, 0.99), pct(ms->ms_lat, ms->ms_nlat, 0.999),
+	 pct(ms->ms_lat, ms->ms_nlat, 1.0));
+  if (emu)
+    printf(",\n     \"missed_ticks\": %llu, \"isr_ns_mean\": %.0f",
+	   (unsigned long long)ms->ms_missed,
+	   ms->ms_isrs ? (double)ms->ms_isr_ns / ms->ms_isrs : 0);
+  printf("}");
+}
+
+static void
+point(const struct point *pt, struct meas *ms)
+{
+  run_point(pt, ms);
+  print_point(pt, ms);
+  fflush(stdout);
+}
+
+static void
+skip(const char *scen, const char *what)
+{
+  printf("%s    {\"scenario\": \"%s\", \"skipped\": "
+	 "\"the %s backend has no %s\"}", first ? "" : ",\n", scen,
+	 drv->dd_name, what);
+  first = 0;
+}
+
+/* n CTR1 reads to a REGISTER_BATCH call, as many calls as fit in -t ms */
+static void
+batch_point(unsigned int n, double *one)
+{
+  struct dasdrv_regop ops[DASDRV_REGBATCH_MAX];
+  uint64_t t0, ns, calls = 0;
+  unsigned int i;
+  void *h;
+  int error;
+
+  memset(ops, 0, sizeof(ops));
+  for (i = 0; i < n; i++) {
+    ops[i].dr_op = DASDRV_REGOP_READ;
+    ops[i].dr_bar = DASDRV_BADR2;
+    ops[i].dr_off = 2;	/* CTR1 */
+  }
+  error = (*drv->dd_open)(0, O_RDWR, &h);
+  t0 = now();
+  while (error == 0 && now() - t0 < run_ms * 1000000ULL) {
+    error = (*drv->dd_regbatch)(h, ops, n);
+    calls++;
+  }
+  ns = now() - t0;
+  if (n == 1 && calls != 0)
+    *one = (double)ns / calls;
+  if (error == 0)
+    (void)(*drv->dd_close)(h);
+  printf("%s    {\"scenario\": \"batch\", \"ops_per_call\": %u,\n",
+	 first ? "" : ",\n", n);
+  first = 0;
+  if (error)
+    printf("     \"error\": \"%s\",\n", strerror(error));
+  printf("     \"seconds\": %.3f, \"calls\": %llu, \"accesses\": %llu,\n"
+	 "     \"ns_per_call\": %.0f, \"ns_per_access\": %.1f, "
+	 "\"speedup\": %.1f}", ns / 1e9, (unsigned long long)calls,
+	 (unsigned long long)calls * n, calls ? (double)ns / calls : 0,
+	 calls ? (double)ns / calls / n : 0,
+	 calls && *one > 0 ? *one * n / ((double)ns / calls) : 0);
+  fflush(stdout);
+}
+
+static int
+parse_samples(void *arg, const uint32_t *w, size_t n)
+{
+  *(uint64_t *)arg += n;
+  return 0;
+}
+
+static int
+parse_record(void *arg, uint32_t hdr, const uint32_t *w)
+{
+  return 0;
+}
+
+/* Samples in w[0..n), skipping records a word at a time */
+static uint64_t
+parse_words(const uint32_t *w, size_t n)
+{
+  uint64_t samples = 0;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    if (w[i] & DAS_REC_FLAG)
+      i += DAS_REC_LEN(w[i]);
+    else
+      samples++;
+  }
+  return samples;
+}
+
+/*
+ * PARSE_WORDS of samples with a record every every samples (0 for none),
+ * fed n words at a time (0 for the word at a time loop) for -t ms.
+ */
+static void
+parse_point(uint32_t *w, unsigned int every, size_t n)
+{
+  struct das_stream st;
+  uint64_t t0, ns, words = 0, samples = 0;
+  size_t i, j, len;
+
+  // samples as das_acq stores them; TIME records, or CONFIG at 16
+  for (i = 0, j = 0; i < PARSE_WORDS; j++) {
+    if (every != 0 && j % every == every - 1) {
+      len = every == 16 ? DAS_REC_CONFIG_LEN : DAS_REC_TIME_LEN;
+      if (i + 1 + len > PARSE_WORDS)
+	break;
+      w[i++] = DAS_REC_HDR(every == 16 ? DAS_REC_CONFIG : DAS_REC_TIME, 0,
+			   len);
+      for (; len > 0; len--)
+	w[i++] = (uint32_t)j;
+    }
+    else
+      w[i++] = ((uint32_t)(j * 7) << 16) | (j & 0x7fff);
+  }
+  len = i;
+  t0 = now();
+  do {
+    if (n == 0)
+      samples += parse_words(w, len);
+    else {
+      das_stream_init(&st);
+      for (i = 0; i < len; i += n)
+	(void)das_stream_feed(&st, w + i, n < len - i ? n : len - i,
+			      parse_samples, parse_record, &samples);
+    }
+    words += len;
+  } while ((ns = now() - t0) < run_ms * 1000000ULL);
+  printf("%s    {\"scenario\": \"parser\", \"parser\": \"%s\", "
+	 "\"record_every\": %u, \"feed_words\": %zu,\n"
+	 "     \"seconds\": %.3f, \"words\": %llu, \"samples\": %llu, "
+	 "\"words_s\": %.0f, \"ns_per_word\": %.3f}",
+	 first ? "" : ",\n", n ? "dasstream" : "per_word", every, n ? n : len,
+	 ns / 1e9, (unsigned long long)words, (unsigned long long)samples,
+	 words * 1e9 / ns, (double)ns / words);
+  first = 0;
+  fflush(stdout);
+}
+
+struct ring {
+  struct das_ring_ctl rg_ctl;
+  struct das_ring_prod rg_prod;
+  uint32_t *rg_slots;
+  volatile int rg_done;
+  uint64_t rg_words, rg_pwaits, rg_cwaits;
+};
+
+/* das_acq's side: 16 samples at a time, as a softint would move them */
+static void *
+ring_produce(void *arg)
+{
+  struct ring *rg = arg;
+  uint32_t w[16], i;
+
+  for (i = 0; i < 16; i++)
+    w[i] = i;
+  while (!rg->rg_done) {
+    if (!das_ring_ready(&rg->rg_ctl, &rg->rg_prod)) {
+      rg->rg_pwaits++;
+      sched_yield();
+      continue;
+    }
+    (void)das_ring_put(&rg->rg_prod, rg->rg_slots, w, 16);
+    if (rg->rg_prod.rp_fill == rg->rg_prod.rp_slotwords)
+      das_ring_complete(&rg->rg_ctl, &rg->rg_prod, 0, 0, 0);
+  }
+  return NULL;
+}
+
+static void *
+ring_consume(void *arg)
+{
+  struct ring *rg = arg;
+  const struct das_cqe *ce;
+  const uint32_t *slot;
+  uint32_t i, sum = 0;
+
+  while (!rg->rg_done) {
+    if ((ce = das_ring_peek(&rg->rg_ctl)) == NULL) {
+      rg->rg_cwaits++;
+      sched_yield();
+      continue;
+    }
+    slot = rg->rg_slots + (size_t)(ce->ce_seq % RING_NSLOT) *
+	rg->rg_ctl.rc_slotwords;
+    for (i = 0; i < ce->ce_words; i++)
+      sum += slot[i];
+    rg->rg_words += ce->ce_words;
+    das_ring_reap(&rg->rg_ctl, 1);
+    das_ring_submit(&rg->rg_ctl, 1);
+  }
+  return (void *)(uintptr_t)sum;
+}
+
+/* RING_NSLOT slots of slotwords through dasring.h for -t ms */
+static void
+ring_point(unsigned int slotwords)
+{
+  struct ring *rg;
+  pthread_t pt, ct;
+  struct timespec ts;
+  uint64_t t0, ns;
+
+  rg = calloc(1, sizeof(*rg));
+  if (rg == NULL ||
+      (rg->rg_slots = calloc(RING_NSLOT, slotwords * sizeof(uint32_t))) ==
+      NULL) {
+    free(rg);
+    perror("dasbench");
+    return;
+  }
+  das_ring_init(&rg->rg_ctl, &rg->rg_prod, RING_NSLOT, slotwords, 0);
+  t0 = now();
+  pthread_create(&ct, NULL, ring_consume, rg);
+  pthread_create(&pt, NULL, ring_produce, rg);
+  ts.tv_sec = run_ms / 1000;
+  ts.tv_nsec = (run_ms % 1000) * 1000000L;
+  nanosleep(&ts, NULL);
+  rg->rg_done = 1;
+  pthread_join(pt, NULL);
+  pthread_join(ct, NULL);
+  ns = now() - t0;
+  printf("%s    {\"scenario\": \"ring\", \"slots\": %u, "
+	 "\"slot_samples\": %u,\n"
+	 "     \"seconds\": %.3f, \"samples\": %llu, \"samples_s\": %.0f, "
+	 "\"ns_per_sample\": %.3f,\n"
+	 "     \"producer_yields\": %llu, "
+	 "\"consumer_yields\": %llu}", first ? "" : ",\n", RING_NSLOT,
+	 slotwords, ns / 1e9, (unsigned long long)rg->rg_words,
+	 rg->rg_words * 1e9 / ns,
+	 rg->rg_words ? (double)ns / rg->rg_words : 0,
+	 (unsigned long long)rg->rg_pwaits, (unsigned long long)rg->rg_cwaits);
+  first = 0;
+  fflush(stdout);
+  free(rg->rg_slots);
+  free(rg);
+}
+
+/* Channel 0's latest sample, by ioctl or mapped, for -t ms of sampling */
+static void
+latest_point(unsigned int count, int map)
+{
+  uint64_t t0, ns, calls = 0, fresh = 0;
+  uint32_t sample, nsamp, last = 0;
+  void *h;
+  int error, opened;
+
+  error = (*drv->dd_open)(0, O_RDWR, &h);
+  opened = error == 0;
+  if (error == 0 && (error = (*drv->dd_set_channel)(h, 0)) == 0 &&
+      (error = (*drv->dd_pacer)(h, count)) == 0)
+    error = (*drv->dd_start)(h);
+  t0 = now();
+  while (error == 0 && now() - t0 < run_ms * 1000000ULL) {
+    error = (*drv->dd_latest)(h, map, 0, &sample, &nsamp);
+    if (error == 0 && (calls == 0 || nsamp != last))
+      fresh++;
+    last = nsamp;
+    calls++;
+  }
+  ns = now() - t0;
+  if (opened) {
+    (void)(*drv->dd_stop)(h);
+    (void)(*drv->dd_close)(h);
+  }
+  printf("%s    {\"scenario\": \"latest\", \"via\": \"%s\", "
+	 "\"count\": %u,\n", first ? "" : ",\n",
+	 map ? "mapped" : "ioctl", count);
+  first = 0;
+  if (error)
+    printf("     \"error\": \"%s\",\n", strerror(error));
+  printf("     \"seconds\": %.3f, \"calls\": %llu, \"ns_per_call\": %.1f, "
+	 "\"fresh\": %llu}", ns / 1e9, (unsigned long long)calls,
+	 calls ? (double)ns / calls : 0, (unsigned long long)fresh);
+  fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+  static const unsigned int maxcounts[] = { 4125, 825, 413, 206, 103, 83, 41 };
+  static const unsigned int nreads[] = { 1, 4, 16, 64, 256, 1024, 4096 };
+  static const unsigned int stalls[] = { 0, 20, 100, 200, 400 };
+  static const unsigned int nreaders[] = { 1, 2, MAXREADER };
+  static const unsigned int nops[] = { 1, 4, 16, 64, DASDRV_REGBATCH_MAX };
+  static const unsigned int every[] = { 0, 1024, 16 };
+  static const unsigned int slotwords[] = { 64, 512, 4096 };
+  static const char *all =
+    "max,readsize,stall,readers,boards,mapped,batch,parser,ring,latest";
+  const char *backend = "netbsd", *scens = all, *recpath = NULL;
+  struct point base, pt;
+  struct meas ms;
+  double best = 0, one = 0;
+  char *list, *scen;
+  uint32_t *words;
+  unsigned int count = 825, nread = 64, i;
+  int ch, error, b;
+
+  while ((ch = getopt(argc, argv, "B:b:c:n:s:t:w:")) != -1) {
+    switch (ch) {
+    case 'B':
+      nboard = strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      backend = optarg;
+      break;
+    case 'c':
+      count = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      nread = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      scens = optarg;
+      break;
+    case 't':
+      run_ms = strtoul(optarg, NULL, 0);
+      break;
+    case 'w':
+      recpath = optarg;
+      break;
+    default:
+    usage:
+      fprintf(stderr, "usage: dasbench [-b netbsd|wdf|dev[:prefix]|"
+	      "replay:file] [-s scenario,...]\n"
+	      "                [-c count] [-n samples] [-t ms] "
+	      "[-B boards] [-w file]\n"
+	      "scenarios: %s\n", all);
+      return 1;
+    }
+  }
+  if (count < 2 || count > 65535 || nread == 0 || run_ms == 0 ||
+      nboard < 1 || nboard > DASSHIM_MAXBOARD) {
+    fprintf(stderr, "dasbench: count is 2-65535, boards 1-%d, samples "
+	    "and time at least 1\n", DASSHIM_MAXBOARD);
+    return 1;
+  }
+  list = strdup(scens);
+  if (list == NULL) {
+    perror("dasbench");
+    return 1;
+  }
+  for (scen = strtok(list, ","); scen != NULL; scen = strtok(NULL, ",")) {
+    for (i = 0; i < NSCEN && strcmp(scen, scenarios[i]) != 0; i++)
+      ;
+    if (i == NSCEN) {
+      fprintf(stderr, "dasbench: no scenario %s\n", scen);
+      return 1;
+    }
+  }
+  strcpy(list, scens);
+
+  if (strcmp(backend, "netbsd") == 0 || strcmp(backend, "wdf") == 0) {
+    drv = strcmp(backend, "wdf") == 0 ? &dasdrv_wdf : &dasdrv_netbsd;
+    emu = 1;
+    for (b = 0; b < nboard; b++) {
+      error = (*drv->dd_attach)(dasshim_board_add());
+      if (error) {
+	fprintf(stderr, "dasbench: %s attach: %s\n", backend,
+		strerror(error));
+	return 1;
+      }
+    }
+    dasshim_start();
+  }
+  else if (strncmp(backend, "dev", 3) == 0 &&
+	   (backend[3] == '\0' || backend[3] == ':')) {
+    drv = &dasdrv_dev;
+    if (backend[3] == ':')
+      dasdev_prefix = backend + 4;
+  }
+  else if (strncmp(backend, "replay:", 7) == 0) {
+    drv = &dasdrv_replay;
+    error = dasreplay_load(backend + 7);
+    if (error) {
+      fprintf(stderr, "dasbench: %s: %s\n", backend + 7, strerror(error));
+      return 1;
+    }
+  }
+  else
+    goto usage;
+  if (recpath != NULL && (rec = fopen(recpath, "wb")) == NULL) {
+    perror(recpath);
+    return 1;
+  }
+
+  memset(&base, 0, sizeof(base));
+  base.pt_count = count;
+  base.pt_nread = nread;
+  base.pt_readers = 1;
+  base.pt_boards = 1;
+  printf("{\"tool\": \"dasbench\", \"build\": \"%s\", \"backend\": \"%s\", "
+	 "\"point_ms\": %u,\n \"points\": [\n", DASBENCH_BUILD, drv->dd_name,
+	 run_ms);
+  for (scen = strtok(list, ","); scen != NULL; scen = strtok(NULL, ",")) {
+    pt = base;
+    pt.pt_scen = scen;
+    if (strcmp(scen, "max") == 0) {
+      for (i = 0; i < sizeof(maxcounts) / sizeof(maxcounts[0]); i++) {
+	pt.pt_count = maxcounts[i];
+	point(&pt, &ms);
+	if (ms.ms_error == 0 && ms.ms_overrun == 0 && ms.ms_missed == 0 &&
+	    ms.ms_samples * 1e9 / ms.ms_ns >=
+	    0.98 * DASEMU_TICK_HZ / pt.pt_count)
+	  best = (double)DASEMU_TICK_HZ / pt.pt_count;
+	free(ms.ms_lat);
+      }
+    }
+    else if (strcmp(scen, "readsize") == 0) {
+      for (i = 0; i < sizeof(nreads) / sizeof(nreads[0]); i++) {
+	pt.pt_nread = nreads[i];
+	point(&pt, &ms);
+	free(ms.ms_lat);
+      }
+    }
+    else if (strcmp(scen, "stall") == 0) {
+      for (i = 0; i < sizeof(stalls) / sizeof(stalls[0]); i++) {
+	pt.pt_stall = stalls[i];
+	point(&pt, &ms);
+	free(ms.ms_lat);
+      }
+    }
+    else if (strcmp(scen, "readers") == 0) {
+      for (i = 0; i < sizeof(nreaders) / sizeof(nreaders[0]); i++) {
+	pt.pt_readers = nreaders[i];
+	point(&pt, &ms);
+	free(ms.ms_lat);
+      }
+    }
+    else if (strcmp(scen, "boards") == 0) {
+      for (b = 1; b <= nboard; b = b < 2 || b == nboard ? b + 1 : nboard) {
+	pt.pt_boards = b;
+	point(&pt, &ms);
+	free(ms.ms_lat);
+      }
+    }
+    else if (strcmp(scen, "mapped") == 0) {
+      if (drv->dd_map == NULL) {
+	skip(scen, "mapped ring");
+	continue;
+      }
+      pt.pt_mapped = 1;
+      point(&pt, &ms);
+      free(ms.ms_lat);
+    }
+    else if (strcmp(scen, "parser") == 0) {
+      if ((words = malloc(PARSE_WORDS * sizeof(*words))) == NULL) {
+	perror("dasbench");
+	return 1;
+      }
+      for (i = 0; i < sizeof(every) / sizeof(every[0]); i++) {
+	parse_point(words, every[i], 64);
+	parse_point(words, every[i], 4096);
+	parse_point(words, every[i], 0);
+      }
+      free(words);
+    }
+    else if (strcmp(scen, "ring") == 0) {
+      for (i = 0; i < sizeof(slotwords) / sizeof(slotwords[0]); i++)
+	ring_point(slotwords[i]);
+    }
+    else if (strcmp(scen, "latest") == 0) {
+      if (drv->dd_latest == NULL) {
+	skip(scen, "latest page");
+	continue;
+      }
+      latest_point(count, 0);
+      latest_point(count, 1);
+    }
+    else {
+      if (drv->dd_regbatch == NULL) {
+	skip(scen, "register batch");
+	continue;
+      }
+      for (i = 0; i < sizeof(nops) / sizeof(nops[0]); i++)
+	batch_point(nops[i], &one);
+    }
+  }
+  printf("\n ]");
+  if (strstr(scens, "max") != NULL)
+    printf(",\n \"max_sustained_hz\": %.1f", best);
+  printf("\n}\n");
+  free(list);
+  if (rec != NULL)
+    fclose(rec);
+  if (emu)
+    dasshim_stop();
+  return 0;
+}
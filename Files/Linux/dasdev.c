@@ -0,0 +1,191 @@
+/* dasdev.c -- a real board through its device node, see dasdrv.h */
+/*
+ * das.c's ioctls on /dev/das<unit>, so on a NetBSD rig dasbench drives
+ * the driver in the kernel the same way it drives the shimmed one.
+ */
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dasio.h"
+#include "daslatest.h"
+#include "shim/dasdrv.h"
+
+const char *dasdev_prefix = "/dev/das";
+
+struct dev {
+  int de_fd;
+  const struct das_latest *de_latest;	/* mapped on first use */
+};
+
+static int
+dev_open(int unit, int flags, void **hp)
+{
+  char path[256];
+  struct dev *de;
+
+  snprintf(path, sizeof(path), "%s%d", dasdev_prefix, unit);
+  de = calloc(1, sizeof(*de));
+  if (de == NULL)
+    return ENOMEM;
+  de->de_fd = open(path, flags);
+  if (de->de_fd < 0) {
+    free(de);
+    return errno;
+  }
+  *hp = de;
+  return 0;
+}
+
+static int
+dev_close(void *h)
+{
+  struct dev *de = h;
+  int error;
+
+  if (de->de_latest != NULL)
+    (void)munmap((void *)(uintptr_t)de->de_latest,
+		  sizeof(struct das_latest));
+  error = close(de->de_fd) < 0 ? errno : 0;
+  free(de);
+  return error;
+}
+
+static int
+dev_ioctl(void *h, unsigned long cmd, void *data)
+{
+  return ioctl(((struct dev *)h)->de_fd, cmd, data) < 0 ? errno : 0;
+}
+
+static int
+dev_pacer(void *h, unsigned int count)
+{
+  int rate = count;
+
+  return dev_ioctl(h, DAS_SET_RATE, &rate);
+}
+
+static int
+dev_set_channel(void *h, int ch)
+{
+  return dev_ioctl(h, DAS_SET_CHANNEL, &ch);
+}
+
+static int
+dev_get_channel(void *h, int *ch)
+{
+  return dev_ioctl(h, DAS_GET_CHANNEL, ch);
+}
+
+static int
+dev_start(void *h)
+{
+  return dev_ioctl(h, DAS_START_SAMPLING, NULL);
+}
+
+static int
+dev_stop(void *h)
+{
+  return dev_ioctl(h, DAS_STOP_SAMPLING, NULL);
+}
+
+static ssize_t
+dev_read(void *h, void *buf, size_t len)
+{
+  ssize_t n = read(((struct dev *)h)->de_fd, buf, len);
+
+  return n < 0 ? -errno : n;
+}
+
+static int
+dev_stats(void *h, struct dasdrv_stats *dv)
+{
+  struct das_stats ds;
+  int error;
+
+  error = dev_ioctl(h, DAS_GET_STATS, &ds);
+  if (error)
+    return error;
+  dv->dv_intr = ds.ds_intr;
+  dv->dv_samples = ds.ds_samples;
+  dv->dv_overrun = ds.ds_overrun;
+  return 0;
+}
+
+static int
+dev_regbatch(void *h, struct dasdrv_regop *dr, unsigned int n)
+{
+  struct das_regop ops[DAS_REGBATCH_MAX];
+  struct das_regbatch rb;
+  unsigned int i;
+  int error;
+
+  if (n > DAS_REGBATCH_MAX)
+    return EINVAL;
+  memset(ops, 0, n * sizeof(ops[0]));
+  for (i = 0; i < n; i++) {
+    ops[i].ro_op = dr[i].dr_op;
+    ops[i].ro_bar = dr[i].dr_bar;
+    ops[i].ro_off = dr[i].dr_off;
+    ops[i].ro_mask = dr[i].dr_mask;
+    ops[i].ro_val = dr[i].dr_val;
+  }
+  rb.rb_nops = n;
+  rb.rb_done = 0;
+  rb.rb_ops = ops;
+  error = dev_ioctl(h, DAS_REGISTER_BATCH, &rb);
+  for (i = 0; error == 0 && i < rb.rb_done; i++)
+    dr[i].dr_result = ops[i].ro_result;
+  return error;
+}
+
+static int
+dev_latest(void *h, int map, unsigned int chan, uint32_t *sample,
+	   uint32_t *nsamp)
+{
+  struct dev *de = h;
+  struct das_latest_snap ls;
+  struct das_latest_val lv;
+  void *p;
+  int error;
+
+  if (chan >= DAS_NCHAN)
+    return EINVAL;
+  if (!map) {
+    error = dev_ioctl(h, DAS_GET_LATEST, &ls);
+    if (error)
+      return error;
+    lv = ls.ls_chan[chan];
+  } else {
+    if (de->de_latest == NULL) {
+      p = mmap(NULL, sizeof(struct das_latest), PROT_READ, MAP_SHARED,
+	       de->de_fd, DAS_LATEST_OFFSET);
+      if (p == MAP_FAILED)
+	return errno;
+      de->de_latest = p;
+    }
+    das_latest_read(de->de_latest, chan, &lv);
+  }
+  *sample = lv.dv_sample;
+  *nsamp = lv.dv_nsamp;
+  return 0;
+}
+
+const struct dasdrv dasdrv_dev = {
+  .dd_name = "dev",
+  .dd_open = dev_open,
+  .dd_close = dev_close,
+  .dd_pacer = dev_pacer,
+  .dd_set_channel = dev_set_channel,
+  .dd_get_channel = dev_get_channel,
+  .dd_start = dev_start,
+  .dd_stop = dev_stop,
+  .dd_read = dev_read,
+  .dd_stats = dev_stats,
+  .dd_regbatch = dev_regbatch,
+  .dd_latest = dev_latest,
+};
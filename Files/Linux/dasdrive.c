@@ -0,0 +1,233 @@
+/* dasdrive -- run das.c or the das1 driver, unchanged, on an emulated board
+ *
+ * usage: dasdrive [-d netbsd|wdf] [-c count] [-n samples] [-t ms]
+ *
+ * The driver is built against its shim in shim/ and attached to a
+ * dasemu board that runs in real time on the shim's interrupt thread.
+ * First the open, ioctl, read and interrupt sequences every program
+ * relies on are checked: a second writer is refused, the channel reads
+ * back, a read with sampling off returns nothing, and an interrupt the
+ * board did not raise is not claimed.  Then it samples for -t ms with
+ * the pacer at counter 2 reload -c, reading -n samples at a time, and
+ * reports the sample rate, read latency, the ISR's host cost, and the
+ * samples the board or the driver lost.  Every channel has its own DC
+ * level, so each sample read is checked too, except the first: a
+ * driver that does not start a conversion with sampling hands back
+ * whatever the ADC last held, which is reported.  Exits 1 if a check
+ * failed or a sample was wrong.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dasemu.h"
+#include "shim/dasshim.h"
+#include "shim/dasdrv.h"
+
+#define CHANNEL 3
+
+static int failed;
+
+static void
+check(const char *what, int ok)
+{
+  printf("%-40s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok)
+    failed++;
+}
+
+static int
+level(int chan)
+{
+  return 256 + 448 * chan;
+}
+
+static int
+cmp64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static double
+pct(const uint64_t *v, size_t n, double p)
+{
+  return n ? v[(size_t)(p * (n - 1))] / 1000.0 : 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  const struct dasdrv *drv = &dasdrv_netbsd;
+  struct dasshim_board *sb;
+  struct dasemu_wave dw;
+  struct dasdrv_stats dv;
+  struct dasemu_stats es;
+  uint64_t *lat = NULL, t0, t, end, bad = 0, samples = 0, drained = 0;
+  uint64_t isrs, isr_ns, isr_max;
+  size_t nlat = 0, maxlat = 0;
+  unsigned int count = 825, nsamp = 64, ms = 1000, i;
+  uint32_t *buf;
+  void *h, *h2;
+  ssize_t n;
+  int ch, chan, error, first = -1;
+
+  while ((ch = getopt(argc, argv, "c:d:n:t:")) != -1) {
+    switch (ch) {
+    case 'c':
+      count = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      if (strcmp(optarg, dasdrv_netbsd.dd_name) == 0)
+	drv = &dasdrv_netbsd;
+      else if (strcmp(optarg, dasdrv_wdf.dd_name) == 0)
+	drv = &dasdrv_wdf;
+      else
+	goto usage;
+      break;
+    case 'n':
+      nsamp = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      ms = strtoul(optarg, NULL, 0);
+      break;
+    default:
+    usage:
+      fprintf(stderr, "usage: dasdrive [-d netbsd|wdf] [-c count] "
+	      "[-n samples] [-t ms]\n");
+      return 1;
+    }
+  }
+  if (count < 2 || count > 65535 || nsamp == 0) {
+    fprintf(stderr, "dasdrive: count is 2-65535, samples at least 1\n");
+    return 1;
+  }
+  buf = calloc(nsamp, sizeof(*buf));
+  if (buf == NULL) {
+    perror("dasdrive");
+    return 1;
+  }
+
+  sb = dasshim_board_add();
+  memset(&dw, 0, sizeof(dw));
+  dw.dw_type = DASEMU_WAVE_DC;
+  for (i = 0; i < DASEMU_NCHAN; i++) {
+    dw.dw_offset = level(i);
+    dasemu_set_wave(&sb->sb_emu, i, &dw);
+  }
+  error = (*drv->dd_attach)(sb);
+  if (error) {
+    fprintf(stderr, "dasdrive: %s attach: %s\n", drv->dd_name,
+	    strerror(error));
+    return 1;
+  }
+  dasshim_start();
+  printf("driver %s, count %u (%.1f Hz), %u ms, %u samples per read\n",
+	 drv->dd_name, count, (double)DASEMU_TICK_HZ / count, ms, nsamp);
+
+  error = (*drv->dd_open)(0, O_RDWR, &h);
+  check("open", error == 0);
+  if (error)
+    goto out;
+  error = (*drv->dd_open)(0, O_RDWR, &h2);
+  check("second writer refused", error == EBUSY);
+  if (error == 0)
+    (*drv->dd_close)(h2);
+  chan = -1;
+  error = (*drv->dd_set_channel)(h, CHANNEL);
+  if (error == 0)
+    error = (*drv->dd_get_channel)(h, &chan);
+  check("channel reads back", error == 0 && chan == CHANNEL);
+  n = (*drv->dd_read)(h, buf, nsamp * sizeof(*buf));
+  check("read with sampling off is empty", n == 0);
+  // the line is down, so this one is not the board's
+  dasshim_intr_lock();
+  dasshim_lock(sb);
+  error = (*sb->sb_isr)(sb->sb_isr_arg);
+  dasshim_unlock(sb);
+  dasshim_intr_unlock();
+  check("foreign interrupt not claimed", error == 0);
+
+  error = (*drv->dd_pacer)(h, count);
+  if (error == 0)
+    error = (*drv->dd_start)(h);
+  check("start", error == 0);
+  t0 = dasshim_ns();
+  end = t0 + (uint64_t)ms * 1000000;
+  while (error == 0 && (t = dasshim_ns()) < end) {
+    n = (*drv->dd_read)(h, buf, nsamp * sizeof(*buf));
+    if (n < 0) {
+      error = -n;
+      break;
+    }
+    if (nlat == maxlat) {
+      maxlat = maxlat ? 2 * maxlat : 1024;
+      lat = realloc(lat, maxlat * sizeof(*lat));
+      if (lat == NULL) {
+	perror("dasdrive");
+	return 1;
+      }
+    }
+    lat[nlat++] = dasshim_ns() - t;
+    for (i = 0; i < n / sizeof(*buf); i++) {
+      if (samples == 0 && i == 0) {
+	first = buf[0] & 0xfff;
+	continue;
+      }
+      if ((buf[i] & 0xfff) != level(CHANNEL))
+	bad++;
+    }
+    samples += n / sizeof(*buf);
+  }
+  t = dasshim_ns() - t0;
+  check("sampling reads", error == 0);
+  error = (*drv->dd_stop)(h);
+  check("stop", error == 0);
+  // what was still buffered, then nothing
+  while ((n = (*drv->dd_read)(h, buf, nsamp * sizeof(*buf))) > 0) {
+    for (i = 0; i < n / sizeof(*buf); i++)
+      if ((buf[i] & 0xfff) != level(CHANNEL))
+	bad++;
+    drained += n / sizeof(*buf);
+  }
+  check("drained after stop", n == 0);
+  check("samples are the channel's level", bad == 0);
+  // an ISR reads the conversion the one before it started
+  printf("%-40s %s\n", "first sample after start",
+	 first == level(CHANNEL) ? "fresh" : "stale, not counted");
+  memset(&dv, 0, sizeof(dv));
+  (void)(*drv->dd_stats)(h, &dv);
+  error = (*drv->dd_close)(h);
+  check("close", error == 0);
+
+  dasshim_lock(sb);
+  es = sb->sb_emu.de_stats;
+  isrs = sb->sb_isrs;
+  isr_ns = sb->sb_isr_ns;
+  isr_max = sb->sb_isr_max_ns;
+  dasshim_unlock(sb);
+  qsort(lat, nlat, sizeof(*lat), cmp64);
+  printf("samples/s        %12.1f\n", samples * 1e9 / t);
+  printf("samples          %12llu (+%llu after stop)\n",
+	 (unsigned long long)samples, (unsigned long long)drained);
+  printf("reads            %12zu\n", nlat);
+  printf("read us p50/p99/max %9.1f %9.1f %9.1f\n", pct(lat, nlat, 0.50),
+	 pct(lat, nlat, 0.99), pct(lat, nlat, 1.0));
+  printf("isr calls        %12llu\n", (unsigned long long)isrs);
+  printf("isr ns mean/max  %12.0f %9llu\n",
+	 isrs ? (double)isr_ns / isrs : 0, (unsigned long long)isr_max);
+  printf("pacer ticks      %12llu\n", (unsigned long long)es.es_pacer);
+  printf("missed ticks     %12llu\n", (unsigned long long)es.es_missed);
+  printf("driver intr/samples/overrun %llu %llu %llu\n",
+	 (unsigned long long)dv.dv_intr, (unsigned long long)dv.dv_samples,
+	 (unsigned long long)dv.dv_overrun);
+out:
+  dasshim_stop();
+  free(lat);
+  free(buf);
+  return failed != 0;
+}
@@ -0,0 +1,453 @@
+/* dasemu.c -- PCI-DAS08 register-level emulator, see dasemu.h */
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "dasio.h"
+#include "dasemu.h"
+
+#define INTCSR_LINT1_EN 0x01
+#define INTCSR_LINT1_STAT 0x04
+#define INTCSR_PCI_EN 0x40
+#define NEVER UINT64_MAX
+
+void
+dasemu_init(struct dasemu *de)
+{
+  int i;
+
+  memset(de, 0, sizeof(*de));
+  de->de_io_ticks = 4;		/* about 1 us */
+  de->de_conv_ticks = 41;	/* about 10 us */
+  de->de_irq_ticks = 8;		/* about 2 us */
+  de->de_seed = 0x9e3779b97f4a7c15ULL;
+  for (i = 0; i < DASEMU_NCHAN; i++) {
+    de->de_wave[i].dw_type = DASEMU_WAVE_DC;
+    de->de_wave[i].dw_offset = 2048;
+  }
+  for (i = 0; i < 3; i++) {
+    de->de_ctr[i].ec_reload = 65536;
+    de->de_ctr[i].ec_next = NEVER;
+  }
+}
+
+void
+dasemu_set_wave(struct dasemu *de, int chan, const struct dasemu_wave *dw)
+{
+  de->de_wave[chan & DAS_CTR1_MUX] = *dw;
+  de->de_source[chan & DAS_CTR1_MUX] = NULL;
+}
+
+void
+dasemu_set_source(struct dasemu *de, int chan, dasemu_source_t *fn, void *arg)
+{
+  de->de_source[chan & DAS_CTR1_MUX] = fn;
+  de->de_source_arg[chan & DAS_CTR1_MUX] = arg;
+}
+
+/* Edge rate into counter 0 or 1 from now on; the count carries on. */
+void
+dasemu_set_input_hz(struct dasemu *de, int n, double hz)
+{
+  struct dasemu_ctr *ec = &de->de_ctr[n & 1];
+
+  // the edges so far keep the rate they came at
+  ec->ec_base += (uint64_t)((double)(de->de_now - ec->ec_t0) * ec->ec_hz /
+      DASEMU_TICK_HZ);
+  ec->ec_t0 = de->de_now;
+  ec->ec_hz = hz;
+}
+
+uint16_t
+dasemu_input(struct dasemu *de, int chan, uint64_t tick)
+{
+  const struct dasemu_wave *dw = &de->de_wave[chan];
+  double t = (double)tick / DASEMU_TICK_HZ, ph, v;
+
+  if (de->de_source[chan] != NULL)
+    return de->de_source[chan](de->de_source_arg[chan], chan, tick) & 0xfff;
+  ph = t * dw->dw_hz - floor(t * dw->dw_hz);
+  switch (dw->dw_type) {
+  case DASEMU_WAVE_SINE:
+    v = dw->dw_offset + dw->dw_amp * sin(2 * M_PI * ph);
+    break;
+  case DASEMU_WAVE_SQUARE:
+    v = dw->dw_offset + (ph < 0.5 ? dw->dw_amp : -dw->dw_amp);
+    break;
+  case DASEMU_WAVE_RAMP:
+    v = dw->dw_offset - dw->dw_amp + 2 * dw->dw_amp * ph;
+    break;
+  case DASEMU_WAVE_NOISE:
+    // xorshift64, the same sequence on every run
+    de->de_seed ^= de->de_seed << 13;
+    de->de_seed ^= de->de_seed >> 7;
+    de->de_seed ^= de->de_seed << 17;
+    v = dw->dw_offset +
+        dw->dw_amp * ((double)(de->de_seed >> 11) / (1ULL << 52) - 1);
+    break;
+  default:
+    v = dw->dw_offset;
+    break;
+  }
+  if (v < 0)
+    return 0;
+  if (v > 4095)
+    return 4095;
+  return (uint16_t)(v + 0.5);
+}
+
+/* Counter 2 terminal counts come on their own in these modes */
+static int
+periodic(const struct dasemu *de, const struct dasemu_ctr *ec)
+{
+  if ((de->de_flags & DASEMU_STRICT_PACER) == 0)
+    return 1;
+  return ec->ec_mode == 2 || ec->ec_mode == 3;
+}
+
+/* The count counter n would show now */
+static uint16_t
+count(const struct dasemu *de, int n)
+{
+  const struct dasemu_ctr *ec = &de->de_ctr[n];
+  uint64_t e;
+
+  if (!ec->ec_armed)
+    return 0;
+  e = de->de_now - ec->ec_t0;
+  if (n != 2)
+    e = ec->ec_base + (uint64_t)((double)e * ec->ec_hz / DASEMU_TICK_HZ);
+  if (n == 2 ? periodic(de, ec) : (ec->ec_mode == 2 || ec->ec_mode == 3))
+    return (uint16_t)(ec->ec_reload - e % ec->ec_reload);
+  return (uint16_t)(ec->ec_reload - e);
+}
+
+static void
+line(struct dasemu *de)
+{
+  int up = de->de_request && (de->de_ctr1 & DAS_CTR1_INTE) &&
+      (de->de_intcsr & (INTCSR_LINT1_EN | INTCSR_PCI_EN)) ==
+      (INTCSR_LINT1_EN | INTCSR_PCI_EN);
+
+  if (up && !de->de_line)
+    de->de_deliver = de->de_now + (de->de_irq_ticks ? de->de_irq_ticks : 1);
+  de->de_line = up;
+}
+
+static void
+pacer(struct dasemu *de)
+{
+  struct dasemu_ctr *ec = &de->de_ctr[2];
+
+  de->de_stats.es_pacer++;
+  if (de->de_ctr1 & DAS_CTR1_OP1) {
+    if (de->de_request)
+      de->de_stats.es_missed++;
+    else {
+      de->de_request = 1;
+      de->de_stats.es_requests++;
+      line(de);
+    }
+  }
+  // a count written during the period takes over at its end
+  if (ec->ec_pending != 0) {
+    ec->ec_reload = ec->ec_pending;
+    ec->ec_pending = 0;
+    ec->ec_t0 = de->de_now;
+  }
+  ec->ec_next = periodic(de, ec) ? de->de_now + ec->ec_reload : NEVER;
+}
+
+/*
+ * Move time on to t, through every conversion end and terminal count on
+ * the way.  With stop set it returns early once a request is raised,
+ * so dasemu_run can deliver it on time.
+ */
+static void
+advance(struct dasemu *de, uint64_t t, int stop)
+{
+  uint64_t next;
+
+  for (;;) {
+    next = t;
+    if (de->de_conv_end != 0 && de->de_conv_end < next)
+      next = de->de_conv_end;
+    if (de->de_ctr[2].ec_next < next)
+      next = de->de_ctr[2].ec_next;
+    de->de_now = next;
+    if (de->de_conv_end == next) {
+      de->de_adc = dasemu_input(de, de->de_conv_chan, de->de_conv_at);
+      de->de_conv_end = 0;
+    }
+    if (de->de_ctr[2].ec_next == next) {
+      pacer(de);
+      if (stop && de->de_line && !de->de_inirq)
+        break;
+    }
+    if (next == t)
+      break;
+  }
+  de->de_stats.es_ticks = de->de_now;
+}
+
+void
+dasemu_spend(struct dasemu *de, uint64_t ticks)
+{
+  advance(de, de->de_now + ticks, 0);
+}
+
+static void
+load(struct dasemu *de, int n, uint32_t c)
+{
+  struct dasemu_ctr *ec = &de->de_ctr[n];
+
+  if (c == 0)
+    c = 65536;
+  if (n == 2 && ec->ec_armed && (ec->ec_mode == 2 || ec->ec_mode == 3)) {
+    ec->ec_pending = c;
+    return;
+  }
+  ec->ec_reload = c;
+  ec->ec_pending = 0;
+  ec->ec_t0 = de->de_now;
+  ec->ec_base = 0;
+  ec->ec_armed = 1;
+  if (n == 2)
+    ec->ec_next = de->de_now + c;
+}
+
+static void
+control(struct dasemu *de, uint8_t v)
+{
+  int n = v >> 6;
+  struct dasemu_ctr *ec;
+
+  if (n == 3)
+    return;	/* read-back, not used by the drivers */
+  ec = &de->de_ctr[n];
+  if ((v & DAS_8254_RW_LH) == 0) {
+    if (!ec->ec_latched) {
+      ec->ec_latch = count(de, n);
+      ec->ec_latched = 1;
+      ec->ec_rbyte = 0;
+    }
+    return;
+  }
+  ec->ec_rw = (v & DAS_8254_RW_LH) >> 4;
+  ec->ec_mode = (v >> 1) & 7;
+  if (ec->ec_mode > 5)
+    ec->ec_mode -= 4;
+  ec->ec_wbyte = 0;
+  ec->ec_rbyte = 0;
+  ec->ec_latched = 0;
+  ec->ec_armed = 0;
+  ec->ec_pending = 0;
+  if (n == 2)
+    ec->ec_next = NEVER;
+}
+
+static void
+ctr_write(struct dasemu *de, int n, uint8_t v)
+{
+  struct dasemu_ctr *ec = &de->de_ctr[n];
+
+  switch (ec->ec_rw) {
+  case 1:
+    load(de, n, v);
+    break;
+  case 2:
+    load(de, n, (uint32_t)v << 8);
+    break;
+  case 3:
+    if (!ec->ec_wbyte) {
+      ec->ec_wlow = v;
+      ec->ec_wbyte = 1;
+    } else {
+      load(de, n, ec->ec_wlow | (uint32_t)v << 8);
+      ec->ec_wbyte = 0;
+    }
+    break;
+  }
+}
+
+static uint8_t
+ctr_read(struct dasemu *de, int n)
+{
+  struct dasemu_ctr *ec = &de->de_ctr[n];
+  uint16_t c = ec->ec_latched ? ec->ec_latch : count(de, n);
+  uint8_t v;
+
+  if (ec->ec_rw == 2 || (ec->ec_rw == 3 && ec->ec_rbyte))
+    v = c >> 8;
+  else
+    v = c & 0xff;
+  if (ec->ec_rw == 3 && !ec->ec_rbyte)
+    ec->ec_rbyte = 1;
+  else {
+    ec->ec_rbyte = 0;
+    ec->ec_latched = 0;
+  }
+  return v;
+}
+
+/* Every access takes de_io_ticks and sees the board at its end. */
+uint8_t
+dasemu_read_1(struct dasemu *de, int bar, uint32_t off)
+{
+  if (bar != DASEMU_BADR2)
+    return (uint8_t)(dasemu_read_4(de, bar, off & ~3) >> (8 * (off & 3)));
+  advance(de, de->de_now + de->de_io_ticks, 0);
+  de->de_stats.es_reads++;
+  switch (off) {
+  case DAS_ADC_HIGH:
+  case DAS_ADC_LOW:
+    if (de->de_conv_end != 0)
+      de->de_stats.es_stale++;
+    return off == DAS_ADC_HIGH ? (de->de_adc & 0xf) << 4 : de->de_adc >> 4;
+  case CTR1:
+    return (de->de_ctr1 & DAS_CTR1_MUX) |
+        (de->de_request ? DAS_CTR1_INTE : 0) |
+        ((de->de_dio << DAS_CTR1_IP_SHIFT) & DAS_CTR1_IP) |
+        (de->de_conv_end != 0 ? EOC : 0);
+  case DAS_CNT0:
+  case DAS_CNT0 + 1:
+  case DAS_CNT0 + 2:
+    return ctr_read(de, off - DAS_CNT0);
+  }
+  return 0xff;
+}
+
+void
+dasemu_write_1(struct dasemu *de, int bar, uint32_t off, uint8_t v)
+{
+  uint8_t old;
+
+  advance(de, de->de_now + de->de_io_ticks, 0);
+  de->de_stats.es_writes++;
+  if (bar != DASEMU_BADR2)
+    return;
+  switch (off) {
+  case DAS_ADC_LOW:
+    if (de->de_conv_end != 0)
+      de->de_stats.es_conv_restart++;
+    de->de_stats.es_conv++;
+    de->de_conv_chan = de->de_ctr1 & DAS_CTR1_MUX;
+    de->de_conv_at = de->de_now;
+    de->de_conv_end = de->de_now + (de->de_conv_ticks ? de->de_conv_ticks : 1);
+    break;
+  case CTR1:
+    old = de->de_ctr1;
+    de->de_ctr1 = v;
+    de->de_request = 0;
+    line(de);
+    if (((old ^ v) & ~(DAS_CTR1_MUX | DAS_CTR1_INTE)) && de->de_out != NULL)
+      de->de_out(de->de_arg, v >> DAS_CTR1_OP_SHIFT, de->de_now);
+    break;
+  case DAS_CNT0:
+  case DAS_CNT0 + 1:
+  case DAS_CNT0 + 2:
+    ctr_write(de, off - DAS_CNT0, v);
+    break;
+  case CTR2:
+    control(de, v);
+    break;
+  }
+}
+
+uint32_t
+dasemu_read_4(struct dasemu *de, int bar, uint32_t off)
+{
+  if (bar == DASEMU_BADR2)
+    return dasemu_read_1(de, bar, off);
+  advance(de, de->de_now + de->de_io_ticks, 0);
+  de->de_stats.es_reads++;
+  switch (off) {
+  case DAS_BADR1_INTCSR:
+    return (de->de_intcsr & ~INTCSR_LINT1_STAT) |
+        (de->de_line ? INTCSR_LINT1_STAT : 0);
+  case DAS_BADR1_CNTRL:
+    return de->de_cntrl;
+  }
+  return 0;
+}
+
+void
+dasemu_write_4(struct dasemu *de, int bar, uint32_t off, uint32_t v)
+{
+  if (bar == DASEMU_BADR2) {
+    dasemu_write_1(de, bar, off, (uint8_t)v);
+    return;
+  }
+  advance(de, de->de_now + de->de_io_ticks, 0);
+  de->de_stats.es_writes++;
+  switch (off) {
+  case DAS_BADR1_INTCSR:
+    de->de_intcsr = v;
+    line(de);
+    break;
+  case DAS_BADR1_CNTRL:
+    de->de_cntrl = v;
+    break;
+  }
+}
+
+static uint64_t
+wallns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+pace(struct dasemu *de)
+{
+  uint64_t at = de->de_wall0 + dasemu_ns(de->de_now);
+  struct timespec ts;
+
+  if (wallns() >= at)
+    return;
+  ts.tv_sec = at / 1000000000;
+  ts.tv_nsec = at % 1000000000;
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/*
+ * Run the board for ticks, calling the irq hook for every request that
+ * gets through.  The hook may run past the end; the next run carries on
+ * from wherever it left the time.
+ */
+void
+dasemu_run(struct dasemu *de, uint64_t ticks)
+{
+  uint64_t end = de->de_now + ticks, t, at;
+
+  if ((de->de_flags & DASEMU_REALTIME) && de->de_wall0 == 0)
+    de->de_wall0 = wallns() - dasemu_ns(de->de_now);
+  while (de->de_now < end) {
+    if (de->de_line && de->de_now >= de->de_deliver && de->de_irq != NULL) {
+      if (de->de_flags & DASEMU_REALTIME)
+        pace(de);
+      at = de->de_now;
+      de->de_inirq = 1;
+      de->de_irq(de->de_arg);
+      de->de_inirq = 0;
+      t = de->de_now - at;
+      de->de_stats.es_irqs++;
+      de->de_stats.es_irq_ticks += t;
+      if (t > de->de_stats.es_irq_max)
+        de->de_stats.es_irq_max = t;
+      // still up: a level-triggered line comes straight back
+      if (de->de_line)
+        de->de_deliver = de->de_now + (de->de_irq_ticks ? de->de_irq_ticks : 1);
+      continue;
+    }
+    t = end;
+    if (de->de_line && de->de_irq != NULL && de->de_deliver < t)
+      t = de->de_deliver;
+    advance(de, t, 1);
+  }
+  if (de->de_flags & DASEMU_REALTIME)
+    pace(de);
+}
@@ -0,0 +1,157 @@
+/* dasemu.h -- PCI-DAS08 register-level emulator for Linux */
+/*
+ * The board as das.c and Queue.c see it, in virtual time.  One tick is
+ * a period of the 4.125 MHz board clock (CLOCK_SPEED kHz), which also
+ * clocks the 8254's counter 2, so every count the drivers latch and
+ * every interval they measure comes out exact.
+ *
+ * BADR1: INTCSR (0x4c) and CNTRL (0x50) hold what is written.  The
+ *   interrupt reaches the host only with INTCSR bits 0 (LINTi1 enable)
+ *   and 6 (PCI interrupt enable) set; bit 2 reads back the line.
+ * BADR2: ADC low nibble (0x00, bits 4-7) and high byte (0x01; any
+ *   write starts a conversion of the channel in CTR1), CTR1 (0x02),
+ *   8254 counters 0-2 (0x04-0x06) and its control word (0x07).
+ * CTR1 write: MUX, INTE, OP1-OP4.  CTR1 read: MUX, the interrupt
+ *   request (bit 3), IP1-IP3 and EOC, set while a conversion runs.
+ *   Any CTR1 write clears the request.
+ * 8254: control words, latch commands, LSB/MSB sequencing and the
+ *   latch hold rules of the real part; a latched counter ignores a
+ *   second latch until both bytes are read.  Counter 2 is the pacer:
+ *   at each terminal count with OP1 set it raises the request, and one
+ *   that is still pending is a missed tick.  Counters 0 and 1 count
+ *   edges of an input of set frequency, for the frequency counter.
+ *
+ * Each port access costs de_io_ticks and a conversion de_conv_ticks.
+ * The interrupt is delivered as a call to the irq hook de_irq_ticks
+ * after the request goes up; the hook is the ISR and its own port
+ * accesses (and dasemu_spend) move time on, so time spent in it is
+ * what the ISR costs.  It is not reentered.  A request still up when
+ * it returns is delivered again, as a level-triggered line would be.
+ *
+ * dasemu_run drives time forward by itself; in DASEMU_REALTIME mode it
+ * also keeps virtual time from getting ahead of the host's clock.
+ */
+#ifndef _DASEMU_H_
+#define _DASEMU_H_
+
+#include <stdint.h>
+
+#define DASEMU_TICK_HZ 4125000	/* CLOCK_SPEED kHz */
+#define DASEMU_NCHAN 8
+
+#define DASEMU_BADR1 1	/* same as DAS_REGOP_BADR1 */
+#define DASEMU_BADR2 2
+
+#define DASEMU_REALTIME 0x01	/* de_flags: pace against CLOCK_MONOTONIC */
+#define DASEMU_STRICT_PACER 0x02	/* counter 2 modes 0 and 1 are one shot */
+
+/* Built-in inputs; codes are 0-4095 and clipped there. */
+#define DASEMU_WAVE_DC 0
+#define DASEMU_WAVE_SINE 1
+#define DASEMU_WAVE_SQUARE 2
+#define DASEMU_WAVE_RAMP 3
+#define DASEMU_WAVE_NOISE 4	/* uniform, dw_amp either side of dw_offset */
+
+struct dasemu_wave {
+  int dw_type;		/* DASEMU_WAVE_* */
+  double dw_offset;	/* codes */
+  double dw_amp;	/* codes, peak */
+  double dw_hz;
+};
+
+/* A channel's input at a tick, when the built-in ones will not do. */
+typedef uint16_t dasemu_source_t(void *, int, uint64_t);
+
+struct dasemu_stats {
+  uint64_t es_ticks;	/* virtual time */
+  uint64_t es_reads;	/* port reads */
+  uint64_t es_writes;	/* port writes */
+  uint64_t es_pacer;	/* counter 2 terminal counts */
+  uint64_t es_requests;	/* interrupt requests raised */
+  uint64_t es_missed;	/* terminal counts while a request was pending */
+  uint64_t es_irqs;	/* irq hook calls */
+  uint64_t es_irq_ticks;	/* time inside the irq hook */
+  uint64_t es_irq_max;	/* longest single call */
+  uint64_t es_conv;	/* conversions started */
+  uint64_t es_conv_restart;	/* started while one was running */
+  uint64_t es_stale;	/* ADC reads with a conversion running */
+};
+
+struct dasemu_ctr {
+  uint8_t ec_mode;	/* 8254 mode 0-5 */
+  uint8_t ec_rw;	/* 1 LSB, 2 MSB, 3 LSB then MSB */
+  uint8_t ec_wbyte;	/* next write is the MSB */
+  uint8_t ec_rbyte;	/* next read is the MSB */
+  uint8_t ec_latched;
+  uint8_t ec_armed;	/* a count has been loaded */
+  uint16_t ec_latch;
+  uint16_t ec_wlow;	/* LSB waiting for its MSB */
+  uint32_t ec_reload;	/* 1-65536 */
+  uint32_t ec_pending;	/* counter 2: reload for the next period, 0 if none */
+  uint64_t ec_t0;	/* tick the count was loaded */
+  uint64_t ec_base;	/* counters 0 and 1: edges before ec_t0 */
+  double ec_hz;		/* input edges per second; counter 2 uses the clock */
+  uint64_t ec_next;	/* counter 2: tick of the next terminal count */
+};
+
+struct dasemu {
+  /* Settings, fill in after dasemu_init */
+  int de_flags;
+  uint32_t de_io_ticks;	/* per port access */
+  uint32_t de_conv_ticks;	/* conversion time */
+  uint32_t de_irq_ticks;	/* request to irq hook, at least 1 */
+  void (*de_irq)(void *);	/* the ISR */
+  void (*de_out)(void *, uint8_t, uint64_t);	/* OP1-OP4 changed, at tick */
+  void *de_arg;
+  uint8_t de_dio;	/* IP1-IP3, IP1 in bit 0 */
+
+  /* Board state */
+  uint64_t de_now;
+  uint32_t de_intcsr;
+  uint32_t de_cntrl;
+  uint8_t de_ctr1;	/* as written */
+  int de_request;	/* interrupt request, CTR1 bit 3 */
+  int de_line;		/* request passed by INTE and INTCSR */
+  int de_inirq;
+  uint64_t de_deliver;	/* tick the pending request reaches the hook */
+  uint64_t de_conv_end;	/* 0 when no conversion runs */
+  int de_conv_chan;
+  uint64_t de_conv_at;	/* tick the conversion started */
+  uint16_t de_adc;	/* last result */
+  struct dasemu_ctr de_ctr[3];
+  struct dasemu_wave de_wave[DASEMU_NCHAN];
+  dasemu_source_t *de_source[DASEMU_NCHAN];
+  void *de_source_arg[DASEMU_NCHAN];
+  uint64_t de_seed;
+  uint64_t de_wall0;	/* DASEMU_REALTIME: host ns at tick 0 */
+
+  struct dasemu_stats de_stats;
+};
+
+void dasemu_init(struct dasemu *);
+void dasemu_set_wave(struct dasemu *, int, const struct dasemu_wave *);
+void dasemu_set_source(struct dasemu *, int, dasemu_source_t *, void *);
+void dasemu_set_input_hz(struct dasemu *, int, double);
+
+uint8_t dasemu_read_1(struct dasemu *, int, uint32_t);
+void dasemu_write_1(struct dasemu *, int, uint32_t, uint8_t);
+uint32_t dasemu_read_4(struct dasemu *, int, uint32_t);
+void dasemu_write_4(struct dasemu *, int, uint32_t, uint32_t);
+
+void dasemu_spend(struct dasemu *, uint64_t);
+void dasemu_run(struct dasemu *, uint64_t);
+uint16_t dasemu_input(struct dasemu *, int, uint64_t);
+
+static inline uint64_t
+dasemu_ns(uint64_t ticks)
+{
+  return ticks * 1000000 / (DASEMU_TICK_HZ / 1000);
+}
+
+static inline uint64_t
+dasemu_ticks(uint64_t ns)
+{
+  return ns * (DASEMU_TICK_HZ / 1000) / 1000000;
+}
+
+#endif /* _DASEMU_H_ */
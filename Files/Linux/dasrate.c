@@ -0,0 +1,144 @@
+/* dasrate -- pacing rates an ISR keeps up with on the emulated board
+ *
+ * usage: dasrate [-c conv] [-i io] [-q latency] [-w work] [-t ms] [count ...]
+ *
+ * Runs the register sequence of das_intr (status, EOC poll, acknowledge,
+ * latch and read counter 2, read the ADC, start the next conversion)
+ * against dasemu at each counter 2 reload given, or a sweep from 1 kHz
+ * up, then bisects for the fastest rate with no missed ticks.  Times
+ * are in board ticks (1/4.125 MHz): -c conversion, -i port access,
+ * -q request to ISR, -w extra ISR work.  -t is virtual time per rate.
+ */
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "dasio.h"
+#include "dasemu.h"
+
+struct isr {
+  struct dasemu *is_de;
+  uint64_t is_work;
+  uint64_t is_spins;
+};
+
+static void
+isr(void *arg)
+{
+  struct isr *is = arg;
+  struct dasemu *de = is->is_de;
+  uint8_t status, ctr1 = DAS_CTR1_INTE | DAS_CTR1_OP1;
+
+  status = dasemu_read_1(de, DASEMU_BADR2, CTR1);
+  if ((status & DAS_CTR1_INTE) == 0)
+    return;
+  while (status & EOC) {
+    is->is_spins++;
+    status = dasemu_read_1(de, DASEMU_BADR2, CTR1);
+  }
+  dasemu_write_1(de, DASEMU_BADR2, CTR1, ctr1);
+  dasemu_write_1(de, DASEMU_BADR2, CTR2, DAS_8254_SC(2));
+  (void)dasemu_read_1(de, DASEMU_BADR2, CLOCK);
+  (void)dasemu_read_1(de, DASEMU_BADR2, CLOCK);
+  (void)dasemu_read_1(de, DASEMU_BADR2, DAS_ADC_HIGH);
+  (void)dasemu_read_1(de, DASEMU_BADR2, DAS_ADC_LOW);
+  dasemu_spend(de, is->is_work);
+  dasemu_write_1(de, DASEMU_BADR2, DAS_ADC_LOW, ctr1);
+}
+
+static struct dasemu proto;
+static uint64_t work, run;
+
+/* One rate; returns the missed ticks and prints a row if asked */
+static uint64_t
+rate(unsigned count, int print)
+{
+  struct dasemu de = proto;
+  struct isr is = { &de, work, 0 };
+  const struct dasemu_stats *es = &de.de_stats;
+
+  de.de_irq = isr;
+  de.de_arg = &is;
+  // what das_attach and das_open do, then DAS_START_SAMPLING
+  dasemu_write_4(&de, DASEMU_BADR1, DAS_BADR1_INTCSR, 0x41);
+  dasemu_write_4(&de, DASEMU_BADR1, DAS_BADR1_CNTRL, 0x6);
+  dasemu_write_1(&de, DASEMU_BADR2, CTR2, COUNTER_CONTROL_WORD);
+  dasemu_write_1(&de, DASEMU_BADR2, CLOCK, count & 0xff);
+  dasemu_write_1(&de, DASEMU_BADR2, CLOCK, count >> 8);
+  dasemu_write_1(&de, DASEMU_BADR2, CTR1, DAS_CTR1_INTE);
+  dasemu_write_1(&de, DASEMU_BADR2, DAS_ADC_LOW, 0);
+  dasemu_write_1(&de, DASEMU_BADR2, CTR1, DAS_CTR1_INTE | DAS_CTR1_OP1);
+  dasemu_run(&de, run);
+  if (print)
+    printf("%6u %9.1f %9llu %8llu %8.2f %8.2f %6.2f %5.1f\n",
+	   count, (double)DASEMU_TICK_HZ / count,
+	   (unsigned long long)es->es_irqs, (unsigned long long)es->es_missed,
+	   es->es_irqs ? dasemu_ns(es->es_irq_ticks / es->es_irqs) / 1000.0 : 0,
+	   dasemu_ns(es->es_irq_max) / 1000.0,
+	   es->es_irqs ? (double)is.is_spins / es->es_irqs : 0,
+	   100.0 * es->es_irq_ticks / es->es_ticks);
+  return es->es_missed;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const unsigned sweep[] = { 4125, 2063, 1031, 516, 258, 129, 64, 32 };
+  unsigned lo, hi, mid;
+  int ch, i;
+
+  dasemu_init(&proto);
+  run = DASEMU_TICK_HZ / 10;
+  while ((ch = getopt(argc, argv, "c:i:q:t:w:")) != -1) {
+    switch (ch) {
+    case 'c':
+      proto.de_conv_ticks = strtoul(optarg, NULL, 0);
+      break;
+    case 'i':
+      proto.de_io_ticks = strtoul(optarg, NULL, 0);
+      break;
+    case 'q':
+      proto.de_irq_ticks = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      run = dasemu_ticks(strtoull(optarg, NULL, 0) * 1000000);
+      break;
+    case 'w':
+      work = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: dasrate [-c conv] [-i io] [-q latency] "
+	      "[-w work] [-t ms] [count ...]\n");
+      return 1;
+    }
+  }
+
+  printf("%6s %9s %9s %8s %8s %8s %6s %5s\n", "count", "Hz", "irqs",
+	 "missed", "isr us", "max us", "spins", "load%");
+  if (optind < argc) {
+    for (i = optind; i < argc; i++)
+      (void)rate(strtoul(argv[i], NULL, 0), 1);
+    return 0;
+  }
+  for (i = 0; i < (int)(sizeof(sweep) / sizeof(sweep[0])); i++)
+    (void)rate(sweep[i], 1);
+
+  // smallest count with nothing missed; 2 is the 8254's floor
+  lo = 2;
+  hi = 4125;
+  if (rate(hi, 0) != 0) {
+    printf("misses even at 1 kHz\n");
+    return 0;
+  }
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (rate(mid, 0) == 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  printf("fastest with no missed ticks: count %u, %.1f Hz\n", hi,
+	 (double)DASEMU_TICK_HZ / hi);
+  return 0;
+}
@@ -0,0 +1,296 @@
+/* dasreplay.c -- a recorded stream played back as a board, see dasdrv.h */
+/*
+ * The file holds words as read returns them, as dasbench -w writes
+ * them.  Once started, a thread per unit puts what the pacer has made
+ * due, 4.125 MHz / count, into a DAS_DEFAULT_BUFSIZE ring every
+ * REPLAY_TICK_NS, looping over the file and dropping what does not
+ * fit as das_intr would.  read follows das_read at watermark 1: it
+ * waits until the request is full unless sampling stops, and returns
+ * 0 once it has stopped and the ring is empty.  One writer per unit,
+ * any number of readers.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dasio.h"
+#include "shim/dasdrv.h"
+
+#define REPLAY_NUNIT 8
+#define REPLAY_TICK_NS 1000000
+
+struct replay {
+  pthread_mutex_t rp_lock;
+  pthread_cond_t rp_cv;
+  pthread_t rp_thread;
+  int rp_writer;
+  int rp_running;
+  unsigned int rp_count;
+  int rp_channel;
+  /* free running, as sc_prod and sc_cons */
+  uint64_t rp_prod, rp_cons;
+  uint64_t rp_intr;	/* samples the pacer made */
+  uint64_t rp_overrun;
+  size_t rp_next;	/* next word of the file */
+  uint32_t rp_ring[DAS_DEFAULT_BUFSIZE];
+};
+
+struct replay_open {
+  struct replay *ro_rp;
+  int ro_writer;
+};
+
+static struct replay units[REPLAY_NUNIT];
+static uint32_t *words;
+static size_t nwords;
+
+int
+dasreplay_load(const char *path)
+{
+  FILE *f;
+  long len;
+  int i;
+
+  f = fopen(path, "rb");
+  if (f == NULL)
+    return errno;
+  if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET) != 0) {
+    fclose(f);
+    return EIO;
+  }
+  nwords = len / sizeof(*words);
+  if (nwords == 0) {
+    fclose(f);
+    return EINVAL;
+  }
+  words = malloc(nwords * sizeof(*words));
+  if (words == NULL) {
+    fclose(f);
+    return ENOMEM;
+  }
+  if (fread(words, sizeof(*words), nwords, f) != nwords) {
+    fclose(f);
+    free(words);
+    words = NULL;
+    return EIO;
+  }
+  fclose(f);
+  for (i = 0; i < REPLAY_NUNIT; i++) {
+    pthread_mutex_init(&units[i].rp_lock, NULL);
+    pthread_cond_init(&units[i].rp_cv, NULL);
+    units[i].rp_count = DAS_DEFAULT_RATE;
+    units[i].rp_channel = DAS_DEFAULT_CHANNEL;
+  }
+  return 0;
+}
+
+static void *
+replay_run(void *arg)
+{
+  struct replay *rp = arg;
+  struct timespec t0, now, next;
+  uint64_t ns, due, base, put;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  next = t0;
+  pthread_mutex_lock(&rp->rp_lock);
+  base = rp->rp_intr;
+  while (rp->rp_running) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (now.tv_sec - t0.tv_sec) * 1000000000ULL + now.tv_nsec - t0.tv_nsec;
+    // CLOCK_SPEED is in kHz
+    due = base + ns * CLOCK_SPEED / (rp->rp_count * 1000000ULL);
+    put = rp->rp_prod;
+    for (; rp->rp_intr < due; rp->rp_intr++) {
+      if (rp->rp_prod - rp->rp_cons >= DAS_DEFAULT_BUFSIZE) {
+	rp->rp_overrun++;
+	continue;
+      }
+      rp->rp_ring[rp->rp_prod++ % DAS_DEFAULT_BUFSIZE] = words[rp->rp_next];
+      if (++rp->rp_next == nwords)
+	rp->rp_next = 0;
+    }
+    if (rp->rp_prod != put)
+      pthread_cond_broadcast(&rp->rp_cv);
+    pthread_mutex_unlock(&rp->rp_lock);
+    next.tv_nsec += REPLAY_TICK_NS;
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_sec++;
+      next.tv_nsec -= 1000000000L;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    pthread_mutex_lock(&rp->rp_lock);
+  }
+  pthread_mutex_unlock(&rp->rp_lock);
+  return NULL;
+}
+
+static int
+replay_open(int unit, int flags, void **hp)
+{
+  struct replay_open *ro;
+  struct replay *rp;
+
+  if (words == NULL || unit < 0 || unit >= REPLAY_NUNIT)
+    return ENXIO;
+  rp = &units[unit];
+  ro = calloc(1, sizeof(*ro));
+  if (ro == NULL)
+    return ENOMEM;
+  ro->ro_rp = rp;
+  ro->ro_writer = (flags & O_ACCMODE) != O_RDONLY;
+  pthread_mutex_lock(&rp->rp_lock);
+  if (ro->ro_writer && rp->rp_writer) {
+    pthread_mutex_unlock(&rp->rp_lock);
+    free(ro);
+    return EBUSY;
+  }
+  if (ro->ro_writer) {
+    rp->rp_writer = 1;
+    rp->rp_prod = rp->rp_cons = 0;
+  }
+  pthread_mutex_unlock(&rp->rp_lock);
+  *hp = ro;
+  return 0;
+}
+
+static int
+replay_stop(void *h)
+{
+  struct replay *rp = ((struct replay_open *)h)->ro_rp;
+  int running;
+
+  pthread_mutex_lock(&rp->rp_lock);
+  running = rp->rp_running;
+  rp->rp_running = 0;
+  pthread_cond_broadcast(&rp->rp_cv);
+  pthread_mutex_unlock(&rp->rp_lock);
+  if (running)
+    pthread_join(rp->rp_thread, NULL);
+  return 0;
+}
+
+static int
+replay_close(void *h)
+{
+  struct replay_open *ro = h;
+
+  if (ro->ro_writer) {
+    (void)replay_stop(h);
+    pthread_mutex_lock(&ro->ro_rp->rp_lock);
+    ro->ro_rp->rp_writer = 0;
+    pthread_mutex_unlock(&ro->ro_rp->rp_lock);
+  }
+  free(ro);
+  return 0;
+}
+
+static int
+replay_pacer(void *h, unsigned int count)
+{
+  struct replay *rp = ((struct replay_open *)h)->ro_rp;
+
+  if (count < 2 || count > UINT16_MAX)
+    return EINVAL;
+  pthread_mutex_lock(&rp->rp_lock);
+  rp->rp_count = count;
+  pthread_mutex_unlock(&rp->rp_lock);
+  return 0;
+}
+
+static int
+replay_set_channel(void *h, int ch)
+{
+  struct replay *rp = ((struct replay_open *)h)->ro_rp;
+
+  if (ch < 0 || ch > 7)
+    return EINVAL;
+  rp->rp_channel = ch;
+  return 0;
+}
+
+static int
+replay_get_channel(void *h, int *ch)
+{
+  *ch = ((struct replay_open *)h)->ro_rp->rp_channel;
+  return 0;
+}
+
+static int
+replay_start(void *h)
+{
+  struct replay *rp = ((struct replay_open *)h)->ro_rp;
+  int error = 0;
+
+  pthread_mutex_lock(&rp->rp_lock);
+  if (!rp->rp_running) {
+    rp->rp_running = 1;
+    error = pthread_create(&rp->rp_thread, NULL, replay_run, rp);
+    if (error)
+      rp->rp_running = 0;
+  }
+  pthread_mutex_unlock(&rp->rp_lock);
+  return error;
+}
+
+static ssize_t
+replay_read(void *h, void *buf, size_t len)
+{
+  struct replay *rp = ((struct replay_open *)h)->ro_rp;
+  size_t done = 0, n, slot;
+
+  if (len < sizeof(uint32_t))
+    return -EINVAL;
+  pthread_mutex_lock(&rp->rp_lock);
+  while (len - done >= sizeof(uint32_t)) {
+    if (rp->rp_prod == rp->rp_cons) {
+      if (!rp->rp_running)
+	break;
+      pthread_cond_wait(&rp->rp_cv, &rp->rp_lock);
+      continue;
+    }
+    // largest run that is ready, wanted, and does not wrap
+    slot = rp->rp_cons % DAS_DEFAULT_BUFSIZE;
+    n = rp->rp_prod - rp->rp_cons;
+    if (n > (len - done) / sizeof(uint32_t))
+      n = (len - done) / sizeof(uint32_t);
+    if (n > DAS_DEFAULT_BUFSIZE - slot)
+      n = DAS_DEFAULT_BUFSIZE - slot;
+    memcpy((char *)buf + done, &rp->rp_ring[slot], n * sizeof(uint32_t));
+    rp->rp_cons += n;
+    done += n * sizeof(uint32_t);
+  }
+  pthread_mutex_unlock(&rp->rp_lock);
+  return done;
+}
+
+static int
+replay_stats(void *h, struct dasdrv_stats *dv)
+{
+  struct replay *rp = ((struct replay_open *)h)->ro_rp;
+
+  pthread_mutex_lock(&rp->rp_lock);
+  dv->dv_intr = rp->rp_intr;
+  dv->dv_samples = rp->rp_intr - rp->rp_overrun;
+  dv->dv_overrun = rp->rp_overrun;
+  pthread_mutex_unlock(&rp->rp_lock);
+  return 0;
+}
+
+const struct dasdrv dasdrv_replay = {
+  .dd_name = "replay",
+  .dd_open = replay_open,
+  .dd_close = replay_close,
+  .dd_pacer = replay_pacer,
+  .dd_set_channel = replay_set_channel,
+  .dd_get_channel = replay_get_channel,
+  .dd_start = replay_start,
+  .dd_stop = replay_stop,
+  .dd_read = replay_read,
+  .dd_stats = replay_stats,
+};
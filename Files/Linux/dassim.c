@@ -0,0 +1,717 @@
+/* dassim -- ISR, softint and reader interleavings in virtual time
+ *
+ * usage: dassim [-D netbsd|wdf] [-r hz,...] [-b size,...] [-k mark,...]
+ *               [-n samples,...] [-l ns] [-j ns] [-i ns] [-q ns] [-w ns]
+ *               [-p prob] [-P ns] [-y ns] [-x ns] [-u ns] [-o ms]
+ *               [-t ms] [-R runs] [-s seed]
+ *
+ * A model of the path a sample takes through das.c or das1, not the
+ * drivers themselves, though das1's rings and read scheduling are its
+ * own wdasisr.h and wdasread.h, built against the WDK stand-ins.  The pacer ticks at -r Hz and the interrupt is
+ * delivered -l ns later plus up to -j ns of uniform jitter.  The ISR
+ * takes -i ns, and a tick that finds the last request not yet
+ * acknowledged is missed, as on the board.  For netbsd the ISR puts the
+ * sample in the -b sample ring, dropping it if the ring is full, and
+ * schedules the softint when the sleeping reader's want is met.  For
+ * wdf it goes to the 256 word ISR ring, and the DPC moves it to a -b
+ * word ring that drops its oldest word (DAS_BUFFER_SIZE, MAX_SAMPLE_SET
+ * on the NetBSD side), then completes the read or leaves it for the -o
+ * ms read timer.  Softints and DPCs start -q ns after they are queued.
+ *
+ * One reader issues reads of -n samples with watermark -k, as das_read
+ * and das1ReadService treat them.  A sleeping reader wakes after an
+ * exponential delay of mean -w ns, and with probability -p that wakeup
+ * is a further -P ns late.  A read costs -y ns to enter plus -x ns per
+ * sample copied (the DPC's moves cost -x too), then the program spends
+ * -u ns per sample before it reads again.
+ *
+ * Every combination of the listed rates, ring sizes, watermarks and
+ * read sizes is run -R times for -t ms, with seeds -s, -s + 1, ..., so
+ * each combination sees the same draws; for netbsd, watermarks over the
+ * ring size are left out.  Each gets a CSV row: the
+ * fraction of runs that lost a sample, samples lost and ticks missed
+ * per million, percentiles (to 1/32) of the time from a sample's tick
+ * to the return of the read that carries it, the ring's high water
+ * mark, reads and wakeups per second, and interrupt side and reader
+ * side CPU in percent of one CPU.  The -u work is not reader CPU.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <ntddk.h>
+#include "dasio.h"
+#include "wdasisr.h"
+#include "wdasread.h"
+
+/* das1's, from wdasio.h */
+#define WDF_BUFFER_SIZE 1000	/* DAS_BUFFER_SIZE */
+#define WDF_READ_TIMEOUT_MS 10	/* DAS_READ_TIMEOUT_MS */
+
+#define NEVER UINT64_MAX
+#define MAXLIST 32
+
+/* Latency buckets: exact below LAT_SUB ns, then LAT_SUB per power of 2 */
+#define LAT_SUB 32
+#define LAT_NB (38 * LAT_SUB)
+
+enum { D_NETBSD, D_WDF };
+
+/* Events, in the order ties are taken */
+enum { EV_TICK, EV_ISR_END, EV_ISR, EV_SOFT_END, EV_SOFT, EV_TIMER,
+       EV_READER, EV_N };
+
+/* Where the reader is */
+enum { R_ENTER, R_LOOP, R_COPY, R_SLEEP, R_PEND };
+
+struct cost {
+  uint64_t c_lat, c_jitter, c_isr, c_soft, c_wake, c_stall;
+  uint64_t c_syscall, c_copy, c_work, c_timeout, c_run;
+  double c_pstall;
+};
+
+struct scen {
+  int sc_driver;
+  unsigned sc_rate, sc_size, sc_mark, sc_nread;
+};
+
+struct result {
+  uint64_t rs_runs, rs_lossy, rs_ticks, rs_dropped, rs_missed;
+  uint64_t rs_reads, rs_wakeups, rs_irq_ns, rs_read_ns, rs_ns;
+  uint64_t rs_nlat, rs_latmax, rs_lat[LAT_NB];
+  unsigned rs_maxfill;
+};
+
+struct sim {
+  const struct scen *sm_s;
+  const struct cost *sm_c;
+  struct result *sm_rs;
+  uint64_t sm_seed;
+  uint64_t sm_at[EV_N];
+  uint64_t sm_tick;	/* ticks so far */
+  int sm_pending;	/* a request is up, not yet acknowledged */
+  uint64_t sm_req;	/* its tick */
+  uint64_t sm_cur;	/* the tick the running ISR samples */
+  uint64_t sm_isr_free;
+  uint64_t sm_dropped;
+  /* Sample ring; free running counts, sm_ts[] holds each sample's tick */
+  uint64_t *sm_ts;
+  unsigned sm_cap;
+  uint64_t *sm_rts;	/* ticks of the samples in the read under way */
+  unsigned sm_rn;
+  uint64_t sm_prod, sm_cons;
+  /* das1's ISR ring, and the tick of the word in each of its slots; a
+   * word is the ring's Head when it went in */
+  DAS_ISR_RING sm_iring;
+  uint64_t sm_its[DAS_ISR_RING_SIZE];
+  /* das1's sample ring; a word is the slot it went in, sm_ts[] has the
+   * tick */
+  ULONG *sm_wbuf, *sm_words;
+  ULONG sm_wr, sm_rd;
+  int sm_queued;	/* softint or DPC queued, not yet started */
+  uint64_t sm_moving;	/* words the running DPC moves */
+  uint64_t sm_soft_free;
+  /* reader */
+  int sm_phase;
+  unsigned sm_resid, sm_want, sm_ncopy;
+  int sm_rwait, sm_armed;
+};
+
+static uint64_t *lat_ts, *lat_rts;
+static ULONG *wdf_buf, *wdf_words;
+
+static double
+uniform(struct sim *sm)
+{
+  // xorshift64, as dasemu's noise
+  sm->sm_seed ^= sm->sm_seed << 13;
+  sm->sm_seed ^= sm->sm_seed >> 7;
+  sm->sm_seed ^= sm->sm_seed << 17;
+  return (double)(sm->sm_seed >> 11) / (1ULL << 53);
+}
+
+static uint64_t
+wake_delay(struct sim *sm)
+{
+  const struct cost *c = sm->sm_c;
+  uint64_t d = (uint64_t)(-(double)c->c_wake * log(1 - uniform(sm)));
+
+  if (c->c_pstall > 0 && uniform(sm) < c->c_pstall)
+    d += c->c_stall;
+  sm->sm_rs->rs_wakeups++;
+  return d;
+}
+
+static unsigned
+lat_bucket(uint64_t v)
+{
+  unsigned e;
+
+  if (v < LAT_SUB)
+    return v;
+  e = 63 - __builtin_clzll(v);
+  if (e > 41)
+    return LAT_NB - 1;
+  return (e - 4) * LAT_SUB + ((v >> (e - 5)) & (LAT_SUB - 1));
+}
+
+/* Smallest value that lands in bucket b */
+static uint64_t
+lat_bucket_lo(unsigned b)
+{
+  if (b < LAT_SUB)
+    return b;
+  return (uint64_t)(LAT_SUB + b % LAT_SUB) << (b / LAT_SUB - 1);
+}
+
+/* n samples from the ring into the read under way */
+static void
+take(struct sim *sm, unsigned n)
+{
+  unsigned i;
+
+  if (sm->sm_s->sc_driver == D_WDF) {
+    das1RingCopyOut(sm->sm_wbuf, sm->sm_s->sc_size, &sm->sm_rd, sm->sm_words,
+		    n);
+    for (i = 0; i < n; i++)
+      sm->sm_rts[sm->sm_rn++] = sm->sm_ts[sm->sm_words[i]];
+  } else
+    for (i = 0; i < n; i++)
+      sm->sm_rts[sm->sm_rn++] =
+	  sm->sm_ts[(sm->sm_cons + i) % sm->sm_s->sc_size];
+  sm->sm_cons += n;
+}
+
+/* The read returns to the program at t, with what it took */
+static void
+complete(struct sim *sm, uint64_t t)
+{
+  struct result *rs = sm->sm_rs;
+  uint64_t v;
+  unsigned i;
+
+  for (i = 0; i < sm->sm_rn; i++) {
+    v = t - sm->sm_rts[i];
+    rs->rs_lat[lat_bucket(v)]++;
+    if (v > rs->rs_latmax)
+      rs->rs_latmax = v;
+  }
+  rs->rs_nlat += sm->sm_rn;
+  rs->rs_reads++;
+  sm->sm_rn = 0;
+}
+
+/* One sample into the sample ring, as das_intr would or by das1RingPut */
+static void
+ring_put(struct sim *sm, uint64_t tick)
+{
+  unsigned fill = sm->sm_prod - sm->sm_cons;
+  ULONG slot;
+
+  if (sm->sm_s->sc_driver == D_WDF) {
+    // das1 drops the oldest instead
+    slot = sm->sm_wr;
+    if (das1RingPut(sm->sm_wbuf, sm->sm_s->sc_size, &sm->sm_wr, &sm->sm_rd,
+		    slot)) {
+      sm->sm_dropped++;
+      sm->sm_cons++;
+      fill--;
+    }
+    sm->sm_ts[slot] = tick;
+  }
+  else if (fill >= sm->sm_cap) {
+    sm->sm_dropped++;
+    return;
+  }
+  else
+    sm->sm_ts[sm->sm_prod % sm->sm_s->sc_size] = tick;
+  sm->sm_prod++;
+  if (fill + 1 > sm->sm_rs->rs_maxfill)
+    sm->sm_rs->rs_maxfill = fill + 1;
+}
+
+/* das1ReadService on the pending read; 1 if it completed */
+static int
+wdf_service(struct sim *sm, uint64_t now, int expired, int caller)
+{
+  const struct cost *c = sm->sm_c;
+  ULONG n;
+  uint64_t done;
+
+  if (!das1ReadTake(das1RingCount(sm->sm_wr, sm->sm_rd, sm->sm_s->sc_size),
+		    sm->sm_s->sc_nread, sm->sm_s->sc_mark,
+		    expired ? DAS_READ_EXPIRED : DAS_READ_WAIT, &n)) {
+    if (!sm->sm_armed) {
+      sm->sm_armed = 1;
+      sm->sm_at[EV_TIMER] = now + c->c_timeout;
+    }
+    sm->sm_phase = R_PEND;
+    sm->sm_at[EV_READER] = NEVER;
+    return 0;
+  }
+  take(sm, n);
+  done = now + n * c->c_copy;
+  if (caller)
+    sm->sm_rs->rs_read_ns += n * c->c_copy;
+  else {
+    // completed from the DPC or the timer: the reader still has to run
+    sm->sm_rs->rs_irq_ns += n * c->c_copy;
+    done += wake_delay(sm);
+  }
+  complete(sm, done);
+  sm->sm_phase = R_ENTER;
+  sm->sm_at[EV_READER] = done + n * c->c_work;
+  return 1;
+}
+
+static void
+isr_end(struct sim *sm, uint64_t now)
+{
+  const struct cost *c = sm->sm_c;
+  uint64_t t;
+
+  if (sm->sm_s->sc_driver == D_NETBSD) {
+    ring_put(sm, sm->sm_cur);
+    // only pay for a wakeup when someone is actually waiting
+    if (!(sm->sm_rwait && sm->sm_prod - sm->sm_cons >= sm->sm_want))
+      return;
+  }
+  else if (das1IsrRingPut(&sm->sm_iring, sm->sm_iring.Head))
+    sm->sm_its[(sm->sm_iring.Head - 1) % DAS_ISR_RING_SIZE] = sm->sm_cur;
+  else
+    sm->sm_dropped++;
+  if (!sm->sm_queued) {
+    sm->sm_queued = 1;
+    t = now + c->c_soft;
+    sm->sm_at[EV_SOFT] = t > sm->sm_soft_free ? t : sm->sm_soft_free;
+  }
+}
+
+static void
+soft(struct sim *sm, uint64_t now)
+{
+  uint64_t n;
+
+  sm->sm_queued = 0;
+  if (sm->sm_s->sc_driver == D_NETBSD) {
+    // das_softintr: the broadcast wakes a reader that is still asleep
+    if (sm->sm_phase == R_SLEEP && sm->sm_at[EV_READER] == NEVER)
+      sm->sm_at[EV_READER] = now + wake_delay(sm);
+    return;
+  }
+  n = das1IsrRingAvail(&sm->sm_iring);
+  if (n == 0)
+    return;
+  sm->sm_moving = n;
+  sm->sm_soft_free = now + n * sm->sm_c->c_copy;
+  sm->sm_rs->rs_irq_ns += n * sm->sm_c->c_copy;
+  sm->sm_at[EV_SOFT_END] = sm->sm_soft_free;
+}
+
+static void
+soft_end(struct sim *sm, uint64_t now)
+{
+  uint64_t i;
+
+  for (i = 0; i < sm->sm_moving; i++)
+    ring_put(sm, sm->sm_its[das1IsrRingWord(&sm->sm_iring, i) %
+			    DAS_ISR_RING_SIZE]);
+  das1IsrRingConsume(&sm->sm_iring, sm->sm_moving);
+  sm->sm_moving = 0;
+  if (sm->sm_phase == R_PEND &&
+      das1RingCount(sm->sm_wr, sm->sm_rd, sm->sm_s->sc_size) >=
+      das1ReadNeed(sm->sm_s->sc_nread, sm->sm_s->sc_mark))
+    (void)wdf_service(sm, now, 0, 0);
+}
+
+static void
+reader(struct sim *sm, uint64_t now)
+{
+  const struct scen *s = sm->sm_s;
+  const struct cost *c = sm->sm_c;
+  unsigned fill, n, slot;
+
+  switch (sm->sm_phase) {
+  case R_ENTER:
+    sm->sm_resid = s->sc_nread;
+    sm->sm_phase = R_LOOP;
+    sm->sm_at[EV_READER] = now + c->c_syscall;
+    sm->sm_rs->rs_read_ns += c->c_syscall;
+    return;
+  case R_SLEEP:
+    sm->sm_rwait = 0;
+    sm->sm_phase = R_LOOP;
+    break;
+  case R_COPY:
+    take(sm, sm->sm_ncopy);
+    sm->sm_resid -= sm->sm_ncopy;
+    if (sm->sm_resid == 0) {
+      complete(sm, now);
+      sm->sm_phase = R_ENTER;
+      sm->sm_at[EV_READER] = now + s->sc_nread * c->c_work;
+      return;
+    }
+    sm->sm_phase = R_LOOP;
+    break;
+  }
+
+  if (s->sc_driver == D_WDF) {
+    (void)wdf_service(sm, now, 0, 1);
+    return;
+  }
+  // das_read: wait for the watermark, or for what is asked if that is less
+  sm->sm_want = s->sc_mark < sm->sm_resid ? s->sc_mark : sm->sm_resid;
+  fill = sm->sm_prod - sm->sm_cons;
+  if (fill < sm->sm_want) {
+    sm->sm_rwait = 1;
+    sm->sm_phase = R_SLEEP;
+    sm->sm_at[EV_READER] = NEVER;
+    return;
+  }
+  // largest run that is ready, wanted, and does not wrap
+  slot = sm->sm_cons % s->sc_size;
+  n = fill < sm->sm_resid ? fill : sm->sm_resid;
+  n = n < s->sc_size - slot ? n : s->sc_size - slot;
+  sm->sm_ncopy = n;
+  sm->sm_phase = R_COPY;
+  sm->sm_at[EV_READER] = now + n * c->c_copy;
+  sm->sm_rs->rs_read_ns += n * c->c_copy;
+}
+
+static void
+run(const struct scen *s, const struct cost *c, uint64_t seed,
+    struct result *rs)
+{
+  struct sim sm;
+  uint64_t now, t;
+  int ev, i;
+
+  memset(&sm, 0, sizeof(sm));
+  sm.sm_s = s;
+  sm.sm_c = c;
+  sm.sm_rs = rs;
+  sm.sm_seed = (seed + 1) * 0x9e3779b97f4a7c15ULL;
+  if (sm.sm_seed == 0)
+    sm.sm_seed = 1;
+  sm.sm_ts = lat_ts;
+  sm.sm_rts = lat_rts;
+  sm.sm_wbuf = wdf_buf;
+  sm.sm_words = wdf_words;
+  das1IsrRingReset(&sm.sm_iring);
+  // das1's ring is empty when the two pointers meet, so one slot is unused
+  sm.sm_cap = s->sc_driver == D_WDF ? s->sc_size - 1 : s->sc_size;
+  for (i = 0; i < EV_N; i++)
+    sm.sm_at[i] = NEVER;
+  sm.sm_at[EV_TICK] = 1000000000ULL / s->sc_rate;
+  sm.sm_at[EV_READER] = 0;
+
+  for (;;) {
+    ev = 0;
+    for (i = 1; i < EV_N; i++)
+      if (sm.sm_at[i] < sm.sm_at[ev])
+	ev = i;
+    now = sm.sm_at[ev];
+    if (now >= c->c_run)
+      break;
+    sm.sm_at[ev] = NEVER;
+    switch (ev) {
+    case EV_TICK:
+      rs->rs_ticks++;
+      if (sm.sm_pending)
+	rs->rs_missed++;
+      else {
+	sm.sm_pending = 1;
+	sm.sm_req = now;
+	t = now + c->c_lat + (uint64_t)(c->c_jitter * uniform(&sm));
+	sm.sm_at[EV_ISR] = t > sm.sm_isr_free ? t : sm.sm_isr_free;
+      }
+      sm.sm_tick++;
+      sm.sm_at[EV_TICK] = (sm.sm_tick + 1) * 1000000000ULL / s->sc_rate;
+      break;
+    case EV_ISR:
+      // the CTR1 write acknowledges the request
+      sm.sm_pending = 0;
+      sm.sm_cur = sm.sm_req;
+      sm.sm_isr_free = now + c->c_isr;
+      sm.sm_at[EV_ISR_END] = sm.sm_isr_free;
+      rs->rs_irq_ns += c->c_isr;
+      break;
+    case EV_ISR_END:
+      isr_end(&sm, now);
+      break;
+    case EV_SOFT:
+      soft(&sm, now);
+      break;
+    case EV_SOFT_END:
+      soft_end(&sm, now);
+      break;
+    case EV_TIMER:
+      sm.sm_armed = 0;
+      if (sm.sm_phase == R_PEND)
+	(void)wdf_service(&sm, now, 1, 0);
+      break;
+    case EV_READER:
+      reader(&sm, now);
+      break;
+    }
+  }
+  rs->rs_runs++;
+  rs->rs_ns += c->c_run;
+  rs->rs_dropped += sm.sm_dropped;
+  if (sm.sm_dropped)
+    rs->rs_lossy++;
+}
+
+static double
+lat_pct(const struct result *rs, double p)
+{
+  uint64_t want, sum = 0;
+  unsigned b;
+
+  if (rs->rs_nlat == 0)
+    return 0;
+  want = (uint64_t)ceil(p * rs->rs_nlat);
+  for (b = 0; b < LAT_NB; b++) {
+    sum += rs->rs_lat[b];
+    if (sum >= want)
+      break;
+  }
+  return lat_bucket_lo(b) / 1000.0;
+}
+
+static int
+parse_list(const char *arg, unsigned *v)
+{
+  char *end;
+  int n = 0;
+
+  do {
+    if (n == MAXLIST)
+      return -1;
+    v[n++] = strtoul(arg, &end, 0);
+    if (end == arg || (*end != ',' && *end != '\0'))
+      return -1;
+    arg = end + 1;
+  } while (*end == ',');
+  return n;
+}
+
+static const char *
+check(const struct scen *s)
+{
+  if (s->sc_rate == 0 || s->sc_rate > CLOCK_SPEED * 1000 / 2)
+    return "rate is 1 Hz up to half the board clock";
+  if (s->sc_nread == 0)
+    return "reads are at least one sample";
+  if (s->sc_driver == D_WDF)
+    return s->sc_size < 2 ? "das1's ring is at least 2 words" : NULL;
+  if (s->sc_size < DAS_MIN_BUFSIZE || s->sc_size > DAS_MAX_BUFSIZE ||
+      (s->sc_size & (s->sc_size - 1)) != 0)
+    return "das.c's ring is a power of 2, DAS_MIN_BUFSIZE to DAS_MAX_BUFSIZE";
+  if (s->sc_mark < 1)
+    return "das.c's watermark is at least 1";
+  return NULL;
+}
+
+/* das_configure refuses a watermark over the ring size; skip those */
+static int
+fits(const struct scen *s)
+{
+  return s->sc_driver == D_WDF || s->sc_mark <= s->sc_size;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const char *names[] = { "netbsd", "wdf" };
+  static unsigned rates[MAXLIST] = { 1000, 5000, 10000, 20000, 50000 };
+  static unsigned sizes[MAXLIST], marks[MAXLIST] = { 1 };
+  static unsigned nreads[MAXLIST] = { 64 };
+  static struct result rs;
+  struct cost c;
+  struct scen s;
+  struct timespec t0, t1;
+  unsigned nruns = 20, maxsize, maxread, i, j, k, l, r;
+  int nrate = 5, nsize = 0, nmark = 1, nnread = 1, driver = D_NETBSD;
+  uint64_t seed = 1, total = 0;
+  const char *why;
+  double secs;
+  int ch;
+
+  memset(&c, 0, sizeof(c));
+  c.c_lat = 2000;
+  c.c_jitter = 5000;
+  c.c_isr = 8000;
+  c.c_soft = 2000;
+  c.c_wake = 20000;
+  c.c_stall = 5000000;
+  c.c_pstall = 0.001;
+  c.c_syscall = 1000;
+  c.c_copy = 5;
+  c.c_timeout = WDF_READ_TIMEOUT_MS * 1000000ULL;
+  c.c_run = 200 * 1000000ULL;
+  while ((ch = getopt(argc, argv, "D:b:i:j:k:l:n:o:P:p:q:R:r:s:t:u:w:x:y:"))
+	 != -1) {
+    switch (ch) {
+    case 'D':
+      if (strcmp(optarg, names[D_NETBSD]) == 0)
+	driver = D_NETBSD;
+      else if (strcmp(optarg, names[D_WDF]) == 0)
+	driver = D_WDF;
+      else
+	goto usage;
+      break;
+    case 'b':
+      if ((nsize = parse_list(optarg, sizes)) < 0)
+	goto usage;
+      break;
+    case 'k':
+      if ((nmark = parse_list(optarg, marks)) < 0)
+	goto usage;
+      break;
+    case 'n':
+      if ((nnread = parse_list(optarg, nreads)) < 0)
+	goto usage;
+      break;
+    case 'r':
+      if ((nrate = parse_list(optarg, rates)) < 0)
+	goto usage;
+      break;
+    case 'i':
+      c.c_isr = strtoull(optarg, NULL, 0);
+      break;
+    case 'j':
+      c.c_jitter = strtoull(optarg, NULL, 0);
+      break;
+    case 'l':
+      c.c_lat = strtoull(optarg, NULL, 0);
+      break;
+    case 'o':
+      c.c_timeout = strtoull(optarg, NULL, 0) * 1000000;
+      break;
+    case 'P':
+      c.c_stall = strtoull(optarg, NULL, 0);
+      break;
+    case 'p':
+      c.c_pstall = strtod(optarg, NULL);
+      break;
+    case 'q':
+      c.c_soft = strtoull(optarg, NULL, 0);
+      break;
+    case 'R':
+      nruns = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    case 't':
+      c.c_run = strtoull(optarg, NULL, 0) * 1000000;
+      break;
+    case 'u':
+      c.c_work = strtoull(optarg, NULL, 0);
+      break;
+    case 'w':
+      c.c_wake = strtoull(optarg, NULL, 0);
+      break;
+    case 'x':
+      c.c_copy = strtoull(optarg, NULL, 0);
+      break;
+    case 'y':
+      c.c_syscall = strtoull(optarg, NULL, 0);
+      break;
+    default:
+    usage:
+      fprintf(stderr, "usage: dassim [-D netbsd|wdf] [-r hz,...] "
+	      "[-b size,...] [-k mark,...]\n"
+	      "              [-n samples,...] [-l ns] [-j ns] [-i ns] "
+	      "[-q ns] [-w ns]\n"
+	      "              [-p prob] [-P ns] [-y ns] [-x ns] [-u ns] "
+	      "[-o ms]\n"
+	      "              [-t ms] [-R runs] [-s seed]\n");
+      return 1;
+    }
+  }
+  if (nsize == 0) {
+    sizes[0] = driver == D_WDF ? WDF_BUFFER_SIZE : DAS_DEFAULT_BUFSIZE;
+    nsize = 1;
+  }
+  if (nruns == 0 || c.c_run == 0) {
+    fprintf(stderr, "dassim: runs and time are at least 1\n");
+    return 1;
+  }
+
+  // check every combination before printing anything
+  maxsize = maxread = 0;
+  s.sc_driver = driver;
+  for (i = 0; i < (unsigned)nrate; i++)
+    for (j = 0; j < (unsigned)nsize; j++)
+      for (k = 0; k < (unsigned)nmark; k++)
+	for (l = 0; l < (unsigned)nnread; l++) {
+	  s.sc_rate = rates[i];
+	  s.sc_size = sizes[j];
+	  s.sc_mark = marks[k];
+	  s.sc_nread = nreads[l];
+	  if ((why = check(&s)) != NULL) {
+	    fprintf(stderr, "dassim: %s\n", why);
+	    return 1;
+	  }
+	  if (s.sc_size > maxsize)
+	    maxsize = s.sc_size;
+	  if (s.sc_nread > maxread)
+	    maxread = s.sc_nread;
+	}
+  lat_ts = calloc(maxsize, sizeof(*lat_ts));
+  lat_rts = calloc(maxread, sizeof(*lat_rts));
+  wdf_buf = calloc(maxsize, sizeof(*wdf_buf));
+  wdf_words = calloc(maxread, sizeof(*wdf_words));
+  if (lat_ts == NULL || lat_rts == NULL || wdf_buf == NULL ||
+      wdf_words == NULL) {
+    perror("dassim");
+    return 1;
+  }
+
+  printf("driver,rate_hz,bufsize,watermark,read_samples,runs,overrun_p,"
+	 "lost_ppm,missed_ppm,lat_p50_us,lat_p99_us,lat_p999_us,lat_max_us,"
+	 "maxfill,reads_s,wakeups_s,cpu_irq_pct,cpu_read_pct\n");
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < (unsigned)nrate; i++)
+    for (j = 0; j < (unsigned)nsize; j++)
+      for (k = 0; k < (unsigned)nmark; k++)
+	for (l = 0; l < (unsigned)nnread; l++) {
+	  s.sc_rate = rates[i];
+	  s.sc_size = sizes[j];
+	  s.sc_mark = marks[k];
+	  s.sc_nread = nreads[l];
+	  if (!fits(&s))
+	    continue;
+	  memset(&rs, 0, sizeof(rs));
+	  for (r = 0; r < nruns; r++)
+	    run(&s, &c, seed + r, &rs);
+	  total += nruns;
+	  secs = rs.rs_ns / 1e9;
+	  printf("%s,%u,%u,%u,%u,%llu,%.4f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,"
+		 "%u,%.1f,%.1f,%.2f,%.2f\n",
+		 names[driver], s.sc_rate, s.sc_size, s.sc_mark, s.sc_nread,
+		 (unsigned long long)rs.rs_runs,
+		 (double)rs.rs_lossy / rs.rs_runs,
+		 rs.rs_ticks ? 1e6 * rs.rs_dropped / rs.rs_ticks : 0,
+		 rs.rs_ticks ? 1e6 * rs.rs_missed / rs.rs_ticks : 0,
+		 lat_pct(&rs, 0.50), lat_pct(&rs, 0.99), lat_pct(&rs, 0.999),
+		 rs.rs_latmax / 1000.0, rs.rs_maxfill,
+		 rs.rs_reads / secs, rs.rs_wakeups / secs,
+		 100.0 * rs.rs_irq_ns / rs.rs_ns,
+		 100.0 * rs.rs_read_ns / rs.rs_ns);
+	}
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+  fprintf(stderr, "dassim: %llu runs in %.2f s, %.0f runs/s\n",
+	  (unsigned long long)total, secs, secs > 0 ? total / secs : 0);
+  free(lat_ts);
+  free(lat_rts);
+  free(wdf_buf);
+  free(wdf_words);
+  return 0;
+}
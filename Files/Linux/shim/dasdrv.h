@@ -0,0 +1,86 @@
+/* dasdrv.h -- one driver built against its shim, as dasdrive sees it */
+/*
+ * nbsd_das.c puts das.c behind this and wdf_das.c the das1 driver,
+ * each through the driver's own entry points and ioctls.  Errors are
+ * errno values; the KMDF side maps its NTSTATUS codes onto them.
+ *
+ * dasbench also runs dasdev.c, a real device through /dev/das<unit>,
+ * and dasreplay.c, a recorded stream played back at the pacer rate.
+ * Neither has a board, so their dd_attach is NULL.
+ */
+#ifndef _DASDRV_H_
+#define _DASDRV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct dasshim_board;
+
+struct dasdrv_stats {
+  uint64_t dv_intr;	/* interrupts the driver counted */
+  uint64_t dv_samples;	/* samples it produced */
+  uint64_t dv_overrun;	/* samples it dropped */
+};
+
+/* One register access of a command list.  The values are both drivers'
+ * DAS_REGOP_* ones. */
+#define DASDRV_REGBATCH_MAX 256
+#define DASDRV_REGOP_READ 0
+#define DASDRV_REGOP_WRITE 1
+#define DASDRV_REGOP_RMW 2
+#define DASDRV_BADR1 1
+#define DASDRV_BADR2 2
+struct dasdrv_regop {
+  uint8_t dr_op;
+  uint8_t dr_bar;
+  uint16_t dr_off;
+  uint32_t dr_mask;
+  uint32_t dr_val;
+  uint32_t dr_result;	/* out */
+};
+
+struct dasdrv {
+  const char *dd_name;
+  /* Attach unit n to board n; hooks the board's interrupt. */
+  int (*dd_attach)(struct dasshim_board *);
+  /* Handles are per open; flags are O_RDONLY or O_RDWR. */
+  int (*dd_open)(int, int, void **);
+  int (*dd_close)(void *);
+  /* Counter 2 reload: the pacer runs at 4.125 MHz / count. */
+  int (*dd_pacer)(void *, unsigned int);
+  int (*dd_set_channel)(void *, int);
+  int (*dd_get_channel)(void *, int *);
+  int (*dd_start)(void *);
+  int (*dd_stop)(void *);
+  /* Bytes read, or -errno; blocks as read(2) would. */
+  ssize_t (*dd_read)(void *, void *, size_t);
+  int (*dd_stats)(void *, struct dasdrv_stats *);
+  /* Mapped sample ring, NULL if there is none: map a ring of n samples
+   * (0 takes it down), then take from it.  A take waits at most once,
+   * up to DASDRV_MAP_WAIT_MS, when the ring holds less than the size
+   * asked for or the read watermark, whichever is smaller, and says so. */
+  int (*dd_map)(void *, unsigned int);
+  ssize_t (*dd_map_read)(void *, void *, size_t, int *);
+  /* Up to DASDRV_REGBATCH_MAX accesses in one call of the driver's
+   * REGISTER_BATCH ioctl, NULL if there is none. */
+  int (*dd_regbatch)(void *, struct dasdrv_regop *, unsigned int);
+  /* A channel's newest sample and its sample number without taking
+   * from the ring, NULL if there are none: from the mapped latest page
+   * if the int is set, else one GET_LATEST ioctl. */
+  int (*dd_latest)(void *, int, unsigned int, uint32_t *, uint32_t *);
+};
+
+#define DASDRV_MAP_WAIT_MS 10
+
+extern const struct dasdrv dasdrv_netbsd;
+extern const struct dasdrv dasdrv_wdf;
+extern const struct dasdrv dasdrv_dev;
+extern const struct dasdrv dasdrv_replay;
+
+/* dasdev.c: the device node is this with the unit appended */
+extern const char *dasdev_prefix;
+/* dasreplay.c: words as read returns them, looped; 0 or an errno */
+int dasreplay_load(const char *);
+
+#endif /* _DASDRV_H_ */
@@ -0,0 +1,452 @@
+/* dasshim.c -- boards, interrupt, soft interrupt and timer threads, see dasshim.h */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dasshim.h"
+
+#define NEVER UINT64_MAX
+
+unsigned int dasshim_ncpu = 4;
+
+static struct dasshim_board boards[DASSHIM_MAXBOARD];
+static int nboard;
+
+static pthread_t intr_tid, soft_tid, timer_tid;
+static volatile int running;
+static uint64_t t0;	/* host ns at virtual tick 0 */
+
+static pthread_mutex_t intr_lock;	/* recursive, see intr_once */
+static pthread_once_t intr_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t soft_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t soft_cv = PTHREAD_COND_INITIALIZER;
+static struct dasshim_soft *soft_head, **soft_tail = &soft_head;
+
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_cv;	/* on CLOCK_MONOTONIC, see timer_once */
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static struct dasshim_timer *timer_list;
+static pthread_t timer_self;
+
+static __thread int cpu = -1;
+static unsigned int cpu_next = 1;
+
+uint64_t
+dasshim_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+sleep_until(uint64_t ns)
+{
+  struct timespec ts;
+
+  ts.tv_sec = ns / 1000000000;
+  ts.tv_nsec = ns % 1000000000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    continue;
+}
+
+static void
+timer_cv_init(void)
+{
+  pthread_condattr_t ca;
+
+  pthread_condattr_init(&ca);
+  pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+  pthread_cond_init(&timer_cv, &ca);
+  pthread_condattr_destroy(&ca);
+}
+
+unsigned int
+dasshim_cpu(void)
+{
+  if (cpu < 0)
+    cpu = __atomic_fetch_add(&cpu_next, 1, __ATOMIC_RELAXED);
+  return cpu % dasshim_ncpu;
+}
+
+struct dasshim_board *
+dasshim_board_add(void)
+{
+  struct dasshim_board *sb;
+  pthread_mutexattr_t ma;
+
+  if (nboard == DASSHIM_MAXBOARD)
+    return NULL;
+  sb = &boards[nboard];
+  memset(sb, 0, sizeof(*sb));
+  dasemu_init(&sb->sb_emu);
+  pthread_mutexattr_init(&ma);
+  pthread_mutexattr_settype(&ma, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&sb->sb_lock, &ma);
+  pthread_mutexattr_destroy(&ma);
+  sb->sb_unit = nboard++;
+  return sb;
+}
+
+struct dasshim_board *
+dasshim_board(int unit)
+{
+  return unit >= 0 && unit < nboard ? &boards[unit] : NULL;
+}
+
+int
+dasshim_nboard(void)
+{
+  return nboard;
+}
+
+void
+dasshim_lock(struct dasshim_board *sb)
+{
+  pthread_mutex_lock(&sb->sb_lock);
+}
+
+void
+dasshim_unlock(struct dasshim_board *sb)
+{
+  pthread_mutex_unlock(&sb->sb_lock);
+}
+
+/* The dasemu irq hook: the driver's ISR, timed */
+static void
+board_irq(void *arg)
+{
+  struct dasshim_board *sb = arg;
+  uint64_t at = dasshim_ns(), ns;
+
+  if (!(*sb->sb_isr)(sb->sb_isr_arg))
+    sb->sb_unclaimed++;
+  ns = dasshim_ns() - at;
+  sb->sb_isrs++;
+  sb->sb_isr_ns += ns;
+  if (ns > sb->sb_isr_max_ns)
+    sb->sb_isr_max_ns = ns;
+}
+
+void
+dasshim_set_isr(struct dasshim_board *sb, int (*fn)(void *), void *arg)
+{
+  dasshim_lock(sb);
+  sb->sb_isr = fn;
+  sb->sb_isr_arg = arg;
+  sb->sb_emu.de_irq = fn != NULL ? board_irq : NULL;
+  sb->sb_emu.de_arg = sb;
+  dasshim_unlock(sb);
+}
+
+uint8_t
+dasshim_read_1(struct dasshim_board *sb, int bar, uint32_t off)
+{
+  uint8_t v;
+
+  dasshim_lock(sb);
+  v = dasemu_read_1(&sb->sb_emu, bar, off);
+  dasshim_unlock(sb);
+  return v;
+}
+
+void
+dasshim_write_1(struct dasshim_board *sb, int bar, uint32_t off, uint8_t v)
+{
+  dasshim_lock(sb);
+  dasemu_write_1(&sb->sb_emu, bar, off, v);
+  dasshim_unlock(sb);
+}
+
+uint32_t
+dasshim_read_4(struct dasshim_board *sb, int bar, uint32_t off)
+{
+  uint32_t v;
+
+  dasshim_lock(sb);
+  v = dasemu_read_4(&sb->sb_emu, bar, off);
+  dasshim_unlock(sb);
+  return v;
+}
+
+void
+dasshim_write_4(struct dasshim_board *sb, int bar, uint32_t off, uint32_t v)
+{
+  dasshim_lock(sb);
+  dasemu_write_4(&sb->sb_emu, bar, off, v);
+  dasshim_unlock(sb);
+}
+
+void
+dasshim_barrier(void)
+{
+  int i;
+
+  for (i = 0; i < nboard; i++) {
+    dasshim_lock(&boards[i]);
+    dasshim_unlock(&boards[i]);
+  }
+}
+
+static void
+intr_lock_init(void)
+{
+  pthread_mutexattr_t ma;
+
+  pthread_mutexattr_init(&ma);
+  pthread_mutexattr_settype(&ma, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&intr_lock, &ma);
+  pthread_mutexattr_destroy(&ma);
+}
+
+void
+dasshim_intr_lock(void)
+{
+  pthread_once(&intr_once, intr_lock_init);
+  pthread_mutex_lock(&intr_lock);
+}
+
+void
+dasshim_intr_unlock(void)
+{
+  pthread_mutex_unlock(&intr_lock);
+}
+
+/* Board tick of the next thing the interrupt thread must see */
+static uint64_t
+board_next(struct dasshim_board *sb)
+{
+  const struct dasemu *de = &sb->sb_emu;
+  uint64_t next = de->de_ctr[2].ec_next;
+
+  if (next != NEVER)
+    next += de->de_irq_ticks;
+  if (de->de_line && de->de_irq != NULL && de->de_deliver < next)
+    next = de->de_deliver;
+  return next;
+}
+
+static void *
+intr_thread(void *arg)
+{
+  struct dasshim_board *sb;
+  uint64_t now, next, at, target;
+  int i;
+
+  cpu = 0;
+  while (running) {
+    now = dasshim_ns() - t0;
+    next = now + DASSHIM_POLL_NS;
+    for (i = 0; i < nboard; i++) {
+      sb = &boards[i];
+      target = sb->sb_base + dasemu_ticks(now);
+      dasshim_intr_lock();
+      dasshim_lock(sb);
+      if (target > sb->sb_emu.de_now)
+        dasemu_run(&sb->sb_emu, target - sb->sb_emu.de_now);
+      at = board_next(sb);
+      dasshim_unlock(sb);
+      dasshim_intr_unlock();
+      if (at != NEVER && at > sb->sb_base &&
+          dasemu_ns(at - sb->sb_base) < next)
+        next = dasemu_ns(at - sb->sb_base);
+    }
+    if (next > now)
+      sleep_until(t0 + next);
+  }
+  return NULL;
+}
+
+void
+dasshim_soft_init(struct dasshim_soft *ss, void (*fn)(void *), void *arg)
+{
+  memset(ss, 0, sizeof(*ss));
+  ss->ss_fn = fn;
+  ss->ss_arg = arg;
+}
+
+void
+dasshim_soft_schedule(struct dasshim_soft *ss)
+{
+  pthread_mutex_lock(&soft_lock);
+  if (!ss->ss_pending) {
+    ss->ss_pending = 1;
+    ss->ss_next = NULL;
+    *soft_tail = ss;
+    soft_tail = &ss->ss_next;
+    pthread_cond_signal(&soft_cv);
+  }
+  pthread_mutex_unlock(&soft_lock);
+}
+
+static void *
+soft_thread(void *arg)
+{
+  struct dasshim_soft *ss;
+
+  cpu = 0;
+  pthread_mutex_lock(&soft_lock);
+  for (;;) {
+    while (soft_head == NULL && running)
+      pthread_cond_wait(&soft_cv, &soft_lock);
+    if (soft_head == NULL)
+      break;
+    ss = soft_head;
+    soft_head = ss->ss_next;
+    if (soft_head == NULL)
+      soft_tail = &soft_head;
+    ss->ss_pending = 0;
+    pthread_mutex_unlock(&soft_lock);
+    (*ss->ss_fn)(ss->ss_arg);
+    pthread_mutex_lock(&soft_lock);
+  }
+  pthread_mutex_unlock(&soft_lock);
+  return NULL;
+}
+
+void
+dasshim_timer_init(struct dasshim_timer *st, void (*fn)(void *), void *arg)
+{
+  pthread_once(&timer_once, timer_cv_init);
+  memset(st, 0, sizeof(*st));
+  st->st_fn = fn;
+  st->st_arg = arg;
+}
+
+static int
+timer_unlink(struct dasshim_timer *st)
+{
+  struct dasshim_timer **p;
+
+  if (!st->st_armed)
+    return 0;
+  for (p = &timer_list; *p != st; p = &(*p)->st_next)
+    continue;
+  *p = st->st_next;
+  st->st_armed = 0;
+  return 1;
+}
+
+/* Nonzero if it was already armed */
+int
+dasshim_timer_start(struct dasshim_timer *st, uint64_t ns)
+{
+  int was;
+
+  pthread_mutex_lock(&timer_lock);
+  was = timer_unlink(st);
+  st->st_when = dasshim_ns() + ns;
+  st->st_armed = 1;
+  st->st_next = timer_list;
+  timer_list = st;
+  pthread_cond_broadcast(&timer_cv);
+  pthread_mutex_unlock(&timer_lock);
+  return was;
+}
+
+int
+dasshim_timer_stop(struct dasshim_timer *st)
+{
+  int was;
+
+  pthread_mutex_lock(&timer_lock);
+  was = timer_unlink(st);
+  pthread_mutex_unlock(&timer_lock);
+  return was;
+}
+
+int
+dasshim_timer_halt(struct dasshim_timer *st)
+{
+  int was;
+
+  pthread_mutex_lock(&timer_lock);
+  was = timer_unlink(st);
+  if (!pthread_equal(pthread_self(), timer_self)) {
+    while (st->st_running)
+      pthread_cond_wait(&timer_cv, &timer_lock);
+  }
+  pthread_mutex_unlock(&timer_lock);
+  return was;
+}
+
+int
+dasshim_timer_pending(struct dasshim_timer *st)
+{
+  return st->st_armed;
+}
+
+static void *
+timer_thread(void *arg)
+{
+  struct dasshim_timer *st, *first;
+  struct timespec ts;
+  uint64_t now;
+
+  cpu = 0;
+  pthread_mutex_lock(&timer_lock);
+  timer_self = pthread_self();
+  while (running) {
+    first = NULL;
+    for (st = timer_list; st != NULL; st = st->st_next)
+      if (first == NULL || st->st_when < first->st_when)
+        first = st;
+    now = dasshim_ns();
+    if (first == NULL || first->st_when > now) {
+      if (first == NULL)
+        pthread_cond_wait(&timer_cv, &timer_lock);
+      else {
+        ts.tv_sec = first->st_when / 1000000000;
+        ts.tv_nsec = first->st_when % 1000000000;
+        pthread_cond_timedwait(&timer_cv, &timer_lock, &ts);
+      }
+      continue;
+    }
+    timer_unlink(first);
+    first->st_running = 1;
+    pthread_mutex_unlock(&timer_lock);
+    (*first->st_fn)(first->st_arg);
+    pthread_mutex_lock(&timer_lock);
+    first->st_running = 0;
+    pthread_cond_broadcast(&timer_cv);
+  }
+  pthread_mutex_unlock(&timer_lock);
+  return NULL;
+}
+
+void
+dasshim_start(void)
+{
+  int i;
+
+  pthread_once(&timer_once, timer_cv_init);
+  running = 1;
+  t0 = dasshim_ns();
+  // attach has already moved the boards' time on
+  for (i = 0; i < nboard; i++)
+    boards[i].sb_base = boards[i].sb_emu.de_now;
+  if (pthread_create(&intr_tid, NULL, intr_thread, NULL) != 0 ||
+      pthread_create(&soft_tid, NULL, soft_thread, NULL) != 0 ||
+      pthread_create(&timer_tid, NULL, timer_thread, NULL) != 0) {
+    fprintf(stderr, "dasshim: cannot start threads\n");
+    exit(1);
+  }
+}
+
+void
+dasshim_stop(void)
+{
+  running = 0;
+  pthread_join(intr_tid, NULL);
+  pthread_mutex_lock(&soft_lock);
+  pthread_cond_broadcast(&soft_cv);
+  pthread_mutex_unlock(&soft_lock);
+  pthread_join(soft_tid, NULL);
+  pthread_mutex_lock(&timer_lock);
+  pthread_cond_broadcast(&timer_cv);
+  pthread_mutex_unlock(&timer_lock);
+  pthread_join(timer_tid, NULL);
+}
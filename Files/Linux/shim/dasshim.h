@@ -0,0 +1,108 @@
+/* dasshim.h -- the kernel both driver shims run on */
+/*
+ * What das.c and the das1 driver need from a kernel beyond their own
+ * API, done once on pthreads: emulated boards behind a lock, an
+ * interrupt thread, one soft interrupt thread, timers and CPU numbers.
+ * nbsd_shim.c and wdf_shim.c put the NetBSD and KMDF names on these.
+ *
+ * Board: a dasemu behind a recursive lock.  Every port access takes
+ * it, and the interrupt thread holds it while it runs the boards, so
+ * the ISR runs with the lock held, the way a real one holds off the
+ * board from the other CPUs' point of view.  dasshim_barrier waits for
+ * any ISR that is running.
+ *
+ * Interrupt priority: one recursive lock, taken before any board lock.
+ * The interrupt thread holds it while it runs the boards, and a thread
+ * that holds it has raised its spl as far as the ISR goes, so the ISR
+ * cannot run until it lets go.  nbsd_shim.c takes it for spin mutexes.
+ *
+ * Interrupt thread: CPU 0.  It keeps each board's virtual time level
+ * with the host's CLOCK_MONOTONIC, so the pacer ticks in real time and
+ * readers block and wake for real; the ISR is called from dasemu_run
+ * and timed in host ns.  It sleeps until the next pacer tick or
+ * DASSHIM_POLL_NS, whichever is sooner.
+ *
+ * Soft interrupts (softint(9), DPCs): one thread, also CPU 0, in the
+ * order they were scheduled; scheduling one that is pending is a no-op.
+ *
+ * Timers (callout(9), WDFTIMER): one thread, CPU 0, millisecond ticks.
+ * dasshim_timer_halt waits for a running handler unless called from it.
+ *
+ * Other threads get CPU numbers 1 up in the order they first ask.
+ */
+#ifndef _DASSHIM_H_
+#define _DASSHIM_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "../dasemu.h"
+
+#define DASSHIM_MAXBOARD 8
+#define DASSHIM_POLL_NS 200000	/* longest interrupt thread sleep */
+
+struct dasshim_board {
+  struct dasemu sb_emu;
+  pthread_mutex_t sb_lock;	/* recursive */
+  int sb_unit;
+  uint64_t sb_base;	/* board tick at dasshim_start */
+  int (*sb_isr)(void *);	/* nonzero if it was the board's */
+  void *sb_isr_arg;
+
+  /* ISR cost in host time, under sb_lock */
+  uint64_t sb_isrs;
+  uint64_t sb_unclaimed;
+  uint64_t sb_isr_ns;
+  uint64_t sb_isr_max_ns;
+};
+
+struct dasshim_soft {
+  void (*ss_fn)(void *);
+  void *ss_arg;
+  int ss_pending;
+  struct dasshim_soft *ss_next;
+};
+
+struct dasshim_timer {
+  void (*st_fn)(void *);
+  void *st_arg;
+  uint64_t st_when;	/* host ns */
+  int st_armed;
+  int st_running;
+  struct dasshim_timer *st_next;
+};
+
+extern unsigned int dasshim_ncpu;
+
+/* Boards; dasemu settings go in sb_emu between add and start. */
+struct dasshim_board *dasshim_board_add(void);
+struct dasshim_board *dasshim_board(int);
+int dasshim_nboard(void);
+void dasshim_set_isr(struct dasshim_board *, int (*)(void *), void *);
+uint8_t dasshim_read_1(struct dasshim_board *, int, uint32_t);
+void dasshim_write_1(struct dasshim_board *, int, uint32_t, uint8_t);
+uint32_t dasshim_read_4(struct dasshim_board *, int, uint32_t);
+void dasshim_write_4(struct dasshim_board *, int, uint32_t, uint32_t);
+void dasshim_lock(struct dasshim_board *);
+void dasshim_unlock(struct dasshim_board *);
+void dasshim_barrier(void);
+void dasshim_intr_lock(void);
+void dasshim_intr_unlock(void);
+
+/* The interrupt, soft interrupt and timer threads */
+void dasshim_start(void);
+void dasshim_stop(void);
+
+void dasshim_soft_init(struct dasshim_soft *, void (*)(void *), void *);
+void dasshim_soft_schedule(struct dasshim_soft *);
+
+void dasshim_timer_init(struct dasshim_timer *, void (*)(void *), void *);
+int dasshim_timer_start(struct dasshim_timer *, uint64_t);	/* ns from now */
+int dasshim_timer_stop(struct dasshim_timer *);
+int dasshim_timer_halt(struct dasshim_timer *);
+int dasshim_timer_pending(struct dasshim_timer *);
+
+unsigned int dasshim_cpu(void);
+uint64_t dasshim_ns(void);
+
+#endif /* _DASSHIM_H_ */
@@ -0,0 +1,246 @@
+/* nbsd_das.c -- das.c attached to an emulated board, see dasdrv.h */
+/*
+ * What config(1) and the cdevsw layer would do for das: das_cd, attach
+ * through das_ca, and d_open/d_ioctl/d_read/d_close on a dev_t whose
+ * minor is the unit.
+ */
+#include <sys/param.h>
+#include <sys/atomic.h>
+#include <sys/systm.h>
+#include <sys/conf.h>
+#include <sys/device.h>
+#include <sys/file.h>
+#include <sys/malloc.h>
+#include <sys/ioctl.h>
+#include <uvm/uvm_extern.h>
+#include <dev/pci/pcivar.h>
+#include <dev/pci/dasio.h>
+#include <dev/pci/daslatest.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "ioconf.h"
+#include "dasshim.h"
+#include "dasdrv.h"
+
+struct cfdriver das_cd = { "das", NULL, 0 };
+extern const struct cfattach das_ca;
+extern const struct cdevsw das_cdevsw;
+
+struct nbsd_das {
+  dev_t nd_dev;
+  int nd_flags;
+  const struct das_latest *nd_latest;	/* mapped on first use */
+};
+
+/*
+ * Opens of each unit, as one vnode would count them: every open reaches
+ * d_open, and only the last close reaches d_close.
+ */
+static u_int nopen[DASSHIM_MAXBOARD];
+static pthread_mutex_t nopen_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+nbsd_attach(struct dasshim_board *sb)
+{
+  struct pci_attach_args pa;
+
+  memset(&pa, 0, sizeof(pa));
+  pa.pa_pc = sb;
+  pa.pa_id = PCI_ID_CODE(DASVENDOR, DASPRODUCT);
+  if (shim_config_attach(&das_cd, &das_ca, sb->sb_unit, &pa) == NULL)
+    return ENXIO;
+  return device_lookup_private(&das_cd, sb->sb_unit) != NULL ? 0 : ENXIO;
+}
+
+static int
+nbsd_open(int unit, int flags, void **hp)
+{
+  struct nbsd_das *nd;
+  int error;
+
+  if (unit < 0 || unit >= DASSHIM_MAXBOARD)
+    return ENXIO;
+  nd = malloc(sizeof(*nd), M_DEVBUF, M_WAITOK | M_ZERO);
+  if (nd == NULL)
+    return ENOMEM;
+  nd->nd_dev = unit;
+  nd->nd_flags = (flags & O_ACCMODE) == O_RDONLY ? FREAD : FREAD | FWRITE;
+  pthread_mutex_lock(&nopen_lock);
+  error = (*das_cdevsw.d_open)(nd->nd_dev, nd->nd_flags, 0, NULL);
+  if (error == 0)
+    nopen[unit]++;
+  pthread_mutex_unlock(&nopen_lock);
+  if (error) {
+    free(nd, M_DEVBUF);
+    return error;
+  }
+  *hp = nd;
+  return 0;
+}
+
+static int
+nbsd_close(void *h)
+{
+  struct nbsd_das *nd = h;
+  int error = 0;
+
+  pthread_mutex_lock(&nopen_lock);
+  if (--nopen[nd->nd_dev] == 0)
+    error = (*das_cdevsw.d_close)(nd->nd_dev, nd->nd_flags, 0, NULL);
+  pthread_mutex_unlock(&nopen_lock);
+  free(nd, M_DEVBUF);
+  return error;
+}
+
+static int
+nbsd_ioctl(void *h, u_long cmd, void *data)
+{
+  struct nbsd_das *nd = h;
+
+  return (*das_cdevsw.d_ioctl)(nd->nd_dev, cmd, data, nd->nd_flags, NULL);
+}
+
+static int
+nbsd_pacer(void *h, unsigned int count)
+{
+  int rate = count;
+
+  return nbsd_ioctl(h, DAS_SET_RATE, &rate);
+}
+
+static int
+nbsd_set_channel(void *h, int ch)
+{
+  return nbsd_ioctl(h, DAS_SET_CHANNEL, &ch);
+}
+
+static int
+nbsd_get_channel(void *h, int *ch)
+{
+  return nbsd_ioctl(h, DAS_GET_CHANNEL, ch);
+}
+
+static int
+nbsd_start(void *h)
+{
+  return nbsd_ioctl(h, DAS_START_SAMPLING, NULL);
+}
+
+static int
+nbsd_stop(void *h)
+{
+  return nbsd_ioctl(h, DAS_STOP_SAMPLING, NULL);
+}
+
+static ssize_t
+nbsd_read(void *h, void *buf, size_t len)
+{
+  struct nbsd_das *nd = h;
+  struct iovec iov;
+  struct uio uio;
+  int error;
+
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  memset(&uio, 0, sizeof(uio));
+  uio.uio_iov = &iov;
+  uio.uio_iovcnt = 1;
+  uio.uio_resid = len;
+  uio.uio_rw = UIO_READ;
+  error = (*das_cdevsw.d_read)(nd->nd_dev, &uio, 0);
+  // like read(2): a partial transfer is not an error
+  if (error && uio.uio_resid == len)
+    return -error;
+  return len - uio.uio_resid;
+}
+
+static int
+nbsd_stats(void *h, struct dasdrv_stats *dv)
+{
+  struct das_stats ds;
+  int error;
+
+  error = nbsd_ioctl(h, DAS_GET_STATS, &ds);
+  if (error)
+    return error;
+  dv->dv_intr = ds.ds_intr;
+  dv->dv_samples = ds.ds_samples;
+  dv->dv_overrun = ds.ds_overrun;
+  return 0;
+}
+
+static int
+nbsd_regbatch(void *h, struct dasdrv_regop *dr, unsigned int n)
+{
+  struct das_regop ops[DAS_REGBATCH_MAX];
+  struct das_regbatch rb;
+  unsigned int i;
+  int error;
+
+  if (n > DAS_REGBATCH_MAX)
+    return EINVAL;
+  memset(ops, 0, n * sizeof(ops[0]));
+  for (i = 0; i < n; i++) {
+    ops[i].ro_op = dr[i].dr_op;
+    ops[i].ro_bar = dr[i].dr_bar;
+    ops[i].ro_off = dr[i].dr_off;
+    ops[i].ro_mask = dr[i].dr_mask;
+    ops[i].ro_val = dr[i].dr_val;
+  }
+  rb.rb_nops = n;
+  rb.rb_done = 0;
+  rb.rb_ops = ops;
+  error = nbsd_ioctl(h, DAS_REGISTER_BATCH, &rb);
+  for (i = 0; i < rb.rb_done; i++)
+    dr[i].dr_result = ops[i].ro_result;
+  return error;
+}
+
+static int
+nbsd_latest(void *h, int map, unsigned int chan, uint32_t *sample,
+	    uint32_t *nsamp)
+{
+  struct nbsd_das *nd = h;
+  struct das_latest_snap ls;
+  struct das_latest_val lv;
+  paddr_t pg;
+  int error;
+
+  if (chan >= DAS_NCHAN)
+    return EINVAL;
+  if (!map) {
+    error = nbsd_ioctl(h, DAS_GET_LATEST, &ls);
+    if (error)
+      return error;
+    lv = ls.ls_chan[chan];
+  } else {
+    if (nd->nd_latest == NULL) {
+      pg = (*das_cdevsw.d_mmap)(nd->nd_dev, DAS_LATEST_OFFSET, VM_PROT_READ);
+      if (pg == (paddr_t)-1)
+	return ENODEV;
+      // the shim's pmap_extract is the identity
+      nd->nd_latest = (const struct das_latest *)(uintptr_t)(pg * PAGE_SIZE);
+    }
+    das_latest_read(nd->nd_latest, chan, &lv);
+  }
+  *sample = lv.dv_sample;
+  *nsamp = lv.dv_nsamp;
+  return 0;
+}
+
+const struct dasdrv dasdrv_netbsd = {
+  .dd_name = "netbsd",
+  .dd_attach = nbsd_attach,
+  .dd_open = nbsd_open,
+  .dd_close = nbsd_close,
+  .dd_pacer = nbsd_pacer,
+  .dd_set_channel = nbsd_set_channel,
+  .dd_get_channel = nbsd_get_channel,
+  .dd_start = nbsd_start,
+  .dd_stop = nbsd_stop,
+  .dd_read = nbsd_read,
+  .dd_stats = nbsd_stats,
+  .dd_regbatch = nbsd_regbatch,
+  .dd_latest = nbsd_latest,
+};
@@ -0,0 +1,724 @@
+/* nbsd_shim.c -- the NetBSD kernel interfaces das.c uses, on dasshim */
+/*
+ * Built with -D_KERNEL against the headers in netbsd/, which stand in
+ * for the kernel's.  Locks and condvars are pthreads, malloc(9) is the
+ * host allocator, user addresses are host addresses, bus_space goes to
+ * the emulated board under its lock, and hz is 1000.  cv_wait_sig is
+ * never interrupted: nothing here delivers signals to the driver.
+ */
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/atomic.h>
+#include <sys/bus.h>
+#include <sys/callout.h>
+#include <sys/condvar.h>
+#include <sys/conf.h>
+#include <sys/cpu.h>
+#include <sys/device.h>
+#include <sys/evcnt.h>
+#include <sys/intr.h>
+#include <sys/kernel.h>
+#include <sys/malloc.h>
+#include <sys/mutex.h>
+#include <sys/select.h>
+#include <sys/sysctl.h>
+#include <sys/xcall.h>
+#include <uvm/uvm_extern.h>
+#include <dev/pci/pcivar.h>
+
+#include "dasshim.h"
+
+int hz = 1000;
+unsigned int ncpu;
+
+struct cpu_info {
+  unsigned int ci_index;
+};
+
+static struct cpu_info cpus[64];
+
+static void __attribute__((__constructor__))
+shim_init(void)
+{
+  unsigned int i;
+
+  ncpu = dasshim_ncpu;
+  if (ncpu > __arraycount(cpus))
+    ncpu = dasshim_ncpu = __arraycount(cpus);
+  for (i = 0; i < ncpu; i++)
+    cpus[i].ci_index = i;
+}
+
+struct cpu_info *
+shim_curcpu(void)
+{
+  return &cpus[dasshim_cpu() % ncpu];
+}
+
+unsigned int
+shim_cpu_index(struct cpu_info *ci)
+{
+  return ci->ci_index;
+}
+
+/* mutex(9) */
+
+/*
+ * A mutex at a hardware interrupt level is a spin mutex: it raises the
+ * spl, so the ISR waits for it and it never waits for a board lock the
+ * ISR holds.  See dasshim.h.
+ */
+void
+mutex_init(kmutex_t *mtx, kmutex_type_t type, int ipl)
+{
+  pthread_mutex_init(&mtx->mtx_lock, NULL);
+  mtx->mtx_held = 0;
+  mtx->mtx_spin = ipl > IPL_SOFTSERIAL;
+}
+
+void
+mutex_destroy(kmutex_t *mtx)
+{
+  pthread_mutex_destroy(&mtx->mtx_lock);
+}
+
+void
+mutex_enter(kmutex_t *mtx)
+{
+  if (mtx->mtx_spin)
+    dasshim_intr_lock();
+  pthread_mutex_lock(&mtx->mtx_lock);
+  mtx->mtx_owner = pthread_self();
+  mtx->mtx_held = 1;
+}
+
+void
+mutex_exit(kmutex_t *mtx)
+{
+  KASSERT(mutex_owned(mtx));
+  mtx->mtx_held = 0;
+  pthread_mutex_unlock(&mtx->mtx_lock);
+  if (mtx->mtx_spin)
+    dasshim_intr_unlock();
+}
+
+int
+mutex_tryenter(kmutex_t *mtx)
+{
+  if (mtx->mtx_spin)
+    dasshim_intr_lock();
+  if (pthread_mutex_trylock(&mtx->mtx_lock) != 0) {
+    if (mtx->mtx_spin)
+      dasshim_intr_unlock();
+    return 0;
+  }
+  mtx->mtx_owner = pthread_self();
+  mtx->mtx_held = 1;
+  return 1;
+}
+
+int
+mutex_owned(kmutex_t *mtx)
+{
+  return mtx->mtx_held && pthread_equal(mtx->mtx_owner, pthread_self());
+}
+
+/* condvar(9) */
+
+void
+cv_init(kcondvar_t *cv, const char *wmesg)
+{
+  pthread_condattr_t ca;
+
+  pthread_condattr_init(&ca);
+  pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+  pthread_cond_init(&cv->cv_cond, &ca);
+  pthread_condattr_destroy(&ca);
+  cv->cv_wmesg = wmesg;
+}
+
+void
+cv_destroy(kcondvar_t *cv)
+{
+  pthread_cond_destroy(&cv->cv_cond);
+}
+
+void
+cv_wait(kcondvar_t *cv, kmutex_t *mtx)
+{
+  KASSERT(mutex_owned(mtx));
+  mtx->mtx_held = 0;
+  pthread_cond_wait(&cv->cv_cond, &mtx->mtx_lock);
+  mtx->mtx_owner = pthread_self();
+  mtx->mtx_held = 1;
+}
+
+int
+cv_wait_sig(kcondvar_t *cv, kmutex_t *mtx)
+{
+  cv_wait(cv, mtx);
+  return 0;
+}
+
+int
+cv_timedwait(kcondvar_t *cv, kmutex_t *mtx, int ticks)
+{
+  struct timespec ts;
+  uint64_t at;
+  int error;
+
+  if (ticks <= 0) {
+    cv_wait(cv, mtx);
+    return 0;
+  }
+  KASSERT(mutex_owned(mtx));
+  at = dasshim_ns() + (uint64_t)ticks * (1000000000 / hz);
+  ts.tv_sec = at / 1000000000;
+  ts.tv_nsec = at % 1000000000;
+  mtx->mtx_held = 0;
+  error = pthread_cond_timedwait(&cv->cv_cond, &mtx->mtx_lock, &ts);
+  mtx->mtx_owner = pthread_self();
+  mtx->mtx_held = 1;
+  return error == ETIMEDOUT ? EWOULDBLOCK : 0;
+}
+
+int
+cv_timedwait_sig(kcondvar_t *cv, kmutex_t *mtx, int ticks)
+{
+  return cv_timedwait(cv, mtx, ticks);
+}
+
+void
+cv_signal(kcondvar_t *cv)
+{
+  pthread_cond_signal(&cv->cv_cond);
+}
+
+void
+cv_broadcast(kcondvar_t *cv)
+{
+  pthread_cond_broadcast(&cv->cv_cond);
+}
+
+/* malloc(9), uvm_km(9), copy(9), uiomove(9) */
+
+#undef malloc
+#undef free
+
+void *
+shim_malloc(unsigned long size, int type, int flags)
+{
+  void *p = (flags & M_ZERO) ? calloc(1, size) : malloc(size);
+
+  if (p == NULL && (flags & M_NOWAIT) == 0) {
+    fprintf(stderr, "malloc(9): out of memory for %lu bytes\n", size);
+    abort();
+  }
+  return p;
+}
+
+void
+shim_free(void *p, int type)
+{
+  free(p);
+}
+
+struct vm_map *kernel_map;
+static struct pmap *kernel_pmap;
+
+vaddr_t
+uvm_km_alloc(struct vm_map *map, vsize_t size, vsize_t align, int flags)
+{
+  void *p;
+
+  size = round_page(size);
+  if (posix_memalign(&p, PAGE_SIZE, size) != 0)
+    return 0;
+  if (flags & UVM_KMF_ZERO)
+    memset(p, 0, size);
+  return (vaddr_t)p;
+}
+
+void
+uvm_km_free(struct vm_map *map, vaddr_t va, vsize_t size, int flags)
+{
+  free((void *)va);
+}
+
+struct pmap *
+pmap_kernel(void)
+{
+  return kernel_pmap;
+}
+
+/* No physical memory here: the "physical" address is the host one. */
+bool
+pmap_extract(struct pmap *pmap, vaddr_t va, paddr_t *pa)
+{
+  *pa = va;
+  return true;
+}
+
+int
+copyin(const void *uaddr, void *kaddr, size_t len)
+{
+  memcpy(kaddr, uaddr, len);
+  return 0;
+}
+
+int
+copyout(const void *kaddr, void *uaddr, size_t len)
+{
+  memcpy(uaddr, kaddr, len);
+  return 0;
+}
+
+int
+uiomove(void *buf, size_t n, struct uio *uio)
+{
+  struct iovec *iov;
+  char *cp = buf;
+  size_t cnt;
+
+  while (n > 0 && uio->uio_resid > 0) {
+    iov = uio->uio_iov;
+    if (iov->iov_len == 0) {
+      KASSERT(uio->uio_iovcnt > 1);
+      uio->uio_iov++;
+      uio->uio_iovcnt--;
+      continue;
+    }
+    cnt = MIN(iov->iov_len, n);
+    if (uio->uio_rw == UIO_READ)
+      memcpy(iov->iov_base, cp, cnt);
+    else
+      memcpy(cp, iov->iov_base, cnt);
+    iov->iov_base = (char *)iov->iov_base + cnt;
+    iov->iov_len -= cnt;
+    uio->uio_resid -= cnt;
+    uio->uio_offset += cnt;
+    cp += cnt;
+    n -= cnt;
+  }
+  return 0;
+}
+
+/* Time */
+
+void
+nanouptime(struct timespec *ts)
+{
+  clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+void
+nanotime(struct timespec *ts)
+{
+  clock_gettime(CLOCK_REALTIME, ts);
+}
+
+/* softint(9), spl(9), xcall(9) */
+
+void *
+softint_establish(unsigned int flags, void (*fn)(void *), void *arg)
+{
+  struct dasshim_soft *ss = calloc(1, sizeof(*ss));
+
+  if (ss != NULL)
+    dasshim_soft_init(ss, fn, arg);
+  return ss;
+}
+
+void
+softint_disestablish(void *cookie)
+{
+  free(cookie);
+}
+
+void
+softint_schedule(void *cookie)
+{
+  dasshim_soft_schedule(cookie);
+}
+
+int
+splhigh(void)
+{
+  return 0;
+}
+
+int
+spltty(void)
+{
+  return 0;
+}
+
+void
+splx(int s)
+{
+}
+
+/* Every CPU has passed the barrier once no ISR is running. */
+void
+xc_barrier(unsigned int flags)
+{
+  dasshim_barrier();
+}
+
+/* callout(9) */
+
+void
+callout_init(callout_t *c, unsigned int flags)
+{
+  dasshim_timer_init(&c->c_timer, NULL, NULL);
+}
+
+void
+callout_destroy(callout_t *c)
+{
+  dasshim_timer_halt(&c->c_timer);
+}
+
+void
+callout_setfunc(callout_t *c, void (*fn)(void *), void *arg)
+{
+  c->c_timer.st_fn = fn;
+  c->c_timer.st_arg = arg;
+}
+
+void
+callout_reset(callout_t *c, int ticks, void (*fn)(void *), void *arg)
+{
+  callout_setfunc(c, fn, arg);
+  callout_schedule(c, ticks);
+}
+
+void
+callout_schedule(callout_t *c, int ticks)
+{
+  dasshim_timer_start(&c->c_timer,
+      (uint64_t)MAX(ticks, 1) * (1000000000 / hz));
+}
+
+bool
+callout_stop(callout_t *c)
+{
+  return dasshim_timer_stop(&c->c_timer);
+}
+
+bool
+callout_halt(callout_t *c, void *interlock)
+{
+  return dasshim_timer_halt(&c->c_timer);
+}
+
+bool
+callout_pending(callout_t *c)
+{
+  return dasshim_timer_pending(&c->c_timer);
+}
+
+/* selinfo(9) */
+
+void
+selinit(struct selinfo *sip)
+{
+  SLIST_INIT(&sip->sel_klist);
+  sip->sel_pending = 0;
+}
+
+void
+seldestroy(struct selinfo *sip)
+{
+}
+
+void
+selrecord(struct lwp *l, struct selinfo *sip)
+{
+  sip->sel_pending++;
+}
+
+void
+selnotify(struct selinfo *sip, int events, long knhint)
+{
+  struct knote *kn;
+
+  sip->sel_pending = 0;
+  SLIST_FOREACH(kn, &sip->sel_klist, kn_selnext)
+    (void)(*kn->kn_fop->f_event)(kn, knhint);
+}
+
+void
+selrecord_knote(struct selinfo *sip, struct knote *kn)
+{
+  SLIST_INSERT_HEAD(&sip->sel_klist, kn, kn_selnext);
+}
+
+void
+selremove_knote(struct selinfo *sip, struct knote *kn)
+{
+  SLIST_REMOVE(&sip->sel_klist, kn, knote, kn_selnext);
+}
+
+/* evcnt(9) */
+
+void
+evcnt_attach_dynamic(struct evcnt *ev, int type, const struct evcnt *parent,
+    const char *group, const char *name)
+{
+  ev->ev_count = 0;
+  ev->ev_type = type;
+  ev->ev_parent = parent;
+  ev->ev_group = group;
+  ev->ev_name = name;
+}
+
+void
+evcnt_detach(struct evcnt *ev)
+{
+}
+
+/* sysctl(9): nodes are kept in a list and found by dotted name */
+
+struct shim_sysctl {
+  struct sysctlnode ss_node;
+  struct sysctllog **ss_log;
+  struct shim_sysctl *ss_next;
+};
+
+static struct shim_sysctl *sysctls;
+static struct sysctlnode sysctl_hw = {
+  .sysctl_type = CTLTYPE_NODE, .sysctl_name = "hw",
+};
+
+int
+sysctl_createv(struct sysctllog **log, int cflags,
+    const struct sysctlnode **rnode, const struct sysctlnode **cnode,
+    int flags, int type, const char *name, const char *desc, sysctlfn func,
+    unsigned long long qv, void *newp, size_t newlen, ...)
+{
+  struct shim_sysctl *ss;
+
+  ss = calloc(1, sizeof(*ss));
+  if (ss == NULL)
+    return ENOMEM;
+  ss->ss_node.sysctl_flags = flags;
+  ss->ss_node.sysctl_type = type;
+  ss->ss_node.sysctl_name = strdup(name);
+  ss->ss_node.sysctl_desc = desc;
+  ss->ss_node.sysctl_data = newp;
+  // the path in the varargs is always hw here
+  ss->ss_node.sysctl_parent = rnode != NULL && *rnode != NULL ? *rnode :
+      &sysctl_hw;
+  ss->ss_log = log;
+  ss->ss_next = sysctls;
+  sysctls = ss;
+  if (cnode != NULL)
+    *cnode = &ss->ss_node;
+  return 0;
+}
+
+void
+sysctl_teardown(struct sysctllog **log)
+{
+  struct shim_sysctl **p, *ss;
+
+  for (p = &sysctls; (ss = *p) != NULL;) {
+    if (ss->ss_log != log) {
+      p = &ss->ss_next;
+      continue;
+    }
+    *p = ss->ss_next;
+    free((void *)ss->ss_node.sysctl_name);
+    free(ss);
+  }
+}
+
+static int
+sysctl_match(const struct sysctlnode *node, const char *name, size_t len)
+{
+  size_t n;
+
+  if (node->sysctl_parent != NULL) {
+    n = len;
+    while (n > 0 && name[n - 1] != '.')
+      n--;
+    if (n == 0 || !sysctl_match(node->sysctl_parent, name, n - 1))
+      return 0;
+    name += n;
+    len -= n;
+  }
+  return strlen(node->sysctl_name) == len &&
+      strncmp(node->sysctl_name, name, len) == 0;
+}
+
+const struct sysctlnode *
+shim_sysctl_lookup(const char *name)
+{
+  struct shim_sysctl *ss;
+
+  for (ss = sysctls; ss != NULL; ss = ss->ss_next)
+    if (sysctl_match(&ss->ss_node, name, strlen(name)))
+      return &ss->ss_node;
+  return NULL;
+}
+
+/* autoconf(9) */
+
+void *
+device_private(device_t dev)
+{
+  return dev->dv_private;
+}
+
+const char *
+device_xname(device_t dev)
+{
+  return dev->dv_xname;
+}
+
+void *
+device_lookup_private(struct cfdriver *cd, int unit)
+{
+  if (unit < 0 || unit >= cd->cd_ndevs || cd->cd_devs[unit] == NULL)
+    return NULL;
+  return cd->cd_devs[unit]->dv_private;
+}
+
+device_t
+shim_config_attach(struct cfdriver *cd, const struct cfattach *ca, int unit,
+    void *aux)
+{
+  struct cfdata cf = { cd->cd_name };
+  device_t dev, *devs;
+
+  if (!(*ca->ca_match)(NULL, &cf, aux))
+    return NULL;
+  if (unit >= cd->cd_ndevs) {
+    devs = realloc(cd->cd_devs, (unit + 1) * sizeof(*devs));
+    if (devs == NULL)
+      return NULL;
+    memset(devs + cd->cd_ndevs, 0, (unit + 1 - cd->cd_ndevs) * sizeof(*devs));
+    cd->cd_devs = devs;
+    cd->cd_ndevs = unit + 1;
+  }
+  dev = calloc(1, sizeof(*dev));
+  dev->dv_private = calloc(1, ca->ca_devsize);
+  if (dev == NULL || dev->dv_private == NULL) {
+    fprintf(stderr, "%s%d: out of memory\n", cd->cd_name, unit);
+    abort();
+  }
+  snprintf(dev->dv_xname, sizeof(dev->dv_xname), "%s%d", cd->cd_name, unit);
+  dev->dv_unit = unit;
+  cd->cd_devs[unit] = dev;
+  (*ca->ca_attach)(NULL, dev, aux);
+  return dev;
+}
+
+/* cdevsw defaults */
+
+void
+nostop(struct tty *tp, int flag)
+{
+}
+
+struct tty *
+notty(dev_t dev)
+{
+  return NULL;
+}
+
+int
+nodiscard(dev_t dev, off_t pos, off_t len)
+{
+  return ENODEV;
+}
+
+/* bus_space(9) and PCI: handles are the emulator's BAR number << 8 */
+
+static uint8_t
+board_read_1(void *cookie, bus_addr_t a)
+{
+  return dasshim_read_1(cookie, a >> 8, a & 0xff);
+}
+
+static void
+board_write_1(void *cookie, bus_addr_t a, uint8_t v)
+{
+  dasshim_write_1(cookie, a >> 8, a & 0xff, v);
+}
+
+static uint32_t
+board_read_4(void *cookie, bus_addr_t a)
+{
+  return dasshim_read_4(cookie, a >> 8, a & 0xff);
+}
+
+static void
+board_write_4(void *cookie, bus_addr_t a, uint32_t v)
+{
+  dasshim_write_4(cookie, a >> 8, a & 0xff, v);
+}
+
+static struct bus_space board_tags[DASSHIM_MAXBOARD];
+
+int
+pci_mapreg_map(const struct pci_attach_args *pa, int reg, pcireg_t type,
+    int flags, bus_space_tag_t *tagp, bus_space_handle_t *handlep,
+    bus_addr_t *basep, bus_size_t *sizep)
+{
+  struct bus_space *bs = &board_tags[pa->pa_pc->sb_unit];
+  int bar;
+
+  switch (reg) {
+  case 0x14:
+    bar = DASEMU_BADR1;
+    break;
+  case 0x18:
+    bar = DASEMU_BADR2;
+    break;
+  default:
+    return 1;
+  }
+  bs->bs_read_1 = board_read_1;
+  bs->bs_write_1 = board_write_1;
+  bs->bs_read_4 = board_read_4;
+  bs->bs_write_4 = board_write_4;
+  bs->bs_cookie = pa->pa_pc;
+  *tagp = bs;
+  *handlep = (bus_space_handle_t)bar << 8;
+  if (basep != NULL)
+    *basep = *handlep;
+  if (sizep != NULL)
+    *sizep = bar == DASEMU_BADR1 ? 0x80 : 0x08;
+  return 0;
+}
+
+int
+pci_intr_map(const struct pci_attach_args *pa, pci_intr_handle_t *ih)
+{
+  *ih = pa->pa_pc->sb_unit;
+  return 0;
+}
+
+const char *
+pci_intr_string(pci_chipset_tag_t pc, pci_intr_handle_t ih, char *buf,
+    size_t len)
+{
+  snprintf(buf, len, "dasemu%d", ih);
+  return buf;
+}
+
+void *
+pci_intr_establish(pci_chipset_tag_t pc, pci_intr_handle_t ih, int ipl,
+    int (*fn)(void *), void *arg)
+{
+  dasshim_set_isr(pc, fn, arg);
+  return pc;
+}
+
+void
+pci_intr_disestablish(pci_chipset_tag_t pc, void *cookie)
+{
+  dasshim_set_isr(pc, NULL, NULL);
+}
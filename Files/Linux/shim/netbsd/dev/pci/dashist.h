@@ -0,0 +1,2 @@
+/* dev/pci/dashist.h -- the driver's own header, straight from the tree */
+#include "../../../../../NetBSD Files/dashist.h"
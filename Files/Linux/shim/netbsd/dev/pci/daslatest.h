@@ -0,0 +1,2 @@
+/* dev/pci/daslatest.h -- the driver's own header, straight from the tree */
+#include "../../../../../NetBSD Files/daslatest.h"
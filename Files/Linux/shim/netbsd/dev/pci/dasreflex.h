@@ -0,0 +1,2 @@
+/* dev/pci/dasreflex.h -- the driver's own header, straight from the tree */
+#include "../../../../../NetBSD Files/dasreflex.h"
@@ -0,0 +1,2 @@
+/* dev/pci/dasring.h -- the driver's own header, straight from the tree */
+#include "../../../../../NetBSD Files/dasring.h"
@@ -0,0 +1,2 @@
+/* dev/pci/dasstream.h -- the driver's own header, straight from the tree */
+#include "../../../../../NetBSD Files/dasstream.h"
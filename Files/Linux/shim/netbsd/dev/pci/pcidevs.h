@@ -0,0 +1 @@
+/* dev/pci/pcidevs.h -- das.c carries its own ids in dasio.h */
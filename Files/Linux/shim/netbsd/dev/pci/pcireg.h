@@ -0,0 +1,15 @@
+/* dev/pci/pcireg.h -- the config space macros das.c uses */
+#ifndef _SHIM_DEV_PCI_PCIREG_H_
+#define _SHIM_DEV_PCI_PCIREG_H_
+
+#include <stdint.h>
+
+typedef uint32_t pcireg_t;
+
+#define PCI_VENDOR(id) ((id) & 0xffff)
+#define PCI_PRODUCT(id) (((id) >> 16) & 0xffff)
+#define PCI_ID_CODE(vid, pid) ((((pid) & 0xffff) << 16) | ((vid) & 0xffff))
+
+#define PCI_MAPREG_TYPE_IO 0x00000001
+
+#endif /* _SHIM_DEV_PCI_PCIREG_H_ */
@@ -0,0 +1,30 @@
+/* dev/pci/pcivar.h -- PCI attach glue backed by a board model */
+#ifndef _SHIM_DEV_PCI_PCIVAR_H_
+#define _SHIM_DEV_PCI_PCIVAR_H_
+
+#include <sys/bus.h>
+#include <dev/pci/pcireg.h>
+#include "../../../dasshim.h"
+
+/* The chipset tag is the board; BARs 0x14 and 0x18 are BADR1 and 2. */
+typedef struct dasshim_board *pci_chipset_tag_t;
+typedef int pci_intr_handle_t;
+
+#define PCI_INTRSTR_LEN 64
+
+struct pci_attach_args {
+  pci_chipset_tag_t pa_pc;
+  pcireg_t pa_id;
+  bus_space_tag_t pa_iot;
+};
+
+int pci_mapreg_map(const struct pci_attach_args *, int, pcireg_t, int,
+    bus_space_tag_t *, bus_space_handle_t *, bus_addr_t *, bus_size_t *);
+int pci_intr_map(const struct pci_attach_args *, pci_intr_handle_t *);
+const char *pci_intr_string(pci_chipset_tag_t, pci_intr_handle_t, char *,
+    size_t);
+void *pci_intr_establish(pci_chipset_tag_t, pci_intr_handle_t, int,
+    int (*)(void *), void *);
+void pci_intr_disestablish(pci_chipset_tag_t, void *);
+
+#endif /* _SHIM_DEV_PCI_PCIVAR_H_ */
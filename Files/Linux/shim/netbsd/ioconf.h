@@ -0,0 +1,4 @@
+/* ioconf.h -- what config(1) would generate for das */
+#include <sys/device.h>
+
+extern struct cfdriver das_cd;
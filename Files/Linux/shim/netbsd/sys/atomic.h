@@ -0,0 +1,31 @@
+/* sys/atomic.h -- atomic_ops(3) and memory barriers on GCC builtins */
+#ifndef _SHIM_SYS_ATOMIC_H_
+#define _SHIM_SYS_ATOMIC_H_
+
+#include <stdint.h>
+
+#define membar_producer() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define membar_consumer() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define membar_enter() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define membar_exit() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define membar_sync() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#define atomic_inc_32(p) ((void)__atomic_add_fetch((p), 1, __ATOMIC_RELAXED))
+#define atomic_inc_32_nv(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define atomic_add_32(p, v) ((void)__atomic_add_fetch((p), (v), __ATOMIC_RELAXED))
+#define atomic_add_32_nv(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define atomic_swap_ptr(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_swap_32(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_swap_uint(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_cas_32(p, o, n) \
+  ({ uint32_t __o = (o); \
+     __atomic_compare_exchange_n((p), &__o, (n), 0, __ATOMIC_SEQ_CST, \
+         __ATOMIC_SEQ_CST); __o; })
+#define atomic_cas_ptr(p, o, n) \
+  ({ void *__o = (o); \
+     __atomic_compare_exchange_n((void *volatile *)(p), &__o, (n), 0, \
+         __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); __o; })
+#define atomic_or_32(p, v) ((void)__atomic_or_fetch((p), (v), __ATOMIC_SEQ_CST))
+#define atomic_and_32(p, v) ((void)__atomic_and_fetch((p), (v), __ATOMIC_SEQ_CST))
+
+#endif /* _SHIM_SYS_ATOMIC_H_ */
@@ -0,0 +1,50 @@
+/* sys/bus.h -- bus_space(9) dispatched to a userspace register model */
+#ifndef _SHIM_SYS_BUS_H_
+#define _SHIM_SYS_BUS_H_
+
+#include <sys/types.h>
+
+typedef unsigned long bus_addr_t;
+typedef unsigned long bus_size_t;
+
+/*
+ * A tag is a table of accessors plus the model behind them.  Handles are
+ * offsets that the model uses to tell its BARs apart.
+ */
+struct bus_space {
+  uint8_t (*bs_read_1)(void *, bus_addr_t);
+  void (*bs_write_1)(void *, bus_addr_t, uint8_t);
+  uint32_t (*bs_read_4)(void *, bus_addr_t);
+  void (*bs_write_4)(void *, bus_addr_t, uint32_t);
+  void *bs_cookie;
+};
+typedef const struct bus_space *bus_space_tag_t;
+typedef bus_addr_t bus_space_handle_t;
+
+static inline uint8_t
+bus_space_read_1(bus_space_tag_t t, bus_space_handle_t h, bus_size_t o)
+{
+  return t->bs_read_1(t->bs_cookie, h + o);
+}
+
+static inline void
+bus_space_write_1(bus_space_tag_t t, bus_space_handle_t h, bus_size_t o,
+    uint8_t v)
+{
+  t->bs_write_1(t->bs_cookie, h + o, v);
+}
+
+static inline uint32_t
+bus_space_read_4(bus_space_tag_t t, bus_space_handle_t h, bus_size_t o)
+{
+  return t->bs_read_4(t->bs_cookie, h + o);
+}
+
+static inline void
+bus_space_write_4(bus_space_tag_t t, bus_space_handle_t h, bus_size_t o,
+    uint32_t v)
+{
+  t->bs_write_4(t->bs_cookie, h + o, v);
+}
+
+#endif /* _SHIM_SYS_BUS_H_ */
@@ -0,0 +1,23 @@
+/* sys/callout.h -- callout(9) on the shim's timer thread, hz ticks */
+#ifndef _SHIM_SYS_CALLOUT_H_
+#define _SHIM_SYS_CALLOUT_H_
+
+#include <stdbool.h>
+#include "../../dasshim.h"
+
+typedef struct callout {
+  struct dasshim_timer c_timer;
+} callout_t;
+
+#define CALLOUT_MPSAFE 0x0100
+
+void callout_init(callout_t *, unsigned int);
+void callout_destroy(callout_t *);
+void callout_setfunc(callout_t *, void (*)(void *), void *);
+void callout_reset(callout_t *, int, void (*)(void *), void *);
+void callout_schedule(callout_t *, int);
+bool callout_stop(callout_t *);
+bool callout_halt(callout_t *, void *);
+bool callout_pending(callout_t *);
+
+#endif /* _SHIM_SYS_CALLOUT_H_ */
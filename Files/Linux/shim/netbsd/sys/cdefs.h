@@ -0,0 +1,27 @@
+/* sys/cdefs.h -- NetBSD kernel additions on top of the host cdefs */
+#include_next <sys/cdefs.h>
+
+#ifndef _SHIM_SYS_CDEFS_H_
+#define _SHIM_SYS_CDEFS_H_
+
+#define __KERNEL_RCSID(n, s) \
+  static const char __kernel_rcsid_##n[] __attribute__((__unused__)) = s
+
+#ifndef __predict_true
+#define __predict_true(x) __builtin_expect((x) != 0, 1)
+#define __predict_false(x) __builtin_expect((x) != 0, 0)
+#endif
+#ifndef __unused
+#define __unused __attribute__((__unused__))
+#endif
+#ifndef __aligned
+#define __aligned(x) __attribute__((__aligned__(x)))
+#endif
+#ifndef __arraycount
+#define __arraycount(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+#ifndef __always_inline
+#define __always_inline inline __attribute__((__always_inline__))
+#endif
+
+#endif /* _SHIM_SYS_CDEFS_H_ */
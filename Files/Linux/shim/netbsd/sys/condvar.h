@@ -0,0 +1,22 @@
+/* sys/condvar.h -- condvar(9) over pthreads */
+#ifndef _SHIM_SYS_CONDVAR_H_
+#define _SHIM_SYS_CONDVAR_H_
+
+#include <pthread.h>
+#include <sys/mutex.h>
+
+typedef struct kcondvar {
+  pthread_cond_t cv_cond;
+  const char *cv_wmesg;
+} kcondvar_t;
+
+void cv_init(kcondvar_t *, const char *);
+void cv_destroy(kcondvar_t *);
+void cv_wait(kcondvar_t *, kmutex_t *);
+int cv_wait_sig(kcondvar_t *, kmutex_t *);
+int cv_timedwait(kcondvar_t *, kmutex_t *, int);
+int cv_timedwait_sig(kcondvar_t *, kmutex_t *, int);
+void cv_signal(kcondvar_t *);
+void cv_broadcast(kcondvar_t *);
+
+#endif /* _SHIM_SYS_CONDVAR_H_ */
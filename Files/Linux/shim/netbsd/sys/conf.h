@@ -0,0 +1,54 @@
+/* sys/conf.h -- character device switch */
+#ifndef _SHIM_SYS_CONF_H_
+#define _SHIM_SYS_CONF_H_
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct lwp;
+struct knote;
+struct tty;
+
+#define dev_type_open(n) int n(dev_t, int, int, struct lwp *)
+#define dev_type_close(n) int n(dev_t, int, int, struct lwp *)
+#define dev_type_read(n) int n(dev_t, struct uio *, int)
+#define dev_type_write(n) int n(dev_t, struct uio *, int)
+#define dev_type_ioctl(n) int n(dev_t, u_long, void *, int, struct lwp *)
+#define dev_type_stop(n) void n(struct tty *, int)
+#define dev_type_tty(n) struct tty *n(dev_t)
+#define dev_type_poll(n) int n(dev_t, int, struct lwp *)
+#define dev_type_mmap(n) paddr_t n(dev_t, off_t, int)
+#define dev_type_kqfilter(n) int n(dev_t, struct knote *)
+#define dev_type_discard(n) int n(dev_t, off_t, off_t)
+
+struct cdevsw {
+  dev_type_open((*d_open));
+  dev_type_close((*d_close));
+  dev_type_read((*d_read));
+  dev_type_write((*d_write));
+  dev_type_ioctl((*d_ioctl));
+  dev_type_stop((*d_stop));
+  dev_type_tty((*d_tty));
+  dev_type_poll((*d_poll));
+  dev_type_mmap((*d_mmap));
+  dev_type_kqfilter((*d_kqfilter));
+  dev_type_discard((*d_discard));
+  int d_flag;
+};
+
+#define D_OTHER 0x0000
+#define D_MPSAFE 0x0100
+
+dev_type_stop(nostop);
+dev_type_tty(notty);
+dev_type_poll(nopoll);
+dev_type_mmap(nommap);
+dev_type_kqfilter(nokqfilter);
+dev_type_discard(nodiscard);
+dev_type_write(nowrite);
+
+#ifndef minor
+#define minor(x) ((int)((x) & 0xff))
+#endif
+
+#endif /* _SHIM_SYS_CONF_H_ */
@@ -0,0 +1,15 @@
+/* sys/cpu.h -- one CPU per thread as far as the driver can tell */
+#ifndef _SHIM_SYS_CPU_H_
+#define _SHIM_SYS_CPU_H_
+
+struct cpu_info;
+
+extern unsigned int ncpu;
+
+struct cpu_info *shim_curcpu(void);
+unsigned int shim_cpu_index(struct cpu_info *);
+
+#define curcpu() shim_curcpu()
+#define cpu_index(ci) shim_cpu_index(ci)
+
+#endif /* _SHIM_SYS_CPU_H_ */
@@ -0,0 +1,52 @@
+/* sys/device.h -- autoconf(9) subset */
+#ifndef _SHIM_SYS_DEVICE_H_
+#define _SHIM_SYS_DEVICE_H_
+
+#include <sys/types.h>
+
+struct device {
+  char dv_xname[16];
+  void *dv_private;
+  int dv_unit;
+};
+typedef struct device *device_t;
+
+struct cfdata {
+  const char *cf_name;
+};
+typedef struct cfdata *cfdata_t;
+
+struct cfdriver {
+  const char *cd_name;
+  device_t *cd_devs;
+  int cd_ndevs;
+};
+
+struct cfattach {
+  const char *ca_name;
+  size_t ca_devsize;
+  int (*ca_match)(device_t, cfdata_t, void *);
+  void (*ca_attach)(device_t, device_t, void *);
+  int (*ca_detach)(device_t, int);
+  int (*ca_activate)(device_t, int);
+};
+
+#define CFATTACH_DECL_NEW(name, ddsize, matfn, attfn, detfn, actfn) \
+  const struct cfattach name##_ca = {					\
+    .ca_name = #name,							\
+    .ca_devsize = ddsize,						\
+    .ca_match = matfn,							\
+    .ca_attach = attfn,							\
+    .ca_detach = detfn,							\
+    .ca_activate = actfn,						\
+  }
+
+void *device_private(device_t);
+void *device_lookup_private(struct cfdriver *, int);
+const char *device_xname(device_t);
+
+/* What autoconf would do for one unit: match, then attach with aux. */
+device_t shim_config_attach(struct cfdriver *, const struct cfattach *, int,
+    void *);
+
+#endif /* _SHIM_SYS_DEVICE_H_ */
@@ -0,0 +1 @@
+/* sys/envsys.h -- nothing das.c needs from here */
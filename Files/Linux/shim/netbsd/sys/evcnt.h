@@ -0,0 +1,23 @@
+/* sys/evcnt.h -- event counters */
+#ifndef _SHIM_SYS_EVCNT_H_
+#define _SHIM_SYS_EVCNT_H_
+
+#include <stdint.h>
+
+struct evcnt {
+  uint64_t ev_count;
+  unsigned char ev_type;
+  const struct evcnt *ev_parent;
+  const char *ev_group;
+  const char *ev_name;
+};
+
+#define EVCNT_TYPE_MISC 0
+#define EVCNT_TYPE_INTR 1
+#define EVCNT_TYPE_TRAP 2
+
+void evcnt_attach_dynamic(struct evcnt *, int, const struct evcnt *,
+    const char *, const char *);
+void evcnt_detach(struct evcnt *);
+
+#endif /* _SHIM_SYS_EVCNT_H_ */
@@ -0,0 +1,36 @@
+/* sys/event.h -- the kqueue(2) driver side: knotes and filterops */
+#ifndef _SHIM_SYS_EVENT_H_
+#define _SHIM_SYS_EVENT_H_
+
+#include <stdint.h>
+#include <sys/queue.h>
+
+#define EVFILT_READ (-1)
+#define EVFILT_WRITE (-2)
+#define EV_EOF 0x8000
+#define NOTE_SUBMIT 0x01000000
+
+#define FILTEROP_ISFD 0x01
+#define FILTEROP_MPSAFE 0x02
+
+struct knote;
+
+struct filterops {
+  int f_flags;
+  int (*f_attach)(struct knote *);
+  void (*f_detach)(struct knote *);
+  int (*f_event)(struct knote *, long);
+};
+
+struct knote {
+  SLIST_ENTRY(knote) kn_selnext;
+  short kn_filter;
+  uint32_t kn_flags;
+  int64_t kn_data;
+  const struct filterops *kn_fop;
+  void *kn_hook;
+};
+
+SLIST_HEAD(klist, knote);
+
+#endif /* _SHIM_SYS_EVENT_H_ */
@@ -0,0 +1 @@
+/* sys/extent.h -- nothing das.c needs from here */
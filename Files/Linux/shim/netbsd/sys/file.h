@@ -0,0 +1,10 @@
+/* sys/file.h -- open flags as the kernel sees them */
+#include_next <sys/file.h>
+
+#ifndef _SHIM_SYS_FILE_H_
+#define _SHIM_SYS_FILE_H_
+
+#define FREAD 0x00000001
+#define FWRITE 0x00000002
+
+#endif /* _SHIM_SYS_FILE_H_ */
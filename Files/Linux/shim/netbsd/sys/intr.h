@@ -0,0 +1,28 @@
+/* sys/intr.h -- interrupt priority levels */
+#ifndef _SHIM_SYS_INTR_H_
+#define _SHIM_SYS_INTR_H_
+
+#define IPL_NONE 0
+#define IPL_SOFTCLOCK 1
+#define IPL_SOFTSERIAL 2
+#define IPL_VM 3
+#define IPL_SCHED 4
+#define IPL_TTY IPL_VM
+#define IPL_HIGH 5
+
+#define SOFTINT_CLOCK 0x0000
+#define SOFTINT_BIO 0x0001
+#define SOFTINT_NET 0x0002
+#define SOFTINT_SERIAL 0x0003
+#define SOFTINT_MPSAFE 0x0100
+
+/* Soft interrupts run on the shim's soft interrupt thread, see dasshim.h. */
+void *softint_establish(unsigned int, void (*)(void *), void *);
+void softint_disestablish(void *);
+void softint_schedule(void *);
+
+int splhigh(void);
+int spltty(void);
+void splx(int);
+
+#endif /* _SHIM_SYS_INTR_H_ */
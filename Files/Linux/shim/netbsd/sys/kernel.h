@@ -0,0 +1,12 @@
+/* sys/kernel.h -- kernel clock interfaces das.c uses */
+#ifndef _SHIM_SYS_KERNEL_H_
+#define _SHIM_SYS_KERNEL_H_
+
+#include <time.h>
+
+/* CLOCK_MONOTONIC, see nbsd_shim.c */
+void nanouptime(struct timespec *);
+/* CLOCK_REALTIME */
+void nanotime(struct timespec *);
+
+#endif /* _SHIM_SYS_KERNEL_H_ */
@@ -0,0 +1 @@
+/* sys/kthread.h -- nothing das.c needs from here */
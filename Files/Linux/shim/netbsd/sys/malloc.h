@@ -0,0 +1,19 @@
+/* sys/malloc.h -- malloc(9) over the host allocator */
+#ifndef _SHIM_SYS_MALLOC_H_
+#define _SHIM_SYS_MALLOC_H_
+
+#include <stdlib.h>
+
+#define M_DEVBUF 1
+#define M_WAITOK 0x0000
+#define M_NOWAIT 0x0001
+#define M_ZERO 0x0002
+
+void *shim_malloc(unsigned long, int, int);
+void shim_free(void *, int);
+
+/* Function-like, so <stdlib.h> must come first; it does, above. */
+#define malloc(size, type, flags) shim_malloc((size), (type), (flags))
+#define free(addr, type) shim_free((addr), (type))
+
+#endif /* _SHIM_SYS_MALLOC_H_ */
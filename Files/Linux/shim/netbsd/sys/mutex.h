@@ -0,0 +1,26 @@
+/* sys/mutex.h -- mutex(9) over pthreads */
+#ifndef _SHIM_SYS_MUTEX_H_
+#define _SHIM_SYS_MUTEX_H_
+
+#include <pthread.h>
+
+typedef struct kmutex {
+  pthread_mutex_t mtx_lock;
+  pthread_t mtx_owner;	/* for mutex_owned, valid while mtx_held */
+  volatile int mtx_held;
+  int mtx_spin;		/* above IPL_SOFTSERIAL: holds off the ISR */
+} kmutex_t;
+
+typedef enum { MUTEX_DEFAULT, MUTEX_SPIN, MUTEX_ADAPTIVE } kmutex_type_t;
+
+void mutex_init(kmutex_t *, kmutex_type_t, int);
+void mutex_destroy(kmutex_t *);
+void mutex_enter(kmutex_t *);
+void mutex_exit(kmutex_t *);
+int mutex_tryenter(kmutex_t *);
+int mutex_owned(kmutex_t *);
+
+#define mutex_spin_enter(mtx) mutex_enter(mtx)
+#define mutex_spin_exit(mtx) mutex_exit(mtx)
+
+#endif /* _SHIM_SYS_MUTEX_H_ */
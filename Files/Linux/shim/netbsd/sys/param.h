@@ -0,0 +1,20 @@
+/* sys/param.h -- NetBSD kernel parameters on top of the host param.h */
+#include_next <sys/param.h>
+
+#ifndef _SHIM_SYS_PARAM_H_
+#define _SHIM_SYS_PARAM_H_
+
+#include <sys/types.h>
+
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 4096
+#endif
+#define PAGE_MASK (PAGE_SIZE - 1)
+#define atop(x) ((paddr_t)(x) / PAGE_SIZE)
+#define round_page(x) (((x) + PAGE_MASK) & ~(vaddr_t)PAGE_MASK)
+
+/* clock ticks per second, see nbsd_shim.c */
+extern int hz;
+#define mstohz(ms) ((int)(((int64_t)(ms) * hz + 999) / 1000))
+
+#endif /* _SHIM_SYS_PARAM_H_ */
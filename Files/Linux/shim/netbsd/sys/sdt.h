@@ -0,0 +1,11 @@
+/* sys/sdt.h -- SDT probes compile away; dastrace is the userland view */
+#ifndef _SHIM_SYS_SDT_H_
+#define _SHIM_SYS_SDT_H_
+#define SDT_PROVIDER_DEFINE(p) struct __sdt_##p
+#define SDT_PROBE_DEFINE2(p, m, f, n, a0, a1) struct __sdt_##p##_##f##_##n
+#define SDT_PROBE_DEFINE3(p, m, f, n, a0, a1, a2) struct __sdt_##p##_##f##_##n
+#define SDT_PROBE_DEFINE4(p, m, f, n, a0, a1, a2, a3) struct __sdt_##p##_##f##_##n
+#define SDT_PROBE2(p, m, f, n, a0, a1) do { (void)(a0); (void)(a1); } while (0)
+#define SDT_PROBE3(p, m, f, n, a0, a1, a2) do { (void)(a0); (void)(a1); (void)(a2); } while (0)
+#define SDT_PROBE4(p, m, f, n, a0, a1, a2, a3) do { (void)(a0); (void)(a1); (void)(a2); (void)(a3); } while (0)
+#endif /* _SHIM_SYS_SDT_H_ */
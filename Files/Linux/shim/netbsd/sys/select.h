@@ -0,0 +1,24 @@
+/* sys/select.h -- selinfo(9) on top of the host select.h */
+#include_next <sys/select.h>
+
+#ifndef _SHIM_SYS_SELECT_H_
+#define _SHIM_SYS_SELECT_H_
+
+#include <sys/event.h>
+
+struct lwp;
+
+/* sel_pending stands in for the lwps a real selrecord would remember */
+struct selinfo {
+  struct klist sel_klist;
+  int sel_pending;
+};
+
+void selinit(struct selinfo *);
+void seldestroy(struct selinfo *);
+void selrecord(struct lwp *, struct selinfo *);
+void selnotify(struct selinfo *, int, long);
+void selrecord_knote(struct selinfo *, struct knote *);
+void selremove_knote(struct selinfo *, struct knote *);
+
+#endif /* _SHIM_SYS_SELECT_H_ */
@@ -0,0 +1,47 @@
+/* sys/sysctl.h -- sysctl_createv() that records nodes for inspection */
+#ifndef _SHIM_SYS_SYSCTL_H_
+#define _SHIM_SYS_SYSCTL_H_
+
+#include <stddef.h>
+
+#define CTL_EOL (-1)
+#define CTL_CREATE (-2)
+#define CTL_HW 6
+
+#define CTLTYPE_NODE 1
+#define CTLTYPE_INT 2
+#define CTLTYPE_STRING 3
+#define CTLTYPE_QUAD 4
+#define CTLTYPE_STRUCT 5
+#define CTLTYPE_BOOL 6
+
+#define CTLFLAG_READONLY 0x00000000
+#define CTLFLAG_READWRITE 0x00000070
+
+#define SYSCTL_DESCR(s) s
+
+struct sysctlnode {
+  int sysctl_flags;
+  int sysctl_type;
+  const char *sysctl_name;
+  const char *sysctl_desc;
+  void *sysctl_data;
+  const struct sysctlnode *sysctl_parent;
+};
+
+struct sysctllog;
+
+#define SYSCTLFN_ARGS const int *name, unsigned int namelen, \
+    void *oldp, size_t *oldlenp, const void *newp, size_t newlen, \
+    const int *oname, struct lwp *l, const struct sysctlnode *rnode
+typedef int (*sysctlfn)(SYSCTLFN_ARGS);
+
+int sysctl_createv(struct sysctllog **, int, const struct sysctlnode **,
+    const struct sysctlnode **, int, int, const char *, const char *,
+    sysctlfn, unsigned long long, void *, size_t, ...);
+void sysctl_teardown(struct sysctllog **);
+
+/* Look a node up by dotted name, e.g. "hw.das0.intr". */
+const struct sysctlnode *shim_sysctl_lookup(const char *);
+
+#endif /* _SHIM_SYS_SYSCTL_H_ */
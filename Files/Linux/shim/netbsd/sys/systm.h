@@ -0,0 +1,29 @@
+/* sys/systm.h -- kernel libc subset for the Linux build */
+#ifndef _SHIM_SYS_SYSTM_H_
+#define _SHIM_SYS_SYSTM_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifndef ERESTART
+#define ERESTART (-1)
+#endif
+#ifndef EJUSTRETURN
+#define EJUSTRETURN (-2)
+#endif
+
+#define KASSERT(e) assert(e)
+
+/* the console, kept off the stdout tools report on */
+#define printf(...) fprintf(stderr, __VA_ARGS__)
+
+int copyin(const void *, void *, size_t);
+int copyout(const void *, void *, size_t);
+
+#endif /* _SHIM_SYS_SYSTM_H_ */
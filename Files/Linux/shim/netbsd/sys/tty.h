@@ -0,0 +1 @@
+/* sys/tty.h -- nothing das.c needs from here */
@@ -0,0 +1,14 @@
+/* sys/types.h -- NetBSD kernel types on top of the host types */
+#include_next <sys/types.h>
+
+#ifndef _SHIM_SYS_TYPES_H_
+#define _SHIM_SYS_TYPES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef unsigned long paddr_t;
+typedef unsigned long vaddr_t;
+typedef unsigned long vsize_t;
+
+#endif /* _SHIM_SYS_TYPES_H_ */
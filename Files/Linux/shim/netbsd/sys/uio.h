@@ -0,0 +1,21 @@
+/* sys/uio.h -- struct uio and uiomove on top of the host iovec */
+#include_next <sys/uio.h>
+
+#ifndef _SHIM_SYS_UIO_H_
+#define _SHIM_SYS_UIO_H_
+
+#include <stddef.h>
+
+enum uio_rw { UIO_READ, UIO_WRITE };
+
+struct uio {
+  struct iovec *uio_iov;	/* scatter/gather list */
+  int uio_iovcnt;		/* length of scatter/gather list */
+  off_t uio_offset;		/* offset in target object */
+  size_t uio_resid;		/* remaining bytes to process */
+  enum uio_rw uio_rw;		/* operation */
+};
+
+int uiomove(void *, size_t, struct uio *);
+
+#endif /* _SHIM_SYS_UIO_H_ */
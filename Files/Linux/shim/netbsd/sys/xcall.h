@@ -0,0 +1,7 @@
+/* sys/xcall.h -- xcall(9); the shim runs das_intr on a thread, see dasshim.h */
+#ifndef _SHIM_SYS_XCALL_H_
+#define _SHIM_SYS_XCALL_H_
+
+void xc_barrier(unsigned int);
+
+#endif /* _SHIM_SYS_XCALL_H_ */
@@ -0,0 +1,22 @@
+/* uvm/uvm_extern.h -- kernel memory and the kernel pmap */
+#ifndef _SHIM_UVM_UVM_EXTERN_H_
+#define _SHIM_UVM_UVM_EXTERN_H_
+
+#include <sys/types.h>
+
+struct vm_map;
+struct pmap;
+extern struct vm_map *kernel_map;
+
+#define UVM_KMF_WIRED 0x1
+#define UVM_KMF_ZERO 0x2
+
+#define VM_PROT_READ 0x1
+#define VM_PROT_WRITE 0x2
+
+vaddr_t uvm_km_alloc(struct vm_map *, vsize_t, vsize_t, int);
+void uvm_km_free(struct vm_map *, vaddr_t, vsize_t, int);
+struct pmap *pmap_kernel(void);
+bool pmap_extract(struct pmap *, vaddr_t, paddr_t *);
+
+#endif /* _SHIM_UVM_UVM_EXTERN_H_ */
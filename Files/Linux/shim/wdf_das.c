@@ -0,0 +1,317 @@
+/* wdf_das.c -- the das1 driver attached to an emulated board, see dasdrv.h */
+/*
+ * DriverEntry once, then a device per board; opens are file objects
+ * and everything else is the driver's IOCTLs and reads.
+ *
+ * IOCTL_DAS_SET_RATE takes the pacer period in whole microseconds, up
+ * to 1588, and ignores a period past that; the pacer count is set to
+ * the nearest period and read back with IOCTL_DAS_GET_RATE.
+ *
+ * The driver has no statistics IOCTL; the counts come from its device
+ * context.
+ *
+ * The mapped ring is taken with the wdasmap.h helpers, as a program
+ * would; the event handle the driver sets is the open's own KEVENT.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ntddk.h>
+#include <wdf.h>
+
+#include "driver.h"	/* and wdasio.h */
+#include "wdf_shim.h"
+#include "dasdrv.h"
+
+struct wdf_das {
+  WDFDEVICE wd_device;
+  WDFFILEOBJECT wd_file;
+  PDAS_MAP_CONTROL wd_map;	/* mapped ring, or NULL */
+  struct _KEVENT wd_event;
+};
+
+static WDFDEVICE devices[DASSHIM_MAXBOARD];
+static int loaded;
+
+static int
+wdf_errno(NTSTATUS status)
+{
+  switch (status) {
+  case STATUS_SUCCESS:
+    return 0;
+  case STATUS_OPEN_FAILED:
+  case STATUS_DEVICE_BUSY:
+    return EBUSY;
+  case STATUS_INVALID_PARAMETER:
+  case STATUS_BUFFER_TOO_SMALL:
+    return EINVAL;
+  case STATUS_INVALID_DEVICE_REQUEST:
+    return ENOTTY;
+  case STATUS_INSUFFICIENT_RESOURCES:
+    return ENOMEM;
+  case STATUS_NOT_SUPPORTED:
+    return EOPNOTSUPP;
+  case STATUS_CANCELLED:
+    return EINTR;
+  case STATUS_INVALID_DEVICE_STATE:
+  case STATUS_DEVICE_CONFIGURATION_ERROR:
+    return ENXIO;
+  default:
+    return NT_SUCCESS(status) ? 0 : EIO;
+  }
+}
+
+static int
+wdf_attach(struct dasshim_board *sb)
+{
+  static UNICODE_STRING path;
+  NTSTATUS status;
+
+  if (!loaded) {
+    status = DriverEntry(&wdfshim_driver_object, &path);
+    if (!NT_SUCCESS(status))
+      return wdf_errno(status);
+    loaded = 1;
+  }
+  status = wdfshim_add_device(sb, &devices[sb->sb_unit]);
+  return wdf_errno(status);
+}
+
+static int
+wdf_open(int unit, int flags, void **hp)
+{
+  struct wdf_das *wd;
+  NTSTATUS status;
+
+  if (unit < 0 || unit >= DASSHIM_MAXBOARD || devices[unit] == NULL)
+    return ENXIO;
+  wd = calloc(1, sizeof(*wd));
+  if (wd == NULL)
+    return ENOMEM;
+  wd->wd_device = devices[unit];
+  pthread_mutex_init(&wd->wd_event.ke_lock, NULL);
+  pthread_cond_init(&wd->wd_event.ke_cv, NULL);
+  // every create reaches the driver, which takes one open at a time
+  status = wdfshim_create(wd->wd_device, &wd->wd_file);
+  if (!NT_SUCCESS(status)) {
+    pthread_cond_destroy(&wd->wd_event.ke_cv);
+    pthread_mutex_destroy(&wd->wd_event.ke_lock);
+    free(wd);
+    return wdf_errno(status);
+  }
+  *hp = wd;
+  return 0;
+}
+
+static int
+wdf_close(void *h)
+{
+  struct wdf_das *wd = h;
+
+  // cleanup takes down a ring still mapped
+  wdfshim_close(wd->wd_file);
+  pthread_cond_destroy(&wd->wd_event.ke_cv);
+  pthread_mutex_destroy(&wd->wd_event.ke_lock);
+  free(wd);
+  return 0;
+}
+
+static int
+wdf_ioctl(void *h, ULONG code, void *in, size_t inlen, void *out,
+    size_t outlen)
+{
+  struct wdf_das *wd = h;
+
+  return wdf_errno(wdfshim_ioctl(wd->wd_file, code, in, inlen, out, outlen,
+      NULL));
+}
+
+static int
+wdf_pacer(void *h, unsigned int count)
+{
+  int us, got = -1;
+  int error;
+
+  if (count < 2 || count > 0xffff)
+    return EINVAL;
+  us = (count * 1000 + DAS_CLOCK_SPEED / 2) / DAS_CLOCK_SPEED;
+  error = wdf_ioctl(h, IOCTL_DAS_SET_RATE, &us, sizeof(us), NULL, 0);
+  if (error == 0)
+    error = wdf_ioctl(h, IOCTL_DAS_GET_RATE, NULL, 0, &got, sizeof(got));
+  if (error == 0 && got != us)
+    error = EINVAL;
+  return error;
+}
+
+static int
+wdf_set_channel(void *h, int ch)
+{
+  return wdf_ioctl(h, IOCTL_DAS_SET_CHANNEL, &ch, sizeof(ch), NULL, 0);
+}
+
+static int
+wdf_get_channel(void *h, int *ch)
+{
+  ULONG v = 0;
+  int error;
+
+  error = wdf_ioctl(h, IOCTL_DAS_GET_CHANNEL, NULL, 0, &v, sizeof(v));
+  if (error == 0)
+    *ch = v;
+  return error;
+}
+
+static int
+wdf_start(void *h)
+{
+  return wdf_ioctl(h, IOCTL_DAS_START_SAMPLING, NULL, 0, NULL, 0);
+}
+
+static int
+wdf_stop(void *h)
+{
+  return wdf_ioctl(h, IOCTL_DAS_STOP_SAMPLING, NULL, 0, NULL, 0);
+}
+
+static ssize_t
+wdf_read(void *h, void *buf, size_t len)
+{
+  struct wdf_das *wd = h;
+  ULONG_PTR info = 0;
+  NTSTATUS status;
+
+  status = wdfshim_read(wd->wd_file, buf, len, &info);
+  if (!NT_SUCCESS(status))
+    return -wdf_errno(status);
+  return info;
+}
+
+static int
+wdf_stats(void *h, struct dasdrv_stats *dv)
+{
+  struct wdf_das *wd = h;
+  PDEVICE_CONTEXT context = DeviceGetContext(wd->wd_device);
+
+  // every interrupt with a sample is posted to the ISR ring or dropped
+  WdfSpinLockAcquire(context->ReadLock);
+  dv->dv_intr = context->IsrRing.Head + context->IsrRing.Dropped;
+  dv->dv_samples = context->IsrRing.Head;
+  dv->dv_overrun = context->ReadOverruns + context->IsrRing.Dropped;
+  WdfSpinLockRelease(context->ReadLock);
+  return 0;
+}
+
+static int
+wdf_map(void *h, unsigned int words)
+{
+  struct wdf_das *wd = h;
+  DAS_MAP_RING map;
+  int error;
+
+  if (words == 0) {
+    if (wd->wd_map == NULL)
+      return 0;
+    error = wdf_ioctl(h, IOCTL_DAS_UNMAP_RING, NULL, 0, NULL, 0);
+    if (error == 0)
+      wd->wd_map = NULL;
+    return error;
+  }
+  memset(&map, 0, sizeof(map));
+  map.Words = words;
+  map.Event = (ULONG64)(ULONG_PTR)&wd->wd_event;
+  error = wdf_ioctl(h, IOCTL_DAS_MAP_RING, &map, sizeof(map), &map,
+      sizeof(map));
+  if (error == 0)
+    wd->wd_map = (PDAS_MAP_CONTROL)(ULONG_PTR)map.Address;
+  return error;
+}
+
+static ssize_t
+wdf_map_read(void *h, void *buf, size_t len, int *waited)
+{
+  struct wdf_das *wd = h;
+  struct _KEVENT *ev = &wd->wd_event;
+  const ULONG *data, *first, *second;
+  ULONG nfirst, nsecond, n, want = len / sizeof(ULONG);
+  ULONG need = want < DAS_READ_WATERMARK ? want : DAS_READ_WATERMARK;
+  struct timespec ts;
+
+  if (wd->wd_map == NULL)
+    return -EINVAL;
+  data = (const ULONG *)((const char *)wd->wd_map + wd->wd_map->DataOffset);
+  *waited = 0;
+  n = das1MapSpans(wd->wd_map, data, &first, &nfirst, &second, &nsecond);
+  // as a read would: sleep until a watermark's worth, not every DPC
+  if (n < need && das1MapPrepareWait(wd->wd_map, need)) {
+    *waited = 1;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += DASDRV_MAP_WAIT_MS * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&ev->ke_lock);
+    while (!ev->ke_signaled &&
+        pthread_cond_timedwait(&ev->ke_cv, &ev->ke_lock, &ts) == 0)
+      ;
+    ev->ke_signaled = 0;
+    pthread_mutex_unlock(&ev->ke_lock);
+    wd->wd_map->Waiting = 0;
+    n = das1MapSpans(wd->wd_map, data, &first, &nfirst, &second, &nsecond);
+  }
+  if (n > want) {
+    n = want;
+    if (nfirst > n)
+      nfirst = n;
+    nsecond = n - nfirst;
+  }
+  memcpy(buf, first, nfirst * sizeof(ULONG));
+  memcpy((ULONG *)buf + nfirst, second, nsecond * sizeof(ULONG));
+  das1MapConsume(wd->wd_map, n);
+  return n * sizeof(ULONG);
+}
+
+static int
+wdf_regbatch(void *h, struct dasdrv_regop *dr, unsigned int n)
+{
+  DAS_REGOP ops[DAS_REGBATCH_MAX];
+  unsigned int i;
+  int error;
+
+  if (n == 0)
+    return 0;
+  if (n > DAS_REGBATCH_MAX)
+    return EINVAL;
+  memset(ops, 0, n * sizeof(ops[0]));
+  for (i = 0; i < n; i++) {
+    ops[i].Op = dr[i].dr_op;
+    ops[i].Bar = dr[i].dr_bar;
+    ops[i].Offset = dr[i].dr_off;
+    ops[i].Mask = dr[i].dr_mask;
+    ops[i].Value = dr[i].dr_val;
+  }
+  error = wdf_ioctl(h, IOCTL_DAS_REGISTER_BATCH, ops, n * sizeof(ops[0]),
+      ops, n * sizeof(ops[0]));
+  for (i = 0; error == 0 && i < n; i++)
+    dr[i].dr_result = ops[i].Result;
+  return error;
+}
+
+const struct dasdrv dasdrv_wdf = {
+  .dd_name = "wdf",
+  .dd_attach = wdf_attach,
+  .dd_open = wdf_open,
+  .dd_close = wdf_close,
+  .dd_pacer = wdf_pacer,
+  .dd_set_channel = wdf_set_channel,
+  .dd_get_channel = wdf_get_channel,
+  .dd_start = wdf_start,
+  .dd_stop = wdf_stop,
+  .dd_read = wdf_read,
+  .dd_stats = wdf_stats,
+  .dd_map = wdf_map,
+  .dd_map_read = wdf_map_read,
+  .dd_regbatch = wdf_regbatch,
+};
@@ -0,0 +1,1165 @@
+/* wdf_shim.c -- the KMDF and NT interfaces das1 uses, on dasshim */
+/*
+ * Built against the headers in wdk/.  Objects are host allocations
+ * with one context each and are freed with their file or never; the
+ * reference count calls are no-ops because a request outlives every
+ * reference the driver takes, its issuer being blocked until it
+ * completes.  Spin locks are pthread mutexes.
+ *
+ * Queues dispatch in the thread that hands them the request: parallel
+ * at once, sequential once the request ahead of it has been completed
+ * or forwarded, in arrival order.  Manual queues are a list.
+ * METHOD_BUFFERED requests get one system buffer for input and output,
+ * copied back on completion; reads (direct I/O) and METHOD_OUT_DIRECT
+ * output use the caller's buffer as it stands.
+ *
+ * The interrupt is connected after D0Entry, as the framework does.
+ * Its ISR runs on dasshim's interrupt thread and its DPC on the soft
+ * interrupt thread; WDFTIMERs run on the timer thread.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ntddk.h>
+#include <wdf.h>
+
+#include "wdf_shim.h"
+
+int shim_dbgprint;
+DRIVER_OBJECT wdfshim_driver_object;
+
+struct wdf_object {
+  struct wdf_object *wo_parent;
+  PVOID wo_context;
+};
+
+struct WDFDRIVER__ {
+  struct wdf_object wd_obj;
+  PDRIVER_OBJECT wd_wdm;
+  WDF_DRIVER_CONFIG wd_config;
+};
+
+struct WDFDEVICE_INIT {
+  struct dasshim_board *di_board;
+  WDF_PNPPOWER_EVENT_CALLBACKS di_pnp;
+  WDF_FILEOBJECT_CONFIG di_file;
+  WDF_OBJECT_ATTRIBUTES di_file_attrs;
+  WDF_DEVICE_IO_TYPE di_io_type;
+  PFN_WDF_IO_IN_CALLER_CONTEXT di_in_caller;
+  WDFDEVICE di_device;
+};
+
+struct WDFDEVICE__ {
+  struct wdf_object wv_obj;
+  struct WDFDEVICE_INIT wv_init;
+  WDFQUEUE wv_default;
+  WDFQUEUE wv_read;
+  WDFQUEUE wv_write;
+  WDFQUEUE wv_ioctl;
+  WDFINTERRUPT wv_intr;
+};
+
+struct WDFFILEOBJECT__ {
+  struct wdf_object wf_obj;
+  WDFDEVICE wf_device;
+};
+
+struct WDFQUEUE__ {
+  struct wdf_object wq_obj;
+  WDFDEVICE wq_device;
+  WDF_IO_QUEUE_CONFIG wq_config;
+  pthread_mutex_t wq_lock;
+  pthread_cond_t wq_cv;
+  int wq_busy;			/* sequential: a request is dispatched */
+  uint64_t wq_ticket;		/* sequential: next arrival */
+  uint64_t wq_serving;		/* sequential: next to dispatch */
+  WDFREQUEST wq_head;		/* manual */
+  WDFREQUEST *wq_tail;
+  ULONG wq_dispatched;		/* requests handed to it, for the tests */
+};
+
+struct WDFMEMORY__ {
+  struct wdf_object wm_obj;
+  PVOID wm_buf;
+  size_t wm_len;
+};
+
+struct WDFREQUEST__ {
+  struct wdf_object wr_obj;
+  WDF_REQUEST_PARAMETERS wr_params;
+  WDFFILEOBJECT wr_file;
+  WDFQUEUE wr_queue;		/* the queue that has it, if any */
+  struct WDFMEMORY__ wr_in;
+  struct WDFMEMORY__ wr_out;
+  ULONG_PTR wr_info;
+  NTSTATUS wr_status;
+  int wr_done;
+  pthread_mutex_t wr_lock;
+  pthread_cond_t wr_cv;
+  WDFREQUEST wr_next;		/* manual queue */
+};
+
+struct WDFSPINLOCK__ {
+  struct wdf_object wl_obj;
+  pthread_mutex_t wl_lock;
+};
+
+struct WDFTIMER__ {
+  struct wdf_object wt_obj;
+  WDF_TIMER_CONFIG wt_config;
+  struct dasshim_timer wt_timer;
+};
+
+struct WDFINTERRUPT__ {
+  struct wdf_object wi_obj;
+  WDFDEVICE wi_device;
+  WDF_INTERRUPT_CONFIG wi_config;
+  struct dasshim_soft wi_dpc;
+};
+
+struct WDFCMRESLIST__ {
+  struct wdf_object wc_obj;
+  ULONG wc_count;
+  CM_PARTIAL_RESOURCE_DESCRIPTOR wc_desc[2];
+};
+
+static WDFDRIVER the_driver;
+
+/* Objects */
+
+static PVOID
+object_alloc(size_t size, PWDF_OBJECT_ATTRIBUTES attributes)
+{
+  struct wdf_object *wo;
+
+  wo = calloc(1, size);
+  if (wo == NULL || attributes == NULL)
+    return wo;
+  wo->wo_parent = attributes->ParentObject;
+  if (attributes->ContextTypeInfo != NULL) {
+    wo->wo_context = calloc(1, attributes->ContextTypeInfo->ContextSize);
+    if (wo->wo_context == NULL) {
+      free(wo);
+      return NULL;
+    }
+  }
+  return wo;
+}
+
+static VOID
+object_free(PVOID h)
+{
+  struct wdf_object *wo = h;
+
+  free(wo->wo_context);
+  free(wo);
+}
+
+PVOID
+WdfObjectGetTypedContextWorker(WDFOBJECT Handle,
+    const WDF_OBJECT_CONTEXT_TYPE_INFO *TypeInfo)
+{
+  return ((struct wdf_object *)Handle)->wo_context;
+}
+
+VOID
+WdfObjectReference(WDFOBJECT Handle)
+{
+}
+
+VOID
+WdfObjectDereference(WDFOBJECT Handle)
+{
+}
+
+/* Driver and device */
+
+NTSTATUS
+WdfDriverCreate(PDRIVER_OBJECT DriverObject, PCUNICODE_STRING RegistryPath,
+    PWDF_OBJECT_ATTRIBUTES DriverAttributes, PWDF_DRIVER_CONFIG DriverConfig,
+    WDFDRIVER *Driver)
+{
+  WDFDRIVER d;
+
+  d = object_alloc(sizeof(*d), DriverAttributes);
+  if (d == NULL)
+    return STATUS_INSUFFICIENT_RESOURCES;
+  d->wd_wdm = DriverObject;
+  d->wd_config = *DriverConfig;
+  the_driver = d;
+  if (Driver != NULL)
+    *Driver = d;
+  return STATUS_SUCCESS;
+}
+
+PDRIVER_OBJECT
+WdfDriverWdmGetDriverObject(WDFDRIVER Driver)
+{
+  return Driver->wd_wdm;
+}
+
+VOID
+WdfDeviceInitSetPnpPowerEventCallbacks(PWDFDEVICE_INIT DeviceInit,
+    PWDF_PNPPOWER_EVENT_CALLBACKS PnpPowerEventCallbacks)
+{
+  DeviceInit->di_pnp = *PnpPowerEventCallbacks;
+}
+
+VOID
+WdfDeviceInitSetFileObjectConfig(PWDFDEVICE_INIT DeviceInit,
+    PWDF_FILEOBJECT_CONFIG FileObjectConfig,
+    PWDF_OBJECT_ATTRIBUTES FileObjectAttributes)
+{
+  DeviceInit->di_file = *FileObjectConfig;
+  if (FileObjectAttributes != NULL)
+    DeviceInit->di_file_attrs = *FileObjectAttributes;
+}
+
+VOID
+WdfDeviceInitSetIoType(PWDFDEVICE_INIT DeviceInit, WDF_DEVICE_IO_TYPE IoType)
+{
+  DeviceInit->di_io_type = IoType;
+}
+
+VOID
+WdfDeviceInitSetIoInCallerContextCallback(PWDFDEVICE_INIT DeviceInit,
+    PFN_WDF_IO_IN_CALLER_CONTEXT EvtIoInCallerContext)
+{
+  DeviceInit->di_in_caller = EvtIoInCallerContext;
+}
+
+NTSTATUS
+WdfDeviceCreate(PWDFDEVICE_INIT *DeviceInit,
+    PWDF_OBJECT_ATTRIBUTES DeviceAttributes, WDFDEVICE *Device)
+{
+  WDFDEVICE dev;
+
+  dev = object_alloc(sizeof(*dev), DeviceAttributes);
+  if (dev == NULL)
+    return STATUS_INSUFFICIENT_RESOURCES;
+  dev->wv_init = **DeviceInit;
+  (*DeviceInit)->di_device = dev;
+  // the framework owns DeviceInit from here
+  *DeviceInit = NULL;
+  *Device = dev;
+  return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfDeviceCreateDeviceInterface(WDFDEVICE Device, const GUID *InterfaceClassGUID,
+    PCUNICODE_STRING ReferenceString)
+{
+  return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfDeviceCreateSymbolicLink(WDFDEVICE Device, PCUNICODE_STRING SymbolicLinkName)
+{
+  return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfDeviceConfigureRequestDispatching(WDFDEVICE Device, WDFQUEUE Queue,
+    WDF_REQUEST_TYPE RequestType)
+{
+  switch (RequestType) {
+  case WdfRequestTypeRead:
+    Device->wv_read = Queue;
+    break;
+  case WdfRequestTypeWrite:
+    Device->wv_write = Queue;
+    break;
+  case WdfRequestTypeDeviceControl:
+    Device->wv_ioctl = Queue;
+    break;
+  default:
+    return STATUS_INVALID_PARAMETER;
+  }
+  return STATUS_SUCCESS;
+}
+
+WDFQUEUE
+WdfDeviceGetDefaultQueue(WDFDEVICE Device)
+{
+  return Device->wv_default;
+}
+
+WDFDEVICE
+WdfFileObjectGetDevice(WDFFILEOBJECT FileObject)
+{
+  return FileObject->wf_device;
+}
+
+ULONG
+WdfCmResourceListGetCount(WDFCMRESLIST List)
+{
+  return List->wc_count;
+}
+
+PCM_PARTIAL_RESOURCE_DESCRIPTOR
+WdfCmResourceListGetDescriptor(WDFCMRESLIST List, ULONG Index)
+{
+  return Index < List->wc_count ? &List->wc_desc[Index] : NULL;
+}
+
+/* Queues */
+
+NTSTATUS
+WdfIoQueueCreate(WDFDEVICE Device, PWDF_IO_QUEUE_CONFIG Config,
+    PWDF_OBJECT_ATTRIBUTES QueueAttributes, WDFQUEUE *Queue)
+{
+  WDFQUEUE q;
+
+  if (Config->DefaultQueue && Device->wv_default != NULL)
+    return STATUS_INVALID_DEVICE_STATE;
+  q = object_alloc(sizeof(*q), QueueAttributes);
+  if (q == NULL)
+    return STATUS_INSUFFICIENT_RESOURCES;
+  q->wq_device = Device;
+  q->wq_config = *Config;
+  pthread_mutex_init(&q->wq_lock, NULL);
+  pthread_cond_init(&q->wq_cv, NULL);
+  q->wq_tail = &q->wq_head;
+  if (Config->DefaultQueue)
+    Device->wv_default = q;
+  *Queue = q;
+  return STATUS_SUCCESS;
+}
+
+WDFDEVICE
+WdfIoQueueGetDevice(WDFQUEUE Queue)
+{
+  return Queue->wq_device;
+}
+
+ULONG
+wdfshim_dispatched(WDFQUEUE Queue)
+{
+  return __atomic_load_n(&Queue->wq_dispatched, __ATOMIC_RELAXED);
+}
+
+/* The request is leaving its queue: a sequential one may dispatch again */
+static VOID
+queue_leave(WDFREQUEST r)
+{
+  WDFQUEUE q = r->wr_queue;
+
+  r->wr_queue = NULL;
+  if (q == NULL || q->wq_config.DispatchType != WdfIoQueueDispatchSequential)
+    return;
+  pthread_mutex_lock(&q->wq_lock);
+  q->wq_busy = 0;
+  pthread_cond_broadcast(&q->wq_cv);
+  pthread_mutex_unlock(&q->wq_lock);
+}
+
+static VOID
+queue_dispatch(WDFQUEUE q, WDFREQUEST r)
+{
+  PWDF_IO_QUEUE_CONFIG c = &q->wq_config;
+  uint64_t ticket;
+
+  __atomic_add_fetch(&q->wq_dispatched, 1, __ATOMIC_RELAXED);
+  r->wr_queue = q;
+  switch (c->DispatchType) {
+  case WdfIoQueueDispatchManual:
+    pthread_mutex_lock(&q->wq_lock);
+    r->wr_next = NULL;
+    *q->wq_tail = r;
+    q->wq_tail = &r->wr_next;
+    pthread_mutex_unlock(&q->wq_lock);
+    return;
+  case WdfIoQueueDispatchSequential:
+    pthread_mutex_lock(&q->wq_lock);
+    ticket = q->wq_ticket++;
+    while (q->wq_busy || ticket != q->wq_serving)
+      pthread_cond_wait(&q->wq_cv, &q->wq_lock);
+    q->wq_busy = 1;
+    q->wq_serving++;
+    pthread_mutex_unlock(&q->wq_lock);
+    break;
+  default:
+    break;
+  }
+
+  switch (r->wr_params.Type) {
+  case WdfRequestTypeRead:
+    if (c->EvtIoRead != NULL) {
+      (*c->EvtIoRead)(q, r, r->wr_params.Parameters.Read.Length);
+      return;
+    }
+    break;
+  case WdfRequestTypeWrite:
+    if (c->EvtIoWrite != NULL) {
+      (*c->EvtIoWrite)(q, r, r->wr_params.Parameters.Write.Length);
+      return;
+    }
+    break;
+  case WdfRequestTypeDeviceControl:
+    if (c->EvtIoDeviceControl != NULL) {
+      (*c->EvtIoDeviceControl)(q, r,
+          r->wr_params.Parameters.DeviceIoControl.OutputBufferLength,
+          r->wr_params.Parameters.DeviceIoControl.InputBufferLength,
+          r->wr_params.Parameters.DeviceIoControl.IoControlCode);
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+  WdfRequestComplete(r, STATUS_INVALID_DEVICE_REQUEST);
+}
+
+NTSTATUS
+WdfDeviceEnqueueRequest(WDFDEVICE Device, WDFREQUEST Request)
+{
+  WDFQUEUE q = NULL;
+
+  switch (Request->wr_params.Type) {
+  case WdfRequestTypeRead:
+    q = Device->wv_read;
+    break;
+  case WdfRequestTypeWrite:
+    q = Device->wv_write;
+    break;
+  case WdfRequestTypeDeviceControl:
+    q = Device->wv_ioctl;
+    break;
+  default:
+    break;
+  }
+  if (q == NULL)
+    q = Device->wv_default;
+  if (q == NULL)
+    return STATUS_INVALID_DEVICE_REQUEST;
+  queue_dispatch(q, Request);
+  return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfIoQueueFindRequest(WDFQUEUE Queue, WDFREQUEST FoundRequest,
+    WDFFILEOBJECT FileObject, PWDF_REQUEST_PARAMETERS Parameters,
+    WDFREQUEST *OutRequest)
+{
+  WDFREQUEST r;
+
+  pthread_mutex_lock(&Queue->wq_lock);
+  r = Queue->wq_head;
+  if (FoundRequest != NULL) {
+    while (r != NULL && r != FoundRequest)
+      r = r->wr_next;
+    if (r == NULL) {
+      pthread_mutex_unlock(&Queue->wq_lock);
+      return STATUS_NOT_FOUND;
+    }
+    r = r->wr_next;
+  }
+  while (r != NULL && FileObject != NULL && r->wr_file != FileObject)
+    r = r->wr_next;
+  if (r != NULL && Parameters != NULL)
+    *Parameters = r->wr_params;
+  pthread_mutex_unlock(&Queue->wq_lock);
+  if (r == NULL)
+    return STATUS_NO_MORE_ENTRIES;
+  *OutRequest = r;
+  return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfIoQueueRetrieveFoundRequest(WDFQUEUE Queue, WDFREQUEST TargetRequest,
+    WDFREQUEST *OutRequest)
+{
+  WDFREQUEST *rp;
+
+  pthread_mutex_lock(&Queue->wq_lock);
+  for (rp = &Queue->wq_head; *rp != NULL; rp = &(*rp)->wr_next) {
+    if (*rp != TargetRequest)
+      continue;
+    *rp = TargetRequest->wr_next;
+    if (Queue->wq_tail == &TargetRequest->wr_next)
+      Queue->wq_tail = rp;
+    pthread_mutex_unlock(&Queue->wq_lock);
+    TargetRequest->wr_queue = NULL;
+    *OutRequest = TargetRequest;
+    return STATUS_SUCCESS;
+  }
+  pthread_mutex_unlock(&Queue->wq_lock);
+  return STATUS_NOT_FOUND;
+}
+
+/* Requests and memory */
+
+VOID
+WdfRequestCompleteWithInformation(WDFREQUEST Request, NTSTATUS Status,
+    ULONG_PTR Information)
+{
+  queue_leave(Request);
+  pthread_mutex_lock(&Request->wr_lock);
+  Request->wr_status = Status;
+  Request->wr_info = Information;
+  Request->wr_done = 1;
+  pthread_cond_signal(&Request->wr_cv);
+  // the issuer frees it once it sees wr_done
+  pthread_mutex_unlock(&Request->wr_lock);
+}
+
+VOID
+WdfRequestComplete(WDFREQUEST Request, NTSTATUS Status)
+{
+  WdfRequestCompleteWithInformation(Request, Status, Request->wr_info);
+}
+
+VOID
+WdfRequestSetInformation(WDFREQUEST Request, ULONG_PTR Information)
+{
+  Request->wr_info = Information;
+}
+
+VOID
+WdfRequestGetParameters(WDFREQUEST Request, PWDF_REQUEST_PARAMETERS Parameters)
+{
+  *Parameters = Request->wr_params;
+}
+
+WDFFILEOBJECT
+WdfRequestGetFileObject(WDFREQUEST Request)
+{
+  return Request->wr_file;
+}
+
+NTSTATUS
+WdfRequestForwardToIoQueue(WDFREQUEST Request, WDFQUEUE DestinationQueue)
+{
+  if (DestinationQueue == Request->wr_queue)
+    return STATUS_INVALID_DEVICE_REQUEST;
+  queue_leave(Request);
+  queue_dispatch(DestinationQueue, Request);
+  return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+request_buffer(struct WDFMEMORY__ *m, size_t MinimumRequiredSize,
+    PVOID *Buffer, size_t *Length)
+{
+  if (m->wm_buf == NULL)
+    return STATUS_INVALID_DEVICE_REQUEST;
+  if (m->wm_len == 0 || m->wm_len < MinimumRequiredSize)
+    return STATUS_BUFFER_TOO_SMALL;
+  *Buffer = m->wm_buf;
+  if (Length != NULL)
+    *Length = m->wm_len;
+  return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRequestRetrieveInputBuffer(WDFREQUEST Request, size_t MinimumRequiredSize,
+    PVOID *Buffer, size_t *Length)
+{
+  return request_buffer(&Request->wr_in, MinimumRequiredSize, Buffer, Length);
+}
+
+NTSTATUS
+WdfRequestRetrieveOutputBuffer(WDFREQUEST Request, size_t MinimumRequiredSize,
+    PVOID *Buffer, size_t *Length)
+{
+  return request_buffer(&Request->wr_out, MinimumRequiredSize, Buffer, Length);
+}
+
+NTSTATUS
+WdfRequestRetrieveInputMemory(WDFREQUEST Request, WDFMEMORY *Memory)
+{
+  PVOID buf;
+  NTSTATUS status;
+
+  status = request_buffer(&Request->wr_in, 0, &buf, NULL);
+  if (NT_SUCCESS(status))
+    *Memory = &Request->wr_in;
+  return status;
+}
+
+NTSTATUS
+WdfRequestRetrieveOutputMemory(WDFREQUEST Request, WDFMEMORY *Memory)
+{
+  PVOID buf;
+  NTSTATUS status;
+
+  status = request_buffer(&Request->wr_out, 0, &buf, NULL);
+  if (NT_SUCCESS(status))
+    *Memory = &Request->wr_out;
+  return status;
+}
+
+NTSTATUS
+WdfMemoryCopyFromBuffer(WDFMEMORY DestinationMemory, size_t DestinationOffset,
+    PVOID Buffer, size_t NumBytesToCopyFrom)
+{
+  if (DestinationOffset > DestinationMemory->wm_len ||
+      NumBytesToCopyFrom > DestinationMemory->wm_len - DestinationOffset)
+    return STATUS_BUFFER_TOO_SMALL;
+  memcpy((PUCHAR)DestinationMemory->wm_buf + DestinationOffset, Buffer,
+      NumBytesToCopyFrom);
+  return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfMemoryCopyToBuffer(WDFMEMORY SourceMemory, size_t SourceOffset,
+    PVOID Buffer, size_t NumBytesToCopyTo)
+{
+  if (SourceOffset > SourceMemory->wm_len ||
+      NumBytesToCopyTo > SourceMemory->wm_len - SourceOffset)
+    return STATUS_BUFFER_TOO_SMALL;
+  memcpy(Buffer, (PUCHAR)SourceMemory->wm_buf + SourceOffset,
+      NumBytesToCopyTo);
+  return STATUS_SUCCESS;
+}
+
+/* Spin locks, timers, interrupts */
+
+NTSTATUS
+WdfSpinLockCreate(PWDF_OBJECT_ATTRIBUTES SpinLockAttributes,
+    WDFSPINLOCK *SpinLock)
+{
+  WDFSPINLOCK l;
+
+  l = object_alloc(sizeof(*l), SpinLockAttributes);
+  if (l == NULL)
+    return STATUS_INSUFFICIENT_RESOURCES;
+  pthread_mutex_init(&l->wl_lock, NULL);
+  *SpinLock = l;
+  return STATUS_SUCCESS;
+}
+
+VOID
+WdfSpinLockAcquire(WDFSPINLOCK SpinLock)
+{
+  pthread_mutex_lock(&SpinLock->wl_lock);
+}
+
+VOID
+WdfSpinLockRelease(WDFSPINLOCK SpinLock)
+{
+  pthread_mutex_unlock(&SpinLock->wl_lock);
+}
+
+static void
+timer_fire(void *arg)
+{
+  WDFTIMER t = arg;
+
+  (*t->wt_config.EvtTimerFunc)(t);
+}
+
+NTSTATUS
+WdfTimerCreate(PWDF_TIMER_CONFIG Config, PWDF_OBJECT_ATTRIBUTES Attributes,
+    WDFTIMER *Timer)
+{
+  WDFTIMER t;
+
+  if (Attributes == NULL || Attributes->ParentObject == NULL)
+    return STATUS_INVALID_PARAMETER;
+  t = object_alloc(sizeof(*t), Attributes);
+  if (t == NULL)
+    return STATUS_INSUFFICIENT_RESOURCES;
+  t->wt_config = *Config;
+  dasshim_timer_init(&t->wt_timer, timer_fire, t);
+  *Timer = t;
+  return STATUS_SUCCESS;
+}
+
+/* Relative due times only; an absolute one fires at once */
+BOOLEAN
+WdfTimerStart(WDFTIMER Timer, LONGLONG DueTime)
+{
+  uint64_t ns = DueTime < 0 ? (uint64_t)-DueTime * 100 : 0;
+
+  return dasshim_timer_start(&Timer->wt_timer, ns) != 0;
+}
+
+WDFOBJECT
+WdfTimerGetParentObject(WDFTIMER Timer)
+{
+  return Timer->wt_obj.wo_parent;
+}
+
+static int
+interrupt_isr(void *arg)
+{
+  WDFINTERRUPT i = arg;
+
+  return (*i->wi_config.EvtInterruptIsr)(i, 0);
+}
+
+static void
+interrupt_dpc(void *arg)
+{
+  WDFINTERRUPT i = arg;
+
+  (*i->wi_config.EvtInterruptDpc)(i, i->wi_device);
+}
+
+NTSTATUS
+WdfInterruptCreate(WDFDEVICE Device, PWDF_INTERRUPT_CONFIG Configuration,
+    PWDF_OBJECT_ATTRIBUTES Attributes, WDFINTERRUPT *Interrupt)
+{
+  WDFINTERRUPT i;
+
+  if (Device->wv_intr != NULL)
+    return STATUS_NOT_SUPPORTED;
+  i = object_alloc(sizeof(*i), Attributes);
+  if (i == NULL)
+    return STATUS_INSUFFICIENT_RESOURCES;
+  i->wi_device = Device;
+  i->wi_config = *Configuration;
+  if (i->wi_config.EvtInterruptDpc != NULL)
+    dasshim_soft_init(&i->wi_dpc, interrupt_dpc, i);
+  Device->wv_intr = i;
+  *Interrupt = i;
+  return STATUS_SUCCESS;
+}
+
+WDFDEVICE
+WdfInterruptGetDevice(WDFINTERRUPT Interrupt)
+{
+  return Interrupt->wi_device;
+}
+
+BOOLEAN
+WdfInterruptQueueDpcForIsr(WDFINTERRUPT Interrupt)
+{
+  BOOLEAN queued = !Interrupt->wi_dpc.ss_pending;
+
+  dasshim_soft_schedule(&Interrupt->wi_dpc);
+  return queued;
+}
+
+VOID
+WdfInterruptAcquireLock(WDFINTERRUPT Interrupt)
+{
+  dasshim_intr_lock();
+}
+
+VOID
+WdfInterruptReleaseLock(WDFINTERRUPT Interrupt)
+{
+  dasshim_intr_unlock();
+}
+
+/* NT kernel routines */
+
+ULONG
+DbgPrintShim(PCSTR Format, ...)
+{
+  va_list ap;
+
+  va_start(ap, Format);
+  vfprintf(stderr, Format, ap);
+  va_end(ap);
+  return STATUS_SUCCESS;
+}
+
+ULONG
+KeQueryActiveProcessorCountEx(USHORT GroupNumber)
+{
+  return dasshim_ncpu;
+}
+
+ULONG
+KeGetCurrentProcessorNumberEx(PVOID ProcNumber)
+{
+  return dasshim_cpu();
+}
+
+/* Interrupt time is in 100 ns units */
+ULONG64
+KeQueryInterruptTimePrecise(ULONG64 *QpcTimeStamp)
+{
+  ULONG64 t = dasshim_ns() / 100;
+
+  if (QpcTimeStamp != NULL)
+    *QpcTimeStamp = t;
+  return t;
+}
+
+/* The performance counter counts nanoseconds */
+LARGE_INTEGER
+KeQueryPerformanceCounter(LARGE_INTEGER *PerformanceFrequency)
+{
+  LARGE_INTEGER t;
+
+  if (PerformanceFrequency != NULL)
+    PerformanceFrequency->QuadPart = 1000000000;
+  t.QuadPart = dasshim_ns();
+  return t;
+}
+
+PVOID
+ExAllocatePoolWithTag(POOL_TYPE PoolType, SIZE_T NumberOfBytes, ULONG Tag)
+{
+  return malloc(NumberOfBytes);
+}
+
+VOID
+ExFreePoolWithTag(PVOID P, ULONG Tag)
+{
+  free(P);
+}
+
+VOID
+ExFreePool(PVOID P)
+{
+  free(P);
+}
+
+static struct dasshim_board *
+port_board(uintptr_t port)
+{
+  return dasshim_board((port >> 12) - 1);
+}
+
+UCHAR
+READ_PORT_UCHAR(PUCHAR Port)
+{
+  uintptr_t a = (uintptr_t)Port;
+
+  return dasshim_read_1(port_board(a), (a >> 8) & 0xf, a & 0xff);
+}
+
+VOID
+WRITE_PORT_UCHAR(PUCHAR Port, UCHAR Value)
+{
+  uintptr_t a = (uintptr_t)Port;
+
+  dasshim_write_1(port_board(a), (a >> 8) & 0xf, a & 0xff, Value);
+}
+
+ULONG
+READ_PORT_ULONG(PULONG Port)
+{
+  uintptr_t a = (uintptr_t)Port;
+
+  return dasshim_read_4(port_board(a), (a >> 8) & 0xf, a & 0xff);
+}
+
+VOID
+WRITE_PORT_ULONG(PULONG Port, ULONG Value)
+{
+  uintptr_t a = (uintptr_t)Port;
+
+  dasshim_write_4(port_board(a), (a >> 8) & 0xf, a & 0xff, Value);
+}
+
+/* One process; event handles are KEVENT pointers */
+
+struct _EPROCESS {
+  int ep_pid;
+};
+
+static struct _EPROCESS the_process;
+static POBJECT_TYPE event_type;
+POBJECT_TYPE *ExEventObjectType = &event_type;
+
+NTSTATUS
+ObReferenceObjectByHandle(HANDLE Handle, ULONG DesiredAccess,
+    POBJECT_TYPE ObjectType, KPROCESSOR_MODE AccessMode, PVOID *Object,
+    PVOID HandleInformation)
+{
+  if (Handle == NULL)
+    return STATUS_INVALID_PARAMETER;
+  *Object = Handle;
+  return STATUS_SUCCESS;
+}
+
+VOID
+ObReferenceObject(PVOID Object)
+{
+}
+
+VOID
+ObDereferenceObject(PVOID Object)
+{
+}
+
+PEPROCESS
+PsGetCurrentProcess(void)
+{
+  return &the_process;
+}
+
+VOID
+KeStackAttachProcess(PEPROCESS Process, KAPC_STATE *ApcState)
+{
+  ApcState->Process = Process;
+}
+
+VOID
+KeUnstackDetachProcess(KAPC_STATE *ApcState)
+{
+}
+
+LONG
+KeSetEvent(PKEVENT Event, LONG Increment, BOOLEAN Wait)
+{
+  LONG was;
+
+  pthread_mutex_lock(&Event->ke_lock);
+  was = Event->ke_signaled;
+  Event->ke_signaled = 1;
+  pthread_cond_broadcast(&Event->ke_cv);
+  pthread_mutex_unlock(&Event->ke_lock);
+  return was;
+}
+
+/* An MDL's pages are one zeroed host allocation, mapped everywhere */
+
+struct _MDL {
+  PVOID md_va;
+  SIZE_T md_len;
+};
+
+PMDL
+MmAllocatePagesForMdlEx(PHYSICAL_ADDRESS LowAddress,
+    PHYSICAL_ADDRESS HighAddress, PHYSICAL_ADDRESS SkipBytes,
+    SIZE_T TotalBytes, MEMORY_CACHING_TYPE CacheType, ULONG Flags)
+{
+  PMDL mdl;
+
+  mdl = malloc(sizeof(*mdl));
+  if (mdl == NULL)
+    return NULL;
+  if (posix_memalign(&mdl->md_va, 4096, TotalBytes) != 0) {
+    free(mdl);
+    return NULL;
+  }
+  memset(mdl->md_va, 0, TotalBytes);
+  mdl->md_len = TotalBytes;
+  return mdl;
+}
+
+PVOID
+MmGetSystemAddressForMdlSafe(PMDL Mdl, ULONG Priority)
+{
+  return Mdl->md_va;
+}
+
+PVOID
+MmMapLockedPagesSpecifyCache(PMDL Mdl, KPROCESSOR_MODE AccessMode,
+    MEMORY_CACHING_TYPE CacheType, PVOID RequestedAddress,
+    ULONG BugCheckOnFailure, ULONG Priority)
+{
+  return Mdl->md_va;
+}
+
+VOID
+MmUnmapLockedPages(PVOID BaseAddress, PMDL Mdl)
+{
+}
+
+VOID
+MmFreePagesFromMdl(PMDL Mdl)
+{
+  free(Mdl->md_va);
+  Mdl->md_va = NULL;
+}
+
+/* The I/O manager and PnP, see wdf_shim.h */
+
+NTSTATUS
+wdfshim_add_device(struct dasshim_board *sb, WDFDEVICE *Device)
+{
+  struct WDFDEVICE_INIT init, *ip = &init;
+  struct WDFCMRESLIST__ res;
+  PCM_PARTIAL_RESOURCE_DESCRIPTOR d;
+  WDFDEVICE dev;
+  NTSTATUS status;
+
+  if (the_driver == NULL)
+    return STATUS_INVALID_DEVICE_STATE;
+  memset(&init, 0, sizeof(init));
+  init.di_board = sb;
+  status = (*the_driver->wd_config.EvtDriverDeviceAdd)(the_driver, ip);
+  if (!NT_SUCCESS(status))
+    return status;
+  dev = init.di_device;
+  if (dev == NULL)
+    return STATUS_UNSUCCESSFUL;
+
+  memset(&res, 0, sizeof(res));
+  res.wc_count = 2;
+  d = &res.wc_desc[0];
+  d->Type = CmResourceTypePort;
+  d->u.Port.Start.QuadPart = WDFSHIM_PORT(sb->sb_unit, DASEMU_BADR1);
+  d->u.Port.Length = 0x80;
+  d = &res.wc_desc[1];
+  d->Type = CmResourceTypePort;
+  d->u.Port.Start.QuadPart = WDFSHIM_PORT(sb->sb_unit, DASEMU_BADR2);
+  d->u.Port.Length = 0x08;
+  if (dev->wv_init.di_pnp.EvtDevicePrepareHardware != NULL) {
+    status = (*dev->wv_init.di_pnp.EvtDevicePrepareHardware)(dev, &res, &res);
+    if (!NT_SUCCESS(status))
+      return status;
+  }
+  if (dev->wv_init.di_pnp.EvtDeviceD0Entry != NULL) {
+    status = (*dev->wv_init.di_pnp.EvtDeviceD0Entry)(dev,
+        WdfPowerDeviceD3Final);
+    if (!NT_SUCCESS(status))
+      return status;
+  }
+  if (dev->wv_intr != NULL)
+    dasshim_set_isr(sb, interrupt_isr, dev->wv_intr);
+  *Device = dev;
+  return STATUS_SUCCESS;
+}
+
+static WDFREQUEST
+request_alloc(WDFFILEOBJECT file, WDF_REQUEST_TYPE type)
+{
+  WDFREQUEST r;
+
+  r = calloc(1, sizeof(*r));
+  if (r == NULL)
+    return NULL;
+  WDF_REQUEST_PARAMETERS_INIT(&r->wr_params);
+  r->wr_params.Type = type;
+  r->wr_file = file;
+  pthread_mutex_init(&r->wr_lock, NULL);
+  pthread_cond_init(&r->wr_cv, NULL);
+  return r;
+}
+
+static NTSTATUS
+request_wait(WDFREQUEST r, ULONG_PTR *info)
+{
+  NTSTATUS status;
+
+  pthread_mutex_lock(&r->wr_lock);
+  while (!r->wr_done)
+    pthread_cond_wait(&r->wr_cv, &r->wr_lock);
+  pthread_mutex_unlock(&r->wr_lock);
+  status = r->wr_status;
+  if (info != NULL)
+    *info = r->wr_info;
+  pthread_mutex_destroy(&r->wr_lock);
+  pthread_cond_destroy(&r->wr_cv);
+  free(r);
+  return status;
+}
+
+/* Read, write and IOCTL requests go through EvtIoInCallerContext */
+static NTSTATUS
+request_issue(WDFREQUEST r, ULONG_PTR *info)
+{
+  WDFDEVICE dev = r->wr_file->wf_device;
+  NTSTATUS status;
+
+  if (dev->wv_init.di_in_caller != NULL) {
+    (*dev->wv_init.di_in_caller)(dev, r);
+  } else {
+    status = WdfDeviceEnqueueRequest(dev, r);
+    if (!NT_SUCCESS(status))
+      WdfRequestComplete(r, status);
+  }
+  return request_wait(r, info);
+}
+
+NTSTATUS
+wdfshim_create(WDFDEVICE Device, WDFFILEOBJECT *FileObject)
+{
+  PFN_WDF_DEVICE_FILE_CREATE create = Device->wv_init.di_file.EvtDeviceFileCreate;
+  WDFFILEOBJECT file;
+  WDFREQUEST r;
+  NTSTATUS status;
+
+  file = object_alloc(sizeof(*file), &Device->wv_init.di_file_attrs);
+  if (file == NULL)
+    return STATUS_INSUFFICIENT_RESOURCES;
+  file->wf_device = Device;
+  if (create != NULL) {
+    r = request_alloc(file, WdfRequestTypeCreate);
+    if (r == NULL) {
+      object_free(file);
+      return STATUS_INSUFFICIENT_RESOURCES;
+    }
+    (*create)(Device, r, file);
+    status = request_wait(r, NULL);
+    if (!NT_SUCCESS(status)) {
+      object_free(file);
+      return status;
+    }
+  }
+  *FileObject = file;
+  return STATUS_SUCCESS;
+}
+
+VOID
+wdfshim_close(WDFFILEOBJECT FileObject)
+{
+  PWDF_FILEOBJECT_CONFIG c = &FileObject->wf_device->wv_init.di_file;
+
+  if (c->EvtFileCleanup != NULL)
+    (*c->EvtFileCleanup)(FileObject);
+  if (c->EvtFileClose != NULL)
+    (*c->EvtFileClose)(FileObject);
+  object_free(FileObject);
+}
+
+NTSTATUS
+wdfshim_ioctl(WDFFILEOBJECT FileObject, ULONG IoControlCode, PVOID In,
+    size_t InLength, PVOID Out, size_t OutLength, ULONG_PTR *Information)
+{
+  WDFREQUEST r;
+  PVOID sys = NULL;
+  size_t syslen;
+  ULONG_PTR info = 0;
+  NTSTATUS status;
+  ULONG method = METHOD_FROM_CTL_CODE(IoControlCode);
+
+  syslen = method == METHOD_BUFFERED && OutLength > InLength ?
+      OutLength : InLength;
+  if (syslen != 0) {
+    sys = calloc(1, syslen);
+    if (sys == NULL)
+      return STATUS_INSUFFICIENT_RESOURCES;
+    if (InLength != 0)
+      memcpy(sys, In, InLength);
+  }
+  r = request_alloc(FileObject, WdfRequestTypeDeviceControl);
+  if (r == NULL) {
+    free(sys);
+    return STATUS_INSUFFICIENT_RESOURCES;
+  }
+  r->wr_params.Parameters.DeviceIoControl.IoControlCode = IoControlCode;
+  r->wr_params.Parameters.DeviceIoControl.InputBufferLength = InLength;
+  r->wr_params.Parameters.DeviceIoControl.OutputBufferLength = OutLength;
+  r->wr_in.wm_buf = sys;
+  r->wr_in.wm_len = InLength;
+  if (method == METHOD_BUFFERED) {
+    r->wr_out.wm_buf = sys;
+    r->wr_out.wm_len = OutLength;
+  } else {
+    r->wr_out.wm_buf = Out;
+    r->wr_out.wm_len = OutLength;
+  }
+  status = request_issue(r, &info);
+  if (method == METHOD_BUFFERED && NT_SUCCESS(status) && OutLength != 0)
+    memcpy(Out, sys, info < OutLength ? info : OutLength);
+  free(sys);
+  if (Information != NULL)
+    *Information = info;
+  return status;
+}
+
+NTSTATUS
+wdfshim_read(WDFFILEOBJECT FileObject, PVOID Buffer, size_t Length,
+    ULONG_PTR *Information)
+{
+  WDFREQUEST r;
+
+  r = request_alloc(FileObject, WdfRequestTypeRead);
+  if (r == NULL)
+    return STATUS_INSUFFICIENT_RESOURCES;
+  r->wr_params.Parameters.Read.Length = Length;
+  r->wr_out.wm_buf = Buffer;
+  r->wr_out.wm_len = Length;
+  return request_issue(r, Information);
+}
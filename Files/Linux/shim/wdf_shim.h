@@ -0,0 +1,41 @@
+/* wdf_shim.h -- what the I/O manager and PnP would do for das1 */
+/*
+ * wdf_das.c drives the framework from outside through these: a device
+ * per board, then create, IRP_MJ_DEVICE_CONTROL, IRP_MJ_READ, cleanup
+ * and close on a file object.  Each request is issued and waited for
+ * in the calling thread, which is the caller's context.
+ *
+ * Port addresses in the resource list are WDFSHIM_PORT(unit, BAR),
+ * BADR1 first; READ_PORT_* and WRITE_PORT_* route them back to the
+ * board, BAR and offset.
+ */
+#ifndef _WDF_SHIM_H_
+#define _WDF_SHIM_H_
+
+#include <pthread.h>
+
+#include "dasshim.h"
+
+#define WDFSHIM_PORT(unit, bar) ((((unit) + 1) << 12) | ((bar) << 8))
+
+struct _KEVENT {
+  pthread_mutex_t ke_lock;
+  pthread_cond_t ke_cv;
+  int ke_signaled;
+};
+
+extern DRIVER_OBJECT wdfshim_driver_object;
+
+/* After DriverEntry: EvtDriverDeviceAdd, PrepareHardware, D0Entry */
+NTSTATUS wdfshim_add_device(struct dasshim_board *, WDFDEVICE *);
+
+NTSTATUS wdfshim_create(WDFDEVICE, WDFFILEOBJECT *);
+VOID wdfshim_close(WDFFILEOBJECT);
+NTSTATUS wdfshim_ioctl(WDFFILEOBJECT, ULONG, PVOID, size_t, PVOID, size_t,
+    ULONG_PTR *);
+NTSTATUS wdfshim_read(WDFFILEOBJECT, PVOID, size_t, ULONG_PTR *);
+
+/* How many requests the queue has been handed, for checking routing */
+ULONG wdfshim_dispatched(WDFQUEUE);
+
+#endif /* _WDF_SHIM_H_ */
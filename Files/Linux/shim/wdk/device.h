@@ -0,0 +1,2 @@
+/* device.h -- the driver's own header, straight from the tree */
+#include "../../../Windows/das1/Device.h"
@@ -0,0 +1 @@
+/* initguid.h -- DEFINE_GUID always defines, see ntddk.h */
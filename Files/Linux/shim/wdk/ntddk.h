@@ -0,0 +1,216 @@
+/* ntddk.h -- the NT kernel subset the das1 driver uses, on dasshim */
+/*
+ * Types have their Windows widths (ULONG is 32 bits).  Port I/O goes to
+ * the emulated board: a port address is (unit << 12) | (BAR << 8) |
+ * offset, as handed out in the resource list by wdf_das.c.  Pool is the
+ * host heap, an MDL's pages are one host allocation that is its own
+ * system and user mapping, and there is a single process.  SEH is not
+ * available, so __try always runs its block and __except never does.
+ */
+#ifndef _SHIM_NTDDK_H_
+#define _SHIM_NTDDK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+
+#define _KERNEL_MODE 1
+
+/* SAL and linkage */
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _In_reads_(n)
+#define _Out_writes_(n)
+#define _Inout_updates_(n)
+#define EXTERN_C_START
+#define EXTERN_C_END
+#define FORCEINLINE static inline __attribute__((__always_inline__))
+#define UNREFERENCED_PARAMETER(p) ((void)(p))
+#define PAGED_CODE() ((void)0)
+
+#define __try if (1)
+#define __except(filter) else if (0)
+#define EXCEPTION_EXECUTE_HANDLER 1
+
+typedef void VOID;
+typedef char CHAR;
+typedef uint8_t UCHAR, *PUCHAR;
+typedef uint8_t BOOLEAN;
+typedef int16_t SHORT;
+typedef uint16_t USHORT;
+typedef int32_t LONG;
+typedef uint32_t ULONG, *PULONG;
+typedef uint32_t UINT32, *PUINT32;
+typedef int64_t LONGLONG, LONG64;
+typedef uint64_t ULONGLONG, ULONG64;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef void *PVOID, *HANDLE;
+typedef const char *PCSTR;
+typedef wchar_t WCHAR, *PWCH;
+typedef LONG NTSTATUS;
+
+#define TRUE 1
+#define FALSE 0
+#define MAXULONG 0xffffffffU
+
+typedef union _LARGE_INTEGER {
+  struct {
+    ULONG LowPart;
+    LONG HighPart;
+  };
+  struct {
+    ULONG LowPart;
+    LONG HighPart;
+  } u;
+  LONGLONG QuadPart;
+} LARGE_INTEGER, PHYSICAL_ADDRESS;
+
+typedef struct _UNICODE_STRING {
+  USHORT Length;
+  USHORT MaximumLength;
+  PWCH Buffer;
+} UNICODE_STRING, *PUNICODE_STRING;
+
+#define DECLARE_CONST_UNICODE_STRING(name, s) \
+  const UNICODE_STRING name = { sizeof(s) - sizeof(WCHAR), sizeof(s), (PWCH)(s) }
+
+typedef struct _GUID {
+  ULONG Data1;
+  USHORT Data2;
+  USHORT Data3;
+  UCHAR Data4[8];
+} GUID;
+
+/* Public.h is in every file; selectany makes the one GUID. */
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+  const GUID name __attribute__((__weak__)) = \
+    { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+
+/* Status */
+#define NT_SUCCESS(s) ((NTSTATUS)(s) >= 0)
+#define STATUS_SUCCESS ((NTSTATUS)0x00000000)
+#define STATUS_TIMEOUT ((NTSTATUS)0x00000102)
+#define STATUS_UNSUCCESSFUL ((NTSTATUS)0xC0000001)
+#define STATUS_NOT_IMPLEMENTED ((NTSTATUS)0xC0000002)
+#define STATUS_INVALID_PARAMETER ((NTSTATUS)0xC000000D)
+#define STATUS_INVALID_DEVICE_REQUEST ((NTSTATUS)0xC0000010)
+#define STATUS_BUFFER_TOO_SMALL ((NTSTATUS)0xC0000023)
+#define STATUS_INSUFFICIENT_RESOURCES ((NTSTATUS)0xC000009A)
+#define STATUS_DEVICE_BUSY ((NTSTATUS)0x80000011)
+#define STATUS_NO_MORE_ENTRIES ((NTSTATUS)0x8000001A)
+#define STATUS_NOT_SUPPORTED ((NTSTATUS)0xC00000BB)
+#define STATUS_CANCELLED ((NTSTATUS)0xC0000120)
+#define STATUS_NOT_FOUND ((NTSTATUS)0xC0000225)
+#define STATUS_OPEN_FAILED ((NTSTATUS)0xC0000136)
+#define STATUS_INVALID_DEVICE_STATE ((NTSTATUS)0xC0000184)
+#define STATUS_DEVICE_CONFIGURATION_ERROR ((NTSTATUS)0xC0000182)
+
+/* I/O control codes */
+#define CTL_CODE(type, fn, method, access) \
+  (((ULONG)(type) << 16) | ((ULONG)(access) << 14) | ((fn) << 2) | (method))
+#define METHOD_BUFFERED 0
+#define METHOD_IN_DIRECT 1
+#define METHOD_OUT_DIRECT 2
+#define METHOD_NEITHER 3
+#define METHOD_FROM_CTL_CODE(c) ((ULONG)(c) & 3)
+#define FILE_ANY_ACCESS 0
+#define FILE_READ_ACCESS 1
+#define FILE_WRITE_ACCESS 2
+
+/* Debug output, off unless shim_dbgprint is set */
+extern int shim_dbgprint;
+ULONG DbgPrintShim(PCSTR, ...);
+#define DbgPrint(...) (shim_dbgprint ? DbgPrintShim(__VA_ARGS__) : 0)
+
+/* Processors, time, barriers */
+#define ALL_PROCESSOR_GROUPS 0xffff
+ULONG KeQueryActiveProcessorCountEx(USHORT);
+ULONG KeGetCurrentProcessorNumberEx(PVOID);
+ULONG64 KeQueryInterruptTimePrecise(ULONG64 *);
+LARGE_INTEGER KeQueryPerformanceCounter(LARGE_INTEGER *);
+#define KeMemoryBarrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define InterlockedIncrement(p) __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+
+/* Pool */
+typedef enum _POOL_TYPE {
+  NonPagedPool, PagedPool, NonPagedPoolNx = 512
+} POOL_TYPE;
+
+PVOID ExAllocatePoolWithTag(POOL_TYPE, SIZE_T, ULONG);
+VOID ExFreePoolWithTag(PVOID, ULONG);
+VOID ExFreePool(PVOID);
+#define RtlZeroMemory(d, n) memset((d), 0, (n))
+#define RtlCopyMemory(d, s, n) memcpy((d), (s), (n))
+
+/* Port I/O */
+UCHAR READ_PORT_UCHAR(PUCHAR);
+VOID WRITE_PORT_UCHAR(PUCHAR, UCHAR);
+ULONG READ_PORT_ULONG(PULONG);
+VOID WRITE_PORT_ULONG(PULONG, ULONG);
+
+/* Objects, processes, events */
+typedef enum _KPROCESSOR_MODE { KernelMode, UserMode } KPROCESSOR_MODE;
+typedef struct _KEVENT KEVENT, *PKEVENT;
+typedef struct _EPROCESS *PEPROCESS;
+typedef struct _OBJECT_TYPE *POBJECT_TYPE;
+typedef struct _KAPC_STATE {
+  PVOID Process;
+} KAPC_STATE;
+
+#define EVENT_MODIFY_STATE 0x0002
+#define IO_NO_INCREMENT 0
+
+extern POBJECT_TYPE *ExEventObjectType;
+
+NTSTATUS ObReferenceObjectByHandle(HANDLE, ULONG, POBJECT_TYPE,
+    KPROCESSOR_MODE, PVOID *, PVOID);
+VOID ObReferenceObject(PVOID);
+VOID ObDereferenceObject(PVOID);
+PEPROCESS PsGetCurrentProcess(void);
+VOID KeStackAttachProcess(PEPROCESS, KAPC_STATE *);
+VOID KeUnstackDetachProcess(KAPC_STATE *);
+LONG KeSetEvent(PKEVENT, LONG, BOOLEAN);
+
+/* Memory descriptor lists */
+typedef struct _MDL *PMDL;
+typedef enum _MEMORY_CACHING_TYPE { MmNonCached, MmCached } MEMORY_CACHING_TYPE;
+#define NormalPagePriority 16
+#define MdlMappingNoExecute 0x40000000
+#define MM_ALLOCATE_FULLY_REQUIRED 0x00000004
+
+PMDL MmAllocatePagesForMdlEx(PHYSICAL_ADDRESS, PHYSICAL_ADDRESS,
+    PHYSICAL_ADDRESS, SIZE_T, MEMORY_CACHING_TYPE, ULONG);
+PVOID MmGetSystemAddressForMdlSafe(PMDL, ULONG);
+PVOID MmMapLockedPagesSpecifyCache(PMDL, KPROCESSOR_MODE,
+    MEMORY_CACHING_TYPE, PVOID, ULONG, ULONG);
+VOID MmUnmapLockedPages(PVOID, PMDL);
+VOID MmFreePagesFromMdl(PMDL);
+
+/* Driver objects and resources */
+typedef struct _DRIVER_OBJECT {
+  PVOID DriverExtension;
+} DRIVER_OBJECT, *PDRIVER_OBJECT;
+
+typedef NTSTATUS DRIVER_INITIALIZE(PDRIVER_OBJECT, PUNICODE_STRING);
+
+#define CmResourceTypePort 1
+#define CmResourceTypeInterrupt 2
+
+typedef struct _CM_PARTIAL_RESOURCE_DESCRIPTOR {
+  UCHAR Type;
+  UCHAR ShareDisposition;
+  USHORT Flags;
+  union {
+    struct {
+      PHYSICAL_ADDRESS Start;
+      ULONG Length;
+    } Port;
+  } u;
+} CM_PARTIAL_RESOURCE_DESCRIPTOR, *PCM_PARTIAL_RESOURCE_DESCRIPTOR;
+
+#endif /* _SHIM_NTDDK_H_ */
@@ -0,0 +1,2 @@
+/* queue.h -- the driver's own header, straight from the tree */
+#include "../../../Windows/das1/Queue.h"
@@ -0,0 +1,2 @@
+/* trace.h -- the driver's own header, straight from the tree */
+#include "../../../Windows/das1/Trace.h"
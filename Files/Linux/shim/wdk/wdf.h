@@ -0,0 +1,352 @@
+/* wdf.h -- the KMDF subset the das1 driver uses, implemented in wdf_shim.c */
+/*
+ * Handles are pointers to the runtime's own structs; every object can
+ * carry one context, typed or not, and the getters the driver declares
+ * return it.  Structures have the members the driver sets or the shim
+ * reads, under their KMDF names, so the driver's INIT calls and
+ * assignments compile as written.
+ */
+#ifndef _SHIM_WDF_H_
+#define _SHIM_WDF_H_
+
+#include "ntddk.h"
+
+typedef void *WDFOBJECT;
+typedef struct WDFDRIVER__ *WDFDRIVER;
+typedef struct WDFDEVICE__ *WDFDEVICE;
+typedef struct WDFQUEUE__ *WDFQUEUE;
+typedef struct WDFREQUEST__ *WDFREQUEST;
+typedef struct WDFMEMORY__ *WDFMEMORY;
+typedef struct WDFSPINLOCK__ *WDFSPINLOCK;
+typedef struct WDFTIMER__ *WDFTIMER;
+typedef struct WDFINTERRUPT__ *WDFINTERRUPT;
+typedef struct WDFFILEOBJECT__ *WDFFILEOBJECT;
+typedef struct WDFCMRESLIST__ *WDFCMRESLIST;
+typedef struct WDFDEVICE_INIT WDFDEVICE_INIT, *PWDFDEVICE_INIT;
+typedef const UNICODE_STRING *PCUNICODE_STRING;
+
+#define WDF_NO_HANDLE NULL
+#define WDF_NO_OBJECT_ATTRIBUTES NULL
+
+typedef enum _WDF_POWER_DEVICE_STATE {
+  WdfPowerDeviceInvalid = 0,
+  WdfPowerDeviceD0,
+  WdfPowerDeviceD1,
+  WdfPowerDeviceD2,
+  WdfPowerDeviceD3,
+  WdfPowerDeviceD3Final,
+} WDF_POWER_DEVICE_STATE;
+
+typedef enum _WDF_DEVICE_IO_TYPE {
+  WdfDeviceIoUndefined = 0,
+  WdfDeviceIoNeither,
+  WdfDeviceIoBuffered,
+  WdfDeviceIoDirect,
+} WDF_DEVICE_IO_TYPE;
+
+typedef enum _WDF_IO_QUEUE_DISPATCH_TYPE {
+  WdfIoQueueDispatchInvalid = 0,
+  WdfIoQueueDispatchSequential,
+  WdfIoQueueDispatchParallel,
+  WdfIoQueueDispatchManual,
+} WDF_IO_QUEUE_DISPATCH_TYPE;
+
+typedef enum _WDF_REQUEST_TYPE {
+  WdfRequestTypeCreate = 0x0,
+  WdfRequestTypeClose = 0x2,
+  WdfRequestTypeRead = 0x3,
+  WdfRequestTypeWrite = 0x4,
+  WdfRequestTypeDeviceControl = 0xE,
+  WdfRequestTypeCleanup = 0x12,
+} WDF_REQUEST_TYPE;
+
+/* Event callbacks */
+typedef NTSTATUS EVT_WDF_DRIVER_DEVICE_ADD(WDFDRIVER, PWDFDEVICE_INIT);
+typedef VOID EVT_WDF_OBJECT_CONTEXT_CLEANUP(WDFOBJECT);
+typedef VOID EVT_WDF_DEVICE_FILE_CREATE(WDFDEVICE, WDFREQUEST, WDFFILEOBJECT);
+typedef VOID EVT_WDF_FILE_CLOSE(WDFFILEOBJECT);
+typedef VOID EVT_WDF_FILE_CLEANUP(WDFFILEOBJECT);
+typedef NTSTATUS EVT_WDF_DEVICE_PREPARE_HARDWARE(WDFDEVICE, WDFCMRESLIST,
+    WDFCMRESLIST);
+typedef NTSTATUS EVT_WDF_DEVICE_D0_ENTRY(WDFDEVICE, WDF_POWER_DEVICE_STATE);
+typedef VOID EVT_WDF_IO_IN_CALLER_CONTEXT(WDFDEVICE, WDFREQUEST);
+typedef VOID EVT_WDF_IO_QUEUE_IO_READ(WDFQUEUE, WDFREQUEST, size_t);
+typedef VOID EVT_WDF_IO_QUEUE_IO_WRITE(WDFQUEUE, WDFREQUEST, size_t);
+typedef VOID EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL(WDFQUEUE, WDFREQUEST, size_t,
+    size_t, ULONG);
+typedef VOID EVT_WDF_IO_QUEUE_IO_STOP(WDFQUEUE, WDFREQUEST, ULONG);
+typedef BOOLEAN EVT_WDF_INTERRUPT_ISR(WDFINTERRUPT, ULONG);
+typedef VOID EVT_WDF_INTERRUPT_DPC(WDFINTERRUPT, WDFOBJECT);
+typedef VOID EVT_WDF_TIMER(WDFTIMER);
+
+typedef EVT_WDF_DRIVER_DEVICE_ADD *PFN_WDF_DRIVER_DEVICE_ADD;
+typedef EVT_WDF_OBJECT_CONTEXT_CLEANUP *PFN_WDF_OBJECT_CONTEXT_CLEANUP;
+typedef EVT_WDF_DEVICE_FILE_CREATE *PFN_WDF_DEVICE_FILE_CREATE;
+typedef EVT_WDF_FILE_CLOSE *PFN_WDF_FILE_CLOSE;
+typedef EVT_WDF_FILE_CLEANUP *PFN_WDF_FILE_CLEANUP;
+typedef EVT_WDF_DEVICE_PREPARE_HARDWARE *PFN_WDF_DEVICE_PREPARE_HARDWARE;
+typedef EVT_WDF_DEVICE_D0_ENTRY *PFN_WDF_DEVICE_D0_ENTRY;
+typedef EVT_WDF_IO_IN_CALLER_CONTEXT *PFN_WDF_IO_IN_CALLER_CONTEXT;
+typedef EVT_WDF_IO_QUEUE_IO_READ *PFN_WDF_IO_QUEUE_IO_READ;
+typedef EVT_WDF_IO_QUEUE_IO_WRITE *PFN_WDF_IO_QUEUE_IO_WRITE;
+typedef EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL *PFN_WDF_IO_QUEUE_IO_DEVICE_CONTROL;
+typedef EVT_WDF_IO_QUEUE_IO_STOP *PFN_WDF_IO_QUEUE_IO_STOP;
+typedef EVT_WDF_INTERRUPT_ISR *PFN_WDF_INTERRUPT_ISR;
+typedef EVT_WDF_INTERRUPT_DPC *PFN_WDF_INTERRUPT_DPC;
+typedef EVT_WDF_TIMER *PFN_WDF_TIMER;
+
+/* Object attributes and contexts */
+typedef struct _WDF_OBJECT_CONTEXT_TYPE_INFO {
+  ULONG Size;
+  PCSTR ContextName;
+  size_t ContextSize;
+} WDF_OBJECT_CONTEXT_TYPE_INFO, *PWDF_OBJECT_CONTEXT_TYPE_INFO;
+
+typedef struct _WDF_OBJECT_ATTRIBUTES {
+  ULONG Size;
+  PFN_WDF_OBJECT_CONTEXT_CLEANUP EvtCleanupCallback;
+  WDFOBJECT ParentObject;
+  size_t ContextSizeOverride;
+  const WDF_OBJECT_CONTEXT_TYPE_INFO *ContextTypeInfo;
+} WDF_OBJECT_ATTRIBUTES, *PWDF_OBJECT_ATTRIBUTES;
+
+PVOID WdfObjectGetTypedContextWorker(WDFOBJECT,
+    const WDF_OBJECT_CONTEXT_TYPE_INFO *);
+VOID WdfObjectReference(WDFOBJECT);
+VOID WdfObjectDereference(WDFOBJECT);
+
+#define WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(type, getter) \
+  static const WDF_OBJECT_CONTEXT_TYPE_INFO _WDF_##type##_TYPE_INFO \
+    __attribute__((__unused__)) = \
+    { sizeof(WDF_OBJECT_CONTEXT_TYPE_INFO), #type, sizeof(type) }; \
+  static inline type *getter(WDFOBJECT Handle) \
+  { \
+    return (type *)WdfObjectGetTypedContextWorker(Handle, \
+        &_WDF_##type##_TYPE_INFO); \
+  }
+
+#define WDF_GET_CONTEXT_TYPE_INFO(type) (&_WDF_##type##_TYPE_INFO)
+
+FORCEINLINE VOID
+WDF_OBJECT_ATTRIBUTES_INIT(PWDF_OBJECT_ATTRIBUTES Attributes)
+{
+  RtlZeroMemory(Attributes, sizeof(*Attributes));
+  Attributes->Size = sizeof(*Attributes);
+}
+
+#define WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(attributes, type) \
+  (WDF_OBJECT_ATTRIBUTES_INIT(attributes), \
+   (attributes)->ContextTypeInfo = WDF_GET_CONTEXT_TYPE_INFO(type))
+
+/* Driver */
+typedef struct _WDF_DRIVER_CONFIG {
+  ULONG Size;
+  PFN_WDF_DRIVER_DEVICE_ADD EvtDriverDeviceAdd;
+  ULONG DriverInitFlags;
+  ULONG DriverPoolTag;
+} WDF_DRIVER_CONFIG, *PWDF_DRIVER_CONFIG;
+
+FORCEINLINE VOID
+WDF_DRIVER_CONFIG_INIT(PWDF_DRIVER_CONFIG Config,
+    PFN_WDF_DRIVER_DEVICE_ADD EvtDriverDeviceAdd)
+{
+  RtlZeroMemory(Config, sizeof(*Config));
+  Config->Size = sizeof(*Config);
+  Config->EvtDriverDeviceAdd = EvtDriverDeviceAdd;
+}
+
+NTSTATUS WdfDriverCreate(PDRIVER_OBJECT, PCUNICODE_STRING,
+    PWDF_OBJECT_ATTRIBUTES, PWDF_DRIVER_CONFIG, WDFDRIVER *);
+PDRIVER_OBJECT WdfDriverWdmGetDriverObject(WDFDRIVER);
+
+/* Device */
+typedef struct _WDF_PNPPOWER_EVENT_CALLBACKS {
+  ULONG Size;
+  PFN_WDF_DEVICE_D0_ENTRY EvtDeviceD0Entry;
+  PFN_WDF_DEVICE_PREPARE_HARDWARE EvtDevicePrepareHardware;
+} WDF_PNPPOWER_EVENT_CALLBACKS, *PWDF_PNPPOWER_EVENT_CALLBACKS;
+
+FORCEINLINE VOID
+WDF_PNPPOWER_EVENT_CALLBACKS_INIT(PWDF_PNPPOWER_EVENT_CALLBACKS Callbacks)
+{
+  RtlZeroMemory(Callbacks, sizeof(*Callbacks));
+  Callbacks->Size = sizeof(*Callbacks);
+}
+
+typedef struct _WDF_FILEOBJECT_CONFIG {
+  ULONG Size;
+  PFN_WDF_DEVICE_FILE_CREATE EvtDeviceFileCreate;
+  PFN_WDF_FILE_CLOSE EvtFileClose;
+  PFN_WDF_FILE_CLEANUP EvtFileCleanup;
+} WDF_FILEOBJECT_CONFIG, *PWDF_FILEOBJECT_CONFIG;
+
+FORCEINLINE VOID
+WDF_FILEOBJECT_CONFIG_INIT(PWDF_FILEOBJECT_CONFIG Config,
+    PFN_WDF_DEVICE_FILE_CREATE EvtDeviceFileCreate,
+    PFN_WDF_FILE_CLOSE EvtFileClose, PFN_WDF_FILE_CLEANUP EvtFileCleanup)
+{
+  RtlZeroMemory(Config, sizeof(*Config));
+  Config->Size = sizeof(*Config);
+  Config->EvtDeviceFileCreate = EvtDeviceFileCreate;
+  Config->EvtFileClose = EvtFileClose;
+  Config->EvtFileCleanup = EvtFileCleanup;
+}
+
+VOID WdfDeviceInitSetPnpPowerEventCallbacks(PWDFDEVICE_INIT,
+    PWDF_PNPPOWER_EVENT_CALLBACKS);
+VOID WdfDeviceInitSetFileObjectConfig(PWDFDEVICE_INIT, PWDF_FILEOBJECT_CONFIG,
+    PWDF_OBJECT_ATTRIBUTES);
+VOID WdfDeviceInitSetIoType(PWDFDEVICE_INIT, WDF_DEVICE_IO_TYPE);
+VOID WdfDeviceInitSetIoInCallerContextCallback(PWDFDEVICE_INIT,
+    PFN_WDF_IO_IN_CALLER_CONTEXT);
+NTSTATUS WdfDeviceCreate(PWDFDEVICE_INIT *, PWDF_OBJECT_ATTRIBUTES,
+    WDFDEVICE *);
+NTSTATUS WdfDeviceCreateDeviceInterface(WDFDEVICE, const GUID *,
+    PCUNICODE_STRING);
+NTSTATUS WdfDeviceCreateSymbolicLink(WDFDEVICE, PCUNICODE_STRING);
+NTSTATUS WdfDeviceConfigureRequestDispatching(WDFDEVICE, WDFQUEUE,
+    WDF_REQUEST_TYPE);
+NTSTATUS WdfDeviceEnqueueRequest(WDFDEVICE, WDFREQUEST);
+WDFQUEUE WdfDeviceGetDefaultQueue(WDFDEVICE);
+WDFDEVICE WdfFileObjectGetDevice(WDFFILEOBJECT);
+
+ULONG WdfCmResourceListGetCount(WDFCMRESLIST);
+PCM_PARTIAL_RESOURCE_DESCRIPTOR WdfCmResourceListGetDescriptor(WDFCMRESLIST,
+    ULONG);
+
+/* Queues */
+typedef struct _WDF_IO_QUEUE_CONFIG {
+  ULONG Size;
+  WDF_IO_QUEUE_DISPATCH_TYPE DispatchType;
+  BOOLEAN DefaultQueue;
+  PFN_WDF_IO_QUEUE_IO_READ EvtIoRead;
+  PFN_WDF_IO_QUEUE_IO_WRITE EvtIoWrite;
+  PFN_WDF_IO_QUEUE_IO_DEVICE_CONTROL EvtIoDeviceControl;
+  PFN_WDF_IO_QUEUE_IO_STOP EvtIoStop;
+} WDF_IO_QUEUE_CONFIG, *PWDF_IO_QUEUE_CONFIG;
+
+FORCEINLINE VOID
+WDF_IO_QUEUE_CONFIG_INIT(PWDF_IO_QUEUE_CONFIG Config,
+    WDF_IO_QUEUE_DISPATCH_TYPE DispatchType)
+{
+  RtlZeroMemory(Config, sizeof(*Config));
+  Config->Size = sizeof(*Config);
+  Config->DispatchType = DispatchType;
+}
+
+FORCEINLINE VOID
+WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(PWDF_IO_QUEUE_CONFIG Config,
+    WDF_IO_QUEUE_DISPATCH_TYPE DispatchType)
+{
+  WDF_IO_QUEUE_CONFIG_INIT(Config, DispatchType);
+  Config->DefaultQueue = TRUE;
+}
+
+NTSTATUS WdfIoQueueCreate(WDFDEVICE, PWDF_IO_QUEUE_CONFIG,
+    PWDF_OBJECT_ATTRIBUTES, WDFQUEUE *);
+WDFDEVICE WdfIoQueueGetDevice(WDFQUEUE);
+
+/* Requests and memory */
+typedef struct _WDF_REQUEST_PARAMETERS {
+  USHORT Size;
+  UCHAR MinorFunction;
+  WDF_REQUEST_TYPE Type;
+  union {
+    struct {
+      size_t Length;
+      ULONG Key;
+      LONGLONG DeviceOffset;
+    } Read, Write;
+    struct {
+      size_t OutputBufferLength;
+      size_t InputBufferLength;
+      ULONG IoControlCode;
+      PVOID Type3InputBuffer;
+    } DeviceIoControl;
+  } Parameters;
+} WDF_REQUEST_PARAMETERS, *PWDF_REQUEST_PARAMETERS;
+
+FORCEINLINE VOID
+WDF_REQUEST_PARAMETERS_INIT(PWDF_REQUEST_PARAMETERS Parameters)
+{
+  RtlZeroMemory(Parameters, sizeof(*Parameters));
+  Parameters->Size = sizeof(*Parameters);
+}
+
+NTSTATUS WdfIoQueueFindRequest(WDFQUEUE, WDFREQUEST, WDFFILEOBJECT,
+    PWDF_REQUEST_PARAMETERS, WDFREQUEST *);
+NTSTATUS WdfIoQueueRetrieveFoundRequest(WDFQUEUE, WDFREQUEST, WDFREQUEST *);
+
+VOID WdfRequestComplete(WDFREQUEST, NTSTATUS);
+VOID WdfRequestCompleteWithInformation(WDFREQUEST, NTSTATUS, ULONG_PTR);
+VOID WdfRequestSetInformation(WDFREQUEST, ULONG_PTR);
+VOID WdfRequestGetParameters(WDFREQUEST, PWDF_REQUEST_PARAMETERS);
+WDFFILEOBJECT WdfRequestGetFileObject(WDFREQUEST);
+NTSTATUS WdfRequestForwardToIoQueue(WDFREQUEST, WDFQUEUE);
+NTSTATUS WdfRequestRetrieveInputBuffer(WDFREQUEST, size_t, PVOID *, size_t *);
+NTSTATUS WdfRequestRetrieveOutputBuffer(WDFREQUEST, size_t, PVOID *, size_t *);
+NTSTATUS WdfRequestRetrieveInputMemory(WDFREQUEST, WDFMEMORY *);
+NTSTATUS WdfRequestRetrieveOutputMemory(WDFREQUEST, WDFMEMORY *);
+
+NTSTATUS WdfMemoryCopyFromBuffer(WDFMEMORY, size_t, PVOID, size_t);
+NTSTATUS WdfMemoryCopyToBuffer(WDFMEMORY, size_t, PVOID, size_t);
+
+/* Synchronization, timers, interrupts */
+NTSTATUS WdfSpinLockCreate(PWDF_OBJECT_ATTRIBUTES, WDFSPINLOCK *);
+VOID WdfSpinLockAcquire(WDFSPINLOCK);
+VOID WdfSpinLockRelease(WDFSPINLOCK);
+
+typedef struct _WDF_TIMER_CONFIG {
+  ULONG Size;
+  PFN_WDF_TIMER EvtTimerFunc;
+  ULONG Period;
+  BOOLEAN AutomaticSerialization;
+} WDF_TIMER_CONFIG, *PWDF_TIMER_CONFIG;
+
+FORCEINLINE VOID
+WDF_TIMER_CONFIG_INIT(PWDF_TIMER_CONFIG Config, PFN_WDF_TIMER EvtTimerFunc)
+{
+  RtlZeroMemory(Config, sizeof(*Config));
+  Config->Size = sizeof(*Config);
+  Config->EvtTimerFunc = EvtTimerFunc;
+  Config->AutomaticSerialization = TRUE;
+}
+
+/* Relative due times are negative, in 100 ns units */
+FORCEINLINE LONGLONG
+WDF_REL_TIMEOUT_IN_MS(ULONGLONG Time)
+{
+  return -(LONGLONG)Time * 10000;
+}
+
+NTSTATUS WdfTimerCreate(PWDF_TIMER_CONFIG, PWDF_OBJECT_ATTRIBUTES,
+    WDFTIMER *);
+BOOLEAN WdfTimerStart(WDFTIMER, LONGLONG);
+WDFOBJECT WdfTimerGetParentObject(WDFTIMER);
+
+typedef struct _WDF_INTERRUPT_CONFIG {
+  ULONG Size;
+  PFN_WDF_INTERRUPT_ISR EvtInterruptIsr;
+  PFN_WDF_INTERRUPT_DPC EvtInterruptDpc;
+} WDF_INTERRUPT_CONFIG, *PWDF_INTERRUPT_CONFIG;
+
+FORCEINLINE VOID
+WDF_INTERRUPT_CONFIG_INIT(PWDF_INTERRUPT_CONFIG Config,
+    PFN_WDF_INTERRUPT_ISR EvtInterruptIsr,
+    PFN_WDF_INTERRUPT_DPC EvtInterruptDpc)
+{
+  RtlZeroMemory(Config, sizeof(*Config));
+  Config->Size = sizeof(*Config);
+  Config->EvtInterruptIsr = EvtInterruptIsr;
+  Config->EvtInterruptDpc = EvtInterruptDpc;
+}
+
+NTSTATUS WdfInterruptCreate(WDFDEVICE, PWDF_INTERRUPT_CONFIG,
+    PWDF_OBJECT_ATTRIBUTES, WDFINTERRUPT *);
+WDFDEVICE WdfInterruptGetDevice(WDFINTERRUPT);
+BOOLEAN WdfInterruptQueueDpcForIsr(WDFINTERRUPT);
+/* The ISR runs under dasshim_intr_lock, so this is that lock. */
+VOID WdfInterruptAcquireLock(WDFINTERRUPT);
+VOID WdfInterruptReleaseLock(WDFINTERRUPT);
+
+#endif /* _SHIM_WDF_H_ */
@@ -0,0 +1,2 @@
+/* wdm.h -- everything is in ntddk.h */
+#include "ntddk.h"
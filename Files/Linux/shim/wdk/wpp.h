@@ -0,0 +1,15 @@
+/* wpp.h -- WPP tracing compiles away; dastrace is the userland view */
+#ifndef _SHIM_WPP_H_
+#define _SHIM_WPP_H_
+
+#define TRACE_LEVEL_CRITICAL 1
+#define TRACE_LEVEL_ERROR 2
+#define TRACE_LEVEL_WARNING 3
+#define TRACE_LEVEL_INFORMATION 4
+#define TRACE_LEVEL_VERBOSE 5
+
+#define WPP_INIT_TRACING(driver, path) ((void)(driver), (void)(path))
+#define WPP_CLEANUP(driver) ((void)(driver))
+#define TraceEvents(level, flags, ...) ((void)0)
+
+#endif /* _SHIM_WPP_H_ */
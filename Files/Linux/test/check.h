@@ -0,0 +1,17 @@
+/* check.h -- what every test prints: a line per check, ok or FAIL */
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <stdio.h>
+
+static int failed;
+
+static void
+check(const char *what, int ok)
+{
+  printf("%-40s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok)
+    failed++;
+}
+
+#endif /* _CHECK_H_ */
@@ -0,0 +1,1305 @@
+/* das -- das.c on an emulated board, through its cdevsw
+ *
+ * usage: das [test ...]
+ *
+ * das.c is attached to one dasemu board, as dasdrive does it, and each
+ * test named, or every test, opens the device, drives it through
+ * d_open, d_ioctl, d_read and d_close, and closes it again.  Every
+ * channel has its own DC level.  The board runs in real time, so the
+ * tests that sample take a few hundred milliseconds each.
+ */
+#include <sys/param.h>
+#include <sys/atomic.h>
+#include <sys/conf.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <uvm/uvm_extern.h>
+#include <dev/pci/dasio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dev/pci/dasstream.h>
+#include <dev/pci/daslatest.h>
+#include "../dasemu.h"
+#include "../shim/dasshim.h"
+#include "../shim/dasdrv.h"
+#undef printf
+#include "check.h"
+
+#define RW (FREAD | FWRITE)
+
+extern const struct cdevsw das_cdevsw;
+
+static struct dasshim_board *sb;
+
+static int
+level(int chan)
+{
+  return 256 + 448 * chan;
+}
+
+static void
+msleep(u_int ms)
+{
+  struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+
+  nanosleep(&ts, NULL);
+}
+
+static int
+dopen(int flags)
+{
+  return (*das_cdevsw.d_open)(0, flags, 0, NULL);
+}
+
+static int
+dclose(void)
+{
+  return (*das_cdevsw.d_close)(0, RW, 0, NULL);
+}
+
+static int
+dioctl(u_long cmd, void *data, int flags)
+{
+  return (*das_cdevsw.d_ioctl)(0, cmd, data, flags, NULL);
+}
+
+/* Bytes read or -errno, as read(2) */
+static ssize_t
+dread(void *buf, size_t len)
+{
+  struct iovec iov;
+  struct uio uio;
+  int error;
+
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  memset(&uio, 0, sizeof(uio));
+  uio.uio_iov = &iov;
+  uio.uio_iovcnt = 1;
+  uio.uio_resid = len;
+  uio.uio_rw = UIO_READ;
+  error = (*das_cdevsw.d_read)(0, &uio, 0);
+  if (error && uio.uio_resid == len)
+    return -error;
+  return len - uio.uio_resid;
+}
+
+static int
+rate(int count)
+{
+  return dioctl(DAS_SET_RATE, &count, RW);
+}
+
+static void
+stats(struct das_stats *ds)
+{
+  memset(ds, 0, sizeof(*ds));
+  (void)dioctl(DAS_GET_STATS, ds, FREAD);
+}
+
+/* Claimed interrupts so far, from the shim's count */
+static uint64_t
+claimed(void)
+{
+  uint64_t n;
+
+  dasshim_lock(sb);
+  n = sb->sb_isrs - sb->sb_unclaimed;
+  dasshim_unlock(sb);
+  return n;
+}
+
+/* A DAS_FMT_RECORDS stream read to EOF: its samples, and its records
+ * with how many samples came before each */
+#define CAP_MAXSAMP 65536
+#define CAP_MAXREC 256
+struct cap {
+  struct das_stream c_st;
+  uint32_t c_samp[CAP_MAXSAMP];
+  size_t c_nsamp;
+  struct {
+    uint32_t r_hdr;
+    uint32_t r_w[8];
+    size_t r_at;
+  } c_rec[CAP_MAXREC];
+  u_int c_nrec;
+};
+
+static int
+cap_samples(void *arg, const uint32_t *w, size_t n)
+{
+  struct cap *c = arg;
+
+  if (n > CAP_MAXSAMP - c->c_nsamp)
+    n = CAP_MAXSAMP - c->c_nsamp;
+  memcpy(c->c_samp + c->c_nsamp, w, n * sizeof(*w));
+  c->c_nsamp += n;
+  return 0;
+}
+
+static int
+cap_record(void *arg, uint32_t hdr, const uint32_t *w)
+{
+  struct cap *c = arg;
+  u_int len = DAS_REC_LEN(hdr);
+
+  if (c->c_nrec < CAP_MAXREC) {
+    c->c_rec[c->c_nrec].r_hdr = hdr;
+    memcpy(c->c_rec[c->c_nrec].r_w, w,
+	   (len < 8 ? len : 8) * sizeof(*w));
+    c->c_rec[c->c_nrec].r_at = c->c_nsamp;
+    c->c_nrec++;
+  }
+  return 0;
+}
+
+/* Reads until EOF; 0, or the error read returned */
+static int
+cap_read(struct cap *c)
+{
+  uint32_t buf[256];
+  ssize_t n;
+
+  while ((n = dread(buf, sizeof(buf))) > 0)
+    (void)das_stream_feed(&c->c_st, buf, n / sizeof(uint32_t),
+			  cap_samples, cap_record, c);
+  return n < 0 ? -n : 0;
+}
+
+static struct cap *
+cap_new(void)
+{
+  struct cap *c = calloc(1, sizeof(*c));
+
+  das_stream_init(&c->c_st);
+  return c;
+}
+
+static u_int
+cap_count(const struct cap *c, u_int type)
+{
+  u_int i, n = 0;
+
+  for (i = 0; i < c->c_nrec; i++)
+    n += DAS_REC_TYPE(c->c_rec[i].r_hdr) == type;
+  return n;
+}
+
+/* Index of the first record of the type, or -1 */
+static int
+cap_find(const struct cap *c, u_int type)
+{
+  u_int i;
+
+  for (i = 0; i < c->c_nrec; i++)
+    if (DAS_REC_TYPE(c->c_rec[i].r_hdr) == type)
+      return i;
+  return -1;
+}
+
+/* Samples [from, to) all read channel ch's level */
+static int
+cap_level(const struct cap *c, size_t from, size_t to, int ch)
+{
+  for (; from < to; from++)
+    if ((c->c_samp[from] & 0xfff) != level(ch))
+      return 0;
+  return 1;
+}
+
+static void
+config(struct das_config *dc, int rate, int ch, int fmt, int trig)
+{
+  memset(dc, 0, sizeof(*dc));
+  dc->dc_version = DAS_CONFIG_VERSION;
+  dc->dc_rate = rate;
+  dc->dc_nscan = 1;
+  dc->dc_scan[0] = ch;
+  dc->dc_format = fmt;
+  dc->dc_watermark = 1;
+  dc->dc_trigger = trig;
+}
+
+/* Holds the board's interrupt off at INTCSR, or lets it through again */
+static void
+mask(int on)
+{
+  static uint32_t intcsr;
+
+  dasshim_lock(sb);
+  if (on) {
+    intcsr = dasemu_read_4(&sb->sb_emu, DASEMU_BADR1, 0x4c);
+    dasemu_write_4(&sb->sb_emu, DASEMU_BADR1, 0x4c, 0);
+  } else
+    dasemu_write_4(&sb->sb_emu, DASEMU_BADR1, 0x4c, intcsr);
+  dasshim_unlock(sb);
+}
+
+/*
+ * A read-only open watches the device, idle or busy, and never keeps a
+ * writer out.  Everything that would change the acquisition is refused
+ * with EBADF, and what it reads is still there.
+ */
+static void
+t_monitor(void)
+{
+  static const struct {
+    u_long cmd;
+    const char *name;
+  } cmds[] = {
+    { DAS_START_SAMPLING, "START_SAMPLING" },
+    { DAS_START_COUNT, "START_COUNT" },
+    { DAS_STOP_SAMPLING, "STOP_SAMPLING" },
+    { DAS_SET_RATE, "SET_RATE" },
+    { DAS_SET_CHANNEL, "SET_CHANNEL" },
+    { DAS_CONFIGURE, "CONFIGURE" },
+    { DAS_QUEUE_CONFIG, "QUEUE_CONFIG" },
+    { DAS_FLUSH_CONFIG, "FLUSH_CONFIG" },
+    { DAS_SET_BURST, "SET_BURST" },
+    { DAS_RING_SETUP, "RING_SETUP" },
+    { DAS_SET_REFLEX, "SET_REFLEX" },
+  };
+  union {
+    int i;
+    struct das_config dc;
+    struct das_config_at ca;
+    struct das_burst db;
+    struct das_ring_setup rs;
+    struct das_reflex rx;
+  } u;
+  struct das_stats ds;
+  struct das_latency_hist lh;
+  char what[64];
+  uint32_t buf[64];
+  struct dasdrv_stats dv;
+  void *h, *w;
+  u_int i;
+  int ch, ok;
+
+  check("monitor open of an idle device", dopen(FREAD) == 0);
+  check("reads EOF", dread(buf, sizeof(buf)) == 0);
+  check("reads the counters", dioctl(DAS_GET_STATS, &ds, FREAD) == 0);
+  check("open, not kept out", dopen(RW) == 0);
+  check("monitor open of a busy device", dopen(FREAD) == 0);
+  check("second writer refused", dopen(RW) == EBUSY);
+  ok = 1;
+  for (i = 0; i < __arraycount(cmds); i++) {
+    memset(&u, 0, sizeof(u));
+    u.i = 1;
+    if (dioctl(cmds[i].cmd, &u, FREAD) != EBADF) {
+      snprintf(what, sizeof(what), "monitor %s", cmds[i].name);
+      check(what, 0);
+      ok = 0;
+    }
+  }
+  check("monitor state changes get EBADF", ok);
+  ch = 4;
+  check("writer sets the channel", dioctl(DAS_SET_CHANNEL, &ch, RW) == 0);
+  ch = -1;
+  check("monitor reads it back",
+	dioctl(DAS_GET_CHANNEL, &ch, FREAD) == 0 && ch == 4);
+  check("monitor reads the counters", dioctl(DAS_GET_STATS, &ds, FREAD) == 0);
+  check("writer starts", rate(825) == 0 &&
+	dioctl(DAS_START_SAMPLING, NULL, RW) == 0);
+  check("monitor cannot stop it",
+	dioctl(DAS_STOP_SAMPLING, NULL, FREAD) == EBADF);
+  check("still sampling", dread(buf, sizeof(buf)) > 0 &&
+	(buf[0] & 0xfff) == level(4));
+  check("writer stops", dioctl(DAS_STOP_SAMPLING, NULL, RW) == 0);
+  // dasstat -r: a monitor clears the histograms
+  check("histograms filled", dioctl(DAS_GET_LATENCY_HIST, &lh, FREAD) == 0 &&
+	lh.lh_latency.dh_n > 0);
+  check("monitor resets the histograms",
+	dioctl(DAS_RESET_LATENCY_HIST, NULL, FREAD) == 0 &&
+	dioctl(DAS_GET_LATENCY_HIST, &lh, FREAD) == 0 &&
+	lh.lh_latency.dh_n == 0 && lh.lh_jitter.dh_n == 0);
+  check("close", dclose() == 0);
+
+  // through dasdrv, where only the last close reaches d_close
+  check("read-only open of an idle device",
+	(*dasdrv_netbsd.dd_open)(0, O_RDONLY, &h) == 0);
+  ok = (*dasdrv_netbsd.dd_open)(0, O_RDWR, &w) == 0;
+  check("does not keep a writer out", ok);
+  if (!ok)
+    return;
+  check("writer starts", (*dasdrv_netbsd.dd_pacer)(w, 825) == 0 &&
+	(*dasdrv_netbsd.dd_start)(w) == 0);
+  msleep(20);
+  check("writer close", (*dasdrv_netbsd.dd_close)(w) == 0);
+  check("monitor still reads the counters",
+	(*dasdrv_netbsd.dd_stats)(h, &dv) == 0 && dv.dv_samples > 0);
+  check("and the samples left",
+	(*dasdrv_netbsd.dd_read)(h, buf, sizeof(buf)) == sizeof(buf));
+  check("no d_close yet: writer refused",
+	(*dasdrv_netbsd.dd_open)(0, O_RDWR, &w) == EBUSY);
+  check("monitor close", (*dasdrv_netbsd.dd_close)(h) == 0);
+  ok = (*dasdrv_netbsd.dd_open)(0, O_RDWR, &w) == 0;
+  check("the last close released it", ok);
+  if (ok)
+    check("writer close", (*dasdrv_netbsd.dd_close)(w) == 0);
+}
+
+struct load {
+  volatile int ld_done;
+  uint64_t ld_words;	/* read by the reader */
+  int ld_error;
+  int ld_backwards;	/* a counter went down between snapshots */
+  u_int ld_snaps;
+};
+
+/* Reads 64 at a time, and every 100 ms stalls for 40 so the ring fills */
+static void *
+load_reader(void *arg)
+{
+  struct load *ld = arg;
+  uint32_t buf[64];
+  u_int n = 0;
+  ssize_t len;
+
+  while ((len = dread(buf, sizeof(buf))) > 0) {
+    ld->ld_words += len / sizeof(uint32_t);
+    if (++n % 250 == 0)
+      msleep(40);
+  }
+  if (len < 0)
+    ld->ld_error = -len;
+  return NULL;
+}
+
+/* DAS_GET_STATS as fast as it will go; no counter may ever go down */
+static void *
+load_monitor(void *arg)
+{
+  struct load *ld = arg;
+  struct das_stats a, b;
+
+  stats(&a);
+  while (!ld->ld_done) {
+    stats(&b);
+    if (b.ds_intr < a.ds_intr || b.ds_samples < a.ds_samples ||
+	b.ds_read < a.ds_read || b.ds_overrun < a.ds_overrun ||
+	b.ds_spurious < a.ds_spurious || b.ds_eocspin < a.ds_eocspin ||
+	b.ds_wakeup < a.ds_wakeup || b.ds_maxfill < a.ds_maxfill)
+      ld->ld_backwards++;
+    ld->ld_snaps++;
+    a = b;
+  }
+  return NULL;
+}
+
+/*
+ * Counters under load: 40 kHz, a reader that falls behind now and
+ * then, and a monitor reading the counters all the while.  Once the
+ * board is quiet they must add up.
+ */
+static void
+t_counters(void)
+{
+  struct das_stats s0, s1;
+  struct load ld;
+  pthread_t rt, mt;
+  uint64_t c0, c1, intr;
+  uint32_t buf[256];
+  ssize_t n;
+
+  memset(&ld, 0, sizeof(ld));
+  check("open", dopen(RW) == 0);
+  stats(&s0);
+  c0 = claimed();
+  check("start at 40 kHz", rate(103) == 0 &&
+	dioctl(DAS_START_SAMPLING, NULL, RW) == 0);
+  pthread_create(&rt, NULL, load_reader, &ld);
+  pthread_create(&mt, NULL, load_monitor, &ld);
+  msleep(600);
+  (void)dioctl(DAS_STOP_SAMPLING, NULL, RW);
+  pthread_join(rt, NULL);
+  ld.ld_done = 1;
+  pthread_join(mt, NULL);
+  // what the reader left, then the board is quiet
+  while ((n = dread(buf, sizeof(buf))) > 0)
+    ld.ld_words += n / sizeof(uint32_t);
+  dasshim_barrier();
+  stats(&s1);
+  c1 = claimed();
+  intr = s1.ds_intr - s0.ds_intr;
+
+  check("reader saw no error", ld.ld_error == 0);
+  check("monitor took snapshots", ld.ld_snaps > 100);
+  check("no counter went backwards", ld.ld_backwards == 0);
+  check("the stall overran the ring", s1.ds_overrun > s0.ds_overrun);
+  check("intr = samples + overrun",
+	intr == (s1.ds_samples - s0.ds_samples) +
+	(s1.ds_overrun - s0.ds_overrun));
+  check("read = samples read", s1.ds_read - s0.ds_read == ld.ld_words);
+  check("samples all read, ring empty",
+	s1.ds_samples - s0.ds_samples == ld.ld_words && s1.ds_fill == 0);
+  check("high water within the ring",
+	s1.ds_maxfill > 0 && s1.ds_maxfill <= s1.ds_bufsize);
+  // after the stop a request still pending is quieted, not counted
+  check("every counted interrupt was claimed",
+	intr <= c1 - c0 && c1 - c0 - intr <= 2);
+  check("no spurious interrupts", s1.ds_spurious == s0.ds_spurious);
+  check("port counts moved", s1.ds_portreads > s0.ds_portreads &&
+	s1.ds_portwrites > s0.ds_portwrites && s1.ds_intr_io > 0);
+  check("close", dclose() == 0);
+  printf("%-40s %llu intr, %llu overrun, %u snapshots\n", "load",
+	 (unsigned long long)intr,
+	 (unsigned long long)(s1.ds_overrun - s0.ds_overrun), ld.ld_snaps);
+}
+
+/* DAS_SET_RATE and dc_rate take the same counts, 2 to 65535 */
+static void
+t_rate(void)
+{
+  static const int bad[] = { -1, 0, 1, 65536, INT32_MAX };
+  struct das_config dc;
+  u_int i;
+  int r, ok;
+
+  check("open", dopen(RW) == 0);
+  check("SET_RATE 825", rate(825) == 0);
+  ok = 1;
+  for (i = 0; i < __arraycount(bad); i++) {
+    config(&dc, bad[i], 0, 0, DAS_TRIG_NONE);
+    ok &= rate(bad[i]) == EINVAL;
+    ok &= dioctl(DAS_CONFIGURE, &dc, RW) == EINVAL;
+  }
+  check("bad counts refused by both", ok);
+  check("refused rate left the rate alone",
+	dioctl(DAS_GET_RATE, &r, FREAD) == 0 && r == 825);
+  check("2 and 65535 accepted", rate(2) == 0 && rate(65535) == 0);
+  config(&dc, 2, 0, 0, DAS_TRIG_NONE);
+  check("CONFIGURE takes 2", dioctl(DAS_CONFIGURE, &dc, RW) == 0 &&
+	dc.dc_rate == 2);
+  check("queued SET_RATE 1 refused", rate(825) == 0 &&
+	dioctl(DAS_START_SAMPLING, NULL, RW) == 0 && rate(1) == EINVAL);
+  (void)dioctl(DAS_STOP_SAMPLING, NULL, RW);
+  check("close", dclose() == 0);
+}
+
+/*
+ * DAS_CONFIGURE while sampling, with no interrupt coming to take the
+ * settings: das_configure installs them itself.  The stream gets a
+ * CONFIG record where they changed and keeps its one START.
+ */
+static void
+t_fallback(void)
+{
+  struct das_config dc;
+  struct cap *c = cap_new();
+  int i;
+
+  check("open", dopen(RW) == 0);
+  config(&dc, 825, 2, DAS_FMT_RECORDS, DAS_TRIG_START);
+  check("start on channel 2", dioctl(DAS_CONFIGURE, &dc, RW) == 0);
+  msleep(50);
+  mask(1);
+  config(&dc, 825, 5, DAS_FMT_RECORDS, DAS_TRIG_NONE);
+  check("configure channel 5 with no interrupt",
+	dioctl(DAS_CONFIGURE, &dc, RW) == 0 && dc.dc_scan[0] == 5 &&
+	dc.dc_trigger == DAS_TRIG_START);
+  mask(0);
+  msleep(50);
+  check("stop", dioctl(DAS_STOP_SAMPLING, NULL, RW) == 0);
+  check("read to EOF", cap_read(c) == 0);
+  check("one START", cap_count(c, DAS_REC_START) == 1);
+  check("one STOP", cap_count(c, DAS_REC_STOP) == 1);
+  check("one CONFIG", cap_count(c, DAS_REC_CONFIG) == 1);
+  i = cap_find(c, DAS_REC_CONFIG);
+  check("CONFIG between channels 2 and 5", i >= 0 &&
+	c->c_rec[i].r_at > 0 && c->c_rec[i].r_at < c->c_nsamp &&
+	// the first sample after the stall can be a conversion of either
+	cap_level(c, 0, c->c_rec[i].r_at, 2) &&
+	cap_level(c, c->c_rec[i].r_at + 1, c->c_nsamp, 5));
+  check("CONFIG numbers its first sample", i >= 0 &&
+	c->c_rec[i].r_w[0] == c->c_rec[i].r_at && c->c_rec[i].r_w[1] == 825);
+  check("close", dclose() == 0);
+  free(c);
+}
+
+/*
+ * DAS_START_COUNT takes exactly the count, then stops by itself: read
+ * returns that many samples and then EOF, and nothing is sampled after.
+ * The larger run is more than the ring holds, with the reader keeping up.
+ */
+static void
+t_count(void)
+{
+  static const int counts[] = { 1, 1000, 5000 };
+  struct das_config dc;
+  struct das_stats s0, s1;
+  struct cap *c;
+  char what[64];
+  u_int i;
+  int n, j, r;
+
+  check("open", dopen(RW) == 0);
+  n = 0;
+  check("count 0 refused", dioctl(DAS_START_COUNT, &n, RW) == EINVAL);
+  n = -1;
+  check("count -1 refused", dioctl(DAS_START_COUNT, &n, RW) == EINVAL);
+  for (i = 0; i < __arraycount(counts); i++) {
+    c = cap_new();
+    n = counts[i];
+    config(&dc, 103, 3, DAS_FMT_RECORDS, DAS_TRIG_NONE);
+    (void)dioctl(DAS_CONFIGURE, &dc, RW);
+    stats(&s0);
+    r = dioctl(DAS_START_COUNT, &n, RW);
+    if (n > 1) {
+      snprintf(what, sizeof(what), "count %d: second start busy", n);
+      check(what, dioctl(DAS_START_COUNT, &n, RW) == EBUSY);
+    }
+    snprintf(what, sizeof(what), "count %d: read to EOF", n);
+    check(what, r == 0 && cap_read(c) == 0);
+    snprintf(what, sizeof(what), "count %d: exactly %d samples", n, n);
+    check(what, c->c_nsamp == (size_t)n && cap_level(c, 0, n, 3));
+    j = cap_find(c, DAS_REC_STOP);
+    snprintf(what, sizeof(what), "count %d: STOP after the last", n);
+    check(what, j >= 0 && c->c_rec[j].r_at == (size_t)n &&
+	  DAS_REC_ARG(c->c_rec[j].r_hdr) == DAS_STOP_COUNT &&
+	  c->c_rec[j].r_w[0] - c->c_rec[cap_find(c, DAS_REC_START)].r_w[0] ==
+	  (uint32_t)n);
+    msleep(20);
+    stats(&s1);
+    snprintf(what, sizeof(what), "count %d: nothing after", n);
+    check(what, s1.ds_samples - s0.ds_samples == (uint64_t)n &&
+	  s1.ds_overrun == s0.ds_overrun && s1.ds_intr - s0.ds_intr ==
+	  (uint64_t)n && dread(&r, sizeof(r)) == 0);
+    free(c);
+  }
+  check("close", dclose() == 0);
+}
+
+struct bgread {
+  struct cap *br_cap;
+  volatile int br_done;
+  int br_error;
+};
+
+/* Reads in the background, through gaps where read says EOF, until told */
+static void *
+bg_read(void *arg)
+{
+  struct bgread *br = arg;
+  uint32_t buf[256];
+  ssize_t n;
+
+  for (;;) {
+    n = dread(buf, sizeof(buf));
+    if (n < 0) {
+      br->br_error = -n;
+      break;
+    }
+    if (n == 0) {
+      if (br->br_done)
+	break;
+      msleep(1);
+      continue;
+    }
+    (void)das_stream_feed(&br->br_cap->c_st, buf, n / sizeof(uint32_t),
+			  cap_samples, cap_record, br->br_cap);
+  }
+  return NULL;
+}
+
+/*
+ * Bursts under load: 100 samples at 5 kHz every 50 ms for 600 ms, with a
+ * reader that sleeps through the gaps and a monitor polling the counters
+ * and the burst log.  Every burst is whole, each START to its STOP, none
+ * is skipped, and the disarm leaves the board idle.
+ */
+static void
+t_burst(void)
+{
+  struct bgread br;
+  struct das_burst db;
+  struct das_burst_log bl;
+  struct das_stats s0, s1;
+  struct load ld;
+  pthread_t rt, mt;
+  struct cap *c = cap_new();
+  struct das_config dc;
+  u_int i, nstart, whole, ntrig;
+  size_t at;
+  int64_t gap, mingap, maxgap;
+
+  check("open", dopen(RW) == 0);
+  config(&dc, 825, 6, DAS_FMT_RECORDS, DAS_TRIG_NONE);
+  check("records at 5 kHz", dioctl(DAS_CONFIGURE, &dc, RW) == 0);
+  db.db_count = 100;
+  db.db_period_ms = 20;
+  db.db_phase_ms = 10;
+  check("burst longer than its period refused",
+	dioctl(DAS_SET_BURST, &db, RW) == EINVAL);
+  db.db_period_ms = 50;
+  db.db_phase_ms = INT32_MAX / hz + 1;
+  check("phase past INT_MAX / hz refused",
+	dioctl(DAS_SET_BURST, &db, RW) == EINVAL);
+  db.db_phase_ms = UINT32_MAX;
+  check("phase of UINT32_MAX refused",
+	dioctl(DAS_SET_BURST, &db, RW) == EINVAL);
+
+  memset(&br, 0, sizeof(br));
+  memset(&ld, 0, sizeof(ld));
+  br.br_cap = c;
+  stats(&s0);
+  db.db_phase_ms = 10;
+  check("arm", dioctl(DAS_SET_BURST, &db, RW) == 0);
+  check("START_SAMPLING busy while armed",
+	dioctl(DAS_START_SAMPLING, NULL, RW) == EBUSY);
+  pthread_create(&rt, NULL, bg_read, &br);
+  pthread_create(&mt, NULL, load_monitor, &ld);
+  msleep(600);
+  check("burst log while armed",
+	dioctl(DAS_GET_BURST_LOG, &bl, FREAD) == 0 && bl.bl_n > 0);
+  db.db_count = 0;
+  check("disarm", dioctl(DAS_SET_BURST, &db, RW) == 0);
+  msleep(20);
+  br.br_done = 1;
+  pthread_join(rt, NULL);
+  ld.ld_done = 1;
+  pthread_join(mt, NULL);
+  dasshim_barrier();
+  stats(&s1);
+
+  nstart = cap_count(c, DAS_REC_START);
+  ntrig = cap_count(c, DAS_REC_TRIGGER);
+  whole = 0;
+  for (i = 0; i < c->c_nrec; i++) {
+    if (DAS_REC_TYPE(c->c_rec[i].r_hdr) != DAS_REC_START)
+      continue;
+    at = c->c_rec[i].r_at;
+    for (i++; i < c->c_nrec; i++)
+      if (DAS_REC_TYPE(c->c_rec[i].r_hdr) == DAS_REC_STOP)
+	break;
+    if (i < c->c_nrec && c->c_rec[i].r_at - at == 100 &&
+	DAS_REC_ARG(c->c_rec[i].r_hdr) == DAS_STOP_COUNT &&
+	cap_level(c, at, at + 100, 6))
+      whole++;
+  }
+  check("reader saw no error", br.br_error == 0);
+  check("10 to 13 bursts in 600 ms", nstart >= 10 && nstart <= 13);
+  check("a TRIGGER for every burst", ntrig == nstart);
+  check("every burst whole", whole == nstart);
+  check("samples = 100 a burst", c->c_nsamp == 100 * nstart &&
+	s1.ds_samples - s0.ds_samples == c->c_nsamp);
+  check("no overrun", s1.ds_overrun == s0.ds_overrun);
+  check("no counter went backwards", ld.ld_backwards == 0);
+  mingap = INT64_MAX;
+  maxgap = 0;
+  for (i = 1; i < bl.bl_n && i < DAS_BURST_NLOG; i++) {
+    gap = (bl.bl_tag[i].bt_sec - bl.bl_tag[i - 1].bt_sec) * 1000000000LL +
+	bl.bl_tag[i].bt_nsec - bl.bl_tag[i - 1].bt_nsec;
+    mingap = gap < mingap ? gap : mingap;
+    maxgap = gap > maxgap ? gap : maxgap;
+  }
+  check("burst log: none skipped", bl.bl_skipped == 0);
+  check("burst log: starts 50 ms apart",
+	bl.bl_n > 1 && mingap > 45000000 && maxgap < 60000000);
+  msleep(30);
+  stats(&s0);
+  check("idle after the disarm", s0.ds_intr == s1.ds_intr);
+  check("close", dclose() == 0);
+  printf("%-40s %u bursts, gaps %.1f-%.1f ms\n", "burst", nstart,
+	 mingap / 1e6, maxgap / 1e6);
+  free(c);
+}
+
+static int
+queue(u_int when, u_int arg, u_int tag, int rate, int ch)
+{
+  struct das_config_at ca;
+
+  memset(&ca, 0, sizeof(ca));
+  ca.ca_when = when;
+  ca.ca_arg = arg;
+  ca.ca_tag = tag;
+  config(&ca.ca_cfg, rate, ch, DAS_FMT_RECORDS, DAS_TRIG_NONE);
+  return dioctl(DAS_QUEUE_CONFIG, &ca, RW);
+}
+
+/*
+ * The configuration queue while sampling at 5 kHz: changes at a sample
+ * number, at a block boundary and at the next sample each land exactly
+ * there with their CONFIG record, in order.  A full queue says EAGAIN,
+ * and entries flushed, once or 200 times over, never take effect.
+ */
+static void
+t_queue(void)
+{
+  static const struct {
+    u_int tag, at;
+    int ch, rate;
+  } want[] = {
+    { 11, 1000, 1, 825 }, { 12, 1024, 2, 825 }, { 13, 1500, 3, 413 },
+    { 14, 0, 4, 413 },
+  };
+  struct das_config_at ca;
+  struct das_config dc;
+  struct bgread br;
+  struct cap *c = cap_new();
+  pthread_t rt;
+  u_int i, j, n, first;
+  int ok;
+
+  check("open", dopen(RW) == 0);
+  memset(&ca, 0, sizeof(ca));
+  config(&ca.ca_cfg, 825, 1, DAS_FMT_RECORDS, DAS_TRIG_NONE);
+  ca.ca_cfg.dc_bufsize = 4096;
+  check("ring size change refused",
+	dioctl(DAS_QUEUE_CONFIG, &ca, RW) == EINVAL);
+  ca.ca_cfg.dc_bufsize = 0;
+  ca.ca_tag = 0x10000;
+  check("tag over 16 bits refused",
+	dioctl(DAS_QUEUE_CONFIG, &ca, RW) == EINVAL);
+  check("block of 0 refused", queue(DAS_AT_BLOCK, 0, 1, 825, 1) == EINVAL);
+  check("flush while idle", queue(DAS_AT_SEQ, 10, 99, 825, 7) == 0 &&
+	dioctl(DAS_FLUSH_CONFIG, NULL, RW) == 0);
+
+  memset(&br, 0, sizeof(br));
+  br.br_cap = c;
+  config(&dc, 825, 0, DAS_FMT_RECORDS, DAS_TRIG_START);
+  check("start on channel 0", dioctl(DAS_CONFIGURE, &dc, RW) == 0);
+  pthread_create(&rt, NULL, bg_read, &br);
+  check("queue at 1000, block 256, 1500",
+	queue(DAS_AT_SEQ, 1000, 11, 825, 1) == 0 &&
+	queue(DAS_AT_BLOCK, 256, 12, 825, 2) == 0 &&
+	queue(DAS_AT_SEQ, 1500, 13, 413, 3) == 0);
+  msleep(450);
+
+  ok = 1;
+  for (i = 0; i < DAS_CQ_SIZE; i++)
+    ok &= queue(DAS_AT_SEQ, 1U << 30, 99, 825, 7) == 0;
+  check("16 queued", ok);
+  check("17th is EAGAIN", queue(DAS_AT_SEQ, 1U << 30, 99, 825, 7) == EAGAIN);
+  check("flush while sampling", dioctl(DAS_FLUSH_CONFIG, NULL, RW) == 0);
+  for (n = 0; n < 200; n++) {
+    for (i = 0; i < 4; i++)
+      (void)queue(DAS_AT_SEQ, 1U << 30, 99, 413, 7);
+    (void)dioctl(DAS_FLUSH_CONFIG, NULL, RW);
+  }
+  // a flush is taken at the next interrupt
+  msleep(5);
+  check("queue next after the flushes",
+	queue(DAS_AT_NEXT, 0, 14, 413, 4) == 0);
+  msleep(50);
+  check("stop", dioctl(DAS_STOP_SAMPLING, NULL, RW) == 0);
+  br.br_done = 1;
+  pthread_join(rt, NULL);
+
+  check("read to EOF", br.br_error == 0);
+  check("4 CONFIGs", cap_count(c, DAS_REC_CONFIG) == 4);
+  first = c->c_rec[cap_find(c, DAS_REC_START)].r_w[0];
+  ok = 1;
+  for (i = 0, j = 0; i < c->c_nrec && j < __arraycount(want); i++) {
+    if (DAS_REC_TYPE(c->c_rec[i].r_hdr) != DAS_REC_CONFIG)
+      continue;
+    ok &= DAS_REC_ARG(c->c_rec[i].r_hdr) == want[j].tag &&
+	c->c_rec[i].r_w[1] == (uint32_t)want[j].rate &&
+	c->c_rec[i].r_at == c->c_rec[i].r_w[0] - first &&
+	(want[j].at == 0 || c->c_rec[i].r_w[0] == want[j].at);
+    // every sample up to the next change is on this one's channel
+    for (n = i + 1; n < c->c_nrec &&
+	   DAS_REC_TYPE(c->c_rec[n].r_hdr) != DAS_REC_CONFIG; n++)
+      ;
+    ok &= cap_level(c, c->c_rec[i].r_at,
+		    n < c->c_nrec ? c->c_rec[n].r_at : c->c_nsamp, want[j].ch);
+    j++;
+  }
+  check("each at its sample, in order", ok && j == __arraycount(want));
+  check("channel 0 before the first",
+	cap_level(c, 0, want[0].at - first, 0));
+  ok = 1;
+  for (i = 0; i < c->c_nsamp; i++)
+    ok &= (c->c_samp[i] & 0xfff) != level(7);
+  check("nothing flushed took effect", ok);
+  check("close", dclose() == 0);
+  free(c);
+}
+
+/* Sets the board's digital inputs IP1-IP3 */
+static void
+dio(int v)
+{
+  dasshim_lock(sb);
+  sb->sb_emu.de_dio = v;
+  dasshim_unlock(sb);
+}
+
+/*
+ * Each DAS_FMT_* on a scan of channels 1 and 5, decoded from the record
+ * stream: bits 12-14 are 0, the channel, or the digital inputs, and the
+ * 12 bit code is always the channel's level.
+ */
+static void
+t_formats(void)
+{
+  static const struct {
+    int fmt;
+    const char *name;
+  } fmts[] = {
+    { 0, "plain" },
+    { DAS_FMT_CHAN, "DAS_FMT_CHAN" },
+    { DAS_FMT_DIO, "DAS_FMT_DIO" },
+  };
+  struct das_config dc;
+  struct cap *c;
+  char what[64];
+  u_int i, j, ch;
+  int ok, count = 200;
+
+  check("open", dopen(RW) == 0);
+  config(&dc, 825, 1, DAS_FMT_CHAN | DAS_FMT_DIO, DAS_TRIG_NONE);
+  check("CHAN with DIO refused", dioctl(DAS_CONFIGURE, &dc, RW) == EINVAL);
+  config(&dc, 825, 1, DAS_FMT_DIOREC, DAS_TRIG_NONE);
+  check("DIOREC without RECORDS refused",
+	dioctl(DAS_CONFIGURE, &dc, RW) == EINVAL);
+  dc.dc_format = DAS_FMT_MASK + 1;
+  check("unknown format bit refused",
+	dioctl(DAS_CONFIGURE, &dc, RW) == EINVAL);
+  dio(5);
+  for (i = 0; i < __arraycount(fmts); i++) {
+    c = cap_new();
+    config(&dc, 825, 1, fmts[i].fmt | DAS_FMT_RECORDS, DAS_TRIG_NONE);
+    dc.dc_nscan = 2;
+    dc.dc_scan[1] = 5;
+    ok = dioctl(DAS_CONFIGURE, &dc, RW) == 0 &&
+	dioctl(DAS_START_COUNT, &count, RW) == 0 && cap_read(c) == 0 &&
+	c->c_nsamp == (size_t)count;
+    for (j = 0; ok && j < c->c_nsamp; j++) {
+      ch = j % 2 ? 5 : 1;
+      ok = (c->c_samp[j] & 0xfff) == level(ch) &&
+	  (c->c_samp[j] & DAS_REC_FLAG) == 0;
+      if (fmts[i].fmt == DAS_FMT_CHAN)
+	ok &= ((c->c_samp[j] >> 12) & 0x7) == ch;
+      else if (fmts[i].fmt == DAS_FMT_DIO)
+	ok &= DAS_SAMPLE_DIO(c->c_samp[j]) == 5;
+      else
+	ok &= (c->c_samp[j] & 0x7000) == 0;
+    }
+    snprintf(what, sizeof(what), "%s decodes", fmts[i].name);
+    check(what, ok);
+    free(c);
+  }
+  dio(0);
+  check("close", dclose() == 0);
+}
+
+/*
+ * Digital inputs stepping through 0-7 every 20 ms while channel 2 samples
+ * at 5 kHz with DAS_FMT_DIO and DAS_FMT_DIOREC: one DAS_REC_DIO at the
+ * start and one per change, in order, and every sample's bits are those
+ * of the last record at or before its sample number, so the record marks
+ * the first sample taken with the new inputs.  Without DAS_FMT_DIO the
+ * records still come and the samples carry nothing.
+ */
+static void
+t_dio(void)
+{
+  static const int fmts[] = { DAS_FMT_DIO, 0 };
+  static const uint8_t steps[] = { 0, 3, 6, 1, 7, 4, 2, 5 };
+  struct das_config dc;
+  struct bgread br;
+  struct cap *c;
+  pthread_t rt;
+  char what[64];
+  uint32_t first, at;
+  u_int f, i, j, n;
+  int ok, cur;
+
+  check("open", dopen(RW) == 0);
+  for (f = 0; f < __arraycount(fmts); f++) {
+    c = cap_new();
+    memset(&br, 0, sizeof(br));
+    br.br_cap = c;
+    dio(steps[0]);
+    config(&dc, 825, 2, fmts[f] | DAS_FMT_DIOREC | DAS_FMT_RECORDS,
+	   DAS_TRIG_START);
+    ok = dioctl(DAS_CONFIGURE, &dc, RW) == 0;
+    pthread_create(&rt, NULL, bg_read, &br);
+    for (i = 1; i < __arraycount(steps); i++) {
+      msleep(20);
+      dio(steps[i]);
+    }
+    msleep(20);
+    ok &= dioctl(DAS_STOP_SAMPLING, NULL, RW) == 0;
+    br.br_done = 1;
+    pthread_join(rt, NULL);
+    snprintf(what, sizeof(what), "%s: sampled and read",
+	     fmts[f] ? "DIO" : "plain");
+    check(what, ok && br.br_error == 0 && c->c_nsamp > 500);
+
+    // the records: one per step, in order, each at a later sample
+    first = c->c_rec[cap_find(c, DAS_REC_START)].r_w[0];
+    ok = cap_count(c, DAS_REC_DIO) == __arraycount(steps);
+    for (i = 0, j = 0, at = 0; ok && i < c->c_nrec; i++) {
+      if (DAS_REC_TYPE(c->c_rec[i].r_hdr) != DAS_REC_DIO)
+	continue;
+      ok = DAS_REC_ARG(c->c_rec[i].r_hdr) == steps[j] &&
+	  (j == 0 ? c->c_rec[i].r_w[0] == first : c->c_rec[i].r_w[0] > at);
+      at = c->c_rec[i].r_w[0];
+      j++;
+    }
+    snprintf(what, sizeof(what), "%s: a DAS_REC_DIO per change",
+	     fmts[f] ? "DIO" : "plain");
+    check(what, ok);
+
+    // the samples: each has the bits of the record before it
+    ok = 1;
+    for (n = 0, i = 0, cur = -1; ok && n < c->c_nsamp; n++) {
+      for (; i < c->c_nrec; i++) {
+	if (DAS_REC_TYPE(c->c_rec[i].r_hdr) != DAS_REC_DIO)
+	  continue;
+	if (c->c_rec[i].r_w[0] - first > n)
+	  break;
+	cur = DAS_REC_ARG(c->c_rec[i].r_hdr);
+      }
+      ok = cur >= 0 && (c->c_samp[n] & 0xfff) == (uint32_t)level(2) &&
+	  (fmts[f] ? DAS_SAMPLE_DIO(c->c_samp[n]) == (uint32_t)cur :
+	   (c->c_samp[n] & 0x7000) == 0);
+    }
+    snprintf(what, sizeof(what), "%s: samples agree with the records",
+	     fmts[f] ? "DIO" : "plain");
+    check(what, ok);
+    free(c);
+  }
+  dio(0);
+  check("close", dclose() == 0);
+}
+
+/* Sets the frequency of the input counter n counts */
+static void
+input_hz(int n, double hz)
+{
+  dasshim_lock(sb);
+  dasemu_set_input_hz(&sb->sb_emu, n, hz);
+  dasshim_unlock(sb);
+}
+
+/*
+ * The frequency counter on each user counter, with the emulator's
+ * inputs at set rates: idle, then with das_intr latching counter 2 at
+ * 20 kHz throughout, when the gates' latches have to take turns with
+ * the interrupt's.  Each gate's edges are what the input made in the
+ * gate's length, and sampling takes no harm from the gates.  3 MHz in
+ * 20 ms is 60000 edges, near the 65535 a gate can tell apart.
+ */
+static void
+t_freq(void)
+{
+  static const struct {
+    u_int ctr, gate;
+    double hz;
+  } pts[] = {
+    { 0, 50, 12345.0 }, { 1, 20, 250000.0 }, { 0, 20, 3.0e6 },
+    { 1, 100, 1000.0 },
+  };
+  struct das_freq_val fv;
+  struct das_freq df;
+  struct das_stats s0, s1;
+  struct bgread br;
+  struct cap *c;
+  pthread_t rt;
+  char what[64];
+  u_int i, load;
+  double want, got;
+  int ok;
+
+  check("open", dopen(RW) == 0);
+  df.df_counter = 2;
+  df.df_gate_ms = 10;
+  check("counter 2 refused", dioctl(DAS_SET_FREQ, &df, RW) == EINVAL);
+  df.df_counter = 0;
+  check("read-only open refused",
+	dioctl(DAS_SET_FREQ, &df, FREAD) == EBADF);
+  for (load = 0; load < 2; load++) {
+    c = cap_new();
+    memset(&br, 0, sizeof(br));
+    br.br_cap = c;
+    if (load) {
+      stats(&s0);
+      check("sample at 20 kHz", rate(206) == 0 &&
+	    dioctl(DAS_START_SAMPLING, NULL, RW) == 0);
+      pthread_create(&rt, NULL, bg_read, &br);
+    }
+    for (i = 0; i < __arraycount(pts); i++) {
+      input_hz(pts[i].ctr, pts[i].hz);
+      df.df_counter = pts[i].ctr;
+      df.df_gate_ms = pts[i].gate;
+      ok = dioctl(DAS_SET_FREQ, &df, RW) == 0;
+      // a gate to prime, one to throw away, then one to measure
+      msleep(pts[i].gate * 3 + 5);
+      memset(&fv, 0, sizeof(fv));
+      ok &= dioctl(DAS_GET_FREQ, &fv, FREAD) == 0;
+      want = pts[i].hz * fv.fv_ns / 1e9;
+      got = fv.fv_events;
+      ok &= fv.fv_seq >= 1 && fv.fv_counter == pts[i].ctr &&
+	  fv.fv_ns >= pts[i].gate * 1000000ULL * 9 / 10 &&
+	  got > want * 0.98 - 2 && got < want * 1.02 + 2 &&
+	  fv.fv_mhz == fv.fv_events * 1000000000000ULL / fv.fv_ns;
+      snprintf(what, sizeof(what), "%s: counter %u at %.0f Hz",
+	       load ? "sampling" : "idle", pts[i].ctr, pts[i].hz);
+      check(what, ok);
+    }
+    df.df_gate_ms = 0;
+    check("gate off", dioctl(DAS_SET_FREQ, &df, RW) == 0);
+    if (load) {
+      check("stop", dioctl(DAS_STOP_SAMPLING, NULL, RW) == 0);
+      br.br_done = 1;
+      pthread_join(rt, NULL);
+      stats(&s1);
+      check("sampling unharmed", br.br_error == 0 &&
+	    s1.ds_overrun == s0.ds_overrun && c->c_nsamp > 2000 &&
+	    cap_level(c, 0, c->c_nsamp, DAS_DEFAULT_CHANNEL));
+    }
+    free(c);
+  }
+  check("close", dclose() == 0);
+}
+
+/* The latest page, read through the page in a loop while sampling */
+struct lwatch {
+  const struct das_latest *lw_page;
+  volatile int lw_done;
+  u_long lw_reads;
+  u_long lw_moved;	/* reads that found a newer entry */
+  int lw_bad;
+};
+
+static void *
+lwatch(void *arg)
+{
+  struct lwatch *lw = arg;
+  struct das_latest_val dv;
+  uint32_t last[DAS_NCHAN], seq[DAS_NCHAN];
+  u_int ch;
+  int seen[DAS_NCHAN];
+
+  // sample numbers start again at open, the sequence does not
+  for (ch = 0; ch < DAS_NCHAN; ch++) {
+    das_latest_read(lw->lw_page, ch, &dv);
+    seq[ch] = dv.dv_seq;
+    seen[ch] = 0;
+  }
+  while (!lw->lw_done) {
+    for (ch = 1; ch <= 5; ch += 4) {
+      das_latest_read(lw->lw_page, ch, &dv);
+      lw->lw_reads++;
+      if (dv.dv_seq == seq[ch])
+	continue;
+      if (dv.dv_seq < seq[ch] || (seen[ch] && dv.dv_nsamp <= last[ch]) ||
+	  (int)(dv.dv_sample & 0xfff) != level(ch))
+	lw->lw_bad++;
+      lw->lw_moved++;
+      last[ch] = dv.dv_nsamp;
+      seen[ch] = 1;
+      seq[ch] = dv.dv_seq;
+    }
+    if (lw->lw_reads % 64 == 0)
+      sched_yield();
+  }
+  return NULL;
+}
+
+/*
+ * The latest value of each channel, mapped at DAS_LATEST_OFFSET and
+ * through DAS_GET_LATEST, over a counted scan of channels 1 and 5
+ * while a thread reads the page: each channel's entry has its level
+ * and moves forward, the two agree, and each conversion wrote its
+ * channel's entry once.
+ */
+static void
+t_latest(void)
+{
+  struct das_latest_snap s0, s1;
+  struct das_latest_val dv;
+  struct das_config dc;
+  struct lwatch lw;
+  struct cap *c = cap_new();
+  pthread_t wt;
+  paddr_t pg;
+  u_int ch;
+  int ok, count = 4000;
+
+  check("open", dopen(RW) == 0);
+  check("page write refused", (*das_cdevsw.d_mmap)(0, DAS_LATEST_OFFSET,
+      VM_PROT_READ | VM_PROT_WRITE) == (paddr_t)-1);
+  check("past the page refused", (*das_cdevsw.d_mmap)(0,
+      DAS_LATEST_OFFSET + PAGE_SIZE, VM_PROT_READ) == (paddr_t)-1);
+  pg = (*das_cdevsw.d_mmap)(0, DAS_LATEST_OFFSET, VM_PROT_READ);
+  check("page maps", pg != (paddr_t)-1);
+  if (pg == (paddr_t)-1) {
+    (void)dclose();
+    free(c);
+    return;
+  }
+  // the shim's pmap_extract is the identity, so the page is at pg
+  memset(&lw, 0, sizeof(lw));
+  lw.lw_page = (const struct das_latest *)(uintptr_t)(pg * PAGE_SIZE);
+  check("page version", lw.lw_page->dl_version == DAS_LATEST_VERSION);
+  check("GET_LATEST", dioctl(DAS_GET_LATEST, &s0, FREAD) == 0);
+
+  pthread_create(&wt, NULL, lwatch, &lw);
+  config(&dc, 413, 1, DAS_FMT_RECORDS, DAS_TRIG_NONE);
+  dc.dc_nscan = 2;
+  dc.dc_scan[1] = 5;
+  check("count on channels 1 and 5", dioctl(DAS_CONFIGURE, &dc, RW) == 0 &&
+	dioctl(DAS_START_COUNT, &count, RW) == 0);
+  ok = cap_read(c) == 0 && c->c_nsamp == (size_t)count;
+  lw.lw_done = 1;
+  pthread_join(wt, NULL);
+  check("read to EOF", ok);
+  check("page moved while sampling", lw.lw_moved > 0);
+  check("page always level, forward", lw.lw_bad == 0);
+
+  check("GET_LATEST after", dioctl(DAS_GET_LATEST, &s1, FREAD) == 0);
+  ok = 1;
+  for (ch = 0; ch < DAS_NCHAN; ch++) {
+    das_latest_read(lw.lw_page, ch, &dv);
+    ok &= memcmp(&dv, &s1.ls_chan[ch], sizeof(dv)) == 0;
+  }
+  check("page and ioctl agree", ok);
+  check("one write per conversion",
+	s1.ls_chan[1].dv_seq - s0.ls_chan[1].dv_seq == (uint32_t)count / 2 &&
+	s1.ls_chan[5].dv_seq - s0.ls_chan[5].dv_seq == (uint32_t)count / 2);
+  check("others untouched",
+	s1.ls_chan[0].dv_seq == s0.ls_chan[0].dv_seq &&
+	s1.ls_chan[4].dv_seq == s0.ls_chan[4].dv_seq);
+  check("last of the scan",
+	s1.ls_chan[5].dv_nsamp == s1.ls_chan[1].dv_nsamp + 1 &&
+	(int)(s1.ls_chan[5].dv_sample & 0xfff) == level(5) &&
+	(int)(s1.ls_chan[1].dv_sample & 0xfff) == level(1));
+  check("close", dclose() == 0);
+  free(c);
+}
+
+/* OP3 on the emulated port, which carries the CTR1 shadow as written */
+static int
+op3(void)
+{
+  return (sb->sb_emu.de_ctr1 & 0x40) != 0;
+}
+
+/*
+ * A tripped reflex output across what rewrites CTR1: stop and start,
+ * a burst's on and off phases, close and open.  The rule stays tripped
+ * the whole time, so nothing would set the output again if one of them
+ * dropped it.
+ */
+static void
+t_outputs(void)
+{
+  struct das_reflex rx;
+  struct das_reflex_stats rs;
+  struct das_burst db;
+  int ch = 2, reg;
+
+  check("open", dopen(RW) == 0);
+  memset(&rx, 0, sizeof(rx));
+  rx.rx_nrules = 1;
+  rx.rx_rule[0].rr_chan = 2;
+  rx.rx_rule[0].rr_out = 3;
+  rx.rx_rule[0].rr_trip = level(2) - 100;
+  rx.rx_rule[0].rr_release = level(2) - 200;
+  check("rule on OP3", dioctl(DAS_SET_REFLEX, &rx, RW) == 0);
+  check("channel 2", dioctl(DAS_SET_CHANNEL, &ch, RW) == 0);
+  check("start", rate(825) == 0 &&
+	dioctl(DAS_START_SAMPLING, NULL, RW) == 0);
+  msleep(20);
+  check("stop", dioctl(DAS_STOP_SAMPLING, NULL, RW) == 0);
+  check("tripped and OP3 set",
+	dioctl(DAS_GET_REFLEX_STATS, &rs, FREAD) == 0 &&
+	rs.rs_tripped == 1 && rs.rs_fired[0] == 1 && op3());
+  check("start again", dioctl(DAS_START_SAMPLING, NULL, RW) == 0);
+  check("start keeps OP3", op3());
+  msleep(20);
+  check("stop keeps OP3",
+	dioctl(DAS_STOP_SAMPLING, NULL, RW) == 0 && op3());
+
+  db.db_count = 50;
+  db.db_period_ms = 30;
+  db.db_phase_ms = 5;
+  check("arm a burst", dioctl(DAS_SET_BURST, &db, RW) == 0);
+  msleep(100);
+  check("bursts keep OP3", op3());
+  db.db_count = 0;
+  check("disarm", dioctl(DAS_SET_BURST, &db, RW) == 0 && op3());
+
+  check("close", dclose() == 0);
+  check("close keeps OP3", op3());
+  check("open", dopen(RW) == 0);
+  check("open keeps OP3", op3());
+  check("still the one firing",
+	dioctl(DAS_GET_REFLEX_STATS, &rs, FREAD) == 0 &&
+	rs.rs_tripped == 1 && rs.rs_fired[0] == 1);
+
+  // rules off leave the output as it is; clear it for the tests after
+  rx.rx_nrules = 0;
+  check("rules off", dioctl(DAS_SET_REFLEX, &rx, RW) == 0 && op3());
+  reg = CTR1 << 16 | DAS_CTR1_INTE | ch;
+  check("OP3 cleared", dioctl(DAS_SET_REGISTER, &reg, RW) == 0 && !op3());
+  check("close", dclose() == 0);
+}
+
+static const struct {
+  const char *t_name;
+  void (*t_fn)(void);
+} tests[] = {
+  { "monitor", t_monitor },
+  { "counters", t_counters },
+  { "rate", t_rate },
+  { "fallback", t_fallback },
+  { "count", t_count },
+  { "burst", t_burst },
+  { "queue", t_queue },
+  { "formats", t_formats },
+  { "dio", t_dio },
+  { "freq", t_freq },
+  { "latest", t_latest },
+  { "outputs", t_outputs },
+};
+
+int
+main(int argc, char **argv)
+{
+  struct dasemu_wave dw;
+  u_int i;
+  int a, run;
+
+  for (a = 1; a < argc; a++) {
+    for (i = 0; i < __arraycount(tests); i++)
+      if (strcmp(argv[a], tests[i].t_name) == 0)
+	break;
+    if (i == __arraycount(tests)) {
+      fprintf(stderr, "das: no test %s\n", argv[a]);
+      return 1;
+    }
+  }
+  sb = dasshim_board_add();
+  memset(&dw, 0, sizeof(dw));
+  dw.dw_type = DASEMU_WAVE_DC;
+  for (i = 0; i < DASEMU_NCHAN; i++) {
+    dw.dw_offset = level(i);
+    dasemu_set_wave(&sb->sb_emu, i, &dw);
+  }
+  if ((*dasdrv_netbsd.dd_attach)(sb) != 0) {
+    fprintf(stderr, "das: attach failed\n");
+    return 1;
+  }
+  dasshim_start();
+  for (i = 0; i < __arraycount(tests); i++) {
+    for (run = argc == 1, a = 1; a < argc; a++)
+      run |= strcmp(argv[a], tests[i].t_name) == 0;
+    if (!run)
+      continue;
+    printf("-- %s\n", tests[i].t_name);
+    (*tests[i].t_fn)();
+  }
+  dasshim_stop();
+  return failed != 0;
+}
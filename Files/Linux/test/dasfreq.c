@@ -0,0 +1,93 @@
+/* dasfreq -- dasfreq.h against a simulated 8254 counter
+ *
+ * usage: dasfreq
+ *
+ * The counter is what das_set_freq programs: mode 2 with a reload of 0,
+ * counting down modulo 2^16 on every input edge.  Gates latch it at
+ * times that drift and jitter the way a callout does, and the edges
+ * each reports, added up, have to be every edge the input made, through
+ * as many wraps of the counter as it takes.  The arithmetic is checked
+ * at its edges too: the first gate, no edges, a zero length gate and the
+ * largest count a gate can tell from none.
+ */
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dasio.h"
+#include "dasfreq.h"
+#include "check.h"
+
+/* The counter after edges edges from a load of 0 */
+static uint16_t
+ctr(uint64_t edges)
+{
+  return (uint16_t)(0x10000 - edges % 0x10000);
+}
+
+int
+main(void)
+{
+  struct das_freq_gate fg;
+  struct das_freq_val fv;
+  uint64_t ns, edges, sum, t;
+  uint32_t seq;
+  int ok, i;
+
+  memset(&fv, 0, sizeof(fv));
+  check("delta without a wrap", das_freq_delta(1000, 400) == 600);
+  check("delta across the wrap", das_freq_delta(5, 65530) == 11);
+  check("delta of 65535", das_freq_delta(0, 1) == 65535);
+  check("no edges: period 0", das_freq_period_ns(0, 1000) == 0);
+  check("no time: 0 mHz", das_freq_mhz(10, 0) == 0);
+  check("1 kHz for 1 s is 1000000 mHz",
+	das_freq_mhz(1000, 1000000000ULL) == 1000000 &&
+	das_freq_period_ns(1000, 1000000000ULL) == 1000000);
+  check("65535 edges in 1 ns does not overflow",
+	das_freq_mhz(65535, 1) == 65535ULL * 1000000000000ULL);
+
+  das_freq_start(&fg);
+  check("first gate only primes",
+	das_freq_gate(&fg, ctr(0), 1000, &fv) == 0 && fv.fv_seq == 0);
+  check("second gate measures",
+	das_freq_gate(&fg, ctr(500), 1000 + 50000000, &fv) == 1 &&
+	fv.fv_seq == 1 && fv.fv_events == 500 && fv.fv_ns == 50000000 &&
+	fv.fv_mhz == 10000000 && fv.fv_period_ns == 100000);
+  check("a late gate keeps the rate",
+	das_freq_gate(&fg, ctr(500 + 700), 1000 + 120000000, &fv) == 1 &&
+	fv.fv_ns == 70000000 && fv.fv_mhz == 10000000);
+  check("no edges", das_freq_gate(&fg, ctr(1200), 1000 + 130000000, &fv) &&
+	fv.fv_events == 0 && fv.fv_mhz == 0 && fv.fv_period_ns == 0);
+  check("65535 edges in a gate",
+	das_freq_gate(&fg, ctr(1200 + 65535), 1000 + 140000000, &fv) &&
+	fv.fv_events == 65535);
+  check("65536 look like none, as documented",
+	das_freq_gate(&fg, ctr(1200 + 65535 + 65536), 1000 + 150000000,
+		      &fv) && fv.fv_events == 0 && fv.fv_seq == 5);
+  das_freq_start(&fg);
+  seq = fv.fv_seq;
+  check("start primes again",
+	das_freq_gate(&fg, ctr(7), 5, &fv) == 0 && fv.fv_seq == seq);
+
+  // 2.5 MHz for 2000 gates of about 20 ms: 50000 edges a gate, so the
+  // counter wraps on most of them
+  das_freq_start(&fg);
+  srandom(40);
+  t = 12345;
+  edges = 0;
+  sum = 0;
+  ok = 1;
+  (void)das_freq_gate(&fg, ctr(0), t, &fv);
+  for (i = 0; i < 2000; i++) {
+    ns = 20000000 + (random() % 400000) - 100000;
+    t += ns;
+    edges = t * 25 / 10000 - 12345 * 25 / 10000;
+    ok &= das_freq_gate(&fg, ctr(edges), t, &fv) == 1 && fv.fv_ns == ns;
+    sum += fv.fv_events;
+    ok &= fv.fv_mhz > 2499000000ULL && fv.fv_mhz < 2501000000ULL;
+  }
+  check("2000 jittered gates at 2.5 MHz", ok);
+  check("every edge counted once", sum == edges);
+  return failed != 0;
+}
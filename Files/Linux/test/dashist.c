@@ -0,0 +1,108 @@
+/* dashist -- dashist.h buckets, updates and absdiff
+ *
+ * usage: dashist
+ *
+ * Every 16 bit value is put in its bucket and checked against the
+ * bucket's bounds, the edges of each bucket are checked by name, and
+ * the top bucket is checked to take everything up to UINT16_MAX: there
+ * is no value past it.  Then das_hist_add and das_hist_clear are checked
+ * on a known set of values, and das_hist_absdiff on every pair that
+ * straddles the edges of the range.
+ */
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dev/pci/dasio.h>
+#include <dev/pci/dashist.h>
+#include "check.h"
+
+/* Largest value in bucket b */
+static uint32_t
+hi(u_int b)
+{
+  return b == DAS_HIST_NBUCKETS - 1 ? UINT16_MAX : das_hist_bucket_lo(b + 1) - 1;
+}
+
+int
+main(void)
+{
+  static const uint16_t edge[] = { 0, 1, 2, 3, 255, 256, 32767, 32768,
+				   65534, 65535 };
+  struct das_hist h;
+  uint64_t sum;
+  uint32_t v, n;
+  char what[64];
+  u_int b, i, j;
+  int ok;
+
+  check("bucket 0 holds 0 and 1",
+	das_hist_bucket(0) == 0 && das_hist_bucket(1) == 0);
+  check("bucket 1 starts at 2",
+	das_hist_bucket(2) == 1 && das_hist_bucket_lo(1) == 2);
+  ok = 1;
+  for (b = 1; b < DAS_HIST_NBUCKETS; b++) {
+    if (das_hist_bucket(das_hist_bucket_lo(b)) != b ||
+	das_hist_bucket(das_hist_bucket_lo(b) - 1) != b - 1 ||
+	das_hist_bucket(hi(b)) != b) {
+      snprintf(what, sizeof(what), "bucket %u edges", b);
+      check(what, 0);
+      ok = 0;
+    }
+  }
+  check("every bucket starts at 2^b", ok);
+  check("overflow bucket takes 32768",
+	das_hist_bucket(32768) == DAS_HIST_NBUCKETS - 1);
+  check("overflow bucket takes UINT16_MAX",
+	das_hist_bucket(UINT16_MAX) == DAS_HIST_NBUCKETS - 1);
+
+  ok = 1;
+  n = 0;
+  for (v = 0; v <= UINT16_MAX; v++) {
+    b = das_hist_bucket(v);
+    if (b >= DAS_HIST_NBUCKETS || v < das_hist_bucket_lo(b) || v > hi(b))
+      ok = 0;
+    n += b == DAS_HIST_NBUCKETS - 1;
+  }
+  check("all 65536 values in range", ok);
+  check("overflow bucket holds 2^15 values", n == 32768);
+
+  das_hist_clear(&h);
+  check("clear: empty, min at UINT16_MAX",
+	h.dh_n == 0 && h.dh_sum == 0 && h.dh_max == 0 &&
+	h.dh_min == UINT16_MAX);
+  sum = 0;
+  for (i = 0; i < __arraycount(edge); i++) {
+    das_hist_add(&h, edge[i]);
+    sum += edge[i];
+  }
+  check("add: n and sum",
+	h.dh_n == __arraycount(edge) && h.dh_sum == sum);
+  check("add: min and max", h.dh_min == 0 && h.dh_max == UINT16_MAX);
+  check("add: counts",
+	h.dh_count[0] == 2 && h.dh_count[1] == 2 && h.dh_count[7] == 1 &&
+	h.dh_count[8] == 1 && h.dh_count[14] == 1 &&
+	h.dh_count[DAS_HIST_NBUCKETS - 1] == 3);
+  for (n = 0, b = 0; b < DAS_HIST_NBUCKETS; b++)
+    n += h.dh_count[b];
+  check("add: counts sum to n", n == h.dh_n);
+  das_hist_clear(&h);
+  das_hist_add(&h, 700);
+  check("one value is min and max",
+	h.dh_min == 700 && h.dh_max == 700 && h.dh_count[9] == 1);
+
+  ok = 1;
+  for (i = 0; i < __arraycount(edge); i++)
+    for (j = 0; j < __arraycount(edge); j++)
+      if (das_hist_absdiff(edge[i], edge[j]) !=
+	  (uint16_t)abs((int)edge[i] - (int)edge[j]))
+	ok = 0;
+  for (v = 0; v <= UINT16_MAX; v += 97)
+    if (das_hist_absdiff(v, 40000) != (uint16_t)abs((int)v - 40000) ||
+	das_hist_absdiff(40000, v) != das_hist_absdiff(v, 40000))
+      ok = 0;
+  check("absdiff", ok);
+  check("absdiff of the extremes",
+	das_hist_absdiff(0, UINT16_MAX) == UINT16_MAX &&
+	das_hist_absdiff(UINT16_MAX, 0) == UINT16_MAX);
+  return failed != 0;
+}
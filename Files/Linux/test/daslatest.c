@@ -0,0 +1,142 @@
+/* daslatest -- daslatest.h's seqlock with a writer and readers racing
+ *
+ * usage: daslatest
+ *
+ * The writer thread stands in for das_intr: it publishes update k of a
+ * channel as sample k, sample number 3k, seconds k and nanoseconds
+ * k * 7, every field a function of k, flat out and round the channels.
+ * Reader threads copy entries through das_latest_read meanwhile and
+ * check that each copy holds one k in every field, and that k and
+ * dv_seq never go back.  A copy that mixed two updates would show.  A
+ * reader with no seqlock runs alongside to show that tearing happens
+ * at all on this host; its count is reported, not checked.
+ */
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dasio.h"
+#include "daslatest.h"
+#include "check.h"
+
+#define NUPDATE 3000000	/* per channel */
+#define NREADER 3
+
+static struct das_latest page;
+static volatile int done;
+
+struct reader {
+  pthread_t r_thread;
+  uint64_t r_reads;
+  uint64_t r_torn;	/* fields from different updates */
+  uint64_t r_back;	/* k or dv_seq went down */
+  int r_locked;
+};
+
+static void *
+writer(void *arg)
+{
+  uint32_t k, c;
+
+  for (k = 1; k <= NUPDATE; k++) {
+    for (c = 0; c < DAS_NCHAN; c++)
+      das_latest_write(&page.dl_chan[c], k, 3 * k, k, 7 * k);
+    if (k % 4096 == 0)
+      sched_yield();
+  }
+  done = 1;
+  return NULL;
+}
+
+/* Copy without the seqlock, the way a careless reader would */
+static void
+read_plain(uint32_t c, struct das_latest_val *dv)
+{
+  const volatile struct das_latest_chan *lc = &page.dl_chan[c];
+
+  dv->dv_seq = lc->lc_seq / 2;
+  dv->dv_sample = lc->lc_sample;
+  dv->dv_nsamp = lc->lc_nsamp;
+  dv->dv_sec = lc->lc_sec;
+  dv->dv_nsec = lc->lc_nsec;
+}
+
+static void *
+reader(void *arg)
+{
+  struct reader *r = arg;
+  struct das_latest_val dv;
+  uint32_t last[DAS_NCHAN], lastseq[DAS_NCHAN], c = 0, k;
+
+  memset(last, 0, sizeof(last));
+  memset(lastseq, 0, sizeof(lastseq));
+  while (!done) {
+    c = (c + 1) % DAS_NCHAN;
+    if (r->r_locked)
+      das_latest_read(&page, c, &dv);
+    else
+      read_plain(c, &dv);
+    r->r_reads++;
+    k = dv.dv_sample;
+    if (dv.dv_nsamp != 3 * k || dv.dv_sec != k ||
+	dv.dv_nsec != (int32_t)(7 * k) || (r->r_locked && dv.dv_seq != k))
+      r->r_torn++;
+    if (k < last[c] || dv.dv_seq < lastseq[c])
+      r->r_back++;
+    last[c] = k;
+    lastseq[c] = dv.dv_seq;
+  }
+  return NULL;
+}
+
+int
+main(void)
+{
+  struct reader rd[NREADER + 1];
+  struct das_latest_val dv;
+  pthread_t wt;
+  uint64_t reads = 0, torn = 0, back = 0;
+  int i;
+
+  check("page is what das_attach maps",
+	sizeof(struct das_latest) <= 4096 &&
+	sizeof(struct das_latest_chan) == 64);
+  memset(&dv, 0xff, sizeof(dv));
+  das_latest_read(&page, 3, &dv);
+  check("never written: dv_seq 0", dv.dv_seq == 0 && dv.dv_sample == 0);
+  das_latest_write(&page.dl_chan[3], 5, 6, 7, 8);
+  das_latest_write(&page.dl_chan[3], 9, 10, 11, 12);
+  das_latest_read(&page, 3 + DAS_NCHAN, &dv);
+  check("two writes: dv_seq 2, the newest",
+	dv.dv_seq == 2 && dv.dv_sample == 9 && dv.dv_nsamp == 10 &&
+	dv.dv_sec == 11 && dv.dv_nsec == 12 && page.dl_chan[3].lc_seq == 4);
+  memset(&page, 0, sizeof(page));
+
+  memset(rd, 0, sizeof(rd));
+  for (i = 0; i <= NREADER; i++) {
+    rd[i].r_locked = i < NREADER;
+    pthread_create(&rd[i].r_thread, NULL, reader, &rd[i]);
+  }
+  pthread_create(&wt, NULL, writer, NULL);
+  pthread_join(wt, NULL);
+  for (i = 0; i <= NREADER; i++)
+    pthread_join(rd[i].r_thread, NULL);
+  for (i = 0; i < NREADER; i++) {
+    reads += rd[i].r_reads;
+    torn += rd[i].r_torn;
+    back += rd[i].r_back;
+  }
+  check("readers raced the writer", reads > 1000);
+  check("no torn copy", torn == 0);
+  check("never went back", back == 0);
+  das_latest_read(&page, 0, &dv);
+  check("last update is the one read",
+	dv.dv_seq == NUPDATE && dv.dv_sample == NUPDATE);
+  printf("%-40s %llu reads, %llu torn without the seqlock\n", "race",
+	 (unsigned long long)reads,
+	 (unsigned long long)rd[NREADER].r_torn);
+  return failed != 0;
+}
@@ -0,0 +1,228 @@
+/* dasreflex -- dasreflex.h's rules, and what evaluating them costs
+ *
+ * usage: dasreflex [-n samples]
+ *
+ * First the rules are checked one by one: what das_reflex_check
+ * refuses, trip and release with the hysteresis between them, either
+ * polarity, DAS_RF_CLEAR, two rules on one output and the counters.
+ * Then das_reflex_eval is timed over -n samples for four tables: none,
+ * eight rules on another channel, eight that never hit, and the worst
+ * case, eight on the channel with the samples swinging so every rule
+ * changes state on every sample.  Calls are timed 64 at a time to get
+ * under the clock's resolution; the mean, p99.9 and worst of those
+ * are reported per call.  The worst case has to stay within
+ * REFLEX_BUDGET_NS a sample at the median, a tenth of the 10 us between
+ * samples at the fastest pacing das_intr keeps up with.
+ */
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "dasio.h"
+#include "dasreflex.h"
+#include "check.h"
+
+#define BATCH 64
+#define REFLEX_BUDGET_NS 1000
+
+static struct das_reflex rx;
+static struct das_reflex_stats rs;
+
+static void
+rule(u_int i, u_int chan, u_int out, u_int flags, u_int trip, u_int rel)
+{
+  struct das_reflex_rule *rr = &rx.rx_rule[i];
+
+  rr->rr_chan = chan;
+  rr->rr_out = out;
+  rr->rr_flags = flags;
+  rr->rr_trip = trip;
+  rr->rr_release = rel;
+  if (rx.rx_nrules <= i)
+    rx.rx_nrules = i + 1;
+}
+
+static void
+reset(void)
+{
+  memset(&rx, 0, sizeof(rx));
+  das_reflex_reset(&rs);
+}
+
+/* OP bits after feeding v[0..n) on chan, starting from op */
+static uint32_t
+feed(u_int chan, const uint16_t *v, u_int n, uint32_t op)
+{
+  u_int i;
+
+  for (i = 0; i < n; i++)
+    op = das_reflex_eval(&rx, &rs, chan, v[i], op);
+  return op;
+}
+
+static uint64_t
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+cmp64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Median batch, per call */
+static double
+bench(const char *name, u_int chan, const uint16_t *v, u_int n)
+{
+  volatile uint32_t sink = 0;
+  uint64_t *t, t0, sum = 0;
+  uint32_t op = 1;
+  u_int nb = n / BATCH, b, i;
+  double med;
+
+  t = malloc(nb * sizeof(*t));
+  if (t == NULL || nb == 0) {
+    free(t);
+    return 0;
+  }
+  das_reflex_reset(&rs);
+  for (b = 0; b < nb; b++) {
+    t0 = now();
+    for (i = 0; i < BATCH; i++)
+      op = das_reflex_eval(&rx, &rs, chan, v[i], op);
+    t[b] = now() - t0;
+    sum += t[b];
+    sink += op;
+  }
+  qsort(t, nb, sizeof(*t), cmp64);
+  med = (double)t[nb / 2] / BATCH;
+  printf("%-7s rules %u  ns/sample mean %6.1f  median %6.1f  p99.9 %7.1f"
+	 "  worst %8.1f\n", name, rx.rx_nrules, (double)sum / nb / BATCH, med,
+	 (double)t[nb - 1 - nb / 1000] / BATCH, (double)t[nb - 1] / BATCH);
+  free(t);
+  (void)sink;
+  return med;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const uint16_t up[] = { 100, 1999, 2000, 2500, 1001, 1000, 999 };
+  static const uint16_t down[] = { 3000, 501, 500, 300, 999, 1000, 3000 };
+  uint16_t swing[BATCH], mid[BATCH];
+  u_int n = 1000000, i, nsamp;
+  uint32_t op;
+  double worst;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "n:")) != -1) {
+    switch (ch) {
+    case 'n':
+      n = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: dasreflex [-n samples]\n");
+      return 1;
+    }
+  }
+
+  reset();
+  check("no rules is a table", das_reflex_check(&rx) == 0);
+  rx.rx_nrules = DAS_REFLEX_MAX + 1;
+  check("too many rules refused", das_reflex_check(&rx) != 0);
+  reset();
+  rule(0, 8, 2, 0, 2000, 1000);
+  check("channel 8 refused", das_reflex_check(&rx) != 0);
+  rule(0, 0, 1, 0, 2000, 1000);
+  check("OP1 refused", das_reflex_check(&rx) != 0);
+  rule(0, 0, 5, 0, 2000, 1000);
+  check("OP5 refused", das_reflex_check(&rx) != 0);
+  rule(0, 0, 2, 0x04, 2000, 1000);
+  check("unknown flag refused", das_reflex_check(&rx) != 0);
+  rule(0, 0, 2, 0, 0x1000, 1000);
+  check("trip over 12 bits refused", das_reflex_check(&rx) != 0);
+  rule(0, 0, 2, 0, 2000, 2000);
+  check("no hysteresis refused", das_reflex_check(&rx) != 0);
+  rule(0, 0, 2, DAS_RF_BELOW, 500, 400);
+  check("release on the wrong side refused", das_reflex_check(&rx) != 0);
+
+  // OP2 on at 2000 and up, off again at 1000 and down
+  reset();
+  rule(0, 3, 2, 0, 2000, 1000);
+  check("rising rule is a table", das_reflex_check(&rx) == 0);
+  check("below trip: off", feed(3, up, 2, 0) == 0);
+  check("at trip: on", feed(3, up + 2, 1, 0) == 0x2);
+  check("in the gap: stays on", feed(3, up + 3, 2, 0x2) == 0x2);
+  check("at release: off", feed(3, up + 5, 1, 0x2) == 0);
+  check("tripped once, released once",
+	rs.rs_fired[0] == 1 && rs.rs_released[0] == 1 && rs.rs_tripped == 0);
+  check("other channel ignored", feed(4, up + 2, 1, 0) == 0 &&
+	rs.rs_fired[0] == 1);
+  check("other outputs kept", feed(3, up + 2, 1, 0x9) == 0xb);
+
+  // OP3 cleared at 500 and down, set again at 1000 and up
+  reset();
+  rule(0, 1, 3, DAS_RF_BELOW | DAS_RF_CLEAR, 500, 1000);
+  op = feed(1, down, 2, 0x4);
+  check("below rule above trip: kept", op == 0x4);
+  op = feed(1, down + 2, 1, op);
+  check("at trip: cleared", op == 0);
+  op = feed(1, down + 3, 2, op);
+  check("in the gap: stays clear", op == 0);
+  op = feed(1, down + 5, 1, op);
+  check("at release: set", op == 0x4 && rs.rs_released[0] == 1);
+
+  // two rules on OP4: the one that changes state last wins
+  reset();
+  rule(0, 0, 4, 0, 2000, 1000);
+  rule(1, 0, 4, DAS_RF_CLEAR, 3000, 2500);
+  op = feed(0, up + 2, 1, 0);
+  check("first trips: on", op == 0x8);
+  op = das_reflex_eval(&rx, &rs, 0, 3000, op);
+  check("second trips: off", op == 0 && rs.rs_tripped == 0x3);
+  op = das_reflex_eval(&rx, &rs, 0, 2400, op);
+  check("second releases: on", op == 0x8 && rs.rs_tripped == 0x1);
+  op = das_reflex_eval(&rx, &rs, 0, 0, op);
+  check("first releases: off", op == 0 && rs.rs_tripped == 0 &&
+	rs.rs_fired[1] == 1 && rs.rs_released[1] == 1);
+  das_reflex_reset(&rs);
+  check("reset clears the counters",
+	rs.rs_tripped == 0 && rs.rs_fired[0] == 0 && rs.rs_released[1] == 0);
+
+  if (n == 0)
+    return failed != 0;
+  for (i = 0; i < BATCH; i++) {
+    swing[i] = i % 2 ? 0 : 0xfff;
+    mid[i] = 2048;
+  }
+  reset();
+  (void)bench("none", 0, swing, n);
+  for (i = 0; i < DAS_REFLEX_MAX; i++)
+    rule(i, 1, 2 + i % 3, i % 2 ? DAS_RF_BELOW : 0, i % 2 ? 100 : 4000,
+	 i % 2 ? 200 : 3900);
+  (void)bench("idle", 0, swing, n);
+  (void)bench("quiet", 1, mid, n);
+  for (i = 0; i < DAS_REFLEX_MAX; i++)
+    rule(i, 0, 2 + i % 3, i % 2 ? DAS_RF_BELOW : 0, i % 2 ? 100 : 4000,
+	 i % 2 ? 200 : 3900);
+  check("worst case table is usable", das_reflex_check(&rx) == 0);
+  worst = bench("worst", 0, swing, n);
+  // the rules below miss only the first sample, 0xfff
+  nsamp = n / BATCH * BATCH;
+  check("worst case: every rule, every sample",
+	rs.rs_fired[0] + rs.rs_released[0] == nsamp &&
+	rs.rs_fired[DAS_REFLEX_MAX - 1] +
+	rs.rs_released[DAS_REFLEX_MAX - 1] == nsamp - 1);
+  check("worst case within budget", worst > 0 && worst < REFLEX_BUDGET_NS);
+  return failed != 0;
+}
@@ -0,0 +1,307 @@
+/* dasreg -- dasreg.h against a mock bus that counts accesses
+ *
+ * usage: dasreg [-n passes]
+ *
+ * The bus keeps the last byte written to each BADR2 port and logs every
+ * access.  First the helpers are checked one by one: which ports they
+ * touch, in what order, and that the shadows save every CTR1 read-back.
+ * Then an interrupt pass as das_acq makes it is timed -n times, with the
+ * shadow and with the read-modify-write of CTR1 it replaced, and the
+ * port accesses per pass are reported with what they cost on a board
+ * at a microsecond each.
+ */
+#include <sys/types.h>
+#include <sys/bus.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dev/pci/dasio.h>
+#include <dev/pci/dasreg.h>
+#include "check.h"
+
+#define NLOG 16
+#define IO_NS 1000	/* a PCI I/O port access on the board */
+
+struct mock {
+  uint8_t mk_port[8];	/* last write; CTR1 reads come from mk_status */
+  uint8_t mk_status;
+  uint32_t mk_eoc;	/* CTR1 reads left with EOC up */
+  uint32_t mk_b1[0x80 / 4];
+  uint32_t mk_reads, mk_writes, mk_ctr1reads;
+  struct {
+    char l_op;		/* 'r' or 'w' */
+    uint8_t l_off, l_val;
+  } mk_log[NLOG];
+  u_int mk_nlog;
+};
+
+static void
+logio(struct mock *mk, char op, bus_addr_t off, uint8_t val)
+{
+  if (mk->mk_nlog < NLOG) {
+    mk->mk_log[mk->mk_nlog].l_op = op;
+    mk->mk_log[mk->mk_nlog].l_off = off;
+    mk->mk_log[mk->mk_nlog].l_val = val;
+  }
+  mk->mk_nlog++;
+}
+
+static uint8_t
+mock_read_1(void *cookie, bus_addr_t off)
+{
+  struct mock *mk = cookie;
+  uint8_t v;
+
+  mk->mk_reads++;
+  if (off == CTR1) {
+    mk->mk_ctr1reads++;
+    v = mk->mk_status | (mk->mk_eoc ? EOC : 0);
+    if (mk->mk_eoc)
+      mk->mk_eoc--;
+  }
+  else
+    v = mk->mk_port[off & 7];
+  logio(mk, 'r', off, v);
+  return v;
+}
+
+static void
+mock_write_1(void *cookie, bus_addr_t off, uint8_t v)
+{
+  struct mock *mk = cookie;
+
+  mk->mk_writes++;
+  mk->mk_port[off & 7] = v;
+  logio(mk, 'w', off, v);
+}
+
+static uint32_t
+mock_read_4(void *cookie, bus_addr_t off)
+{
+  struct mock *mk = cookie;
+
+  mk->mk_reads++;
+  return mk->mk_b1[(off / 4) % (sizeof(mk->mk_b1) / 4)];
+}
+
+static void
+mock_write_4(void *cookie, bus_addr_t off, uint32_t v)
+{
+  struct mock *mk = cookie;
+
+  mk->mk_writes++;
+  mk->mk_b1[(off / 4) % (sizeof(mk->mk_b1) / 4)] = v;
+}
+
+static struct mock mock;
+static const struct bus_space mock_bus = {
+  mock_read_1, mock_write_1, mock_read_4, mock_write_4, &mock
+};
+
+static void
+reset(struct das_regs *dr)
+{
+  memset(&mock, 0, sizeof(mock));
+  memset(dr, 0, sizeof(*dr));
+  dr->dr_iot = &mock_bus;
+  dr->dr_iot1 = &mock_bus;
+}
+
+static void
+mark(void)
+{
+  mock.mk_reads = mock.mk_writes = mock.mk_ctr1reads = 0;
+  mock.mk_nlog = 0;
+}
+
+static int
+logged(u_int i, char op, uint8_t off, uint8_t val)
+{
+  return i < mock.mk_nlog && mock.mk_log[i].l_op == op &&
+      mock.mk_log[i].l_off == off && mock.mk_log[i].l_val == val;
+}
+
+/* An interrupt pass as das_acq makes it, the scan and reflex paths left out */
+static uint16_t
+pass_shadow(struct das_regs *dr)
+{
+  uint32_t spins;
+  uint8_t status;
+  uint16_t lat;
+
+  status = das_reg_status(dr);
+  status = das_reg_wait_eoc(dr, status, &spins);
+  das_reg_stage_ctr1(dr, DAS_CTR1_MUX, (das_reg_channel(dr) + 1) & 7);
+  das_reg_ack(dr);
+  lat = das_reg_read_clock(dr);
+  lat ^= das_reg_read_adc(dr);
+  das_reg_start_conv(dr);
+  return lat;
+}
+
+/* The same pass before the shadow: CTR1 read back to rebuild each write */
+static uint16_t
+pass_readback(struct das_regs *dr)
+{
+  uint32_t spins;
+  uint8_t status, ctr1;
+  uint16_t lat;
+
+  status = das_reg_status(dr);
+  status = das_reg_wait_eoc(dr, status, &spins);
+  ctr1 = das_reg_read_1(dr, CTR1);
+  das_reg_write_1(dr, CTR1, (ctr1 & ~DAS_CTR1_MUX) | ((ctr1 + 1) & 7));
+  lat = das_reg_read_clock(dr);
+  lat ^= das_reg_read_adc(dr);
+  ctr1 = das_reg_read_1(dr, CTR1);
+  das_reg_write_1(dr, DAS_ADC_LOW, ctr1);
+  return lat;
+}
+
+static uint64_t
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+bench(const char *name, uint16_t (*pass)(struct das_regs *), u_int n)
+{
+  struct das_regs dr;
+  volatile uint16_t sink = 0;
+  uint64_t t;
+  double io;
+  u_int i;
+
+  reset(&dr);
+  das_reg_set_ctr1(&dr, DAS_CTR1_INTE | DAS_CTR1_OP1);
+  mock.mk_status = DAS_CTR1_INTE;
+  mark();
+  t = now();
+  for (i = 0; i < n; i++) {
+    mock.mk_nlog = 0;
+    sink += (*pass)(&dr);
+  }
+  t = now() - t;
+  io = (double)(mock.mk_reads + mock.mk_writes) / n;
+  printf("%-9s ns/pass %6.1f  reads %4.1f  writes %4.1f  ctr1 reads %3.1f"
+	 "  board us %4.1f\n", name, (double)t / n, (double)mock.mk_reads / n,
+	 (double)mock.mk_writes / n, (double)mock.mk_ctr1reads / n,
+	 io * IO_NS / 1000);
+  (void)sink;
+}
+
+int
+main(int argc, char **argv)
+{
+  struct das_regs dr;
+  u_int n = 1000000;
+  uint32_t spins, io;
+  uint8_t st;
+  uint16_t v;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "n:")) != -1) {
+    switch (ch) {
+    case 'n':
+      n = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: dasreg [-n passes]\n");
+      return 1;
+    }
+  }
+
+  reset(&dr);
+  das_reg_set_ctr1(&dr, DAS_CTR1_INTE | 5);
+  check("set_ctr1 writes port and shadow", mock.mk_port[CTR1] ==
+	(DAS_CTR1_INTE | 5) && das_reg_ctr1(&dr) == (DAS_CTR1_INTE | 5));
+  mark();
+  check("channel from the shadow, no access",
+	das_reg_channel(&dr) == 5 && mock.mk_nlog == 0);
+  das_reg_update_ctr1(&dr, DAS_CTR1_MUX, 2);
+  check("update_ctr1 is one write, no read", mock.mk_nlog == 1 &&
+	logged(0, 'w', CTR1, DAS_CTR1_INTE | 2));
+  mark();
+  das_reg_stage_ctr1(&dr, DAS_CTR1_MUX | DAS_CTR1_OP1, DAS_CTR1_OP1 | 7);
+  check("stage_ctr1 touches no port",
+	mock.mk_nlog == 0 && mock.mk_port[CTR1] == (DAS_CTR1_INTE | 2));
+  das_reg_ack(&dr);
+  check("ack writes the staged shadow", mock.mk_nlog == 1 &&
+	logged(0, 'w', CTR1, DAS_CTR1_INTE | DAS_CTR1_OP1 | 7));
+
+  mark();
+  mock.mk_status = DAS_CTR1_INTE | 0x50;
+  mock.mk_eoc = 4;
+  st = das_reg_status(&dr);
+  st = das_reg_wait_eoc(&dr, st, &spins);
+  check("wait_eoc spins while EOC is up",
+	spins == 4 && mock.mk_ctr1reads == 5 && (st & EOC) == 0);
+  check("status gives the inputs", das_reg_dio(st) == 5);
+  mark();
+  st = das_reg_wait_eoc(&dr, DAS_CTR1_INTE, &spins);
+  check("wait_eoc with EOC down reads nothing",
+	spins == 0 && mock.mk_nlog == 0);
+
+  mock.mk_port[DAS_ADC_HIGH] = 0x5a;
+  mock.mk_port[DAS_ADC_LOW] = 0xab;
+  mark();
+  v = das_reg_read_adc(&dr);
+  check("read_adc: 12 bits from two reads", v == 0xab5 &&
+	logged(0, 'r', DAS_ADC_HIGH, 0x5a) && logged(1, 'r', DAS_ADC_LOW, 0xab));
+  mark();
+  das_reg_start_conv(&dr);
+  check("start_conv writes the A/D register",
+	mock.mk_nlog == 1 && mock.mk_log[0].l_op == 'w' &&
+	mock.mk_log[0].l_off == DAS_ADC_LOW);
+
+  mark();
+  mock.mk_port[DAS_CNT0 + 1] = 0x34;
+  v = das_reg_read_ctr(&dr, 1);
+  check("read_ctr latches, then low and high",
+	mock.mk_nlog == 3 && logged(0, 'w', CTR2, DAS_8254_SC(1)) &&
+	mock.mk_log[1].l_off == DAS_CNT0 + 1 &&
+	mock.mk_log[2].l_off == DAS_CNT0 + 1 && v == 0x3434);
+  mark();
+  das_reg_set_ctr(&dr, 0, DAS_8254_MODE2, 0x1234);
+  check("set_ctr: mode, low, high", mock.mk_nlog == 3 &&
+	logged(0, 'w', CTR2, DAS_8254_SC(0) | DAS_8254_RW_LH | DAS_8254_MODE2) &&
+	logged(1, 'w', DAS_CNT0, 0x34) && logged(2, 'w', DAS_CNT0, 0x12));
+  mark();
+  das_reg_set_count(&dr, 825);
+  check("set_count: control word, low, high", mock.mk_nlog == 3 &&
+	logged(0, 'w', CTR2, COUNTER_CONTROL_WORD) &&
+	logged(1, 'w', CLOCK, 825 & 0xff) && logged(2, 'w', CLOCK, 825 >> 8) &&
+	dr.dr_count == 825);
+  mark();
+  das_reg_reload_count(&dr, 825);
+  check("reload_count skips an unchanged count", mock.mk_nlog == 0);
+  das_reg_reload_count(&dr, 413);
+  check("reload_count: low, high, no mode", mock.mk_nlog == 2 &&
+	logged(0, 'w', CLOCK, 413 & 0xff) && logged(1, 'w', CLOCK, 413 >> 8));
+
+  reset(&dr);
+  das_reg_write_4_b1(&dr, DAS_BADR1_INTCSR, 0x41);
+  check("BADR1 goes to the second tag",
+	das_reg_read_4_b1(&dr, DAS_BADR1_INTCSR) == 0x41);
+  das_reg_set_ctr1(&dr, DAS_CTR1_INTE | DAS_CTR1_OP1);
+  mock.mk_status = DAS_CTR1_INTE;
+  mark();
+  io = das_reg_count(&dr);
+  (void)pass_shadow(&dr);
+  check("counters match the bus",
+	dr.dr_nread == mock.mk_reads + 1 && dr.dr_nwrite == mock.mk_writes + 2 &&
+	das_reg_count(&dr) - io == mock.mk_reads + mock.mk_writes);
+  check("interrupt pass reads CTR1 once",
+	mock.mk_ctr1reads == 1 && mock.mk_reads + mock.mk_writes == 8);
+
+  if (n > 0) {
+    bench("shadow", pass_shadow, n);
+    bench("readback", pass_readback, n);
+  }
+  return failed != 0;
+}
@@ -0,0 +1,182 @@
+/* dasring -- dasring.h's producer and consumer, with no driver between
+ *
+ * usage: dasring
+ *
+ * First one thread plays both sides through setup, a partial slot, an
+ * empty END slot and a full ring, checking what each counter and
+ * completion says.  Then a producer thread, taking the part of das_acq
+ * and das_ring_fill, writes a counting sequence into slots of odd
+ * sizes while a consumer thread reaps and resubmits them, for long
+ * enough that every counter wraps the ring thousands of times.  Every
+ * word must come out once, in order, in the slot its completion names.
+ */
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dasio.h"
+#include "dasring.h"
+#include "check.h"
+
+#define NSLOT 8
+#define SLOTWORDS 37
+#define NWORDS 4000000
+
+struct area {
+  struct das_ring_ctl a_ctl;
+  uint32_t a_slots[DAS_RING_MAXSLOT * SLOTWORDS];
+};
+
+static struct area area;
+static struct das_ring_prod prod;
+
+struct side {
+  uint64_t s_words;
+  uint64_t s_slots;
+  uint64_t s_waits;	/* producer: spins on a slot not yet submitted */
+  int s_bad;
+};
+
+/* The driver's side: runs of 1 to 50 words, an END slot every 997 */
+static void *
+producer(void *arg)
+{
+  struct side *sd = arg;
+  uint32_t w[50], next = 0, n, took, i;
+
+  while (next < NWORDS) {
+    n = 1 + next % 50;
+    if (n > NWORDS - next)
+      n = NWORDS - next;
+    for (i = 0; i < n; i++)
+      w[i] = next + i;
+    for (i = 0; i < n; i += took) {
+      while (!das_ring_ready(&area.a_ctl, &prod)) {
+	sd->s_waits++;
+	sched_yield();
+      }
+      took = das_ring_put(&prod, area.a_slots, w + i, n - i);
+      if (prod.rp_fill == SLOTWORDS) {
+	das_ring_complete(&area.a_ctl, &prod, 0, 0, 0);
+	sd->s_slots++;
+      }
+    }
+    next += n;
+    if (next / 997 != (next - n) / 997 && prod.rp_fill != 0) {
+      das_ring_complete(&area.a_ctl, &prod, DAS_CQE_END, 0, 0);
+      sd->s_slots++;
+    }
+  }
+  while (!das_ring_ready(&area.a_ctl, &prod))
+    sched_yield();
+  das_ring_complete(&area.a_ctl, &prod, DAS_CQE_END, 0, 0);
+  sd->s_slots++;
+  sd->s_words = next;
+  return NULL;
+}
+
+/* The program's side: reap, check, resubmit */
+static void *
+consumer(void *arg)
+{
+  struct side *sd = arg;
+  const struct das_cqe *ce;
+  const uint32_t *slot;
+  uint32_t next = 0, seq = 0, i;
+
+  while (next < NWORDS) {
+    if ((ce = das_ring_peek(&area.a_ctl)) == NULL) {
+      sched_yield();
+      continue;
+    }
+    if (ce->ce_seq != seq++ || ce->ce_words > SLOTWORDS ||
+	(ce->ce_words < SLOTWORDS && !(ce->ce_flags & DAS_CQE_END)))
+      sd->s_bad++;
+    slot = das_ring_slot(&area, &area.a_ctl, ce);
+    for (i = 0; i < ce->ce_words; i++)
+      if (slot[i] != next++)
+	sd->s_bad++;
+    sd->s_slots++;
+    das_ring_reap(&area.a_ctl, 1);
+    das_ring_submit(&area.a_ctl, 1);
+  }
+  sd->s_words = next;
+  return NULL;
+}
+
+int
+main(void)
+{
+  struct das_ring_ctl *rc = &area.a_ctl;
+  const struct das_cqe *ce;
+  struct side ps, cs;
+  pthread_t pt, ct;
+  uint32_t w[SLOTWORDS + 5], i;
+  int ok;
+
+  for (i = 0; i < SLOTWORDS + 5; i++)
+    w[i] = 100 + i;
+  das_ring_init(rc, &prod, NSLOT, SLOTWORDS, offsetof(struct area, a_slots));
+  check("setup submits every slot",
+	rc->rc_sq_tail == NSLOT && rc->rc_cq_tail == 0 &&
+	rc->rc_cq_head == 0 && das_ring_ready(rc, &prod));
+  check("nothing to reap", das_ring_peek(rc) == NULL);
+  check("put takes what fits",
+	das_ring_put(&prod, area.a_slots, w, 10) == 10 &&
+	das_ring_put(&prod, area.a_slots, w + 10, SLOTWORDS) ==
+	SLOTWORDS - 10 && prod.rp_fill == SLOTWORDS);
+  das_ring_complete(rc, &prod, 0, 12, 34);
+  ce = das_ring_peek(rc);
+  check("full slot completed", ce != NULL && ce->ce_seq == 0 &&
+	ce->ce_words == SLOTWORDS && ce->ce_flags == 0 &&
+	ce->ce_sec == 12 && ce->ce_nsec == 34 && rc->rc_cq_tail == 1);
+  check("slot holds the words", ce != NULL &&
+	memcmp(das_ring_slot(&area, rc, ce), w,
+	       SLOTWORDS * sizeof(uint32_t)) == 0);
+  das_ring_put(&prod, area.a_slots, w, 3);
+  das_ring_complete(rc, &prod, DAS_CQE_END, 0, 0);
+  das_ring_complete(rc, &prod, DAS_CQE_END, 0, 0);
+  check("short and empty END slots", rc->rc_cq[1].ce_words == 3 &&
+	rc->rc_cq[2].ce_words == 0 && rc->rc_cq[2].ce_flags == DAS_CQE_END);
+  for (i = 3; i < NSLOT; i++)
+    das_ring_complete(rc, &prod, 0, 0, 0);
+  check("every slot taken: not ready", !das_ring_ready(rc, &prod) &&
+	rc->rc_cq_tail == NSLOT);
+  das_ring_reap(rc, 2);
+  check("reaped, not submitted: not ready", !das_ring_ready(rc, &prod) &&
+	das_ring_peek(rc) == &rc->rc_cq[2]);
+  das_ring_submit(rc, 2);
+  check("submitted: ready again, at slot 0", das_ring_ready(rc, &prod) &&
+	prod.rp_head % NSLOT == 0);
+  // a program that hands over more than it has cannot make it ready
+  rc->rc_sq_tail = prod.rp_head + NSLOT + 1;
+  check("a wild tail is ignored", !das_ring_ready(rc, &prod));
+
+  memset(&area, 0, sizeof(area));
+  das_ring_init(rc, &prod, NSLOT, SLOTWORDS, offsetof(struct area, a_slots));
+  memset(&ps, 0, sizeof(ps));
+  memset(&cs, 0, sizeof(cs));
+  pthread_create(&ct, NULL, consumer, &cs);
+  pthread_create(&pt, NULL, producer, &ps);
+  pthread_join(pt, NULL);
+  pthread_join(ct, NULL);
+  ok = cs.s_words == NWORDS && ps.s_words == NWORDS;
+  check("threads: every word once, in order", ok && cs.s_bad == 0);
+  // the consumer stops at the last word; only empty END slots follow it
+  while ((ce = das_ring_peek(rc)) != NULL) {
+    ok &= ce->ce_words == 0 && ce->ce_flags == DAS_CQE_END;
+    das_ring_reap(rc, 1);
+    cs.s_slots++;
+  }
+  check("threads: every completion reaped",
+	ok && cs.s_slots == ps.s_slots);
+  check("threads: counters wrapped the ring",
+	rc->rc_cq_tail > 1000 * NSLOT && rc->rc_cq_head <= rc->rc_cq_tail);
+  printf("%-40s %llu slots, %llu producer waits\n", "threads",
+	 (unsigned long long)ps.s_slots, (unsigned long long)ps.s_waits);
+  return failed != 0;
+}
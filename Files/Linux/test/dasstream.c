@@ -0,0 +1,203 @@
+/* dasstream -- dasstream.h on synthetic DAS_FMT_RECORDS streams
+ *
+ * usage: dasstream
+ *
+ * A stream of sample runs and records of every type, unknown ones and
+ * ones of 0 and 255 payload words among them, is made up from a fixed
+ * seed and fed whole, in buffers of fixed sizes from 1 word up, and in
+ * buffers of random sizes, so records are split at every point.  Each
+ * feed must hand back the same samples in the same runs' order and the
+ * same records with the same payloads.  Samples carry channel or
+ * digital input bits in 12-14 as DAS_FMT_CHAN and DAS_FMT_DIO put
+ * them, and payload words may have DAS_REC_FLAG set; neither may
+ * confuse the parser.
+ */
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dasio.h"
+#include "dasstream.h"
+#include "check.h"
+
+#define NWORDS 200000
+#define MAXREC 8192
+
+/* The stream and what a parser should make of it */
+static uint32_t stream[NWORDS];
+static size_t nstream;
+static uint32_t want_samp[NWORDS];
+static size_t nwant_samp;
+static struct {
+  uint32_t hdr;
+  size_t off;		/* payload in stream[] */
+} want_rec[MAXREC];
+static u_int nwant_rec;
+
+/* What one feed made of it */
+static uint32_t got_samp[NWORDS];
+static size_t ngot_samp;
+static u_int ngot_rec, bad_rec, stop_at;
+
+static uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t
+rnd(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed >> 16;
+}
+
+/* A sample as das_acq stores it: time offset, bits 12-14, 12 bit code */
+static uint32_t
+sample(void)
+{
+  uint32_t w = rnd();
+
+  return (w & 0xffff0000) | (w & 0x7fff);
+}
+
+static void
+make(void)
+{
+  static const u_int len[] = { 0, DAS_REC_CONFIG_LEN, DAS_REC_OVERRUN_LEN,
+    DAS_REC_TRIGGER_LEN, DAS_REC_TIME_LEN, DAS_REC_START_LEN,
+    DAS_REC_STOP_LEN, DAS_REC_DIO_LEN };
+  u_int type, n, i;
+
+  while (nstream < NWORDS - 300 && nwant_rec < MAXREC) {
+    // runs of 0 to 40 samples, now and then a long one
+    n = rnd() % 8 == 0 ? rnd() % 2000 : rnd() % 41;
+    if (n > NWORDS - 300 - nstream)
+      n = NWORDS - 300 - nstream;
+    for (i = 0; i < n; i++)
+      stream[nstream++] = want_samp[nwant_samp++] = sample();
+    type = rnd() % 10;
+    if (type >= 1 && type <= 7)
+      n = len[type];
+    else {
+      // unknown to this parser, any length
+      type = 0x40 + rnd() % 0x3f;
+      n = rnd() % 4 == 0 ? 255 * (rnd() % 2) : rnd() % 9;
+    }
+    want_rec[nwant_rec].hdr = DAS_REC_HDR(type, rnd() & 0xffff, n);
+    stream[nstream++] = want_rec[nwant_rec].hdr;
+    want_rec[nwant_rec++].off = nstream;
+    for (i = 0; i < n; i++)
+      stream[nstream++] = rnd() | (rnd() & 1 ? DAS_REC_FLAG : 0);
+  }
+}
+
+static int
+on_samples(void *arg, const uint32_t *w, size_t n)
+{
+  memcpy(got_samp + ngot_samp, w, n * sizeof(*w));
+  ngot_samp += n;
+  return 0;
+}
+
+static int
+on_record(void *arg, uint32_t hdr, const uint32_t *w)
+{
+  if (ngot_rec >= nwant_rec || hdr != want_rec[ngot_rec].hdr ||
+      memcmp(w, stream + want_rec[ngot_rec].off,
+	     DAS_REC_LEN(hdr) * sizeof(*w)) != 0)
+    bad_rec++;
+  ngot_rec++;
+  return stop_at != 0 && ngot_rec == stop_at ? 7 : 0;
+}
+
+/* Feeds the stream in buffers of size, or of random sizes up to -size */
+static int
+feed(int size)
+{
+  struct das_stream st;
+  size_t off, n;
+  int r = 0;
+
+  das_stream_init(&st);
+  ngot_samp = 0;
+  ngot_rec = bad_rec = 0;
+  for (off = 0; off < nstream && r == 0; off += n) {
+    n = size > 0 ? (size_t)size : 1 + rnd() % -size;
+    if (n > nstream - off)
+      n = nstream - off;
+    r = das_stream_feed(&st, stream + off, n, on_samples, on_record, NULL);
+  }
+  if (r != 0)
+    return r;
+  return st.ss_hdr == 0 && st.ss_samples == nwant_samp &&
+      st.ss_records == nwant_rec && ngot_samp == nwant_samp &&
+      ngot_rec == nwant_rec && bad_rec == 0 &&
+      memcmp(got_samp, want_samp, nwant_samp * sizeof(uint32_t)) == 0 ?
+      0 : -1;
+}
+
+int
+main(void)
+{
+  static const int sizes[] = { NWORDS, 1, 2, 3, 4, 5, 7, 8, 16, 255, 256,
+    257, 1024, -8, -300, -5000 };
+  uint32_t w[12];
+  struct das_stream st;
+  char what[64];
+  u_int i, j, at;
+  int ok;
+
+  // the scan stops at the first header wherever it is
+  ok = 1;
+  for (at = 0; at <= 12; at++) {
+    for (i = 0; i < 12; i++)
+      w[i] = i == at ? DAS_REC_HDR(4, 0, 0) : 0x7fff7fff;
+    for (i = 0; i <= 12; i++)
+      ok &= das_stream_scan(w, i) == (at < i ? at : i);
+  }
+  check("scan finds the first header", ok);
+
+  make();
+  for (i = 0, j = 0; i < nwant_rec; i++)
+    j |= 1U << (DAS_REC_TYPE(want_rec[i].hdr) < 8 ?
+		DAS_REC_TYPE(want_rec[i].hdr) : 8);
+  check("stream has every record type", j == 0x1fe);
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    if (sizes[i] > 0)
+      snprintf(what, sizeof(what), "feeds of %d words", sizes[i]);
+    else
+      snprintf(what, sizeof(what), "feeds of 1 to %d words", -sizes[i]);
+    check(what, feed(sizes[i]) == 0);
+  }
+
+  stop_at = nwant_rec / 2;
+  check("a callback's return ends the feed", feed(100) == 7 &&
+	ngot_rec == stop_at && bad_rec == 0);
+  stop_at = 0;
+
+  // a header at the very end of a buffer, its payload in the next two
+  das_stream_init(&st);
+  w[0] = 0x123;
+  w[1] = DAS_REC_HDR(DAS_REC_TIME, 9, DAS_REC_TIME_LEN);
+  w[2] = DAS_REC_FLAG | 1;
+  w[3] = 2;
+  w[4] = 3;
+  w[5] = 4;
+  w[6] = 0x456;
+  ngot_samp = 0;
+  ngot_rec = 0;
+  nwant_rec = 1;
+  want_rec[0].hdr = w[1];
+  memcpy(stream, w, sizeof(w));
+  want_rec[0].off = 2;
+  bad_rec = 0;
+  (void)das_stream_feed(&st, w, 2, on_samples, on_record, NULL);
+  j = st.ss_hdr == w[1] && st.ss_have == 0;
+  (void)das_stream_feed(&st, w + 2, 1, on_samples, on_record, NULL);
+  j &= st.ss_have == 1 && ngot_rec == 0;
+  (void)das_stream_feed(&st, w + 3, 4, on_samples, on_record, NULL);
+  check("header alone, then the payload split",
+	j && ngot_rec == 1 && bad_rec == 0 && ngot_samp == 2 &&
+	got_samp[0] == 0x123 && got_samp[1] == 0x456 && st.ss_hdr == 0);
+  return failed != 0;
+}
@@ -0,0 +1,306 @@
+/* dastrace -- dastrace.h's flight recorder: wrap, loss and torn records
+ *
+ * usage: dastrace [dump]
+ *
+ * One CPU's buffer is filled through das_trace_put and read back with
+ * das_trace_collect: in order, with every record accounted for as kept
+ * or lost, across a wrap and with records left half written or stale.
+ * DAS_TRACE_ACQUIRE is hooked so that a write can land between a
+ * copy's two reads of a slot's sequence; das_trace_snap and
+ * das_trace_collect must both drop that record.  Then a writer thread
+ * stands in for a driver tracing flat out, record k carrying a0 k and
+ * a1 ~k, while a reader takes das_trace_snap snapshots and collects
+ * them and the live buffer; no record it keeps may mix two writes.  A plain memcpy snapshot runs alongside to show
+ * that tearing happens at all on this host; its count is reported, not
+ * checked.  Last, the cost of a put, a collect and a snapshot.
+ *
+ * Given a file, the wrapped buffer is also written there as a dump for
+ * dastrace(1) -r to decode.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static struct das_trace_cpu *trace;
+static unsigned int backend;
+static void between(void);
+
+#define DAS_TRACE_BUF trace
+#define DAS_TRACE_NCPU 1
+#define DAS_TRACE_BACKEND(ev, a0, a1) (backend++)
+#define DAS_TRACE_ACQUIRE() between()
+#include "dastrace.h"
+#include "check.h"
+
+#define NPUT 2000000	/* writer thread, and put timing */
+#define NREP 2000	/* collect and snapshot timing */
+
+static struct das_trace_cpu tbuf, snap;
+static struct das_trace_rec out[DAS_TRACE_NREC];
+static volatile int done;
+static uint32_t knext;
+static int steps, stepat;
+
+static void
+put(uint32_t k)
+{
+  das_trace_put(&tbuf, 1, 0, (uint16_t)k, k, ~(uint64_t)k);
+}
+
+/* The barrier, and on acquire number stepat the write of record knext */
+static void
+between(void)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (++steps == stepat)
+    put(knext++);
+}
+
+/* n records kept, oldest k0, each as put() wrote it and in time order */
+static int
+intact(size_t n, uint32_t k0)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if (out[i].tr_seq != k0 + i + 1 || out[i].tr_a0 != k0 + i ||
+	out[i].tr_a1 != ~(uint64_t)(k0 + i) ||
+	out[i].tr_ev != (uint16_t)(k0 + i) || out[i].tr_cpu != 0 ||
+	(i > 0 && out[i].tr_ns < out[i - 1].tr_ns))
+      return 0;
+  return 1;
+}
+
+static void
+t_collect(void)
+{
+  uint64_t lost;
+  size_t n;
+  uint32_t k, slot;
+
+  n = das_trace_collect(&tbuf, out, &lost);
+  check("empty: nothing, nothing lost", n == 0 && lost == 0);
+  for (k = 0; k < 10; k++)
+    put(k);
+  n = das_trace_collect(&tbuf, out, &lost);
+  check("10 puts: 10 records", n == 10 && lost == 0 && intact(n, 0));
+  for (; k < DAS_TRACE_NREC; k++)
+    put(k);
+  n = das_trace_collect(&tbuf, out, &lost);
+  check("full: every record, nothing lost",
+	n == DAS_TRACE_NREC && lost == 0 && intact(n, 0));
+  for (; k < 3 * DAS_TRACE_NREC + 5; k++)
+    put(k);
+  n = das_trace_collect(&tbuf, out, &lost);
+  check("wrapped: the newest NREC, oldest first",
+	n == DAS_TRACE_NREC && intact(n, k - DAS_TRACE_NREC));
+  check("wrapped: overwritten ones lost", lost == k - DAS_TRACE_NREC);
+
+  // the slot of record k - 10 as das_trace_put leaves it mid-write
+  slot = (k - 10) & (DAS_TRACE_NREC - 1);
+  tbuf.tc_rec[slot].tr_seq = 0;
+  n = das_trace_collect(&tbuf, out, &lost);
+  check("half written: dropped and lost",
+	n == DAS_TRACE_NREC - 1 && lost == k - DAS_TRACE_NREC + 1 &&
+	intact(DAS_TRACE_NREC - 10, k - DAS_TRACE_NREC) &&
+	out[DAS_TRACE_NREC - 10].tr_a0 == k - 9);
+  // and as a lap behind, the write to it not yet started
+  tbuf.tc_rec[slot].tr_seq = k - 10 - DAS_TRACE_NREC + 1;
+  n = das_trace_collect(&tbuf, out, &lost);
+  check("stale: dropped and lost",
+	n == DAS_TRACE_NREC - 1 && lost == k - DAS_TRACE_NREC + 1);
+  put(k++);
+  put(k++);
+
+  memset(&snap, 0xff, sizeof(snap));
+  das_trace_snap(&snap, &tbuf);
+  check("snapshot of a still buffer: a copy",
+	snap.tc_next == k && memcmp(snap.tc_rec, tbuf.tc_rec,
+	sizeof(tbuf.tc_rec)) == 0);
+  for (slot = 0; slot < 15 && snap.tc_pad[slot] == 0; slot++)
+    ;
+  check("snapshot: padding cleared", slot == 15);
+
+  trace = NULL;
+  backend = 0;
+  DAS_TRACE_STATE(DAS_TEV_OPEN, 1, 0);
+  check("no buffer: backend only", backend == 1 && tbuf.tc_next == k);
+  trace = &tbuf;
+  DAS_TRACE_STATE(DAS_TEV_CLOSE, 2, 3);
+  n = das_trace_collect(&tbuf, out, &lost);
+  check("trace point: backend and buffer", backend == 2 &&
+	tbuf.tc_next == k + 1 && out[n - 1].tr_ev == DAS_TEV_CLOSE &&
+	out[n - 1].tr_a0 == 2 && out[n - 1].tr_a1 == 3);
+}
+
+/*
+ * Record knext goes to the slot of the oldest one, right after a copy
+ * has read that slot's sequence: acquire 1 follows the read of
+ * tc_next, and the slot's first is 2 + 2 * slot in a snapshot and 2 in
+ * a collect, which starts at the oldest.
+ */
+static void
+t_torn(void)
+{
+  uint64_t lost;
+  uint32_t next, slot, i;
+  size_t n;
+
+  for (i = 0; i < DAS_TRACE_NREC; i++)
+    put(tbuf.tc_next);
+  next = knext = tbuf.tc_next;
+  slot = next & (DAS_TRACE_NREC - 1);
+  steps = 0;
+  stepat = 2 + 2 * slot;
+  das_trace_snap(&snap, &tbuf);
+  stepat = 0;
+  check("snapshot: written during its copy", knext == next + 1 &&
+	tbuf.tc_rec[slot].tr_a0 == next);
+  check("snapshot: that record marked torn", snap.tc_rec[slot].tr_seq == 0);
+  n = das_trace_collect(&snap, out, &lost);
+  check("snapshot: torn record dropped", n == DAS_TRACE_NREC - 1 &&
+	lost == next - DAS_TRACE_NREC + 1 &&
+	intact(n, next - DAS_TRACE_NREC + 1));
+
+  next = knext = tbuf.tc_next;
+  steps = 0;
+  stepat = 2;
+  n = das_trace_collect(&tbuf, out, &lost);
+  stepat = 0;
+  check("live collect: written during its copy", knext == next + 1);
+  check("live collect: torn record dropped", n == DAS_TRACE_NREC - 1 &&
+	lost == next - DAS_TRACE_NREC + 1 &&
+	intact(n, next - DAS_TRACE_NREC + 1));
+}
+
+static void *
+writer(void *arg)
+{
+  uint32_t k;
+
+  for (k = 0; k < NPUT; k++) {
+    put(k);
+    if (k % 4096 == 0)
+      sched_yield();
+  }
+  done = 1;
+  return NULL;
+}
+
+/* Kept records that mix two writes: fields from different k */
+static uint64_t
+torn(size_t n)
+{
+  uint64_t bad = 0;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    bad += out[i].tr_seq != out[i].tr_a0 + 1 ||
+      out[i].tr_a1 != ~out[i].tr_a0 || out[i].tr_ev != (uint16_t)out[i].tr_a0;
+  return bad;
+}
+
+static void
+t_race(void)
+{
+  uint64_t lost, kept = 0, bad = 0, count = 0, plain = 0, snaps = 0;
+  pthread_t wt;
+  size_t n;
+
+  memset(&tbuf, 0, sizeof(tbuf));
+  pthread_create(&wt, NULL, writer, NULL);
+  while (!done) {
+    das_trace_snap(&snap, &tbuf);
+    n = das_trace_collect(&snap, out, &lost);
+    kept += n;
+    bad += torn(n);
+    count += n + lost != snap.tc_next;
+    n = das_trace_collect(&tbuf, out, &lost);
+    kept += n;
+    bad += torn(n);
+    memcpy(&snap, &tbuf, sizeof(snap));
+    n = das_trace_collect(&snap, out, &lost);
+    plain += torn(n);
+    snaps++;
+  }
+  pthread_join(wt, NULL);
+  check("reader raced the writer", snaps > 100 && kept > 0);
+  check("no torn record kept", bad == 0);
+  check("every record kept or lost", count == 0);
+  printf("%-40s %llu snapshots, %llu torn with memcpy\n", "race",
+	 (unsigned long long)snaps, (unsigned long long)plain);
+}
+
+static uint64_t
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+t_bench(void)
+{
+  uint64_t t0, tput, tcoll, tsnap, lost, n = 0;
+  uint32_t k;
+  int i;
+
+  memset(&tbuf, 0, sizeof(tbuf));
+  t0 = now();
+  for (k = 0; k < NPUT; k++)
+    put(k);
+  tput = now() - t0;
+  t0 = now();
+  for (i = 0; i < NREP; i++)
+    n += das_trace_collect(&tbuf, out, &lost);
+  tcoll = now() - t0;
+  t0 = now();
+  for (i = 0; i < NREP; i++)
+    das_trace_snap(&snap, &tbuf);
+  tsnap = now() - t0;
+  check("bench: every record collected",
+	n == (uint64_t)NREP * DAS_TRACE_NREC && intact(DAS_TRACE_NREC,
+	NPUT - DAS_TRACE_NREC));
+  printf("%-40s put %.1f  collect %.2f  snapshot %.2f ns/record\n", "bench",
+	 (double)tput / NPUT, (double)tcoll / n,
+	 (double)tsnap / ((uint64_t)NREP * DAS_TRACE_NREC));
+}
+
+/* The buffer as DAS_GET_TRACE would hand it out, for dastrace -r */
+static void
+dump(const char *path)
+{
+  struct das_trace_hdr th;
+  FILE *f;
+  int ok;
+
+  th.th_magic = DAS_TRACE_MAGIC;
+  th.th_version = DAS_TRACE_VERSION;
+  th.th_ncpu = 1;
+  th.th_nrec = DAS_TRACE_NREC;
+  das_trace_snap(&snap, &tbuf);
+  ok = (f = fopen(path, "w")) != NULL && fwrite(&th, sizeof(th), 1, f) == 1 &&
+    fwrite(&snap, sizeof(snap), 1, f) == 1;
+  if (f != NULL)
+    ok = fclose(f) == 0 && ok;
+  check("dump written", ok);
+}
+
+int
+main(int argc, char **argv)
+{
+  trace = &tbuf;
+  t_collect();
+  t_torn();
+  if (argc > 1)
+    dump(argv[1]);
+  t_race();
+  t_bench();
+  return failed != 0;
+}
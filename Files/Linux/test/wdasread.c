@@ -0,0 +1,143 @@
+/* wdasread -- the das1 driver's sample ring and read scheduling
+ *
+ * usage: wdasread
+ *
+ * wdasread.h on its own, through the WDK stand-ins.  The ring is checked
+ * against a plain model: words come out in order, a full ring drops its
+ * oldest word and says so, and copies that cross the end of the buffer
+ * split into two spans.  A long random run of puts and copy-outs of odd
+ * sizes on small rings has to agree with the model word for word.
+ * das1ReadNeed and das1ReadTake are checked on every case of the
+ * watermark and the three modes.
+ */
+#include <ntddk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "wdasread.h"
+#include "check.h"
+
+#define MAXSIZE 64
+
+/* The ring as a list: words in order, oldest first */
+struct model {
+  ULONG m_w[MAXSIZE];
+  ULONG m_n;
+};
+
+static void
+model_put(struct model *m, ULONG size, ULONG w, BOOLEAN *dropped)
+{
+  *dropped = m->m_n == size - 1;
+  if (*dropped) {
+    memmove(m->m_w, m->m_w + 1, (m->m_n - 1) * sizeof(ULONG));
+    m->m_n--;
+  }
+  m->m_w[m->m_n++] = w;
+}
+
+/* Random puts and copy-outs on a ring of size; 1 if it kept to the model */
+static int
+run(ULONG size, ULONG ops)
+{
+  ULONG buf[MAXSIZE], out[MAXSIZE], wr = 0, rd = 0, next = 1, i, k, n;
+  ULONG first, second;
+  struct model m;
+  BOOLEAN drop, mdrop;
+
+  memset(&m, 0, sizeof(m));
+  for (i = 0; i < ops; i++) {
+    if (random() % 3 != 0) {
+      drop = das1RingPut(buf, size, &wr, &rd, next);
+      model_put(&m, size, next++, &mdrop);
+      if (drop != mdrop)
+	return 0;
+    } else {
+      n = random() % size;
+      if (n > das1RingCount(wr, rd, size))
+	n = das1RingCount(wr, rd, size);
+      first = das1RingSpan(rd, n, size, &second);
+      if (first + second != n || rd + first > size ||
+	  (second != 0 && rd + first != size))
+	return 0;
+      das1RingCopyOut(buf, size, &rd, out, n);
+      for (k = 0; k < n; k++)
+	if (out[k] != m.m_w[k])
+	  return 0;
+      memmove(m.m_w, m.m_w + n, (m.m_n - n) * sizeof(ULONG));
+      m.m_n -= n;
+    }
+    if (das1RingCount(wr, rd, size) != m.m_n || wr >= size || rd >= size)
+      return 0;
+  }
+  return 1;
+}
+
+int
+main(void)
+{
+  static const struct {
+    ULONG avail, want, wm, mode;
+    BOOLEAN ret;
+    ULONG take;
+  } takes[] = {
+    { 0, 64, 16, DAS_READ_WAIT, FALSE, 0 },
+    { 15, 64, 16, DAS_READ_WAIT, FALSE, 15 },
+    { 16, 64, 16, DAS_READ_WAIT, TRUE, 16 },
+    { 100, 64, 16, DAS_READ_WAIT, TRUE, 64 },
+    { 8, 8, 16, DAS_READ_WAIT, TRUE, 8 },	/* want under the watermark */
+    { 7, 8, 16, DAS_READ_WAIT, FALSE, 7 },
+    { 1, 64, 0, DAS_READ_WAIT, TRUE, 1 },	/* watermark 0 is 1 */
+    { 0, 64, 0, DAS_READ_WAIT, FALSE, 0 },
+    { 3, 64, 16, DAS_READ_EXPIRED, TRUE, 3 },
+    { 0, 64, 16, DAS_READ_EXPIRED, FALSE, 0 },
+    { 3, 64, 16, DAS_READ_FLUSH, TRUE, 3 },
+    { 0, 64, 16, DAS_READ_FLUSH, TRUE, 0 },
+  };
+  ULONG buf[8], out[8], wr, rd, i, take, second;
+  BOOLEAN drop, ok;
+  char what[64];
+
+  check("count without a wrap", das1RingCount(5, 2, 8) == 3);
+  check("count across the end", das1RingCount(1, 6, 8) == 3);
+  check("count when empty", das1RingCount(4, 4, 8) == 0);
+
+  wr = rd = 6;
+  for (i = 0, ok = TRUE; i < 7; i++)
+    ok &= !das1RingPut(buf, 8, &wr, &rd, 100 + i);
+  check("seven words fit in eight", ok && das1RingCount(wr, rd, 8) == 7 &&
+	wr == 5 && rd == 6);
+  drop = das1RingPut(buf, 8, &wr, &rd, 107);
+  check("the eighth drops the oldest", drop && rd == 7 &&
+	das1RingCount(wr, rd, 8) == 7);
+  check("span splits at the end",
+	das1RingSpan(rd, 7, 8, &second) == 1 && second == 6);
+  das1RingCopyOut(buf, 8, &rd, out, 7);
+  for (i = 0, ok = TRUE; i < 7; i++)
+    ok &= out[i] == 101 + i;
+  check("the newest seven, in order", ok && rd == wr);
+  check("span that ends at the end",
+	das1RingSpan(5, 3, 8, &second) == 3 && second == 0);
+  rd = 5;
+  das1RingCopyOut(buf, 8, &rd, out, 3);
+  check("reader wraps to 0 at the end", rd == 0);
+
+  srandom(41);
+  check("random run on 2 words", run(2, 200000));
+  check("random run on 7 words", run(7, 1000000));
+  check("random run on 64 words", run(64, 1000000));
+
+  check("need: want under the watermark", das1ReadNeed(8, 16) == 8);
+  check("need: the watermark", das1ReadNeed(64, 16) == 16);
+  check("need: watermark 0 is 1", das1ReadNeed(64, 0) == 1);
+  for (i = 0; i < sizeof(takes) / sizeof(takes[0]); i++) {
+    take = 0xdead;
+    ok = das1ReadTake(takes[i].avail, takes[i].want, takes[i].wm,
+		      takes[i].mode, &take) == takes[i].ret &&
+	take == takes[i].take;
+    snprintf(what, sizeof(what), "take %lu of %lu, mark %lu, mode %lu",
+	     (unsigned long)takes[i].avail, (unsigned long)takes[i].want,
+	     (unsigned long)takes[i].wm, (unsigned long)takes[i].mode);
+    check(what, ok);
+  }
+  return failed != 0;
+}
@@ -0,0 +1,211 @@
+/* wdasroute -- which queue each das1 IOCTL reaches
+ *
+ * usage: wdasroute
+ *
+ * Every IOCTL_DAS_ code that wdasio.h defines is listed here with the
+ * queue it is meant for, and das1Route has to agree; the list is checked
+ * against the text of wdasio.h so a new code cannot go unrouted.
+ * MAP_RING and UNMAP_RING are done in the caller's context and must not
+ * be in das1Routes at all.  Then each code is sent to the driver on an
+ * emulated board: status codes are handed to the default queue only,
+ * configuration codes to the default queue and then the configuration
+ * queue, the two ring codes to no queue, and unknown codes are refused
+ * on the default queue.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <ntddk.h>
+#include <wdf.h>
+
+#include "driver.h"	/* and wdasio.h */
+#include "wdasroute.h"
+#include "wdf_shim.h"
+#include "check.h"
+
+#ifndef WDASIO
+#define WDASIO "../Windows/das1/wdasio.h"
+#endif
+
+#define ROUTE_CALLER 3	/* not routed: done in EvtIoInCallerContext */
+
+static const struct {
+  const char *name;
+  ULONG code;
+  ULONG route;
+} ioctls[] = {
+  { "IOCTL_DAS_START_SAMPLING", IOCTL_DAS_START_SAMPLING, DAS_ROUTE_CONFIG },
+  { "IOCTL_DAS_STOP_SAMPLING", IOCTL_DAS_STOP_SAMPLING, DAS_ROUTE_CONFIG },
+  { "IOCTL_DAS_SET_RATE", IOCTL_DAS_SET_RATE, DAS_ROUTE_CONFIG },
+  { "IOCTL_DAS_GET_RATE", IOCTL_DAS_GET_RATE, DAS_ROUTE_STATUS },
+  { "IOCTL_DAS_SET_CHANNEL", IOCTL_DAS_SET_CHANNEL, DAS_ROUTE_CONFIG },
+  { "IOCTL_DAS_GET_CHANNEL", IOCTL_DAS_GET_CHANNEL, DAS_ROUTE_STATUS },
+  { "IOCTL_DAS_GET_REGISTER", IOCTL_DAS_GET_REGISTER, DAS_ROUTE_CONFIG },
+  { "IOCTL_DAS_SET_REGISTER", IOCTL_DAS_SET_REGISTER, DAS_ROUTE_CONFIG },
+  { "IOCTL_DAS_REGISTER_BATCH", IOCTL_DAS_REGISTER_BATCH, DAS_ROUTE_CONFIG },
+  { "IOCTL_DAS_MAP_RING", IOCTL_DAS_MAP_RING, ROUTE_CALLER },
+  { "IOCTL_DAS_UNMAP_RING", IOCTL_DAS_UNMAP_RING, ROUTE_CALLER },
+  { "IOCTL_DAS_GET_TRACE", IOCTL_DAS_GET_TRACE, DAS_ROUTE_STATUS },
+};
+
+#define NIOCTL (sizeof(ioctls) / sizeof(ioctls[0]))
+#define NROUTE (sizeof(das1Routes) / sizeof(das1Routes[0]))
+
+/* Codes next to the real ones that nothing should accept */
+static const ULONG unknown[] = {
+  CTL_CODE(DAS_TYPE, 0xFEF, METHOD_BUFFERED, FILE_READ_ACCESS),
+  CTL_CODE(DAS_TYPE, 0xFFC, METHOD_BUFFERED, FILE_READ_ACCESS),
+  CTL_CODE(DAS_TYPE, 0xFF0, METHOD_BUFFERED, FILE_WRITE_ACCESS),
+  CTL_CODE(DAS_TYPE + 1, 0xFF3, METHOD_BUFFERED, FILE_READ_ACCESS),
+  0,
+};
+
+static int
+known(const char *name)
+{
+  unsigned int i;
+
+  for (i = 0; i < NIOCTL; i++)
+    if (strcmp(ioctls[i].name, name) == 0)
+      return 1;
+  return 0;
+}
+
+/* Every #define IOCTL_DAS_ in wdasio.h is in ioctls[] */
+static void
+t_header(void)
+{
+  char line[256], name[64], what[80];
+  unsigned int n = 0;
+  FILE *f;
+
+  f = fopen(WDASIO, "r");
+  check("wdasio.h opens", f != NULL);
+  if (f == NULL)
+    return;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, " # define %63[A-Z_0-9]", name) != 1 ||
+	strncmp(name, "IOCTL_DAS_", 10) != 0)
+      continue;
+    snprintf(what, sizeof(what), "listed: %s", name + 6);
+    check(what, known(name));
+    n++;
+  }
+  fclose(f);
+  check("as many codes as listed", n == NIOCTL);
+}
+
+static void
+t_table(void)
+{
+  char what[80];
+  unsigned int i, j, dup, listed;
+
+  for (i = 0; i < NIOCTL; i++) {
+    snprintf(what, sizeof(what), "route: %s", ioctls[i].name + 6);
+    check(what, das1Route(ioctls[i].code) ==
+	  (ioctls[i].route == ROUTE_CALLER ? DAS_ROUTE_INVALID :
+	   ioctls[i].route));
+  }
+  for (i = dup = listed = 0; i < NROUTE; i++) {
+    for (j = i + 1; j < NROUTE; j++)
+      dup += das1Routes[i].IoControlCode == das1Routes[j].IoControlCode;
+    for (j = 0; j < NIOCTL; j++)
+      if (ioctls[j].code == das1Routes[i].IoControlCode &&
+	  ioctls[j].route == das1Routes[i].Route)
+	break;
+    listed += j < NIOCTL;
+  }
+  check("no code twice in the table", dup == 0);
+  check("every table entry as listed", listed == NROUTE);
+  for (i = 0; i < NROUTE; i++)
+    if (das1Routes[i].IoControlCode == IOCTL_DAS_MAP_RING ||
+	das1Routes[i].IoControlCode == IOCTL_DAS_UNMAP_RING)
+      break;
+  check("map and unmap not in the table", i == NROUTE);
+  for (i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++)
+    if (das1Route(unknown[i]) != DAS_ROUTE_INVALID)
+      break;
+  check("unknown codes are invalid", i == sizeof(unknown) / sizeof(unknown[0]));
+}
+
+/* Send one code and see which queues were handed it */
+static void
+send(WDFFILEOBJECT file, WDFQUEUE dflt, WDFQUEUE config, WDFQUEUE read,
+     const char *name, ULONG code, ULONG route)
+{
+  static UCHAR in[4096], out[4096];
+  ULONG d0, c0, r0, d, c;
+  ULONG_PTR info;
+  NTSTATUS status;
+  char what[80];
+
+  memset(in, 0, sizeof(in));
+  d0 = wdfshim_dispatched(dflt);
+  c0 = wdfshim_dispatched(config);
+  r0 = wdfshim_dispatched(read);
+  status = wdfshim_ioctl(file, code, in, sizeof(in), out, sizeof(out), &info);
+  d = wdfshim_dispatched(dflt) - d0;
+  c = wdfshim_dispatched(config) - c0;
+  snprintf(what, sizeof(what), "queues: %s", name);
+  switch (route) {
+  case DAS_ROUTE_STATUS:
+    check(what, d == 1 && c == 0);
+    break;
+  case DAS_ROUTE_CONFIG:
+    check(what, d == 1 && c == 1);
+    break;
+  case ROUTE_CALLER:
+    check(what, d == 0 && c == 0 && status != STATUS_INVALID_DEVICE_REQUEST);
+    break;
+  default:
+    check(what, d == 1 && c == 0 && status == STATUS_INVALID_DEVICE_REQUEST);
+    break;
+  }
+  if (wdfshim_dispatched(read) != r0)
+    check("no IOCTL on the read queue", 0);
+}
+
+static void
+t_driver(void)
+{
+  static UNICODE_STRING path;
+  struct dasshim_board *sb;
+  PDEVICE_CONTEXT context;
+  WDFDEVICE device;
+  WDFFILEOBJECT file;
+  WDFQUEUE dflt;
+  char what[80];
+  unsigned int i;
+
+  sb = dasshim_board_add();
+  check("DriverEntry", NT_SUCCESS(DriverEntry(&wdfshim_driver_object, &path)));
+  check("add device", NT_SUCCESS(wdfshim_add_device(sb, &device)));
+  dasshim_start();
+  check("create", NT_SUCCESS(wdfshim_create(device, &file)));
+  context = DeviceGetContext(device);
+  dflt = WdfDeviceGetDefaultQueue(device);
+  check("three distinct queues", dflt != NULL &&
+	context->ConfigQueue != NULL && context->ReadQueue != NULL &&
+	dflt != context->ConfigQueue && dflt != context->ReadQueue &&
+	context->ConfigQueue != context->ReadQueue);
+  for (i = 0; i < NIOCTL; i++)
+    send(file, dflt, context->ConfigQueue, context->ReadQueue,
+	 ioctls[i].name + 6, ioctls[i].code, ioctls[i].route);
+  for (i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++) {
+    snprintf(what, sizeof(what), "0x%08lx", (unsigned long)unknown[i]);
+    send(file, dflt, context->ConfigQueue, context->ReadQueue, what,
+	 unknown[i], DAS_ROUTE_INVALID);
+  }
+  wdfshim_close(file);
+  dasshim_stop();
+}
+
+int
+main(void)
+{
+  t_header();
+  t_table();
+  t_driver();
+  return failed != 0;
+}
@@ -18,6 +18,15 @@ __KERNEL_RCSID(0, "$NetBSD: das.c,v 1.0.0.0 2024/01/27 15:50:13 jenson Exp $");
 #include <sys/ioctl.h>
 #include <sys/poll.h>
 #include <sys/conf.h>
+#include <sys/file.h>
+#include <sys/evcnt.h>
+#include <sys/sysctl.h>
+#include <sys/atomic.h>
+#include <sys/sdt.h>
+#include <sys/xcall.h>
+#include <sys/select.h>
+#include <sys/event.h>
+#include <sys/cpu.h>
 
 // for current condvar implementation
 #include <sys/condvar.h>
@@ -25,6 +34,22 @@ __KERNEL_RCSID(0, "$NetBSD: das.c,v 1.0.0.0 2024/01/27 15:50:13 jenson Exp $");
 
 //das header file
 #include <dev/pci/dasio.h>
+#include <dev/pci/dasreg.h>
+#include <dev/pci/dashist.h>
+#include <dev/pci/dasring.h>
+#include <dev/pci/daslatest.h>
+#include <dev/pci/dasreflex.h>
+#include <dev/pci/dasfreq.h>
+#include <dev/pci/dastrace.h>
+
+// dasbatch.h runs register lists through these, see das_register_batch
+static uint32_t das_batch_read(void *, u_int, u_int);
+static void das_batch_write(void *, u_int, u_int, uint32_t);
+static uint64_t das_batch_now(void);
+#define DAS_BATCH_READ(ctx, bar, off) das_batch_read((ctx), (bar), (off))
+#define DAS_BATCH_WRITE(ctx, bar, off, val) das_batch_write((ctx), (bar), (off), (val))
+#define DAS_BATCH_NOW(ctx) das_batch_now()
+#include <dev/pci/dasbatch.h>
 
 //pci
 #include <dev/pci/pcidevs.h>
@@ -37,39 +62,209 @@ __KERNEL_RCSID(0, "$NetBSD: das.c,v 1.0.0.0 2024/01/27 15:50:13 jenson Exp $");
 #include "ioconf.h"
 
 
+/*
+ * Static probes, das::<function>:<name>.  They cost a patched-out branch
+ * until dtrace enables them.  The argument lists are an interface for
+ * the scripts in dtrace/: new arguments go on the end, existing ones do
+ * not change meaning or position.
+ *
+ *   intr:entry     sc, CTR1 status, sc_prod
+ *   intr:eoc       sc, extra EOC polls, CTR1 status
+ *   intr:sample    sc, 12 bit sample, latency in ticks, ring fill
+ *   intr:overrun   sc, sc_prod, sc_cons
+ *   intr:return    sc, port accesses this pass
+ *   read:block     sc, sc_cons, bytes wanted
+ *   read:wake      sc, cv_wait_sig error, ring fill
+ *   read:copy      sc, samples copied, sc_cons before the copy
+ *   ioctl:config   sc, ioctl cmd, new value (rate, channel or 0)
+ *   trace:event    DAS_TEV_* event, a0, a1 (see dastrace.h)
+ */
+SDT_PROVIDER_DEFINE(das);
+SDT_PROBE_DEFINE3(das, , intr, entry,
+    "struct das_softc *", "uint8_t", "u_int");
+SDT_PROBE_DEFINE3(das, , intr, eoc,
+    "struct das_softc *", "uint32_t", "uint8_t");
+SDT_PROBE_DEFINE4(das, , intr, sample,
+    "struct das_softc *", "uint16_t", "uint16_t", "u_int");
+SDT_PROBE_DEFINE3(das, , intr, overrun,
+    "struct das_softc *", "u_int", "u_int");
+SDT_PROBE_DEFINE2(das, , intr, return,
+    "struct das_softc *", "uint32_t");
+SDT_PROBE_DEFINE3(das, , read, block,
+    "struct das_softc *", "u_int", "size_t");
+SDT_PROBE_DEFINE3(das, , read, wake,
+    "struct das_softc *", "int", "u_int");
+SDT_PROBE_DEFINE3(das, , read, copy,
+    "struct das_softc *", "u_int", "u_int");
+SDT_PROBE_DEFINE3(das, , ioctl, config,
+    "struct das_softc *", "u_long", "int");
+SDT_PROBE_DEFINE3(das, , trace, event,
+    "uint16_t", "uint64_t", "uint64_t");
+
+/*
+ * Flight recorder for the whole driver, one buffer per CPU, allocated by
+ * the first attach unless DAS_TRACE_LEVEL is 0.
+ */
+static struct das_trace_cpu *das_trace_buf;
+static u_int das_trace_ncpu;
+#define DAS_TRACE_BUF das_trace_buf
+#define DAS_TRACE_NCPU das_trace_ncpu
+#define DAS_TRACE_BACKEND(ev, a0, a1) SDT_PROBE3(das, , trace, event, ev, a0, a1)
+
 static dev_type_open(das_open);
 static dev_type_close(das_close);
 static dev_type_ioctl(das_ioctl);
 static dev_type_write(das_write);
 static dev_type_read(das_read);
+static dev_type_poll(das_poll);
+static dev_type_kqfilter(das_kqfilter);
+static dev_type_mmap(das_mmap);
+
+/*
+ * Statistics.  Every counter has exactly one writer: das_intr for the
+ * acquisition side, the reader (under sc_mtx) for the read side.  The
+ * interrupt is serialized by the kernel, so these are plain increments
+ * with no lock and no atomic op on the hot path.
+ */
+struct das_evcnts {
+  struct evcnt ev_intr;		/* interrupts taken */
+  struct evcnt ev_samples;	/* samples produced */
+  struct evcnt ev_read;		/* samples read */
+  struct evcnt ev_overrun;	/* samples dropped, ring full */
+  struct evcnt ev_spurious;	/* interrupts with CTR1 & 8 clear */
+  struct evcnt ev_eocspin;	/* extra EOC polls */
+  struct evcnt ev_wakeup;	/* reader wakeups */
+  struct evcnt ev_burst;	/* scheduled bursts started */
+  struct evcnt ev_burstskip;	/* scheduled bursts skipped */
+  struct evcnt ev_reflex;	/* reflex output changes */
+};
+
+struct das_softc;
+
+/*
+ * One pass of the acquisition path for an interrupt that is ours: CTR1
+ * status as first read, and the port access count before that read.
+ */
+typedef int das_acq_t(struct das_softc *, uint8_t, uint32_t);
 
 struct das_softc {
   struct device sc_dev;
   pci_intr_handle_t *	sc_ih;
   pci_intr_handle_t * sc_isave;
-  bus_space_tag_t sc_iot;
-  bus_space_handle_t sc_ioh;
+  struct das_regs sc_regs;	/* BADR1/BADR2 access, CTR1 shadow */
   
-  uint8_t ctrl_word;
   int  sc_flags;		/* misc. flags. */
-  callout_t sc_ch;    /* callout pseudo-interrupt */
+  callout_t sc_ch;    /* burst schedule, see das_burst_tick */
   int sc_open;
   int sc_rate;
   int sc_channel;
-  int sc_samp;
+  volatile int sc_samp;	/* das_intr clears it to end a finite run */
+  das_acq_t *volatile sc_acq;	/* das_acq_idle unless sampling, see das_acq_select */
+  volatile u_int sc_remain;	/* conversions left in a finite run, 0 if continuous */
 
   // data buffers
+  /* sc_prod is only written by das_intr and sc_cons only by das_read;
+   * both run free and the slot is the count modulo sc_bufsize. */
   uint32_t* sc_buf;
+  u_int sc_bufsize;	/* ring size, power of 2 */
   uint16_t sc_time_offset;
-  int sc_intr_ptr;
-  int sc_reader_ptr;
+  volatile u_int sc_prod;	/* samples put in the ring */
+  volatile u_int sc_cons;	/* samples taken out */
+  volatile int sc_rwait;	/* a reader is asleep on sc_cv */
+  volatile int sc_selwait;	/* poll or kqueue wants das_softintr */
+  struct selinfo sc_selq;	/* poll and kqueue, under sc_mtx */
+  u_int sc_rwant;	/* ring fill that wakes it */
+  u_int sc_maxfill;	/* high water mark of sc_prod - sc_cons */
   
-  uint8_t sc_ad_high;
-  uint8_t sc_ad_low;
   uint16_t sc_sample;
+  uint32_t sc_intr_io;	/* port accesses in the last das_intr pass */
+
+  // latency histograms, only das_intr adds to them
+  struct das_latency_hist sc_hist;
+  uint16_t sc_last_lat;	/* previous latency, for jitter */
+  int sc_have_lat;	/* sc_last_lat is from this run */
+  volatile int sc_hist_reset;	/* das_intr clears before its next add */
+
+  /* Scan list and format, read by das_intr.  While sampling they only
+   * change from das_intr itself, see das_configure. */
+  u_int sc_nscan;
+  u_int sc_scanidx;	/* entry being converted */
+  uint8_t sc_scan[DAS_MAX_SCAN];
+  uint32_t sc_format;
+  u_int sc_watermark;
+  kmutex_t sc_cfglock;	/* one DAS_CONFIGURE at a time */
+  /* The CTR1 shadow, the 8254 control word and counter 2 belong to
+   * das_intr, which holds this for its whole pass; anything else that
+   * touches them takes it too. */
+  kmutex_t sc_intrlock;
+  struct das_config sc_pend;	/* checked, waiting for a sample boundary */
+  volatile u_int sc_cfgpend;	/* sc_pend is valid, das_intr claims it */
+
+  /* Queued reconfiguration.  Single producer (ioctl, under sc_cfglock)
+   * and single consumer (das_intr), so only sc_cq_prod moves on one side
+   * and sc_cq_cons on the other. */
+  struct das_config_at sc_cq[DAS_CQ_SIZE];
+  volatile u_int sc_cq_prod;
+  volatile u_int sc_cq_cons;
+  volatile u_int sc_cq_flush;	/* das_intr skips sc_cq_cons up to sc_cq_flushto */
+  u_int sc_cq_flushto;
+  struct das_config sc_cq_last;	/* settings once the queue has drained */
+  u_int sc_nsamp;	/* conversions since open, das_intr only */
+
+  // in-band records owed, set before a run and cleared by das_intr
+  volatile u_int sc_recpend;	/* DAS_RP_* */
+  u_int sc_runcount;	/* das_start's count, for DAS_REC_START */
+  uint16_t sc_rectrig;	/* burst sequence for DAS_RP_TRIGGER */
+  int sc_recrun;	/* a DAS_REC_START went out, a STOP is owed */
+  u_int sc_dropped;	/* samples dropped since the last overrun record */
+  u_int sc_dropfirst;
+  uint8_t sc_dio;	/* inputs last reported, 0xff before the first */
+  u_int sc_dio_nsamp;	/* sample they changed at */
+
+  /* Mapped slot ring.  sc_ringmem is allocated by the first setup and
+   * kept, since a mapping can outlive the setup that made it.  The rest
+   * is under sc_mtx: das_ring_fill is a consumer like das_read. */
+  void *sc_ringmem;	/* control page, then the slots */
+  vsize_t sc_ringsize;
+  int sc_ringon;
+  struct das_ring_ctl *sc_ringctl;
+  uint32_t *sc_ringslots;
+  struct das_ring_prod sc_ringprod;
+  int sc_ringend;	/* this run's DAS_CQE_END is posted */
+  uint64_t sc_ringover;	/* ev_overrun at setup */
+
+  /* Reflex rules.  das_intr reads sc_reflex only while sc_nreflex is
+   * nonzero, so das_set_reflex zeroes it and waits out das_intr first. */
+  struct das_reflex sc_reflex;
+  struct das_reflex_stats sc_reflexst;	/* das_intr only */
+  volatile u_int sc_nreflex;
+
+  /* Frequency counter.  sc_freq and the gate belong to das_freq_tick
+   * once it is scheduled; das_set_freq halts it before changing them.
+   * sc_freqval is under sc_mtx. */
+  callout_t sc_fch;
+  struct das_freq sc_freq;	/* df_gate_ms 0 when stopped */
+  int sc_freq_ticks;
+  struct das_freq_gate sc_fgate;
+  struct das_freq_val sc_freqval;
+
+  // newest sample per channel, a wired page das_intr writes
+  struct das_latest *sc_latest;
+
+  // burst schedule, under sc_cfglock
+  struct das_burst sc_burst;	/* db_count 0 when disarmed */
+  int sc_burst_ticks;	/* period in ticks */
+  u_int sc_burst_seq;
+  u_int sc_burst_skipped;
+  u_int sc_burst_head;	/* next slot in sc_burst_log */
+  struct das_burst_tag sc_burst_log[DAS_BURST_NLOG];
   // condvar
   kcondvar_t sc_cv;
   kmutex_t sc_mtx;
+  void *sc_si;		/* softint that wakes readers */
+
+  struct das_evcnts sc_ev;
+  struct sysctllog *sc_log;
 };
 
 //dispatch table
@@ -81,9 +276,9 @@ const struct cdevsw das_cdevsw = {
 	.d_ioctl = das_ioctl,
 	.d_stop = nostop,
 	.d_tty = notty,
-	.d_poll = nopoll,
-	.d_mmap = nommap,
-	.d_kqfilter = nokqfilter,
+	.d_poll = das_poll,
+	.d_mmap = das_mmap,
+	.d_kqfilter = das_kqfilter,
 	.d_discard = nodiscard,
 	.d_flag = D_OTHER
 };
@@ -97,6 +292,52 @@ static int das_read(dev_t, struct uio *, int);
 static int das_write(dev_t, struct uio *, int);
 static int das_ioctl(dev_t, u_long, void*, int, struct lwp *);
 static int das_intr(void *p);
+static das_acq_t das_acq_idle;
+static das_acq_t *das_acq_select(struct das_softc *);
+static void das_softintr(void *p);
+static void das_wakeup(struct das_softc *);
+static void das_stats_attach(struct das_softc *, const char *);
+static void das_get_stats(struct das_softc *, struct das_stats *);
+static void das_hist_reset(struct das_softc *);
+static void das_start(struct das_softc *, u_int);
+static void das_stop(struct das_softc *);
+static void das_intr_barrier(struct das_softc *);
+static void das_update_ctr1(struct das_softc *, uint8_t, uint8_t);
+static int das_rate_check(u_int);
+static int das_config_check(const struct das_config *, u_int);
+static void das_config_apply(struct das_softc *, const struct das_config *);
+static void das_config_get(struct das_softc *, struct das_config *);
+static int das_configure(struct das_softc *, struct das_config *);
+static int das_register_batch(struct das_softc *, struct das_regbatch *, int);
+static int das_set_burst(struct das_softc *, const struct das_burst *);
+static void das_get_burst_log(struct das_softc *, struct das_burst_log *);
+static void das_burst_tick(void *);
+static int das_cq_put(struct das_softc *, const struct das_config_at *);
+static int das_cq_flush(struct das_softc *);
+static void das_cq_base(struct das_softc *, struct das_config *);
+static int das_cq_due(const struct das_config_at *, u_int);
+static uint32_t das_cq_scanword(struct das_softc *);
+static int das_cq_room(struct das_softc *, const struct das_config_at *);
+static u_int das_ring_limit(struct das_softc *);
+static int das_rec_put(struct das_softc *, uint32_t, const uint32_t *, u_int, u_int);
+static void das_rec_pre(struct das_softc *, u_int);
+static void das_rec_stop(struct das_softc *, u_int, u_int);
+static int das_ring_setup(struct das_softc *, struct das_ring_setup *);
+static void das_ring_fill(struct das_softc *);
+static int das_ring_wait(struct das_softc *, int);
+static void das_get_latest(struct das_softc *, struct das_latest_snap *);
+static int das_set_reflex(struct das_softc *, const struct das_reflex *);
+static int das_set_freq(struct das_softc *, const struct das_freq *);
+static void das_freq_tick(void *);
+static int das_get_trace(struct das_trace_get *);
+
+#define DAS_RP_START 0x01
+#define DAS_RP_TIME 0x02
+#define DAS_RP_TRIGGER 0x04
+#define DAS_RP_DIO 0x08
+
+/* The CTR1 bits the driver sets outright; OP2-OP4 are the reflex rules' */
+#define DAS_CTR1_OWN (DAS_CTR1_MUX|DAS_CTR1_INTE|DAS_CTR1_OP1)
 
 
 CFATTACH_DECL_NEW(
@@ -137,47 +378,46 @@ static void das_attach(device_t parent, device_t self, void *aux)
 
   const char *intrstr;
   char intrbuf[PCI_INTRSTR_LEN];
-  sc->sc_intr_ptr =0;
-  sc->sc_reader_ptr = 0;
-  sc->sc_ad_high = BAR2;
-  sc->sc_ad_low = BAR2 + 0x1;
+  sc->sc_prod = 0;
+  sc->sc_cons = 0;
+  sc->sc_rwait = 0;
   sc->sc_sample = 0;
   sc->sc_samp = 0;
+  sc->sc_bufsize = DAS_DEFAULT_BUFSIZE;
+  sc->sc_watermark = 1;
+  sc->sc_nscan = 1;
+  sc->sc_hist.lh_clock_khz = CLOCK_SPEED;
+  das_hist_reset(sc);
   /* Map I/O registers <-- confirm if needed*/
   // This is pulled from oboe.c, might need ajusting for register num
   
   //need to map BADR1 and set values
   if (pci_mapreg_map(pa,BAR1, PCI_MAPREG_TYPE_IO, 0,
-		     &sc->sc_iot, &sc->sc_ioh, NULL, NULL)) {
+		     &sc->sc_regs.dr_iot1, &sc->sc_regs.dr_ioh1, NULL, NULL)) {
     printf("Could not map I/O space\n");
     return;
   }
   //read in 32 bits from BADDR1 +0x4c, set bits, then write back
-  cmd = bus_space_read_4(sc->sc_iot,sc->sc_ioh,0x4c);
+  cmd = das_reg_read_4_b1(&sc->sc_regs, DAS_BADR1_INTCSR);
   //printf("CMD initial:%d\n",cmd);
   cmd = (cmd & ~0xff)^0x41;
   //printf("CMD after mod :%d\n",cmd);
-  bus_space_write_4(sc->sc_iot,sc->sc_ioh,0x4c,cmd);
+  das_reg_write_4_b1(&sc->sc_regs, DAS_BADR1_INTCSR, cmd);
   //read in 32 bits from baddr1+0x50, set bits, then write back
-  cmd = bus_space_read_4(sc->sc_iot,sc->sc_ioh,0x50);
+  cmd = das_reg_read_4_b1(&sc->sc_regs, DAS_BADR1_CNTRL);
   cmd = (cmd & ~0x7)^0x6;
-  bus_space_write_4(sc->sc_iot,sc->sc_ioh,0x50,cmd);
+  das_reg_write_4_b1(&sc->sc_regs, DAS_BADR1_CNTRL, cmd);
   
-  //unmap badr1
-  //probably won't worry about unmapping it.
-  //bus_space_unmap(sc->sc_iot,sc->sc_ioh,32); //need to ask about size
+  //badr1 stays mapped in dr_ioh1
   //map BADR2
   
   if (pci_mapreg_map(pa, BAR2, PCI_MAPREG_TYPE_IO,0,
-  		     &sc->sc_iot,&sc->sc_ioh,NULL,NULL)){
+  		     &sc->sc_regs.dr_iot,&sc->sc_regs.dr_ioh,NULL,NULL)){
     printf("Could not map I/O space\n");
     return;
   }
-  // //disable interupts before open.
-  // uint8_t word = bus_space_read_1(sc->sc_iot,sc->sc_ioh,CTR1);
-  // word = word & 7;
-  // printf("word= %d\n",word);
-  // bus_space_write_1(sc->sc_iot,sc->sc_ioh,CTR1,word);
+  //disable interupts before open, this also seeds the CTR1 shadow
+  das_reg_set_ctr1(&sc->sc_regs, 0);
   
   //printf("Debug1\n");
    // example pci_intr_map given by if_le_pci.c
@@ -190,10 +430,35 @@ static void das_attach(device_t parent, device_t self, void *aux)
    cv_init(&sc->sc_cv, "condvar");
    //printf("cv_init success\n");
    mutex_init(&sc->sc_mtx, MUTEX_DEFAULT, IPL_NONE);
+   mutex_init(&sc->sc_cfglock, MUTEX_DEFAULT, IPL_NONE);
+   mutex_init(&sc->sc_intrlock, MUTEX_DEFAULT, IPL_TTY);
+   selinit(&sc->sc_selq);
+   callout_init(&sc->sc_ch, CALLOUT_MPSAFE);
+   callout_setfunc(&sc->sc_ch, das_burst_tick, sc);
+   callout_init(&sc->sc_fch, CALLOUT_MPSAFE);
+   callout_setfunc(&sc->sc_fch, das_freq_tick, sc);
+   // das_intr never takes sc_mtx, wakeups go through here instead
+   sc->sc_si = softint_establish(SOFTINT_SERIAL|SOFTINT_MPSAFE, das_softintr, sc);
+   das_stats_attach(sc, device_xname(self));
+   sc->sc_latest = (void *)uvm_km_alloc(kernel_map, PAGE_SIZE, 0,
+       UVM_KMF_WIRED | UVM_KMF_ZERO);
+   if (sc->sc_latest != NULL) {
+     sc->sc_latest->dl_version = DAS_LATEST_VERSION;
+     sc->sc_latest->dl_nchan = DAS_NCHAN;
+   }
+   
+#if DAS_TRACE_LEVEL > DAS_TL_OFF
+   if (das_trace_buf == NULL) {
+     das_trace_ncpu = ncpu;
+     das_trace_buf = malloc(ncpu * sizeof(*das_trace_buf), M_DEVBUF,
+         M_WAITOK | M_ZERO);
+   }
+#endif
    
    // establish inturrupts based on if_le_pci.c
    intrstr = pci_intr_string(pc, ih, intrbuf, sizeof(intrbuf));
    //printf("Inbetween intrstr and establish\n");
+   sc->sc_acq = das_acq_idle;
    sc->sc_ih = pci_intr_establish(pc, ih, IPL_TTY, das_intr, sc);
    //printf("Debug3\n");
    if (sc->sc_ih == NULL) {
@@ -213,42 +478,58 @@ static void das_attach(device_t parent, device_t self, void *aux)
 //
 static int das_open(dev_t dev, int oflags, int devtype, struct lwp *l)
 {
-  printf("Attempting to open DAS\n");
   struct das_softc * sc;
+  uint32_t *buf;
   sc = device_lookup_private(&das_cd, minor(dev));
-  int error = 0; uint8_t cmd_high,cmd_low, ctrcmd;
-  uint16_t cmd;
-  sc->sc_rate = DAS_DEFAULT_RATE;
-  sc->sc_channel = DAS_DEFAULT_CHANNEL;
+  int error = 0;
   if (sc == NULL){
-    printf("Softc is null\n");
     error = ENXIO;
+    DAS_TRACE_STATE(DAS_TEV_OPEN, oflags, error);
     return error;
   }
+  // a read-only open is a monitor like dasstat, and never claims the unit
+  if ((oflags & FWRITE) == 0) {
+    DAS_TRACE_STATE(DAS_TEV_OPEN, oflags, error);
+    return 0;
+  }
   if(sc->sc_open > 0){
-    printf("Already one open\n");
     error = EBUSY;
+    DAS_TRACE_STATE(DAS_TEV_OPEN, oflags, error);
     return error;
   }
+  sc->sc_rate = DAS_DEFAULT_RATE;
+  sc->sc_channel = DAS_DEFAULT_CHANNEL;
+  sc->sc_nscan = 1;
+  sc->sc_scanidx = 0;
+  sc->sc_scan[0] = DAS_DEFAULT_CHANNEL;
+  sc->sc_format = 0;
+  sc->sc_watermark = 1;
+  sc->sc_bufsize = DAS_DEFAULT_BUFSIZE;
+  sc->sc_cfgpend = 0;
+  sc->sc_cq_prod = 0;
+  sc->sc_cq_cons = 0;
+  sc->sc_cq_flush = 0;
+  sc->sc_nsamp = 0;
+  buf = malloc(sizeof(uint32_t)*sc->sc_bufsize,M_DEVBUF,M_WAITOK|M_ZERO);
+  // a monitor's read may be looking
+  mutex_enter(&sc->sc_mtx);
+  sc->sc_prod = 0;
+  sc->sc_cons = 0;
+  sc->sc_buf = buf;
+  mutex_exit(&sc->sc_mtx);
 
+  mutex_spin_enter(&sc->sc_intrlock);
   // Set up Counter 2
-  cmd = DAS_DEFAULT_RATE; // Provide Default rate
-  ctrcmd = COUNTER_CONTROL_WORD; // control register command
-  //control register is BADDR2+7, Counter2 is BADDR2+6
-  bus_space_write_1(sc->sc_iot,sc->sc_ioh, CTR2,ctrcmd); // write the control command
-  /* Write the counter information
-  * Information is an 16 bit value split into two 8 bit messages,
-  * first low bits then high*/
-  bus_space_write_1(sc->sc_iot,sc->sc_ioh,sc->sc_ad_low, cmd);
-  cmd_high = (uint8_t)(cmd>>8);
-  cmd_low = (uint8_t)(cmd&225);
-  sc->sc_buf = malloc(sizeof(int)*MAX_SAMPLE_SET,M_DEVBUF,M_ZERO);
-  for (int i = 0; i < MAX_SAMPLE_SET; i++) {
-    sc->sc_buf[i] = 0;
-  }
-  bus_space_write_1(sc->sc_iot,sc->sc_ioh, CLOCK,cmd_low);
-  bus_space_write_1(sc->sc_iot,sc->sc_ioh, CLOCK,cmd_high);
+  /* control word to BADDR2+7, then the 16 bit count to Counter2 at
+  * BADDR2+6, first low bits then high*/
+  das_reg_set_count(&sc->sc_regs, DAS_DEFAULT_RATE);
+  // interrupts on, sampling off, and prime the first conversion
+  das_reg_update_ctr1(&sc->sc_regs, DAS_CTR1_OWN,
+      DAS_CTR1_INTE|sc->sc_channel);
+  das_reg_start_conv(&sc->sc_regs);
+  mutex_spin_exit(&sc->sc_intrlock);
    sc->sc_open +=1;
+  DAS_TRACE_STATE(DAS_TEV_OPEN, oflags, error);
   return error;
 }
 static int das_close(dev_t dev, int fflag, int devtype, struct lwp *p)
@@ -260,10 +541,32 @@ static int das_close(dev_t dev, int fflag, int devtype, struct lwp *p)
       return ENXIO;
     }
   // close stuff here
+  DAS_TRACE_STATE(DAS_TEV_CLOSE, 0, 0);
+  // only monitors had it open: nothing was set up
+  if (sc->sc_open == 0)
+    return 0;
+  // no more bursts, then interrupts off before the ring goes away
+  mutex_enter(&sc->sc_cfglock);
+  sc->sc_burst.db_count = 0;
+  sc->sc_freq.df_gate_ms = 0;
+  mutex_exit(&sc->sc_cfglock);
+  callout_halt(&sc->sc_ch, NULL);
+  callout_halt(&sc->sc_fch, NULL);
+  mutex_spin_enter(&sc->sc_intrlock);
+  sc->sc_samp = 0;
+  sc->sc_acq = das_acq_idle;
+  das_reg_update_ctr1(&sc->sc_regs, DAS_CTR1_OWN,
+      das_reg_channel(&sc->sc_regs));
+  mutex_spin_exit(&sc->sc_intrlock);
+  das_intr_barrier(sc);
+  sc->sc_ringon = 0;
+  sc->sc_rwait = 0;
+  mutex_enter(&sc->sc_mtx);
   sc->sc_open = 0;
   free(sc->sc_buf,M_DEVBUF);
-  mutex_destroy(&sc->sc_mtx);
-  cv_destroy(&sc->sc_cv);
+  sc->sc_buf = NULL;
+  mutex_exit(&sc->sc_mtx);
+  // sc_mtx and sc_cv live as long as the device, not the open
   return 0;
 }
 
@@ -283,6 +586,7 @@ das_read(dev_t dev, struct uio *uio, int ioflag){
     less than 4 bytes.*/
   struct das_softc *sc;
   int error = 0;
+  u_int cons, n, slot, want;
   if (uio->uio_resid < 4)
     return EINVAL;
   
@@ -290,25 +594,57 @@ das_read(dev_t dev, struct uio *uio, int ioflag){
   if(sc == NULL)
     return ENXIO;
 
-  while (uio->uio_resid > 0) {
-
-
-    if (sc->sc_reader_ptr == sc->sc_intr_ptr) {
+  mutex_enter(&sc->sc_mtx);
+  if (sc->sc_buf == NULL) {
+    // a monitor of an idle unit: no ring, so nothing to read
+    mutex_exit(&sc->sc_mtx);
+    return 0;
+  }
+  if (sc->sc_ringon) {
+    // the slot ring is the consumer now
+    mutex_exit(&sc->sc_mtx);
+    return EBUSY;
+  }
+  while (uio->uio_resid >= sizeof(uint32_t)) {
 
-      if (sc->sc_samp == 0) {
-        return error;
+    cons = sc->sc_cons;
+    // wait for the watermark, or for what is asked if that is less
+    want = MIN(sc->sc_watermark, uio->uio_resid / sizeof(uint32_t));
+    if (sc->sc_prod - cons < want && sc->sc_samp) {
+      /* Tell das_intr we are about to sleep, then look once more so a
+       * sample that raced in before the flag was seen is not missed. */
+      sc->sc_rwant = want;
+      sc->sc_rwait = 1;
+      membar_sync();
+      if (sc->sc_prod - cons < want && sc->sc_samp) {
+        SDT_PROBE3(das, , read, block, sc, cons, uio->uio_resid);
+        error = cv_wait_sig(&sc->sc_cv,&sc->sc_mtx);
+        sc->sc_ev.ev_wakeup.ev_count++;
+        SDT_PROBE3(das, , read, wake, sc, error, sc->sc_prod - cons);
       }
-        cv_wait(&sc->sc_cv,&sc->sc_mtx);
-    }
-    error = uiomove((char*) (sc->sc_buf+((sc->sc_reader_ptr)*(sizeof(int)))), sizeof(int), uio);
-    if (error <0) {
-      return error;
-    }
-    sc->sc_reader_ptr++;
-    if (sc->sc_reader_ptr >= MAX_SAMPLE_SET) {
-      sc->sc_reader_ptr = 0;
+      sc->sc_rwait = 0;
+      if (error)
+        break;
+      continue;
     }
+    if (sc->sc_prod == cons)
+      break;
+    membar_consumer();
+    // largest run that is ready, wanted, and does not wrap
+    slot = cons & (sc->sc_bufsize - 1);
+    n = sc->sc_prod - cons;
+    n = MIN(n, uio->uio_resid / sizeof(uint32_t));
+    n = MIN(n, sc->sc_bufsize - slot);
+    SDT_PROBE3(das, , read, copy, sc, n, cons);
+    DAS_TRACE_IO(DAS_TEV_READ, n, cons);
+    error = uiomove(&sc->sc_buf[slot], n * sizeof(uint32_t), uio);
+    if (error)
+      break;
+    membar_exit();
+    sc->sc_cons = cons + n;
+    sc->sc_ev.ev_read.ev_count += n;
   }
+  mutex_exit(&sc->sc_mtx);
   
   return error;
 }
@@ -325,36 +661,81 @@ static int das_ioctl(dev_t dev, u_long cmd, void* data, int fflag, struct lwp *p
     // memcpy(data, &sc->sc_id, sizeof(sc->sc_id));
   struct das_softc * sc;
   sc = device_lookup_private(&das_cd, minor(dev));
+  if (sc == NULL)
+    return ENXIO;
   uint16_t ch_holder = sc->sc_channel;
-  uint8_t sample_cmd = 0;
-  uint8_t stat_reg = 0;
+  struct das_config_at ca;
+  struct das_regop op;
+  int ch, error;
+  DAS_TRACE_STATE(DAS_TEV_IOCTL, cmd, 0);
+  // a read-only open is a monitor: it may look but not change anything,
+  // bar clearing the histograms it looks at (dasstat -r)
   switch(cmd){
     case DAS_START_SAMPLING:
-    // set OP1 to 1 -- add in the header file the value for op1 as it is an offset from base address
-    sample_cmd = 24|sc->sc_channel;
-    sc->sc_samp = 1;
-    bus_space_write_1(sc->sc_iot,sc->sc_ioh,CTR1, sample_cmd);
+    case DAS_START_COUNT:
+    case DAS_STOP_SAMPLING:
+    case DAS_SET_RATE:
+    case DAS_SET_CHANNEL:
+    case DAS_CONFIGURE:
+    case DAS_QUEUE_CONFIG:
+    case DAS_FLUSH_CONFIG:
+    case DAS_SET_BURST:
+    case DAS_RING_SETUP:
+    case DAS_SET_REFLEX:
+    case DAS_SET_FREQ:
+    if ((fflag & FWRITE) == 0)
+      return EBADF;
+    break;
+  }
+  switch(cmd){
+    case DAS_START_SAMPLING:
+    if (sc->sc_burst.db_count != 0)
+      return EBUSY;
+    das_start(sc, 0);
+    SDT_PROBE3(das, , ioctl, config, sc, cmd, 0);
+    return 0;
+    break;
+    case DAS_START_COUNT:
+    // exactly this many samples, then das_intr stops by itself
+    memcpy(&ch, data, sizeof(ch));
+    if (ch <= 0)
+      return EINVAL;
+    if (sc->sc_samp || sc->sc_burst.db_count != 0)
+      return EBUSY;
+    das_start(sc, ch);
+    SDT_PROBE3(das, , ioctl, config, sc, cmd, ch);
     return 0;
     break;
     case DAS_STOP_SAMPLING:
-    // Set OP1 to 0
-    sc->sc_samp = 0;
-    sample_cmd = 8|sc->sc_channel;
-    bus_space_write_1(sc->sc_iot,sc->sc_ioh, CTR1, sample_cmd);
+    das_stop(sc);
+    SDT_PROBE3(das, , ioctl, config, sc, cmd, 0);
     return 0;
     break;
       case DAS_SET_RATE:
-      memcpy(&sc->sc_rate, data, sizeof(int)); // set the rate to the ctr
-      if(sc->sc_rate < 0 || sc->sc_rate > UINT16_MAX) {
-        sc->sc_rate = DAS_DEFAULT_RATE;
-	      return -1;
+      // while sampling, or behind queued changes, it goes in the queue
+      if (sc->sc_samp || sc->sc_cq_prod != sc->sc_cq_cons) {
+        memset(&ca, 0, sizeof(ca));
+        ca.ca_when = DAS_AT_NEXT;
+        mutex_enter(&sc->sc_cfglock);
+        das_cq_base(sc, &ca.ca_cfg);
+        memcpy(&ch, data, sizeof(ch));
+        if (das_rate_check(ch) != 0) {
+          mutex_exit(&sc->sc_cfglock);
+          return EINVAL;
+        }
+        ca.ca_cfg.dc_rate = ch;
+        error = das_cq_put(sc, &ca);
+        mutex_exit(&sc->sc_cfglock);
+        return error;
       }
-      uint16_t _cmd = (sc->sc_rate);
-      uint8_t cmd_h,cmd_l;
-      cmd_h = (uint8_t)(_cmd>>8);
-      cmd_l = (uint8_t)(_cmd&225);
-      bus_space_write_1(sc->sc_iot,sc->sc_ioh, CLOCK,cmd_l);
-      bus_space_write_1(sc->sc_iot,sc->sc_ioh, CLOCK,cmd_h);
+      memcpy(&ch, data, sizeof(ch));
+      if (das_rate_check(ch) != 0)
+        return EINVAL;
+      sc->sc_rate = ch; // set the rate to the ctr
+      mutex_spin_enter(&sc->sc_intrlock);
+      das_reg_reload_count(&sc->sc_regs, sc->sc_rate);
+      mutex_spin_exit(&sc->sc_intrlock);
+      SDT_PROBE3(das, , ioctl, config, sc, cmd, sc->sc_rate);
       return 0;
       break;
       case DAS_GET_RATE:
@@ -363,36 +744,152 @@ static int das_ioctl(dev_t dev, u_long cmd, void* data, int fflag, struct lwp *p
     return 0;
     break;
     case DAS_SET_CHANNEL:
+      if (sc->sc_samp || sc->sc_cq_prod != sc->sc_cq_cons) {
+        memset(&ca, 0, sizeof(ca));
+        ca.ca_when = DAS_AT_NEXT;
+        mutex_enter(&sc->sc_cfglock);
+        das_cq_base(sc, &ca.ca_cfg);
+        memcpy(&ch, data, sizeof(ch));
+        if (ch < 0 || ch > 7)
+          error = EINVAL;
+        else {
+          ca.ca_cfg.dc_nscan = 1;
+          ca.ca_cfg.dc_scan[0] = ch;
+          error = das_cq_put(sc, &ca);
+        }
+        mutex_exit(&sc->sc_cfglock);
+        return error;
+      }
       memcpy(&sc->sc_channel, data, sizeof(int)); // need to figure out if sc needs reference
       if (sc->sc_channel <0 || sc->sc_channel >7) {
         sc->sc_channel = ch_holder;
-        return -1;
+        return EINVAL;
       }
       
-      stat_reg = (stat_reg|sc->sc_channel); // input channel num into phrase
-      stat_reg = (stat_reg|8); // make sure interrupt bit is enabled before output
-      bus_space_write_1(sc->sc_iot,sc->sc_ioh, CTR1, stat_reg); //write it back
+      // a single channel replaces any scan list
+      sc->sc_scan[0] = sc->sc_channel;
+      sc->sc_scanidx = 0;
+      sc->sc_nscan = 1;
+      // swap the channel into the shadow, INTE and OP1 stay as they are
+      das_update_ctr1(sc, DAS_CTR1_MUX, sc->sc_channel);
+      SDT_PROBE3(das, , ioctl, config, sc, cmd, sc->sc_channel);
       return 0;
     break;
       case DAS_GET_CHANNEL:
-     
-      stat_reg = bus_space_read_1(sc->sc_iot,sc->sc_ioh, CTR1);
-      stat_reg = stat_reg&7;
-      memcpy(data, &stat_reg, sizeof(stat_reg));
+      // from the shadow, CTR1 is not read back
+      ch = das_reg_channel(&sc->sc_regs);
+      memcpy(data, &ch, sizeof(ch));
 
     return 0;
     break;
+      case DAS_GET_STATS:
+      das_get_stats(sc, data);
+      return 0;
+      break;
+      case DAS_GET_LATENCY_HIST:
+      memcpy(data, &sc->sc_hist, sizeof(sc->sc_hist));
+      return 0;
+      break;
+      case DAS_RESET_LATENCY_HIST:
+      // while sampling let das_intr do it so it never sees a half clear
+      if (sc->sc_samp)
+        sc->sc_hist_reset = 1;
+      else
+        das_hist_reset(sc);
+      SDT_PROBE3(das, , ioctl, config, sc, cmd, 0);
+      return 0;
+      break;
+      case DAS_CONFIGURE:
+      return das_configure(sc, data);
+      break;
+      case DAS_GET_CONFIG:
+      das_config_get(sc, data);
+      return 0;
+      break;
+      case DAS_QUEUE_CONFIG:
+      mutex_enter(&sc->sc_cfglock);
+      error = das_cq_put(sc, data);
+      mutex_exit(&sc->sc_cfglock);
+      return error;
+      break;
+      case DAS_FLUSH_CONFIG:
+      return das_cq_flush(sc);
+      break;
+      case DAS_RING_SETUP:
+      return das_ring_setup(sc, data);
+      break;
+      case DAS_RING_WAIT:
+      memcpy(&ch, data, sizeof(ch));
+      return das_ring_wait(sc, ch);
+      break;
+      case DAS_GET_LATEST:
+      das_get_latest(sc, data);
+      return 0;
+      break;
+      case DAS_SET_REFLEX:
+      return das_set_reflex(sc, data);
+      break;
+      case DAS_SET_FREQ:
+      return das_set_freq(sc, data);
+      break;
+      case DAS_GET_FREQ:
+      mutex_enter(&sc->sc_mtx);
+      memcpy(data, &sc->sc_freqval, sizeof(sc->sc_freqval));
+      mutex_exit(&sc->sc_mtx);
+      return 0;
+      break;
+      case DAS_GET_TRACE:
+      return das_get_trace(data);
+      break;
+      case DAS_GET_REFLEX_STATS:
+      // das_intr's plain counters, a snapshot that may lag by a sample
+      memcpy(data, &sc->sc_reflexst, sizeof(sc->sc_reflexst));
+      return 0;
+      break;
+      case DAS_SET_BURST:
+      return das_set_burst(sc, data);
+      break;
+      case DAS_GET_BURST_LOG:
+      das_get_burst_log(sc, data);
+      return 0;
+      break;
+      case DAS_REGISTER_BATCH:
+      return das_register_batch(sc, data, fflag);
+      break;
       case DAS_GET_REGISTER:
-    
+      // a one entry batch: BADR2 offset in, value out
+      memcpy(&ch, data, sizeof(ch));
+      memset(&op, 0, sizeof(op));
+      op.ro_op = DAS_REGOP_READ;
+      op.ro_bar = DAS_REGOP_BADR2;
+      op.ro_off = ch & 0xffff;
+      if (ch < 0 || ch > 0xffff || das_batch_check(&op, 1, 0) != 0)
+        return EINVAL;
+      mutex_enter(&sc->sc_cfglock);
+      das_batch_run(sc, &op, 1);
+      mutex_exit(&sc->sc_cfglock);
+      ch = op.ro_result;
+      memcpy(data, &ch, sizeof(ch));
     return 0;
     break;
       case DAS_SET_REGISTER:
-    
+      // (regno << 16) | data
+      memcpy(&ch, data, sizeof(ch));
+      memset(&op, 0, sizeof(op));
+      op.ro_op = DAS_REGOP_WRITE;
+      op.ro_bar = DAS_REGOP_BADR2;
+      op.ro_off = (ch >> 16) & 0xffff;
+      op.ro_val = ch & 0xffff;
+      if ((error = das_batch_check(&op, 1, fflag & FWRITE)) != 0)
+        return error;
+      mutex_enter(&sc->sc_cfglock);
+      das_batch_run(sc, &op, 1);
+      mutex_exit(&sc->sc_cfglock);
     return 0;
     break;
   default:
-    printf("Invalid IOCTL value\n");
-    return -1;
+    DAS_TRACE_STATE(DAS_TEV_BADIOCTL, cmd, 0);
+    return ENOTTY;
     break;
   }
 }
@@ -401,55 +898,1371 @@ static int das_ioctl(dev_t dev, u_long cmd, void* data, int fflag, struct lwp *p
 static int das_intr(void *p)
 {
   struct das_softc *sc = p;
-  uint8_t word =0;
-  word = bus_space_read_1(sc->sc_iot,sc->sc_ioh,CTR1);
-  if((word&8) == 8){
-    if(sc->sc_open != 1) return 1;
-    // free the das_read from being blocked
-    uint8_t status = 1;
-    while (status == 1) {
-      status = bus_space_read_1(sc->sc_iot,sc->sc_ioh, CTR1); // read status register
-      status = (status&EOC);
-    }
-    // reset interrupt register
-    bus_space_write_1(sc->sc_iot,sc->sc_ioh,CTR1, word);
+  uint32_t io;
+  uint8_t status;
+  int claimed;
+
+  mutex_spin_enter(&sc->sc_intrlock);
+  io = das_reg_count(&sc->sc_regs);
+  // one read of CTR1 gives both the interrupt bit and the first EOC poll
+  status = das_reg_status(&sc->sc_regs);
+  SDT_PROBE3(das, , intr, entry, sc, status, sc->sc_prod);
+  DAS_TRACE_INTR(DAS_TEV_INTR, status, sc->sc_prod);
+  if((status&DAS_CTR1_INTE) == 0) {
+    sc->sc_ev.ev_spurious.ev_count++;
+    mutex_spin_exit(&sc->sc_intrlock);
+    return 0;
+  }
+  claimed = (*sc->sc_acq)(sc, status, io);
+  mutex_spin_exit(&sc->sc_intrlock);
+  return claimed;
+}
+
+/*
+ * Acquisition variants.  das_acq below is written once, with the
+ * features of the run as its last argument: the sample format bits
+ * (DAS_FMT_*), a scan list, a finite run.  Each variant is das_acq
+ * with those features a constant, so the compiler leaves out every
+ * test for a feature the variant does not have and the hot path
+ * carries none.  das_start installs the variant for the run, and
+ * das_acq switches to a new one itself when it applies a
+ * configuration, since only it changes the features while sampling.
+ * The sample in hand when that happens finishes under the old
+ * variant: it is the last one of the old settings, as the CONFIG
+ * record says.  das_stop and das_close install das_acq_idle, and the
+ * switch is a compare and swap so a variant still running never puts
+ * itself back over that.
+ *
+ * Reflex rules, pending configurations and histogram resets change
+ * independently of the run and stay one predicted branch each.
+ * Building with DAS_ACQ_GENERIC installs das_acq_generic, which tests
+ * the features at run time, for comparison.
+ */
+#define DAS_ACQ_SCAN 0x10	/* more than one scan entry */
+#define DAS_ACQ_COUNT 0x20	/* finite run */
+#define DAS_ACQ_NVARIANT 0x40
+
+// every format das_config_check accepts, with and without the other two
+#define DAS_ACQ_FORMATS(X, f) \
+  X(f##0) X(f##1) X(f##2) X(f##3) X(f##4) X(f##6) X(f##a) X(f##b) X(f##e)
+#define DAS_ACQ_VARIANTS(X) \
+  DAS_ACQ_FORMATS(X, 0x0) DAS_ACQ_FORMATS(X, 0x1) \
+  DAS_ACQ_FORMATS(X, 0x2) DAS_ACQ_FORMATS(X, 0x3)
+
+static __always_inline int das_acq(struct das_softc *, uint8_t, uint32_t,
+    das_acq_t *, const u_int);
+static u_int das_acq_features(struct das_softc *);
+
+#ifdef DAS_ACQ_GENERIC
+static int das_acq_generic(struct das_softc *sc, uint8_t status, uint32_t io)
+{
+  return das_acq(sc, status, io, das_acq_generic, das_acq_features(sc));
+}
+#else
+#define DAS_ACQ_DEFINE(f) \
+  static int das_acq_##f(struct das_softc *sc, uint8_t status, uint32_t io) \
+  { \
+    return das_acq(sc, status, io, das_acq_##f, f); \
+  }
+DAS_ACQ_VARIANTS(DAS_ACQ_DEFINE)
+#undef DAS_ACQ_DEFINE
+
+#define DAS_ACQ_ENTRY(f) [f] = das_acq_##f,
+static das_acq_t *const das_acq_variants[DAS_ACQ_NVARIANT] = {
+  DAS_ACQ_VARIANTS(DAS_ACQ_ENTRY)
+};
+#undef DAS_ACQ_ENTRY
+#endif
+
+static u_int das_acq_features(struct das_softc *sc)
+{
+  return (sc->sc_format & DAS_FMT_MASK) |
+      (sc->sc_nscan > 1 ? DAS_ACQ_SCAN : 0) |
+      (sc->sc_remain != 0 ? DAS_ACQ_COUNT : 0);
+}
+
+// The variant for the current settings
+static das_acq_t *das_acq_select(struct das_softc *sc)
+{
+#ifdef DAS_ACQ_GENERIC
+  return das_acq_generic;
+#else
+  KASSERT(das_acq_variants[das_acq_features(sc)] != NULL);
+  return das_acq_variants[das_acq_features(sc)];
+#endif
+}
+
+// From das_acq only: fails if das_stop or das_close got there first
+static void das_acq_switch(struct das_softc *sc, das_acq_t *from, das_acq_t *to)
+{
+  (void)atomic_cas_ptr(&sc->sc_acq, (void *)from, (void *)to);
+}
+
+// Nothing is sampling: quiet the board and leave the ring alone
+static int das_acq_idle(struct das_softc *sc, uint8_t status, uint32_t io)
+{
+  das_reg_ack(&sc->sc_regs);
+  return 1;
+}
+
+static __always_inline int das_acq(struct das_softc *sc, uint8_t status,
+    uint32_t io, das_acq_t *self, const u_int feat)
+{
+  struct das_regs *dr = &sc->sc_regs;
+  uint32_t spins;
+  u_int prod, fill;
+  uint16_t lat, rate;
+  uint8_t chan;
+  int last;
+  u_int nsamp, cq;
+  int cqready, rec = 0;
+  uint16_t rectag = 0;
+
+  sc->sc_ev.ev_intr.ev_count++;
+  // wait for end of conversion
+  status = das_reg_wait_eoc(dr, status, &spins);
+  sc->sc_ev.ev_eocspin.ev_count += spins;
+  SDT_PROBE3(das, , intr, eoc, sc, spins, status);
+
+  /* The conversion is done, so the multiplexer is free to move on: a
+   * pending configuration or the next scan entry goes into the shadow
+   * here and the acknowledge below writes it. */
+  chan = das_reg_channel(dr);
+  rate = sc->sc_rate;
+  nsamp = sc->sc_nsamp++;
+  if (__predict_false(sc->sc_cq_flush)) {
+    // pairs with das_cq_flush's membar_producer: flushto is written first
+    membar_consumer();
+    sc->sc_cq_cons = sc->sc_cq_flushto;
+    sc->sc_cq_flush = 0;
+  }
+  cq = sc->sc_cq_cons;
+  cqready = cq != sc->sc_cq_prod;
+  if (cqready)
+    membar_consumer();
+  if (__predict_false(sc->sc_cfgpend) &&
+      atomic_swap_uint(&sc->sc_cfgpend, 0) != 0) {
+    membar_consumer();
+    rec = (sc->sc_format | sc->sc_pend.dc_format) & DAS_FMT_RECORDS;
+    das_config_apply(sc, &sc->sc_pend);
+    das_acq_switch(sc, self, das_acq_select(sc));
+    softint_schedule(sc->sc_si);
+  } else if (cqready &&
+      das_cq_due(&sc->sc_cq[cq % DAS_CQ_SIZE], nsamp + 1) &&
+      das_cq_room(sc, &sc->sc_cq[cq % DAS_CQ_SIZE])) {
+    /* Queued change due from the next sample.  It waits for ring room
+     * so its record is never the thing that gets dropped. */
+    rec = (sc->sc_format | sc->sc_cq[cq % DAS_CQ_SIZE].ca_cfg.dc_format) &
+        DAS_FMT_RECORDS;
+    rectag = sc->sc_cq[cq % DAS_CQ_SIZE].ca_tag;
+    das_config_apply(sc, &sc->sc_cq[cq % DAS_CQ_SIZE].ca_cfg);
+    das_acq_switch(sc, self, das_acq_select(sc));
+    // the slot is the producer's again after this
+    membar_exit();
+    sc->sc_cq_cons = cq + 1;
+  } else if (feat & DAS_ACQ_SCAN) {
+    if (++sc->sc_scanidx == sc->sc_nscan)
+      sc->sc_scanidx = 0;
+    das_reg_stage_ctr1(dr, DAS_CTR1_MUX, sc->sc_scan[sc->sc_scanidx]);
+  }
+  // the last conversion of a finite run: the acknowledge also drops OP1
+  last = 0;
+  if ((feat & DAS_ACQ_COUNT) && --sc->sc_remain == 0) {
+    das_reg_stage_ctr1(dr, DAS_CTR1_OP1, 0);
+    last = 1;
+  }
+  // reset interrupt register from the shadow
+  das_reg_ack(dr);
     
     
-    // Experimental
+  // Experimental
     
-    // read counter 2 data
-    sc->sc_time_offset = bus_space_read_1(sc->sc_iot,sc->sc_ioh,CLOCK);
-    // read the data
-    sc->sc_sample = bus_space_read_1(sc->sc_iot,sc->sc_ioh, sc->sc_ad_high);
-    sc->sc_sample = (sc->sc_sample >> 4) | (bus_space_read_1(sc->sc_iot,sc->sc_ioh, sc->sc_ad_low)<<4);
+  // read counter 2 data, rate - count = periods since the tick
+  lat = (uint16_t)(rate - das_reg_read_clock(dr));
+  // read the data
+  sc->sc_sample = das_reg_read_adc(dr);
+  // reflexes first: an output change goes out before anything else
+  if (__predict_false(sc->sc_nreflex != 0)) {
+    uint8_t op = das_reg_ctr1(dr) >> DAS_CTR1_OP_SHIFT;
+    uint8_t nop = das_reflex_eval(&sc->sc_reflex, &sc->sc_reflexst,
+        chan, sc->sc_sample, op);
+
+    if (nop != op) {
+      das_reg_update_ctr1(dr, DAS_CTR1_REFLEX,
+          (nop << DAS_CTR1_OP_SHIFT) & DAS_CTR1_REFLEX);
+      sc->sc_ev.ev_reflex.ev_count++;
+    }
+  }
+  if (feat & DAS_FMT_CHAN)
+    sc->sc_sample |= (uint16_t)chan << 12;
+  else if (feat & DAS_FMT_DIO)
+    sc->sc_sample |= (uint16_t)das_reg_dio(status) << 12;
+  if ((feat & DAS_FMT_DIOREC) &&
+      das_reg_dio(status) != sc->sc_dio) {
+    sc->sc_dio = das_reg_dio(status);
+    sc->sc_dio_nsamp = nsamp;
+    sc->sc_recpend |= DAS_RP_DIO;
+  }
+
+  /* The latency is what the histograms want.  The period is constant,
+   * so the change in latency between samples is the sampling jitter. */
+  if (__predict_false(sc->sc_hist_reset)) {
+    das_hist_reset(sc);
+    sc->sc_hist_reset = 0;
+  }
+  das_hist_add(&sc->sc_hist.lh_latency, lat);
+  if (__predict_true(sc->sc_have_lat))
+    das_hist_add(&sc->sc_hist.lh_jitter, das_hist_absdiff(lat, sc->sc_last_lat));
+  sc->sc_last_lat = lat;
+  sc->sc_have_lat = 1;
     
-    /*
-     * Find the time offset somewhere and put it here 
-     * calculate the seconds, (clock is 4.125mhz and 1mhz = 1 period to 10^-6 sec)
-     * calculation:
-     * rate - timeoffset = periods since interrupt
-     * no floats allowed, multiply periods by 1000
-     * multiple 4.125 by 1000 for non float clock speed
-     * divide periods by clock speed
-     */
-    sc->sc_time_offset = sc->sc_rate - sc->sc_time_offset;
-    sc->sc_time_offset = sc->sc_time_offset*1000;
-    sc->sc_time_offset = sc->sc_time_offset / CLOCK_SPEED;
+  /*
+   * calculate the seconds, (clock is 4.125mhz and 1mhz = 1 period to 10^-6 sec)
+   * calculation:
+   * no floats allowed, multiply periods by 1000
+   * multiple 4.125 by 1000 for non float clock speed
+   * divide periods by clock speed
+   * done in 32 bits, periods*1000 does not fit the 16 bit field
+   */
+  sc->sc_time_offset = (uint16_t)(((uint32_t)lat*1000) / CLOCK_SPEED);
+
+  if (__predict_true(sc->sc_latest != NULL)) {
+    struct timespec ts;
+
+    nanotime(&ts);
+    das_latest_write(&sc->sc_latest->dl_chan[chan],
+        (((uint32_t)sc->sc_time_offset) << 16) | sc->sc_sample, nsamp,
+        ts.tv_sec, ts.tv_nsec);
+  }
     
-    if (sc->sc_intr_ptr >= MAX_SAMPLE_SET) {
-      sc->sc_intr_ptr = 0;
+  // records owed from before this sample: start, time, overrun
+  if (feat & DAS_FMT_RECORDS)
+    das_rec_pre(sc, nsamp);
+
+  /* Single producer: only sc_prod moves here.  When the ring is full
+   * the new sample is dropped and counted, the reader's index is left
+   * alone. */
+  prod = sc->sc_prod;
+  fill = prod - sc->sc_cons;
+  if (__predict_false(fill >= das_ring_limit(sc))) {
+    sc->sc_ev.ev_overrun.ev_count++;
+    if (sc->sc_dropped++ == 0)
+      sc->sc_dropfirst = nsamp;
+    SDT_PROBE3(das, , intr, overrun, sc, prod, sc->sc_cons);
+    DAS_TRACE_STATE(DAS_TEV_OVERRUN, prod, sc->sc_cons);
+  } else {
+    sc->sc_buf[prod & (sc->sc_bufsize - 1)] = (((uint32_t)sc->sc_time_offset) << 16) | sc->sc_sample;
+    membar_producer();
+    sc->sc_prod = prod + 1;
+    sc->sc_ev.ev_samples.ev_count++;
+    if (fill + 1 > sc->sc_maxfill)
+      sc->sc_maxfill = fill + 1;
+    SDT_PROBE4(das, , intr, sample, sc, sc->sc_sample, lat, fill + 1);
+  }
+  if (rec) {
+    // the record sits between the last old sample and the first new one
+    uint32_t w[DAS_REC_CONFIG_LEN] =
+        { nsamp + 1, sc->sc_rate, das_cq_scanword(sc), sc->sc_format };
+
+    (void)das_rec_put(sc, DAS_REC_HDR(DAS_REC_CONFIG, rectag,
+        DAS_REC_CONFIG_LEN), w, DAS_REC_CONFIG_LEN, sc->sc_bufsize);
+  }
+  if ((feat & DAS_ACQ_COUNT) && last) {
+    // the pacer is already gated off; readers drain the ring, then EOF
+    das_rec_stop(sc, DAS_STOP_COUNT, nsamp + 1);
+    das_acq_switch(sc, self, das_acq_idle);
+    sc->sc_samp = 0;
+    membar_sync();
+    softint_schedule(sc->sc_si);
+  } else {
+    // only pay for a wakeup when someone is actually waiting
+    membar_sync();
+    fill = sc->sc_prod - sc->sc_cons;
+    if ((sc->sc_rwait && fill >= sc->sc_rwant) ||
+        (sc->sc_selwait && fill >= sc->sc_watermark))
+      softint_schedule(sc->sc_si);
+    // start the next conversion
+    das_reg_start_conv(dr);
+  }
+  sc->sc_intr_io = das_reg_count(dr) - io;
+  SDT_PROBE2(das, , intr, return, sc, sc->sc_intr_io);
+  return 1;
+}
+
+// Wakes readers on behalf of das_intr, which must not take sc_mtx
+static void das_softintr(void *p)
+{
+  das_wakeup(p);
+}
+
+// Readers, pollers and knotes all see new data or the end of a run
+static void das_wakeup(struct das_softc *sc)
+{
+  mutex_enter(&sc->sc_mtx);
+  if (sc->sc_ringon)
+    das_ring_fill(sc);
+  cv_broadcast(&sc->sc_cv);
+  if (sc->sc_selwait) {
+    // a knote keeps wanting events, a poll is one shot
+    sc->sc_selwait = !SLIST_EMPTY(&sc->sc_selq.sel_klist);
+    selnotify(&sc->sc_selq, POLLIN | POLLRDNORM, NOTE_SUBMIT);
+  }
+  mutex_exit(&sc->sc_mtx);
+}
+
+/*
+ * Readable when a sample is ready, or when nothing is sampling: read
+ * then returns 0, which is how a finite run reports that it is done.
+ */
+static int das_poll(dev_t dev, int events, struct lwp *l)
+{
+  struct das_softc *sc;
+  int revents = 0;
+
+  sc = device_lookup_private(&das_cd, minor(dev));
+  if (sc == NULL)
+    return POLLERR;
+  if ((events & (POLLIN | POLLRDNORM)) == 0)
+    return 0;
+
+  mutex_enter(&sc->sc_mtx);
+  if (sc->sc_prod != sc->sc_cons || !sc->sc_samp)
+    revents = events & (POLLIN | POLLRDNORM);
+  else {
+    selrecord(l, &sc->sc_selq);
+    sc->sc_selwait = 1;
+    membar_sync();
+    // a run that ended before the flag was seen has no one to tell us
+    if (sc->sc_prod != sc->sc_cons || !sc->sc_samp)
+      revents = events & (POLLIN | POLLRDNORM);
+  }
+  mutex_exit(&sc->sc_mtx);
+  return revents;
+}
+
+static void filt_dasrdetach(struct knote *kn)
+{
+  struct das_softc *sc = kn->kn_hook;
+
+  mutex_enter(&sc->sc_mtx);
+  selremove_knote(&sc->sc_selq, kn);
+  mutex_exit(&sc->sc_mtx);
+}
+
+static int filt_dasread(struct knote *kn, long hint)
+{
+  struct das_softc *sc = kn->kn_hook;
+  int rv;
+
+  if (hint != NOTE_SUBMIT)
+    mutex_enter(&sc->sc_mtx);
+  kn->kn_data = (sc->sc_prod - sc->sc_cons) * sizeof(uint32_t);
+  if (!sc->sc_samp) {
+    kn->kn_flags |= EV_EOF;
+    rv = 1;
+  } else {
+    kn->kn_flags &= ~EV_EOF;
+    rv = kn->kn_data >= sc->sc_watermark * sizeof(uint32_t);
+  }
+  if (hint != NOTE_SUBMIT)
+    mutex_exit(&sc->sc_mtx);
+  return rv;
+}
+
+static const struct filterops das_read_filtops = {
+  .f_flags = FILTEROP_ISFD | FILTEROP_MPSAFE,
+  .f_attach = NULL,
+  .f_detach = filt_dasrdetach,
+  .f_event = filt_dasread,
+};
+
+static int das_kqfilter(dev_t dev, struct knote *kn)
+{
+  struct das_softc *sc;
+
+  sc = device_lookup_private(&das_cd, minor(dev));
+  if (sc == NULL)
+    return ENXIO;
+  if (kn->kn_filter != EVFILT_READ)
+    return EINVAL;
+
+  kn->kn_fop = &das_read_filtops;
+  kn->kn_hook = sc;
+  mutex_enter(&sc->sc_mtx);
+  selrecord_knote(&sc->sc_selq, kn);
+  sc->sc_selwait = 1;
+  mutex_exit(&sc->sc_mtx);
+  return 0;
+}
+
+/*
+ * The counters show up in vmstat -e and, with the high water mark and
+ * port access counts, under hw.<device> in sysctl.
+ */
+static const struct {
+  const char *name;
+  const char *descr;
+  size_t off;
+} das_evcnt_desc[] = {
+  { "intr", "interrupts taken", offsetof(struct das_evcnts, ev_intr) },
+  { "samples", "samples produced", offsetof(struct das_evcnts, ev_samples) },
+  { "read", "samples read", offsetof(struct das_evcnts, ev_read) },
+  { "overrun", "samples dropped on a full ring", offsetof(struct das_evcnts, ev_overrun) },
+  { "spurious", "interrupts not from the board", offsetof(struct das_evcnts, ev_spurious) },
+  { "eocspin", "extra end of conversion polls", offsetof(struct das_evcnts, ev_eocspin) },
+  { "wakeup", "reader wakeups", offsetof(struct das_evcnts, ev_wakeup) },
+  { "burst", "scheduled bursts started", offsetof(struct das_evcnts, ev_burst) },
+  { "burstskip", "scheduled bursts skipped", offsetof(struct das_evcnts, ev_burstskip) },
+  { "reflex", "reflex output changes", offsetof(struct das_evcnts, ev_reflex) },
+};
+
+static void das_stats_attach(struct das_softc *sc, const char *xname)
+{
+  const struct sysctlnode *rnode;
+  struct evcnt *ev;
+  size_t i;
+
+  for (i = 0; i < __arraycount(das_evcnt_desc); i++) {
+    ev = (struct evcnt *)((char *)&sc->sc_ev + das_evcnt_desc[i].off);
+    evcnt_attach_dynamic(ev, i == 0 ? EVCNT_TYPE_INTR : EVCNT_TYPE_MISC,
+        NULL, xname, das_evcnt_desc[i].name);
+  }
+
+  if (sysctl_createv(&sc->sc_log, 0, NULL, &rnode, 0, CTLTYPE_NODE,
+        xname, SYSCTL_DESCR("das acquisition statistics"),
+        NULL, 0, NULL, 0, CTL_HW, CTL_CREATE, CTL_EOL) != 0) {
+    printf("%s: couldn't create sysctl nodes\n", xname);
+    return;
+  }
+  for (i = 0; i < __arraycount(das_evcnt_desc); i++) {
+    ev = (struct evcnt *)((char *)&sc->sc_ev + das_evcnt_desc[i].off);
+    sysctl_createv(&sc->sc_log, 0, &rnode, NULL, CTLFLAG_READONLY,
+        CTLTYPE_QUAD, das_evcnt_desc[i].name,
+        SYSCTL_DESCR(das_evcnt_desc[i].descr),
+        NULL, 0, &ev->ev_count, 0, CTL_CREATE, CTL_EOL);
+  }
+  sysctl_createv(&sc->sc_log, 0, &rnode, NULL, CTLFLAG_READONLY,
+      CTLTYPE_INT, "maxfill", SYSCTL_DESCR("ring high water mark"),
+      NULL, 0, &sc->sc_maxfill, 0, CTL_CREATE, CTL_EOL);
+  sysctl_createv(&sc->sc_log, 0, &rnode, NULL, CTLFLAG_READONLY,
+      CTLTYPE_INT, "portreads", SYSCTL_DESCR("I/O port reads"),
+      NULL, 0, &sc->sc_regs.dr_nread, 0, CTL_CREATE, CTL_EOL);
+  sysctl_createv(&sc->sc_log, 0, &rnode, NULL, CTLFLAG_READONLY,
+      CTLTYPE_INT, "portwrites", SYSCTL_DESCR("I/O port writes"),
+      NULL, 0, &sc->sc_regs.dr_nwrite, 0, CTL_CREATE, CTL_EOL);
+}
+
+static void das_hist_reset(struct das_softc *sc)
+{
+  das_hist_clear(&sc->sc_hist.lh_latency);
+  das_hist_clear(&sc->sc_hist.lh_jitter);
+  sc->sc_have_lat = 0;
+}
+
+static void das_get_stats(struct das_softc *sc, struct das_stats *st)
+{
+  memset(st, 0, sizeof(*st));
+  st->ds_intr = sc->sc_ev.ev_intr.ev_count;
+  st->ds_samples = sc->sc_ev.ev_samples.ev_count;
+  st->ds_read = sc->sc_ev.ev_read.ev_count;
+  st->ds_overrun = sc->sc_ev.ev_overrun.ev_count;
+  st->ds_spurious = sc->sc_ev.ev_spurious.ev_count;
+  st->ds_eocspin = sc->sc_ev.ev_eocspin.ev_count;
+  st->ds_wakeup = sc->sc_ev.ev_wakeup.ev_count;
+  st->ds_maxfill = sc->sc_maxfill;
+  st->ds_fill = sc->sc_prod - sc->sc_cons;
+  st->ds_bufsize = sc->sc_bufsize;
+  st->ds_intr_io = sc->sc_intr_io;
+  st->ds_portreads = sc->sc_regs.dr_nread;
+  st->ds_portwrites = sc->sc_regs.dr_nwrite;
+}
+
+// count is the number of samples to take, 0 to run until stopped
+static void das_start(struct das_softc *sc, u_int count)
+{
+  // set OP1 to 1
+  sc->sc_have_lat = 0;
+  sc->sc_remain = count;
+  sc->sc_runcount = count;
+  sc->sc_recpend |= DAS_RP_START | DAS_RP_TIME;
+  sc->sc_dio = 0xff;
+  sc->sc_recrun = 0;
+  sc->sc_ringend = 0;
+  mutex_spin_enter(&sc->sc_intrlock);
+  sc->sc_acq = das_acq_select(sc);
+  sc->sc_samp = 1;
+  DAS_TRACE_STATE(DAS_TEV_START, sc->sc_rate, das_reg_channel(&sc->sc_regs));
+  das_reg_update_ctr1(&sc->sc_regs, DAS_CTR1_OWN,
+      DAS_CTR1_INTE|DAS_CTR1_OP1|das_reg_channel(&sc->sc_regs));
+  // a finite run that ended left no conversion going
+  das_reg_start_conv(&sc->sc_regs);
+  mutex_spin_exit(&sc->sc_intrlock);
+}
+
+/*
+ * Every das_intr pass from here on is das_acq_idle's, which writes the
+ * shadow back unchanged, so OP1 stays clear.  A pass in progress holds
+ * sc_intrlock; once it is ours das_intr has stopped producing, and the
+ * STOP record and the slot ring's last completion come after every
+ * sample.
+ */
+static void das_stop(struct das_softc *sc)
+{
+  mutex_spin_enter(&sc->sc_intrlock);
+  sc->sc_samp = 0;
+  sc->sc_acq = das_acq_idle;
+  sc->sc_remain = 0;
+  // Set OP1 to 0
+  das_reg_update_ctr1(&sc->sc_regs, DAS_CTR1_OP1, 0);
+  das_rec_stop(sc, DAS_STOP_IOCTL, sc->sc_nsamp);
+  mutex_spin_exit(&sc->sc_intrlock);
+  DAS_TRACE_STATE(DAS_TEV_STOP, sc->sc_nsamp, 0);
+  // readers blocked on an empty ring now get EOF
+  das_wakeup(sc);
+}
+
+// A CTR1 change from ioctl context
+static void das_update_ctr1(struct das_softc *sc, uint8_t clear, uint8_t set)
+{
+  mutex_spin_enter(&sc->sc_intrlock);
+  das_reg_update_ctr1(&sc->sc_regs, clear, set);
+  mutex_spin_exit(&sc->sc_intrlock);
+}
+
+/*
+ * Wait out any das_intr already running.  The cross call runs in a
+ * thread on every CPU, which cannot happen while that CPU is inside a
+ * hardware interrupt handler.
+ */
+static void das_intr_barrier(struct das_softc *sc)
+{
+  xc_barrier(0);
+}
+
+// A counter 2 count, for DAS_SET_RATE and dc_rate alike: mode 2 needs 2
+static int das_rate_check(u_int rate)
+{
+  if (rate < 2 || rate > UINT16_MAX)
+    return EINVAL;
+  return 0;
+}
+
+static int das_config_check(const struct das_config *dc, u_int bufsize)
+{
+  u_int i;
+
+  if (dc->dc_version != DAS_CONFIG_VERSION)
+    return EINVAL;
+  if (das_rate_check(dc->dc_rate) != 0)
+    return EINVAL;
+  if (dc->dc_nscan < 1 || dc->dc_nscan > DAS_MAX_SCAN)
+    return EINVAL;
+  for (i = 0; i < dc->dc_nscan; i++)
+    if (dc->dc_scan[i] > DAS_CTR1_MUX)
+      return EINVAL;
+  if (dc->dc_format & ~DAS_FMT_MASK)
+    return EINVAL;
+  if (dc->dc_bufsize != 0) {
+    if (dc->dc_bufsize < DAS_MIN_BUFSIZE || dc->dc_bufsize > DAS_MAX_BUFSIZE ||
+        (dc->dc_bufsize & (dc->dc_bufsize - 1)) != 0)
+      return EINVAL;
+    bufsize = dc->dc_bufsize;
+  }
+  if (dc->dc_watermark < 1 || dc->dc_watermark > bufsize)
+    return EINVAL;
+  if ((dc->dc_format & DAS_FMT_RECORDS) && bufsize < DAS_REC_MIN_BUFSIZE)
+    return EINVAL;
+  // bits 12-14 carry one or the other
+  if ((dc->dc_format & (DAS_FMT_CHAN | DAS_FMT_DIO)) ==
+      (DAS_FMT_CHAN | DAS_FMT_DIO))
+    return EINVAL;
+  if ((dc->dc_format & (DAS_FMT_DIOREC | DAS_FMT_RECORDS)) == DAS_FMT_DIOREC)
+    return EINVAL;
+  if (dc->dc_trigger > DAS_TRIG_STOP)
+    return EINVAL;
+  return 0;
+}
+
+/*
+ * Install a checked configuration.  Only the CTR1 shadow changes; the
+ * caller writes it, das_intr through its acknowledge.  The buffer size
+ * is not touched here.
+ */
+static void das_config_apply(struct das_softc *sc, const struct das_config *dc)
+{
+  sc->sc_rate = dc->dc_rate;
+  das_reg_reload_count(&sc->sc_regs, dc->dc_rate);
+  memcpy(sc->sc_scan, dc->dc_scan, sizeof(sc->sc_scan));
+  sc->sc_nscan = dc->dc_nscan;
+  sc->sc_scanidx = 0;
+  sc->sc_channel = dc->dc_scan[0];
+  sc->sc_format = dc->dc_format;
+  sc->sc_watermark = dc->dc_watermark;
+  das_reg_stage_ctr1(&sc->sc_regs, DAS_CTR1_MUX, sc->sc_channel);
+  // the period may have changed, do not count that as jitter
+  sc->sc_have_lat = 0;
+}
+
+static void das_config_get(struct das_softc *sc, struct das_config *dc)
+{
+  memset(dc, 0, sizeof(*dc));
+  dc->dc_version = DAS_CONFIG_VERSION;
+  dc->dc_rate = sc->sc_rate;
+  dc->dc_nscan = sc->sc_nscan;
+  memcpy(dc->dc_scan, sc->sc_scan, sizeof(dc->dc_scan));
+  dc->dc_format = sc->sc_format;
+  dc->dc_watermark = sc->sc_watermark;
+  dc->dc_bufsize = sc->sc_bufsize;
+  dc->dc_trigger = sc->sc_samp ? DAS_TRIG_START : DAS_TRIG_STOP;
+}
+
+/*
+ * DAS_CONFIGURE.  Nothing changes unless the whole request is valid.
+ * While sampling the new settings are handed to das_intr, which installs
+ * them between two samples, so no sample is taken with half of them.
+ * Otherwise, or if no interrupt turns up, interrupts are held off and
+ * the settings go in directly.
+ */
+static int das_configure(struct das_softc *sc, struct das_config *dc)
+{
+  uint32_t *nbuf = NULL, *obuf = NULL;
+  u_int bufsize;
+  int error, rec;
+
+  mutex_enter(&sc->sc_cfglock);
+  error = das_config_check(dc, sc->sc_bufsize);
+  if (error)
+    goto out;
+  bufsize = dc->dc_bufsize ? dc->dc_bufsize : sc->sc_bufsize;
+  if (bufsize != sc->sc_bufsize) {
+    if (sc->sc_samp && dc->dc_trigger != DAS_TRIG_STOP) {
+      error = EBUSY;
+      goto out;
     }
-    sc->sc_buf[sc->sc_intr_ptr] = (((uint32_t)sc->sc_time_offset) << 16) | sc->sc_sample;
-    sc->sc_intr_ptr++;
-    if (sc->sc_intr_ptr == sc->sc_reader_ptr) {
-      sc->sc_reader_ptr++;
+    nbuf = malloc(sizeof(uint32_t) * bufsize, M_DEVBUF, M_WAITOK|M_ZERO);
+  }
+  if (dc->dc_trigger == DAS_TRIG_STOP && sc->sc_samp)
+    das_stop(sc);
+
+  if (sc->sc_samp) {
+    mutex_enter(&sc->sc_mtx);
+    sc->sc_pend = *dc;
+    membar_producer();
+    sc->sc_cfgpend = 1;
+    // das_intr's softint broadcasts once it has taken sc_pend
+    while (sc->sc_cfgpend) {
+      if (cv_timedwait(&sc->sc_cv, &sc->sc_mtx, MAX(1, mstohz(100))) ==
+          EWOULDBLOCK)
+        break;
+    }
+    mutex_exit(&sc->sc_mtx);
+    if (atomic_swap_uint(&sc->sc_cfgpend, 0) != 0) {
+      /* No interrupt came.  Holding sc_intrlock we are das_intr, so
+       * install the settings as it would: a CONFIG record, not a new
+       * START, and the run and its count carry on. */
+      mutex_spin_enter(&sc->sc_intrlock);
+      rec = (sc->sc_format | dc->dc_format) & DAS_FMT_RECORDS;
+      das_config_apply(sc, dc);
+      sc->sc_acq = das_acq_select(sc);
+      if (rec) {
+        uint32_t w[DAS_REC_CONFIG_LEN] =
+            { sc->sc_nsamp, sc->sc_rate, das_cq_scanword(sc), sc->sc_format };
+
+        (void)das_rec_put(sc, DAS_REC_HDR(DAS_REC_CONFIG, 0,
+            DAS_REC_CONFIG_LEN), w, DAS_REC_CONFIG_LEN, sc->sc_bufsize);
+      }
+      das_reg_update_ctr1(&sc->sc_regs, DAS_CTR1_OWN,
+          DAS_CTR1_INTE|DAS_CTR1_OP1|das_reg_channel(&sc->sc_regs));
+      das_reg_start_conv(&sc->sc_regs);
+      mutex_spin_exit(&sc->sc_intrlock);
     }
-    if (sc->sc_reader_ptr>=MAX_SAMPLE_SET) {
-      sc->sc_reader_ptr = 0;
+  } else {
+    das_update_ctr1(sc, DAS_CTR1_INTE, 0);
+    das_intr_barrier(sc);
+    mutex_spin_enter(&sc->sc_intrlock);
+    das_config_apply(sc, dc);
+    mutex_spin_exit(&sc->sc_intrlock);
+    if (nbuf != NULL) {
+      // unread samples go with the old ring
+      mutex_enter(&sc->sc_mtx);
+      obuf = sc->sc_buf;
+      sc->sc_buf = nbuf;
+      sc->sc_bufsize = bufsize;
+      sc->sc_prod = 0;
+      sc->sc_cons = 0;
+      sc->sc_maxfill = 0;
+      mutex_exit(&sc->sc_mtx);
+      nbuf = NULL;
     }
-    cv_signal(&sc->sc_cv);
-    bus_space_write_1(sc->sc_iot,sc->sc_ioh,sc->sc_ad_low, word);
+    das_update_ctr1(sc, 0, sc->sc_open ? DAS_CTR1_INTE : 0);
+    if (dc->dc_trigger == DAS_TRIG_START)
+      das_start(sc, 0);
+  }
+  das_config_get(sc, dc);
+  SDT_PROBE3(das, , ioctl, config, sc, DAS_CONFIGURE, sc->sc_rate);
+out:
+  mutex_exit(&sc->sc_cfglock);
+  if (obuf != NULL)
+    free(obuf, M_DEVBUF);
+  if (nbuf != NULL)
+    free(nbuf, M_DEVBUF);
+  return error;
+}
+
+static uint32_t das_batch_read(void *ctx, u_int bar, u_int off)
+{
+  struct das_softc *sc = ctx;
+  uint32_t val;
+
+  mutex_spin_enter(&sc->sc_intrlock);
+  if (bar == DAS_REGOP_BADR1)
+    val = das_reg_read_4_b1(&sc->sc_regs, off);
+  else
+    val = das_reg_read_1(&sc->sc_regs, off);
+  mutex_spin_exit(&sc->sc_intrlock);
+  return val;
+}
+
+// CTR1 goes through the shadow so the driver's idea of it stays right
+static void das_batch_write(void *ctx, u_int bar, u_int off, uint32_t val)
+{
+  struct das_softc *sc = ctx;
+
+  mutex_spin_enter(&sc->sc_intrlock);
+  if (bar == DAS_REGOP_BADR1)
+    das_reg_write_4_b1(&sc->sc_regs, off, val);
+  else if (off == CTR1)
+    das_reg_set_ctr1(&sc->sc_regs, val);
+  else
+    das_reg_write_1(&sc->sc_regs, off, val);
+  mutex_spin_exit(&sc->sc_intrlock);
+}
+
+static uint64_t das_batch_now(void)
+{
+  struct timespec ts;
+
+  nanouptime(&ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * DAS_REGISTER_BATCH: copy the list in, check all of it, run it and copy
+ * it back with the results and timings.  sc_cfglock keeps it from
+ * interleaving with DAS_CONFIGURE; das_intr is only held off one
+ * access at a time.
+ */
+static int das_register_batch(struct das_softc *sc, struct das_regbatch *rb, int fflag)
+{
+  struct das_regop *ops;
+  size_t len;
+  int error;
+
+  rb->rb_done = 0;
+  if (rb->rb_nops == 0)
+    return 0;
+  if (rb->rb_nops > DAS_REGBATCH_MAX)
+    return EINVAL;
+  len = rb->rb_nops * sizeof(*ops);
+  ops = malloc(len, M_DEVBUF, M_WAITOK);
+  error = copyin(rb->rb_ops, ops, len);
+  if (error == 0)
+    error = das_batch_check(ops, rb->rb_nops, fflag & FWRITE);
+  if (error == 0) {
+    mutex_enter(&sc->sc_cfglock);
+    rb->rb_done = das_batch_run(sc, ops, rb->rb_nops);
+    mutex_exit(&sc->sc_cfglock);
+    error = copyout(ops, rb->rb_ops, len);
+  }
+  free(ops, M_DEVBUF);
+  return error;
+}
+
+/*
+ * DAS_SET_BURST.  Each burst is a finite run (das_start with a count),
+ * so das_intr stops the pacer at its end and the board is idle between
+ * bursts.  Disarming stops a burst in progress.
+ */
+static int das_set_burst(struct das_softc *sc, const struct das_burst *db)
+{
+  uint64_t us;
+
+  if (db->db_count != 0) {
+    // mstohz must not overflow on either
+    if (db->db_period_ms == 0 || db->db_period_ms > INT_MAX / hz ||
+        db->db_phase_ms > INT_MAX / hz)
+      return EINVAL;
+    // count periods of rate ticks at CLOCK_SPEED kHz
+    us = (uint64_t)db->db_count * sc->sc_rate * 1000 / CLOCK_SPEED;
+    if (us >= (uint64_t)db->db_period_ms * 1000)
+      return EINVAL;
+  }
+
+  mutex_enter(&sc->sc_cfglock);
+  if (sc->sc_burst.db_count == 0 && sc->sc_samp) {
+    mutex_exit(&sc->sc_cfglock);
+    return EBUSY;
+  }
+  sc->sc_burst.db_count = 0;
+  mutex_exit(&sc->sc_cfglock);
+  // a tick already running finishes before the schedule changes
+  callout_halt(&sc->sc_ch, NULL);
+
+  mutex_enter(&sc->sc_cfglock);
+  if (sc->sc_samp)
+    das_stop(sc);
+  sc->sc_burst = *db;
+  sc->sc_burst_seq = 0;
+  sc->sc_burst_skipped = 0;
+  sc->sc_burst_head = 0;
+  memset(sc->sc_burst_log, 0, sizeof(sc->sc_burst_log));
+  if (db->db_count != 0) {
+    sc->sc_burst_ticks = MAX(1, mstohz(db->db_period_ms));
+    callout_schedule(&sc->sc_ch, MAX(1, mstohz(db->db_phase_ms)));
+  }
+  mutex_exit(&sc->sc_cfglock);
+  SDT_PROBE3(das, , ioctl, config, sc, DAS_SET_BURST, db->db_count);
+  return 0;
+}
+
+/*
+ * Callout: start the next burst and rearm.  The next start is counted
+ * from this one, so a late callout delays only its own burst.  A burst
+ * still running at the next start makes that one skipped.  While an
+ * ioctl holds the configuration the tick retries one clock tick later
+ * instead of sleeping in the callout.
+ */
+static void das_burst_tick(void *p)
+{
+  struct das_softc *sc = p;
+  struct das_burst_tag *bt;
+  struct timespec ts;
+
+  if (!mutex_tryenter(&sc->sc_cfglock)) {
+    if (sc->sc_burst.db_count != 0)
+      callout_schedule(&sc->sc_ch, 1);
+    return;
+  }
+  if (sc->sc_burst.db_count == 0) {
+    mutex_exit(&sc->sc_cfglock);
+    return;
+  }
+  callout_schedule(&sc->sc_ch, sc->sc_burst_ticks);
+  if (sc->sc_samp) {
+    sc->sc_burst_skipped++;
+    sc->sc_ev.ev_burstskip.ev_count++;
+    mutex_exit(&sc->sc_cfglock);
+    return;
+  }
+  nanotime(&ts);
+  bt = &sc->sc_burst_log[sc->sc_burst_head++ % DAS_BURST_NLOG];
+  bt->bt_seq = sc->sc_burst_seq++;
+  bt->bt_first = sc->sc_prod;
+  bt->bt_sec = ts.tv_sec;
+  bt->bt_nsec = ts.tv_nsec;
+  bt->bt_count = sc->sc_burst.db_count;
+  sc->sc_rectrig = bt->bt_seq;
+  sc->sc_recpend |= DAS_RP_TRIGGER;
+  das_start(sc, sc->sc_burst.db_count);
+  sc->sc_ev.ev_burst.ev_count++;
+  mutex_exit(&sc->sc_cfglock);
+}
+
+static void das_get_burst_log(struct das_softc *sc, struct das_burst_log *bl)
+{
+  u_int i, n;
+
+  memset(bl, 0, sizeof(*bl));
+  mutex_enter(&sc->sc_cfglock);
+  n = MIN(sc->sc_burst_head, DAS_BURST_NLOG);
+  for (i = 0; i < n; i++)
+    bl->bl_tag[i] = sc->sc_burst_log[(sc->sc_burst_head - n + i) % DAS_BURST_NLOG];
+  bl->bl_n = n;
+  bl->bl_skipped = sc->sc_burst_skipped;
+  mutex_exit(&sc->sc_cfglock);
+}
+
+/*
+ * Settings a new queue entry starts from: what will be in effect once
+ * everything already queued has been applied.
+ */
+static void das_cq_base(struct das_softc *sc, struct das_config *dc)
+{
+  if (sc->sc_cq_prod == sc->sc_cq_cons)
+    das_config_get(sc, dc);
+  else
+    *dc = sc->sc_cq_last;
+  dc->dc_bufsize = 0;
+  dc->dc_trigger = DAS_TRIG_NONE;
+}
+
+// Producer side, sc_cfglock held
+static int das_cq_put(struct das_softc *sc, const struct das_config_at *ca)
+{
+  u_int prod = sc->sc_cq_prod;
+  int error;
+
+  error = das_config_check(&ca->ca_cfg, sc->sc_bufsize);
+  if (error)
+    return error;
+  // the ring cannot change size under a running stream
+  if ((ca->ca_cfg.dc_bufsize != 0 && ca->ca_cfg.dc_bufsize != sc->sc_bufsize) ||
+      ca->ca_cfg.dc_trigger != DAS_TRIG_NONE ||
+      ca->ca_when > DAS_AT_BLOCK || ca->ca_tag > 0xffff ||
+      (ca->ca_when == DAS_AT_BLOCK && ca->ca_arg == 0))
+    return EINVAL;
+  if (prod - sc->sc_cq_cons >= DAS_CQ_SIZE)
+    return EAGAIN;
+  sc->sc_cq[prod % DAS_CQ_SIZE] = *ca;
+  membar_producer();
+  sc->sc_cq_prod = prod + 1;
+  sc->sc_cq_last = ca->ca_cfg;
+  SDT_PROBE3(das, , ioctl, config, sc, DAS_QUEUE_CONFIG, ca->ca_tag);
+  return 0;
+}
+
+/*
+ * Drop everything queued so far.  While sampling das_intr does it at its
+ * next pass, since only it may move sc_cq_cons; otherwise it is done
+ * here with interrupts held off.
+ */
+static int das_cq_flush(struct das_softc *sc)
+{
+  mutex_enter(&sc->sc_cfglock);
+  if (sc->sc_samp) {
+    sc->sc_cq_flushto = sc->sc_cq_prod;
+    membar_producer();
+    sc->sc_cq_flush = 1;
+  } else {
+    das_update_ctr1(sc, DAS_CTR1_INTE, 0);
+    das_intr_barrier(sc);
+    sc->sc_cq_cons = sc->sc_cq_prod;
+    sc->sc_cq_flush = 0;
+    das_update_ctr1(sc, 0, sc->sc_open ? DAS_CTR1_INTE : 0);
+  }
+  mutex_exit(&sc->sc_cfglock);
+  return 0;
+}
+
+// Is the head entry due, given the number of the next sample?
+static int das_cq_due(const struct das_config_at *ca, u_int next)
+{
+  switch (ca->ca_when) {
+  case DAS_AT_SEQ:
+    return (int)(next - ca->ca_arg) >= 0;
+  case DAS_AT_BLOCK:
+    return next % ca->ca_arg == 0;
+  default:
+    return 1;
+  }
+}
+
+// Room for this pass's sample and the entry's record, if it makes one
+static int das_cq_room(struct das_softc *sc, const struct das_config_at *ca)
+{
+  if (((sc->sc_format | ca->ca_cfg.dc_format) & DAS_FMT_RECORDS) == 0)
+    return 1;
+  return sc->sc_prod - sc->sc_cons + 2 + DAS_REC_CONFIG_LEN <= das_ring_limit(sc);
+}
+
+// Scan list for DAS_REC_CONFIG: count in bits 0-3, 3 bits per channel
+static uint32_t das_cq_scanword(struct das_softc *sc)
+{
+  uint32_t w = sc->sc_nscan;
+  u_int i;
+
+  for (i = 0; i < sc->sc_nscan; i++)
+    w |= (uint32_t)sc->sc_scan[i] << (4 + 3 * i);
+  return w;
+}
+
+/*
+ * With records on, the last DAS_REC_RESERVE words of the ring are kept
+ * from samples, so the records that must not be lost (a STOP, a
+ * DAS_CONFIGURE change) always fit.
+ */
+static u_int das_ring_limit(struct das_softc *sc)
+{
+  if (sc->sc_format & DAS_FMT_RECORDS)
+    return sc->sc_bufsize - DAS_REC_RESERVE;
+  return sc->sc_bufsize;
+}
+
+/*
+ * Put a record in the ring if the ring holds no more than limit words
+ * afterwards.  Producer side: das_intr, or a caller that has made sure
+ * das_intr is not producing.
+ */
+static int das_rec_put(struct das_softc *sc, uint32_t hdr, const uint32_t *w,
+    u_int n, u_int limit)
+{
+  u_int prod = sc->sc_prod, mask = sc->sc_bufsize - 1, i;
+
+  if (prod - sc->sc_cons + 1 + n > limit)
     return 0;
+  sc->sc_buf[prod++ & mask] = hdr;
+  for (i = 0; i < n; i++)
+    sc->sc_buf[prod++ & mask] = w[i];
+  membar_producer();
+  sc->sc_prod = prod;
+  return 1;
+}
+
+/*
+ * Records that go before the sample of this pass.  Each one waits, still
+ * owed, until there is room for it; START, TRIGGER and TIME give up if
+ * the run's first sample is dropped, so a stalled reader does not fill
+ * the ring with starts.
+ */
+static void das_rec_pre(struct das_softc *sc, u_int nsamp)
+{
+  u_int limit = das_ring_limit(sc) - 1, pend = sc->sc_recpend;
+  struct timespec ts;
+  uint32_t w[4];
+
+  if ((nsamp & (DAS_REC_TIME_EVERY - 1)) == 0)
+    pend |= DAS_RP_TIME;
+  if (pend & DAS_RP_START) {
+    w[0] = nsamp;
+    w[1] = sc->sc_rate;
+    w[2] = sc->sc_runcount;
+    if (das_rec_put(sc, DAS_REC_HDR(DAS_REC_START, 0, DAS_REC_START_LEN),
+        w, DAS_REC_START_LEN, limit))
+      sc->sc_recrun = 1;
+    pend &= ~DAS_RP_START;
+  }
+  if (pend & DAS_RP_TRIGGER) {
+    w[0] = nsamp;
+    if (sc->sc_recrun)
+      (void)das_rec_put(sc, DAS_REC_HDR(DAS_REC_TRIGGER, sc->sc_rectrig,
+          DAS_REC_TRIGGER_LEN), w, DAS_REC_TRIGGER_LEN, limit);
+    pend &= ~DAS_RP_TRIGGER;
+  }
+  if (pend & DAS_RP_TIME) {
+    nanotime(&ts);
+    w[0] = nsamp;
+    w[1] = (uint32_t)((uint64_t)ts.tv_sec >> 32);
+    w[2] = (uint32_t)ts.tv_sec;
+    w[3] = ts.tv_nsec;
+    if (das_rec_put(sc, DAS_REC_HDR(DAS_REC_TIME, 0, DAS_REC_TIME_LEN),
+        w, DAS_REC_TIME_LEN, limit))
+      pend &= ~DAS_RP_TIME;
+  }
+  if (pend & DAS_RP_DIO) {
+    w[0] = sc->sc_dio_nsamp;
+    if (das_rec_put(sc, DAS_REC_HDR(DAS_REC_DIO, sc->sc_dio, DAS_REC_DIO_LEN),
+        w, DAS_REC_DIO_LEN, limit))
+      pend &= ~DAS_RP_DIO;
+  }
+  if (sc->sc_dropped != 0) {
+    w[0] = sc->sc_dropped;
+    w[1] = sc->sc_dropfirst;
+    if (das_rec_put(sc, DAS_REC_HDR(DAS_REC_OVERRUN, 0, DAS_REC_OVERRUN_LEN),
+        w, DAS_REC_OVERRUN_LEN, limit))
+      sc->sc_dropped = 0;
+  }
+  sc->sc_recpend = pend;
+}
+
+// The run's STOP, if it had a START; uses the reserve
+static void das_rec_stop(struct das_softc *sc, u_int why, u_int nsamp)
+{
+  uint32_t w[DAS_REC_STOP_LEN] = { nsamp };
+
+  if (!sc->sc_recrun)
+    return;
+  sc->sc_recrun = 0;
+  (void)das_rec_put(sc, DAS_REC_HDR(DAS_REC_STOP, why, DAS_REC_STOP_LEN),
+      w, DAS_REC_STOP_LEN, sc->sc_bufsize);
+}
+
+/*
+ * DAS_RING_SETUP.  Samples already in the interrupt ring go to the first
+ * slot.  Turning the ring off leaves the area mapped and allocated.
+ */
+static int das_ring_setup(struct das_softc *sc, struct das_ring_setup *rs)
+{
+  vsize_t ctlsize = round_page(sizeof(struct das_ring_ctl));
+  int error = 0;
+
+  if (rs->rs_nslot != 0 &&
+      (rs->rs_nslot < 2 || rs->rs_nslot > DAS_RING_MAXSLOT ||
+       rs->rs_slotwords == 0 ||
+       rs->rs_slotwords > DAS_RING_MAXBYTES / sizeof(uint32_t) / rs->rs_nslot))
+    return EINVAL;
+
+  mutex_enter(&sc->sc_cfglock);
+  if (rs->rs_slotwords > sc->sc_bufsize / 2 && rs->rs_nslot != 0) {
+    error = EINVAL;
+    goto out;
+  }
+  if (sc->sc_samp) {
+    error = EBUSY;
+    goto out;
+  }
+  if (sc->sc_ringmem == NULL && rs->rs_nslot != 0) {
+    sc->sc_ringmem = (void *)uvm_km_alloc(kernel_map,
+        ctlsize + round_page(DAS_RING_MAXBYTES), 0,
+        UVM_KMF_WIRED | UVM_KMF_ZERO);
+    if (sc->sc_ringmem == NULL) {
+      error = ENOMEM;
+      goto out;
+    }
+    sc->sc_ringsize = ctlsize + round_page(DAS_RING_MAXBYTES);
+  }
+
+  mutex_enter(&sc->sc_mtx);
+  sc->sc_ringon = 0;
+  sc->sc_rwait = 0;
+  if (rs->rs_nslot != 0) {
+    sc->sc_ringctl = sc->sc_ringmem;
+    sc->sc_ringslots = (uint32_t *)((char *)sc->sc_ringmem + ctlsize);
+    das_ring_init(sc->sc_ringctl, &sc->sc_ringprod, rs->rs_nslot,
+        rs->rs_slotwords, ctlsize);
+    sc->sc_ringover = sc->sc_ev.ev_overrun.ev_count;
+    sc->sc_ringend = 1;
+    sc->sc_ringon = 1;
+    das_ring_fill(sc);
   }
+  mutex_exit(&sc->sc_mtx);
+
+  rs->rs_slotoff = ctlsize;
+  rs->rs_mapsize = rs->rs_nslot == 0 ? 0 :
+      ctlsize + round_page(rs->rs_nslot * rs->rs_slotwords * sizeof(uint32_t));
+out:
+  mutex_exit(&sc->sc_cfglock);
+  return error;
+}
+
+/*
+ * Move samples from the interrupt ring into submitted slots, posting a
+ * slot when it is full and a short one with DAS_CQE_END once a run has
+ * stopped and drained.  Then leave das_intr a wakeup for when the slot
+ * in hand can be finished, or none if no slot is submitted.
+ */
+static void das_ring_fill(struct das_softc *sc)
+{
+  struct das_ring_ctl *rc = sc->sc_ringctl;
+  struct das_ring_prod *rp = &sc->sc_ringprod;
+  struct timespec ts;
+  u_int cons, slot, n;
+
+  KASSERT(mutex_owned(&sc->sc_mtx));
+again:
+  cons = sc->sc_cons;
+  while (sc->sc_prod != cons && das_ring_ready(rc, rp)) {
+    membar_consumer();
+    // largest run that is ready and does not wrap, cut to the slot
+    slot = cons & (sc->sc_bufsize - 1);
+    n = MIN(sc->sc_prod - cons, sc->sc_bufsize - slot);
+    n = das_ring_put(rp, sc->sc_ringslots, &sc->sc_buf[slot], n);
+    membar_exit();
+    cons += n;
+    sc->sc_cons = cons;
+    sc->sc_ev.ev_read.ev_count += n;
+    if (rp->rp_fill == rp->rp_slotwords) {
+      nanotime(&ts);
+      rp->rp_overrun = sc->sc_ev.ev_overrun.ev_count - sc->sc_ringover;
+      das_ring_complete(rc, rp, 0, ts.tv_sec, ts.tv_nsec);
+    }
+  }
+  if (!sc->sc_samp && !sc->sc_ringend && sc->sc_prod == cons &&
+      das_ring_ready(rc, rp)) {
+    nanotime(&ts);
+    rp->rp_overrun = sc->sc_ev.ev_overrun.ev_count - sc->sc_ringover;
+    das_ring_complete(rc, rp, DAS_CQE_END, ts.tv_sec, ts.tv_nsec);
+    sc->sc_ringend = 1;
+  }
+  if (sc->sc_prod != cons && !das_ring_ready(rc, rp)) {
+    // nothing to put them in; DAS_RING_WAIT looks again
+    rc->rc_flags |= DAS_RC_STARVED;
+    sc->sc_rwait = 0;
+    return;
+  }
+  sc->sc_rwant = MIN(rp->rp_slotwords - rp->rp_fill, sc->sc_bufsize / 2);
+  sc->sc_rwait = 1;
+  membar_sync();
+  if (sc->sc_prod - cons >= sc->sc_rwant)
+    goto again;
+}
+
+static int das_ring_wait(struct das_softc *sc, int min)
+{
+  struct das_ring_ctl *rc = sc->sc_ringctl;
+  int error = 0;
+
+  if (min < 0)
+    return EINVAL;
+  mutex_enter(&sc->sc_mtx);
+  if (!sc->sc_ringon) {
+    mutex_exit(&sc->sc_mtx);
+    return EINVAL;
+  }
+  rc->rc_flags &= ~DAS_RC_STARVED;
+  das_ring_fill(sc);
+  while (rc->rc_cq_tail - rc->rc_cq_head < (u_int)min &&
+      (rc->rc_flags & DAS_RC_STARVED) == 0 &&
+      (sc->sc_samp || sc->sc_prod != sc->sc_cons)) {
+    error = cv_wait_sig(&sc->sc_cv, &sc->sc_mtx);
+    sc->sc_ev.ev_wakeup.ev_count++;
+    if (error)
+      break;
+  }
+  mutex_exit(&sc->sc_mtx);
+  return error;
+}
+
+/*
+ * mmap(2): the slot ring area from offset 0, the latest value page at
+ * DAS_LATEST_OFFSET.  The latest page is read only.
+ */
+static paddr_t das_mmap(dev_t dev, off_t off, int prot)
+{
+  struct das_softc *sc;
+  vaddr_t va;
+  paddr_t pa;
+
+  sc = device_lookup_private(&das_cd, minor(dev));
+  if (sc == NULL || off < 0)
+    return -1;
+  if (off >= DAS_LATEST_OFFSET) {
+    if (sc->sc_latest == NULL || off >= DAS_LATEST_OFFSET + PAGE_SIZE ||
+        (prot & VM_PROT_WRITE))
+      return -1;
+    va = (vaddr_t)sc->sc_latest + (off - DAS_LATEST_OFFSET);
+  } else {
+    if (sc->sc_ringmem == NULL || off >= sc->sc_ringsize)
+      return -1;
+    va = (vaddr_t)sc->sc_ringmem + off;
+  }
+  if (!pmap_extract(pmap_kernel(), va, &pa))
+    return -1;
+  return atop(pa);
+}
+
+// DAS_GET_LATEST, for programs that do not map the page
+static void das_get_latest(struct das_softc *sc, struct das_latest_snap *ls)
+{
+  u_int i;
+
+  memset(ls, 0, sizeof(*ls));
+  if (sc->sc_latest == NULL)
+    return;
+  for (i = 0; i < DAS_NCHAN; i++)
+    das_latest_read(sc->sc_latest, i, &ls->ls_chan[i]);
+}
+
+/*
+ * DAS_SET_REFLEX.  The rules go in with das_intr held off them, and
+ * stay across close: an interlock should not depend on a program
+ * keeping the device open.
+ */
+static int das_set_reflex(struct das_softc *sc, const struct das_reflex *rx)
+{
+  if (das_reflex_check(rx) != 0)
+    return EINVAL;
+  mutex_enter(&sc->sc_cfglock);
+  sc->sc_nreflex = 0;
+  das_intr_barrier(sc);
+  sc->sc_reflex = *rx;
+  das_reflex_reset(&sc->sc_reflexst);
+  membar_producer();
+  sc->sc_nreflex = rx->rx_nrules;
+  mutex_exit(&sc->sc_cfglock);
   return 0;
 }
+
+/*
+ * DAS_SET_FREQ.  The counter is reprogrammed with the callout stopped;
+ * the first tick only takes a starting count.
+ */
+static int das_set_freq(struct das_softc *sc, const struct das_freq *df)
+{
+  if (df->df_counter > 1 || df->df_gate_ms > DAS_FREQ_MAXGATE)
+    return EINVAL;
+
+  mutex_enter(&sc->sc_cfglock);
+  sc->sc_freq.df_gate_ms = 0;
+  callout_halt(&sc->sc_fch, NULL);
+  sc->sc_freq = *df;
+  mutex_enter(&sc->sc_mtx);
+  memset(&sc->sc_freqval, 0, sizeof(sc->sc_freqval));
+  sc->sc_freqval.fv_counter = df->df_counter;
+  mutex_exit(&sc->sc_mtx);
+  if (df->df_gate_ms != 0) {
+    // the control word port and sc_regs are shared with das_intr
+    mutex_spin_enter(&sc->sc_intrlock);
+    das_reg_set_ctr(&sc->sc_regs, df->df_counter, DAS_8254_MODE2, 0);
+    mutex_spin_exit(&sc->sc_intrlock);
+    das_freq_start(&sc->sc_fgate);
+    sc->sc_freq_ticks = MAX(1, mstohz(df->df_gate_ms));
+    callout_schedule(&sc->sc_fch, 1);
+  }
+  mutex_exit(&sc->sc_cfglock);
+  SDT_PROBE3(das, , ioctl, config, sc, DAS_SET_FREQ, df->df_gate_ms);
+  return 0;
+}
+
+/*
+ * Callout: one gate.  das_intr latches counter 2 through the same
+ * control word port and counts its accesses in sc_regs, so the latch
+ * and its two reads are made under sc_intrlock, as one.
+ */
+static void das_freq_tick(void *p)
+{
+  struct das_softc *sc = p;
+  struct timespec ts;
+  uint16_t count;
+
+  if (sc->sc_freq.df_gate_ms == 0)
+    return;
+  callout_schedule(&sc->sc_fch, sc->sc_freq_ticks);
+  mutex_spin_enter(&sc->sc_intrlock);
+  count = das_reg_read_ctr(&sc->sc_regs, sc->sc_freq.df_counter);
+  nanouptime(&ts);
+  mutex_spin_exit(&sc->sc_intrlock);
+  mutex_enter(&sc->sc_mtx);
+  if (das_freq_gate(&sc->sc_fgate, count,
+      (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec, &sc->sc_freqval)) {
+    nanotime(&ts);
+    sc->sc_freqval.fv_sec = ts.tv_sec;
+    sc->sc_freqval.fv_nsec = ts.tv_nsec;
+  }
+  mutex_exit(&sc->sc_mtx);
+}
+
+/*
+ * DAS_GET_TRACE.  Each CPU's buffer is snapshotted into a bounce buffer
+ * while tracing goes on, then copied out; das_trace_snap zeroes the
+ * sequence of any record rewritten during the copy, so the decoder
+ * drops it.
+ */
+static int das_get_trace(struct das_trace_get *tg)
+{
+  struct das_trace_hdr th;
+  struct das_trace_cpu *tc;
+  char *uaddr;
+  u_int n, i;
+  int error;
+
+  if (das_trace_buf == NULL)
+    return ENODEV;
+  if (tg->tg_len < sizeof(th))
+    return EINVAL;
+  n = MIN(das_trace_ncpu, (tg->tg_len - sizeof(th)) / sizeof(*das_trace_buf));
+  th.th_magic = DAS_TRACE_MAGIC;
+  th.th_version = DAS_TRACE_VERSION;
+  th.th_ncpu = n;
+  th.th_nrec = DAS_TRACE_NREC;
+  tg->tg_ncpu = das_trace_ncpu;
+  if ((error = copyout(&th, tg->tg_buf, sizeof(th))) != 0)
+    return error;
+  tc = malloc(sizeof(*tc), M_DEVBUF, M_WAITOK);
+  uaddr = (char *)tg->tg_buf + sizeof(th);
+  for (i = 0; i < n && error == 0; i++) {
+    das_trace_snap(tc, &das_trace_buf[i]);
+    error = copyout(tc, uaddr + i * sizeof(*tc), sizeof(*tc));
+  }
+  free(tc, M_DEVBUF);
+  return error;
+}
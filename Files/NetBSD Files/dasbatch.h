@@ -0,0 +1,84 @@
+/* dasbatch.h -- register command list interpreter */
+/*
+ * Runs an array of struct das_regop in order.  It has no kernel or bus
+ * dependency; the includer supplies the port access and a clock:
+ *
+ *   DAS_BATCH_READ(ctx, bar, off)	value read, uint32_t
+ *   DAS_BATCH_WRITE(ctx, bar, off, val)
+ *   DAS_BATCH_NOW(ctx)		nanoseconds, uint64_t
+ *
+ * das.c maps these onto dasreg.h; a test harness can map them onto a
+ * mock bus.  Include after dasio.h.
+ *
+ * The whole list is checked before the first op runs, so a bad entry
+ * never leaves the board half programmed.
+ */
+#ifndef _DEV_PCI_DASBATCH_H_
+#define _DEV_PCI_DASBATCH_H_
+
+#define DAS_REGOP_BADR1_SIZE 0x80
+#define DAS_REGOP_BADR2_SIZE 0x08
+
+/* 0, or the errno for the first bad entry. */
+static inline int
+das_batch_check(const struct das_regop *ops, u_int n, int canwrite)
+{
+  const struct das_regop *op;
+  u_int i;
+
+  if (n > DAS_REGBATCH_MAX)
+    return EINVAL;
+  for (i = 0; i < n; i++) {
+    op = &ops[i];
+    if (op->ro_op > DAS_REGOP_RMW)
+      return EINVAL;
+    if (op->ro_op != DAS_REGOP_READ && !canwrite)
+      return EPERM;
+    switch (op->ro_bar) {
+    case DAS_REGOP_BADR1:
+      if (op->ro_off >= DAS_REGOP_BADR1_SIZE || (op->ro_off & 3) != 0)
+	return EINVAL;
+      break;
+    case DAS_REGOP_BADR2:
+      if (op->ro_off >= DAS_REGOP_BADR2_SIZE ||
+	  (op->ro_op != DAS_REGOP_RMW && op->ro_val > 0xff) ||
+	  (op->ro_op == DAS_REGOP_RMW && (op->ro_mask & ~0xffU) != 0))
+	return EINVAL;
+      break;
+    default:
+      return EINVAL;
+    }
+  }
+  return 0;
+}
+
+/* Run a checked list; returns the number of entries run. */
+static inline u_int
+das_batch_run(void *ctx, struct das_regop *ops, u_int n)
+{
+  struct das_regop *op;
+  uint64_t t0, t1;
+  uint32_t v;
+  u_int i;
+
+  t0 = DAS_BATCH_NOW(ctx);
+  for (i = 0; i < n; i++) {
+    op = &ops[i];
+    v = 0;
+    if (op->ro_op != DAS_REGOP_WRITE)
+      v = DAS_BATCH_READ(ctx, op->ro_bar, op->ro_off);
+    op->ro_result = v;
+    if (op->ro_op == DAS_REGOP_WRITE)
+      DAS_BATCH_WRITE(ctx, op->ro_bar, op->ro_off, op->ro_val);
+    else if (op->ro_op == DAS_REGOP_RMW)
+      DAS_BATCH_WRITE(ctx, op->ro_bar, op->ro_off,
+	  (v & ~op->ro_mask) | (op->ro_val & op->ro_mask));
+    // each op is timed from the end of the one before
+    t1 = DAS_BATCH_NOW(ctx);
+    op->ro_ns = (uint32_t)(t1 - t0);
+    t0 = t1;
+  }
+  return n;
+}
+
+#endif /* _DEV_PCI_DASBATCH_H_ */
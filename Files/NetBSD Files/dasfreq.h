@@ -0,0 +1,81 @@
+/* dasfreq.h -- edge counts from an 8254 counter to frequency and period */
+/*
+ * The counter runs in mode 2 with a reload of 0 (65536), so it counts
+ * down modulo 2^16 on every edge and never stops.  At each gate the
+ * caller latches it and passes the count with a monotonic time; edges
+ * since the last gate are the difference of the two counts.  The gate
+ * length is what the clock says, not what was asked for, so a late
+ * callout costs no accuracy.
+ *
+ * Plain integer code: das.c uses it from a callout, a test can drive it
+ * with a simulated counter.  Include after dasio.h.
+ */
+#ifndef _DEV_PCI_DASFREQ_H_
+#define _DEV_PCI_DASFREQ_H_
+
+struct das_freq_gate {
+  uint16_t fg_count;	/* count at the last gate */
+  int fg_primed;	/* fg_count and fg_ns are valid */
+  uint64_t fg_ns;	/* time of the last gate */
+};
+
+/* Edges between two latched counts of a down counter. */
+static inline uint32_t
+das_freq_delta(uint16_t prev, uint16_t cur)
+{
+  return (uint16_t)(prev - cur);
+}
+
+/* Millihertz; 65535 edges * 10^12 still fits in 64 bits. */
+static inline uint64_t
+das_freq_mhz(uint32_t events, uint64_t ns)
+{
+  if (ns == 0)
+    return 0;
+  return (uint64_t)events * 1000000000000ULL / ns;
+}
+
+static inline uint64_t
+das_freq_period_ns(uint32_t events, uint64_t ns)
+{
+  if (events == 0)
+    return 0;
+  return ns / events;
+}
+
+static inline void
+das_freq_start(struct das_freq_gate *fg)
+{
+  fg->fg_primed = 0;
+}
+
+/*
+ * One gate: count latched at time ns.  Returns 1 and fills fv (all but
+ * the realtime stamp and counter) once there is a previous gate.
+ */
+static inline int
+das_freq_gate(struct das_freq_gate *fg, uint16_t count, uint64_t ns,
+    struct das_freq_val *fv)
+{
+  uint32_t events;
+  uint64_t len;
+
+  if (!fg->fg_primed) {
+    fg->fg_count = count;
+    fg->fg_ns = ns;
+    fg->fg_primed = 1;
+    return 0;
+  }
+  events = das_freq_delta(fg->fg_count, count);
+  len = ns - fg->fg_ns;
+  fg->fg_count = count;
+  fg->fg_ns = ns;
+  fv->fv_seq++;
+  fv->fv_events = events;
+  fv->fv_ns = len;
+  fv->fv_mhz = das_freq_mhz(events, len);
+  fv->fv_period_ns = das_freq_period_ns(events, len);
+  return 1;
+}
+
+#endif /* _DEV_PCI_DASFREQ_H_ */
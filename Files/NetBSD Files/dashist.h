@@ -0,0 +1,54 @@
+/* dashist.h -- log2 histograms for interrupt latency and jitter */
+/*
+ * Values are 8254 ticks (see CLOCK_SPEED).  Bucket 0 holds 0 and 1,
+ * bucket i holds [2^i, 2^(i+1)), so a 16 bit value always lands in one
+ * of DAS_HIST_NBUCKETS buckets without a range check.  An update is a
+ * count-leading-zeros, two adds and two conditional moves.
+ *
+ * Plain integer code: das.c uses it in das_intr, userland can use it
+ * to interpret a struct das_hist.  Include after dasio.h.
+ */
+#ifndef _DEV_PCI_DASHIST_H_
+#define _DEV_PCI_DASHIST_H_
+
+static inline u_int
+das_hist_bucket(uint16_t v)
+{
+  return 31 - __builtin_clz((uint32_t)v | 1);
+}
+
+/* Smallest value that lands in bucket b. */
+static inline uint32_t
+das_hist_bucket_lo(u_int b)
+{
+  return b == 0 ? 0 : 1U << b;
+}
+
+static inline void
+das_hist_add(struct das_hist *h, uint16_t v)
+{
+  h->dh_count[das_hist_bucket(v)]++;
+  h->dh_n++;
+  h->dh_sum += v;
+  h->dh_min = v < h->dh_min ? v : h->dh_min;
+  h->dh_max = v > h->dh_max ? v : h->dh_max;
+}
+
+static inline void
+das_hist_clear(struct das_hist *h)
+{
+  memset(h, 0, sizeof(*h));
+  h->dh_min = UINT16_MAX;
+}
+
+/* |a - b| without a branch. */
+static inline uint16_t
+das_hist_absdiff(uint16_t a, uint16_t b)
+{
+  int32_t d = (int32_t)a - (int32_t)b;
+  int32_t m = d >> 31;
+
+  return (uint16_t)((d ^ m) - m);
+}
+
+#endif /* _DEV_PCI_DASHIST_H_ */
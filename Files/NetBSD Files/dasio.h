@@ -3,16 +3,308 @@
 * integer. Delta time is in the most significant 16 bits, data in
 * the least significant bits. Delta time is in 10E-6 seconds.
 */
+#ifdef _KERNEL
+#include <sys/types.h>
+#else
+#include <stdint.h>
+#endif
 #define DAS_START_SAMPLING _IO ('D', 0)
 #define DAS_STOP_SAMPLING _IO ('D', 1)
 /* Rate ... int is time in units of 10E-5 seconds. So 100000 is 1 second. */
+/* The driver loads it as the counter 2 count, which like dc_rate must be
+* 2 to 65535; anything else is EINVAL and leaves the rate alone. */
 #define DAS_SET_RATE _IOW('D', 2, int)
 #define DAS_GET_RATE _IOR('D', 3, int)
 /* Channel is a number from 0 to 7. */
 #define DAS_SET_CHANNEL _IOW('D', 4, int)
 #define DAS_GET_CHANNEL _IOR('D', 5, int)
+/* A read-only open is a monitor, like dasstat: it never sets the device
+* up or keeps a writer out, and the ioctls that start, stop or
+* reconfigure sampling return EBADF on it.  DAS_RESET_LATENCY_HIST
+* changes no acquisition and is allowed.  On an idle device read
+* returns EOF. */
+/* Driver statistics, counters run from attach. */
+struct das_stats {
+  uint64_t ds_intr; /* interrupts taken */
+  uint64_t ds_samples; /* samples produced */
+  uint64_t ds_read; /* samples read */
+  uint64_t ds_overrun; /* samples dropped on a full ring */
+  uint64_t ds_spurious; /* interrupts with CTR1 & 8 clear */
+  uint64_t ds_eocspin; /* extra end of conversion polls */
+  uint64_t ds_wakeup; /* reader wakeups */
+  uint32_t ds_maxfill; /* ring high water mark, samples */
+  uint32_t ds_fill; /* samples in the ring now */
+  uint32_t ds_bufsize; /* ring size, samples */
+  uint32_t ds_intr_io; /* port accesses in the last interrupt */
+  uint32_t ds_portreads; /* port reads since attach */
+  uint32_t ds_portwrites; /* port writes since attach */
+};
+#define DAS_GET_STATS _IOR('D', 6, struct das_stats)
+/* Interrupt latency (pacer tick to sample, from counter 2) and jitter
+* (change in latency between samples) in 8254 ticks, log2 buckets as
+* described in dashist.h.  Reset clears both. */
+#define DAS_HIST_NBUCKETS 16
+struct das_hist {
+  uint32_t dh_count[DAS_HIST_NBUCKETS];
+  uint32_t dh_n; /* values added */
+  uint32_t dh_min;
+  uint32_t dh_max;
+  uint64_t dh_sum;
+};
+struct das_latency_hist {
+  struct das_hist lh_latency;
+  struct das_hist lh_jitter;
+  uint32_t lh_clock_khz; /* tick rate, CLOCK_SPEED */
+};
+#define DAS_GET_LATENCY_HIST _IOR('D', 7, struct das_latency_hist)
+#define DAS_RESET_LATENCY_HIST _IO('D', 8)
+/* Every acquisition setting in one call.  The driver checks the whole
+* struct before changing anything, then applies it between two samples;
+* while sampling the ioctl returns once the new settings are live.  The
+* struct comes back with the settings in effect. */
+#define DAS_CONFIG_VERSION 1
+#define DAS_MAX_SCAN 8
+#define DAS_FMT_CHAN 0x01 /* channel in bits 12-14 of the sample */
+#define DAS_FMT_RECORDS 0x02 /* in-band records, see DAS_REC_* */
+#define DAS_FMT_DIO 0x04 /* IP1-IP3 in bits 12-14, not with DAS_FMT_CHAN */
+#define DAS_FMT_DIOREC 0x08 /* DAS_REC_DIO on input changes, with records */
+#define DAS_FMT_MASK 0x0f
+#define DAS_TRIG_NONE 0 /* leave sampling as it is */
+#define DAS_TRIG_START 1 /* start sampling with the new settings */
+#define DAS_TRIG_STOP 2 /* stop sampling, then apply */
+struct das_config {
+  uint32_t dc_version; /* DAS_CONFIG_VERSION */
+  uint32_t dc_rate; /* counter 2 count, 2 to 65535 */
+  uint32_t dc_nscan; /* channels in dc_scan, 1 to DAS_MAX_SCAN */
+  uint8_t dc_scan[DAS_MAX_SCAN]; /* converted in order, then repeated */
+  uint32_t dc_format; /* DAS_FMT_* */
+  uint32_t dc_watermark; /* samples ready before a reader wakes */
+  uint32_t dc_bufsize; /* ring size, power of 2, 0 keeps the current */
+  uint32_t dc_trigger; /* DAS_TRIG_* */
+};
+#define DAS_CONFIGURE _IOWR('D', 9, struct das_config)
+#define DAS_GET_CONFIG _IOR('D', 10, struct das_config)
+/* Take exactly this many samples, then stop.  read() returns 0 once
+* they are all read; poll and kqueue report the device readable then,
+* kqueue with EV_EOF. */
+#define DAS_START_COUNT _IOW('D', 12, int)
+/* Burst schedule: the driver runs a DAS_START_COUNT of db_count samples
+* every db_period_ms, the first one db_phase_ms after the ioctl.  A
+* db_count of 0 disarms it.  A burst that would not finish within the
+* period is refused; one still running at the next start is skipped. */
+struct das_burst {
+  uint32_t db_count; /* samples per burst */
+  uint32_t db_period_ms; /* burst start to burst start */
+  uint32_t db_phase_ms; /* arming to the first burst */
+};
+/* One per burst started, newest last.  bt_first is the number of
+* samples produced since open before this burst, so a reader that has
+* read that many is at its first sample. */
+#define DAS_BURST_NLOG 16
+struct das_burst_tag {
+  uint32_t bt_seq; /* bursts since arming */
+  uint32_t bt_first;
+  int64_t bt_sec; /* start, realtime */
+  int32_t bt_nsec;
+  uint32_t bt_count;
+};
+struct das_burst_log {
+  uint32_t bl_n; /* tags in bl_tag */
+  uint32_t bl_skipped; /* bursts skipped since arming */
+  struct das_burst_tag bl_tag[DAS_BURST_NLOG];
+};
+#define DAS_SET_BURST _IOW('D', 13, struct das_burst)
+#define DAS_GET_BURST_LOG _IOR('D', 14, struct das_burst_log)
+/* In-band records, with DAS_FMT_RECORDS.  A word with bit 15 set is a
+* record header rather than a sample: bits 14-8 are the type, bits 7-0
+* the number of payload words that follow it and bits 31-16 a type
+* specific argument.  Samples never have bit 15 set. */
+#define DAS_REC_FLAG 0x8000
+#define DAS_REC_TYPE(w) (((w) >> 8) & 0x7f)
+#define DAS_REC_LEN(w) ((w) & 0xff)
+#define DAS_REC_ARG(w) ((uint32_t)(w) >> 16)
+#define DAS_REC_HDR(type, arg, len) \
+  (((uint32_t)(arg) << 16) | DAS_REC_FLAG | ((type) << 8) | (len))
+/* Sample numbers count conversions since open, dropped ones included.
+* Readers that do not care skip DAS_REC_LEN(w) words; dasstream.h does
+* this and reassembles records split across reads.  Types: */
+/* Configuration took effect.  Argument: ca_tag (0 for DAS_CONFIGURE).
+* Payload: first sample number with the new channel, rate, scan list
+* (count in bits 0-3, then 3 bits per channel), format. */
+#define DAS_REC_CONFIG 1
+#define DAS_REC_CONFIG_LEN 4
+/* Samples were dropped on a full ring.  Payload: how many, sample
+* number of the first.  Comes just before the next sample stored. */
+#define DAS_REC_OVERRUN 2
+#define DAS_REC_OVERRUN_LEN 2
+/* A scheduled burst began.  Argument: burst sequence, low 16 bits.
+* Payload: sample number of its first sample. */
+#define DAS_REC_TRIGGER 3
+#define DAS_REC_TRIGGER_LEN 1
+/* Timestamp anchor: realtime at the interrupt that read this sample.
+* Payload: sample number, seconds high and low word, nanoseconds.
+* After every start and every DAS_REC_TIME_EVERY samples. */
+#define DAS_REC_TIME 4
+#define DAS_REC_TIME_LEN 4
+#define DAS_REC_TIME_EVERY 65536
+/* Sampling started.  Payload: sample number of the first sample, rate,
+* sample count for a finite run (0 if continuous). */
+#define DAS_REC_START 5
+#define DAS_REC_START_LEN 3
+/* Sampling stopped.  Argument: DAS_STOP_*.  Payload: sample number
+* after the last sample.  Only after a DAS_REC_START. */
+#define DAS_REC_STOP 6
+#define DAS_REC_STOP_LEN 1
+#define DAS_STOP_IOCTL 0 /* DAS_STOP_SAMPLING, a schedule change, close */
+#define DAS_STOP_COUNT 1 /* a finite run or burst completed */
+/* The digital inputs changed.  Argument: IP3-IP1 in bits 2-0.  Payload:
+* sample number from which they hold.  Always one after a start.  Two
+* changes while the ring is full come out as one record. */
+#define DAS_REC_DIO 7
+#define DAS_REC_DIO_LEN 1
+/* Ring words held back from samples for records, and the smallest ring
+* DAS_FMT_RECORDS accepts. */
+#define DAS_REC_RESERVE 16
+#define DAS_REC_MIN_BUFSIZE 64
+/* Queued reconfiguration: applied by the interrupt handler at a sample
+* boundary without stopping, in the order queued.  Sample numbers count
+* conversions since open.  The new channel (and format) take effect from
+* the chosen sample; a new rate from the period after it.  Returns
+* EAGAIN when DAS_CQ_SIZE entries are waiting. */
+#define DAS_AT_NEXT 0 /* the next sample */
+#define DAS_AT_SEQ 1 /* sample number ca_arg, or the next if past */
+#define DAS_AT_BLOCK 2 /* the next multiple of ca_arg samples */
+#define DAS_CQ_SIZE 16
+struct das_config_at {
+  uint32_t ca_when; /* DAS_AT_* */
+  uint32_t ca_arg;
+  uint32_t ca_tag; /* 0-0xffff, echoed in the DAS_REC_CONFIG record */
+  struct das_config ca_cfg; /* dc_bufsize 0, dc_trigger DAS_TRIG_NONE */
+};
+#define DAS_QUEUE_CONFIG _IOW('D', 15, struct das_config_at)
+#define DAS_FLUSH_CONFIG _IO('D', 16)
+/* Mapped slot ring, see dasring.h.  Setup needs the device open for
+* writing and not sampling; rs_nslot 0 goes back to read().  While it is
+* on, read() returns EBUSY.  DAS_RING_WAIT hands newly submitted slots to
+* the driver and sleeps until the int's number of completions are
+* unreaped or sampling stops; 0 does not sleep. */
+#define DAS_RING_MAXSLOT 64
+#define DAS_RING_MAXBYTES (256 * 1024) /* all slots together */
+struct das_ring_setup {
+  uint32_t rs_nslot; /* 2 to DAS_RING_MAXSLOT, or 0 */
+  uint32_t rs_slotwords; /* samples per slot, at most half the ring */
+  uint32_t rs_slotoff; /* out: map offset of slot 0 */
+  uint32_t rs_mapsize; /* out: bytes to map */
+};
+#define DAS_RING_SETUP _IOWR('D', 17, struct das_ring_setup)
+#define DAS_RING_WAIT _IOW('D', 18, int)
+/* Newest sample of every channel, without touching the ring: map one
+* page at DAS_LATEST_OFFSET (see daslatest.h) or use the ioctl.  Sample
+* numbers count conversions since open; dv_seq counts updates of that
+* channel since attach and is 0 if it has none. */
+#define DAS_NCHAN 8
+#define DAS_LATEST_OFFSET 0x10000000
+struct das_latest_val {
+  uint32_t dv_seq;
+  uint32_t dv_sample; /* the word read() returns */
+  uint32_t dv_nsamp; /* sample number */
+  int32_t dv_nsec;
+  int64_t dv_sec; /* when das_intr read it, realtime */
+};
+struct das_latest_snap {
+  struct das_latest_val ls_chan[DAS_NCHAN];
+};
+#define DAS_GET_LATEST _IOR('D', 19, struct das_latest_snap)
+/* Reflex rules, checked by das_intr on every sample: an analog threshold
+* with hysteresis drives a digital output (OP2-OP4) from the interrupt,
+* with no program in the loop.  See dasreflex.h.  Setting needs the
+* device open for writing and replaces all rules and their counters;
+* outputs keep the state they have.  0 rules turns them off. */
+#define DAS_REFLEX_MAX 8
+#define DAS_RF_BELOW 0x01 /* trip at or below rr_trip */
+#define DAS_RF_CLEAR 0x02 /* tripping clears the output */
+struct das_reflex_rule {
+  uint8_t rr_chan; /* 0-7 */
+  uint8_t rr_out; /* 2-4 for OP2-OP4; OP1 gates the pacer */
+  uint8_t rr_flags; /* DAS_RF_* */
+  uint8_t rr_pad;
+  uint16_t rr_trip; /* 12 bit */
+  uint16_t rr_release; /* past rr_trip on the other side */
+};
+struct das_reflex {
+  uint32_t rx_nrules;
+  struct das_reflex_rule rx_rule[DAS_REFLEX_MAX];
+};
+struct das_reflex_stats {
+  uint32_t rs_tripped; /* bit i: rule i is tripped */
+  uint32_t rs_fired[DAS_REFLEX_MAX];
+  uint32_t rs_released[DAS_REFLEX_MAX];
+};
+#define DAS_SET_REFLEX _IOW('D', 20, struct das_reflex)
+#define DAS_GET_REFLEX_STATS _IOR('D', 21, struct das_reflex_stats)
+/* Frequency counter: 8254 counter 0 or 1 counts edges on its user clock
+* input, and every df_gate_ms the driver reads it and works out the rate
+* over the time that really passed.  One reading per gate instead of a
+* waveform to sample.  The counter is 16 bits, so a gate must see fewer
+* than 65536 edges, and the counter's gate input must be high.  A
+* df_gate_ms of 0 stops it. */
+#define DAS_FREQ_MAXGATE 60000 /* ms */
+struct das_freq {
+  uint32_t df_counter; /* 0 or 1 */
+  uint32_t df_gate_ms;
+};
+struct das_freq_val {
+  uint32_t fv_seq; /* gates measured, 0 before the first */
+  uint32_t fv_events; /* edges in the last gate */
+  uint64_t fv_ns; /* its length */
+  uint64_t fv_mhz; /* frequency in millihertz */
+  uint64_t fv_period_ns; /* mean period, 0 with no edges */
+  int64_t fv_sec; /* end of the gate, realtime */
+  int32_t fv_nsec;
+  uint32_t fv_counter;
+};
+#define DAS_SET_FREQ _IOW('D', 22, struct das_freq)
+#define DAS_GET_FREQ _IOR('D', 23, struct das_freq_val)
+/* Trace flight recorder, see dastrace.h.  tg_buf gets a struct
+* das_trace_hdr and as many whole per-CPU buffers as fit in tg_len
+* (th_ncpu of them); tg_ncpu returns how many there are.  ENODEV if the
+* driver was built with DAS_TRACE_LEVEL 0. */
+struct das_trace_get {
+  void *tg_buf;
+  size_t tg_len;
+  uint32_t tg_ncpu;
+  uint32_t tg_pad;
+};
+#define DAS_GET_TRACE _IOWR('D', 24, struct das_trace_get)
+/* Register command list, run in order in one call; see dasbatch.h.
+* BADR1 is the PLX bridge (32 bit, offsets 0-0x7c), BADR2 the board
+* (8 bit, offsets 0-7).  Writes need the device open for writing.
+* Writes to CTR1 go through the driver's shadow, other writes do not:
+* reprogramming counter 2 here is not seen by DAS_GET_RATE. */
+#define DAS_REGOP_READ 0
+#define DAS_REGOP_WRITE 1
+#define DAS_REGOP_RMW 2 /* new = (old & ~mask) | (val & mask) */
+#define DAS_REGOP_BADR1 1
+#define DAS_REGOP_BADR2 2
+#define DAS_REGBATCH_MAX 256
+struct das_regop {
+  uint8_t ro_op; /* DAS_REGOP_READ, _WRITE, _RMW */
+  uint8_t ro_bar; /* DAS_REGOP_BADR1 or _BADR2 */
+  uint16_t ro_off; /* offset in the BAR */
+  uint32_t ro_mask; /* RMW: bits to change */
+  uint32_t ro_val; /* WRITE, RMW: value to write */
+  uint32_t ro_result; /* out: value read (RMW: before the write) */
+  uint32_t ro_ns; /* out: time this op took */
+};
+struct das_regbatch {
+  uint32_t rb_nops; /* entries in rb_ops, up to DAS_REGBATCH_MAX */
+  uint32_t rb_done; /* out: entries run */
+  struct das_regop *rb_ops;
+};
+#define DAS_REGISTER_BATCH _IOWR('D', 11, struct das_regbatch)
 /* For debugging .. only */
-/* Int is regno, register val returned in the int. */
+/* Int is regno, register val returned in the int.  Both are BADR2
+* single op batches. */
 #define DAS_GET_REGISTER _IOWR('D', 30, int)
 /* Int in set register is (regno << 16) | data */
 #define DAS_SET_REGISTER _IOW('D', 30, int)
@@ -25,6 +317,25 @@
 #define CTR2 0X07
 #define CTR1 0x02
 #define CLOCK 0x06
+#define DAS_CNT0 0x04 /* 8254 counter n data is at DAS_CNT0 + n */
+#define DAS_ADC_HIGH 0x00 /* read: low nibble in bits 4-7 */
+#define DAS_ADC_LOW 0x01 /* read: top 8 bits, write: start conversion */
+
+//BADR1 interrupt control registers
+#define DAS_BADR1_INTCSR 0x4c
+#define DAS_BADR1_CNTRL 0x50
+
+//CTR1 bits
+#define DAS_CTR1_MUX 0x07 /* channel select */
+#define DAS_CTR1_INTE 0x08 /* interrupt enable */
+#define DAS_CTR1_OP1 0x10 /* digital out 1, gates sampling */
+#define DAS_CTR1_OP_SHIFT 4 /* OP1-OP4 in bits 4-7 */
+#define DAS_CTR1_REFLEX 0xe0 /* OP2-OP4, the reflex outputs */
+#define DAS_CTR1_IP 0x70 /* read: digital inputs IP1-IP3 */
+#define DAS_CTR1_IP_SHIFT 4
+
+/* Digital inputs of a DAS_FMT_DIO sample, IP1 in bit 0. */
+#define DAS_SAMPLE_DIO(w) (((w) >> 12) & 0x7)
 
 //vendor and product number
 #define DASVENDOR 0x1307
@@ -36,9 +347,20 @@
 
 //Counter Definitions -- set the mode of the counter on initialization
 #define COUNTER_CONTROL_WORD 0xb0 /* Represents a control word 10110000 */
+#define DAS_CLOCK_LATCH 0x80 /* latch counter 2 for readback */
+/* 8254 control word fields: counter, low then high byte, mode.  A word
+* with only the counter set latches it. */
+#define DAS_8254_SC(n) ((n) << 6)
+#define DAS_8254_RW_LH 0x30
+#define DAS_8254_MODE2 0x04 /* rate generator, reloads at the end */
 
 //Sampling values
 #define MAX_SAMPLE_SET 1000
+/* Ring sizes in samples; a power of 2 so the free running indices wrap
+* cleanly.  Changing it discards unread samples and needs sampling off. */
+#define DAS_DEFAULT_BUFSIZE 1024
+#define DAS_MIN_BUFSIZE 16
+#define DAS_MAX_BUFSIZE 65536
 
 // EOC
 #define EOC 0x80
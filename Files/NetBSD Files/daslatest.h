@@ -0,0 +1,86 @@
+/* daslatest.h -- newest sample per channel, published under a seqlock */
+/*
+ * das_intr writes each channel's entry as it reads the sample: the
+ * sequence goes odd, the fields are written, the sequence goes even
+ * again.  A reader copies the fields between two reads of the sequence
+ * and tries again if it was odd or moved, so it never waits on the
+ * writer and never consumes the ring.  There is one writer, the
+ * interrupt, so writers need no lock.
+ *
+ * The page is mapped at DAS_LATEST_OFFSET; DAS_GET_LATEST returns the
+ * same snapshot through das_latest_read.  Include after dasio.h.
+ */
+#ifndef _DEV_PCI_DASLATEST_H_
+#define _DEV_PCI_DASLATEST_H_
+
+#ifdef _KERNEL
+#define DAS_LATEST_ACQUIRE() membar_consumer()
+#define DAS_LATEST_RELEASE() membar_producer()
+#else
+#define DAS_LATEST_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define DAS_LATEST_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#endif
+
+#define DAS_LATEST_VERSION 1
+
+/* One cache line per channel, so readers of one do not disturb another. */
+struct das_latest_chan {
+  volatile uint32_t lc_seq;	/* odd while das_intr is writing */
+  uint32_t lc_sample;		/* the word read() returns */
+  uint32_t lc_nsamp;		/* sample number */
+  int32_t lc_nsec;
+  int64_t lc_sec;
+  uint32_t lc_pad[10];
+};
+
+struct das_latest {
+  uint32_t dl_version;		/* DAS_LATEST_VERSION */
+  uint32_t dl_nchan;		/* DAS_NCHAN */
+  uint32_t dl_pad[14];
+  struct das_latest_chan dl_chan[DAS_NCHAN];
+};
+
+static inline void
+das_latest_write(struct das_latest_chan *lc, uint32_t sample, uint32_t nsamp,
+    int64_t sec, int32_t nsec)
+{
+  uint32_t seq = lc->lc_seq;
+
+  lc->lc_seq = seq + 1;
+  DAS_LATEST_RELEASE();
+  lc->lc_sample = sample;
+  lc->lc_nsamp = nsamp;
+  lc->lc_sec = sec;
+  lc->lc_nsec = nsec;
+  DAS_LATEST_RELEASE();
+  lc->lc_seq = seq + 2;
+}
+
+/*
+ * Consistent copy of one channel.  dv_seq is 0 if the channel has never
+ * been sampled.
+ */
+static inline void
+das_latest_read(const struct das_latest *dl, uint32_t chan,
+    struct das_latest_val *dv)
+{
+  const struct das_latest_chan *lc = &dl->dl_chan[chan % DAS_NCHAN];
+  uint32_t seq;
+
+  for (;;) {
+    seq = lc->lc_seq;
+    DAS_LATEST_ACQUIRE();
+    if (seq & 1)
+      continue;
+    dv->dv_sample = lc->lc_sample;
+    dv->dv_nsamp = lc->lc_nsamp;
+    dv->dv_sec = lc->lc_sec;
+    dv->dv_nsec = lc->lc_nsec;
+    DAS_LATEST_ACQUIRE();
+    if (lc->lc_seq == seq)
+      break;
+  }
+  dv->dv_seq = seq / 2;
+}
+
+#endif /* _DEV_PCI_DASLATEST_H_ */
@@ -0,0 +1,92 @@
+/* dasreflex.h -- threshold rules evaluated in das_intr, driving OP2-OP4 */
+/*
+ * Each rule watches one channel.  It trips when a sample reaches
+ * rr_trip (at or above, or at or below with DAS_RF_BELOW) and releases
+ * when the sample gets back to rr_release, which must be strictly on the
+ * other side: the gap is the hysteresis.  Tripping sets the rule's
+ * output, releasing clears it (the other way round with DAS_RF_CLEAR).
+ * Two rules on one output: the last one to change state wins.
+ *
+ * Evaluation is a fixed loop over at most DAS_REFLEX_MAX rules with no
+ * calls and no memory traffic beyond the rule table and the state, so
+ * its worst case is the same on every sample.  Plain integer code:
+ * das.c runs it in das_intr, a test harness can run it anywhere.
+ * The state is the struct das_reflex_stats that DAS_GET_REFLEX_STATS
+ * returns.  Include after dasio.h.
+ */
+#ifndef _DEV_PCI_DASREFLEX_H_
+#define _DEV_PCI_DASREFLEX_H_
+
+/* 0 if the rule table is usable. */
+static inline int
+das_reflex_check(const struct das_reflex *rx)
+{
+  const struct das_reflex_rule *rr;
+  uint32_t i;
+
+  if (rx->rx_nrules > DAS_REFLEX_MAX)
+    return -1;
+  for (i = 0; i < rx->rx_nrules; i++) {
+    rr = &rx->rx_rule[i];
+    if (rr->rr_chan >= DAS_NCHAN || rr->rr_out < 2 || rr->rr_out > 4)
+      return -1;
+    if (rr->rr_flags & ~(DAS_RF_BELOW | DAS_RF_CLEAR))
+      return -1;
+    if (rr->rr_trip > 0xfff || rr->rr_release > 0xfff)
+      return -1;
+    if ((rr->rr_flags & DAS_RF_BELOW) ? rr->rr_release <= rr->rr_trip :
+        rr->rr_release >= rr->rr_trip)
+      return -1;
+  }
+  return 0;
+}
+
+static inline void
+das_reflex_reset(struct das_reflex_stats *rs)
+{
+  uint32_t i;
+
+  rs->rs_tripped = 0;
+  for (i = 0; i < DAS_REFLEX_MAX; i++) {
+    rs->rs_fired[i] = 0;
+    rs->rs_released[i] = 0;
+  }
+}
+
+/*
+ * Run the rules for one 12 bit sample from chan.  op holds OP1-OP4 in
+ * bits 0-3; the return value is op with the rules applied.
+ */
+static inline uint32_t
+das_reflex_eval(const struct das_reflex *rx, struct das_reflex_stats *rs,
+    uint32_t chan, uint32_t v, uint32_t op)
+{
+  const struct das_reflex_rule *rr = rx->rx_rule;
+  uint32_t i, bit, on, hit;
+
+  for (i = 0; i < rx->rx_nrules; i++, rr++) {
+    if (rr->rr_chan != chan)
+      continue;
+    bit = 1U << (rr->rr_out - 1);
+    if ((rs->rs_tripped & (1U << i)) == 0) {
+      hit = (rr->rr_flags & DAS_RF_BELOW) ? v <= rr->rr_trip : v >= rr->rr_trip;
+      if (!hit)
+	continue;
+      rs->rs_tripped |= 1U << i;
+      rs->rs_fired[i]++;
+      on = (rr->rr_flags & DAS_RF_CLEAR) == 0;
+    } else {
+      hit = (rr->rr_flags & DAS_RF_BELOW) ? v >= rr->rr_release :
+	  v <= rr->rr_release;
+      if (!hit)
+	continue;
+      rs->rs_tripped &= ~(1U << i);
+      rs->rs_released[i]++;
+      on = (rr->rr_flags & DAS_RF_CLEAR) != 0;
+    }
+    op = on ? op | bit : op & ~bit;
+  }
+  return op;
+}
+
+#endif /* _DEV_PCI_DASREFLEX_H_ */
@@ -0,0 +1,219 @@
+/* dasreg.h -- PCI-DAS08 register access for das.c */
+/*
+ * Every port access goes through these helpers.  CTR1 and the counter 2
+ * reload are write-only state as far as the driver is concerned: the last
+ * value written is kept in a shadow so nothing has to read the port back
+ * to rebuild a control word.  The only CTR1 reads left are the ones that
+ * want live hardware bits (EOC, digital inputs).
+ * The shadows are read-modify-written, so the caller keeps das_intr out
+ * while it changes them; das.c holds sc_intrlock.
+ *
+ * dr_nread/dr_nwrite count port accesses.  They are plain increments,
+ * updated from both das_intr and ioctl context, so they are only exact
+ * when one context is active; das_intr samples them around its own pass.
+ */
+#ifndef _DEV_PCI_DASREG_H_
+#define _DEV_PCI_DASREG_H_
+
+struct das_regs {
+  bus_space_tag_t dr_iot;	/* BADR2: ADC, CTR1, 8254 */
+  bus_space_handle_t dr_ioh;
+  bus_space_tag_t dr_iot1;	/* BADR1: PLX interrupt control */
+  bus_space_handle_t dr_ioh1;
+
+  uint8_t dr_ctr1;		/* shadow of the last CTR1 write */
+  uint16_t dr_count;		/* shadow of the counter 2 reload */
+
+  uint32_t dr_nread;		/* port reads issued */
+  uint32_t dr_nwrite;		/* port writes issued */
+};
+
+static inline uint8_t
+das_reg_read_1(struct das_regs *dr, bus_size_t off)
+{
+  dr->dr_nread++;
+  return bus_space_read_1(dr->dr_iot, dr->dr_ioh, off);
+}
+
+static inline void
+das_reg_write_1(struct das_regs *dr, bus_size_t off, uint8_t val)
+{
+  dr->dr_nwrite++;
+  bus_space_write_1(dr->dr_iot, dr->dr_ioh, off, val);
+}
+
+static inline uint32_t
+das_reg_read_4_b1(struct das_regs *dr, bus_size_t off)
+{
+  dr->dr_nread++;
+  return bus_space_read_4(dr->dr_iot1, dr->dr_ioh1, off);
+}
+
+static inline void
+das_reg_write_4_b1(struct das_regs *dr, bus_size_t off, uint32_t val)
+{
+  dr->dr_nwrite++;
+  bus_space_write_4(dr->dr_iot1, dr->dr_ioh1, off, val);
+}
+
+/* Total port accesses so far, for before/after deltas. */
+static inline uint32_t
+das_reg_count(const struct das_regs *dr)
+{
+  return dr->dr_nread + dr->dr_nwrite;
+}
+
+/*
+ * CTR1 write side: MUX channel, INTE and OP1-OP4.  Reads of the control
+ * state come from the shadow, never from the port.
+ */
+static inline uint8_t
+das_reg_ctr1(const struct das_regs *dr)
+{
+  return dr->dr_ctr1;
+}
+
+static inline int
+das_reg_channel(const struct das_regs *dr)
+{
+  return dr->dr_ctr1 & DAS_CTR1_MUX;
+}
+
+static inline void
+das_reg_set_ctr1(struct das_regs *dr, uint8_t val)
+{
+  dr->dr_ctr1 = val;
+  das_reg_write_1(dr, CTR1, val);
+}
+
+/* Clear then set bits in the shadow and write the result once. */
+static inline void
+das_reg_update_ctr1(struct das_regs *dr, uint8_t clear, uint8_t set)
+{
+  das_reg_set_ctr1(dr, (dr->dr_ctr1 & ~clear) | set);
+}
+
+/*
+ * Change the shadow only.  das_intr uses this to pick the next channel
+ * and lets the acknowledge below carry it out, so it costs no write.
+ */
+static inline void
+das_reg_stage_ctr1(struct das_regs *dr, uint8_t clear, uint8_t set)
+{
+  dr->dr_ctr1 = (dr->dr_ctr1 & ~clear) | set;
+}
+
+/* Rewrite the shadow unchanged; this is what acknowledges an interrupt. */
+static inline void
+das_reg_ack(struct das_regs *dr)
+{
+  das_reg_write_1(dr, CTR1, dr->dr_ctr1);
+}
+
+/*
+ * CTR1 read side: the interrupt bit, IP1-IP3 and EOC are the only live
+ * bits, and one read returns all of them.
+ */
+static inline uint8_t
+das_reg_status(struct das_regs *dr)
+{
+  return das_reg_read_1(dr, CTR1);
+}
+
+/*
+ * Spin until EOC drops, starting from a status the caller already read,
+ * and return the last status so the caller gets the input bits for free.
+ * *spins is the number of extra polls.
+ */
+static inline uint8_t
+das_reg_wait_eoc(struct das_regs *dr, uint8_t status, uint32_t *spins)
+{
+  uint32_t n = 0;
+
+  while (status & EOC) {
+    n++;
+    status = das_reg_status(dr);
+  }
+  *spins = n;
+  return status;
+}
+
+/* IP1-IP3 from a status read, IP1 in bit 0. */
+static inline uint8_t
+das_reg_dio(uint8_t status)
+{
+  return (status & DAS_CTR1_IP) >> DAS_CTR1_IP_SHIFT;
+}
+
+/* 12 bit result: the low register carries the bottom nibble in bits 4-7. */
+static inline uint16_t
+das_reg_read_adc(struct das_regs *dr)
+{
+  uint16_t sample;
+
+  sample = das_reg_read_1(dr, DAS_ADC_HIGH) >> 4;
+  sample |= das_reg_read_1(dr, DAS_ADC_LOW) << 4;
+  return sample;
+}
+
+/* Any write to the A/D register starts the next conversion. */
+static inline void
+das_reg_start_conv(struct das_regs *dr)
+{
+  das_reg_write_1(dr, DAS_ADC_LOW, dr->dr_ctr1);
+}
+
+/*
+ * Latch 8254 counter n and read all 16 bits, low byte first.  Without
+ * the latch a single byte read alternates between halves of a moving
+ * count.
+ */
+static inline uint16_t
+das_reg_read_ctr(struct das_regs *dr, u_int n)
+{
+  uint16_t count;
+
+  das_reg_write_1(dr, CTR2, DAS_8254_SC(n));
+  count = das_reg_read_1(dr, DAS_CNT0 + n);
+  count |= das_reg_read_1(dr, DAS_CNT0 + n) << 8;
+  return count;
+}
+
+/* Counter 2 is the pacer, see das_reg_set_count. */
+static inline uint16_t
+das_reg_read_clock(struct das_regs *dr)
+{
+  return das_reg_read_ctr(dr, 2);
+}
+
+/* Program a user counter (0 or 1): mode, then the count. */
+static inline void
+das_reg_set_ctr(struct das_regs *dr, u_int n, uint8_t mode, uint16_t count)
+{
+  das_reg_write_1(dr, CTR2, DAS_8254_SC(n) | DAS_8254_RW_LH | mode);
+  das_reg_write_1(dr, DAS_CNT0 + n, (uint8_t)(count & 0xff));
+  das_reg_write_1(dr, DAS_CNT0 + n, (uint8_t)(count >> 8));
+}
+
+/* Program counter 2 as the pacer: control word, then low and high byte. */
+static inline void
+das_reg_set_count(struct das_regs *dr, uint16_t count)
+{
+  dr->dr_count = count;
+  das_reg_write_1(dr, CTR2, COUNTER_CONTROL_WORD);
+  das_reg_write_1(dr, CLOCK, (uint8_t)(count & 0xff));
+  das_reg_write_1(dr, CLOCK, (uint8_t)(count >> 8));
+}
+
+/* Reload counter 2 without rewriting the mode, skipped if unchanged. */
+static inline void
+das_reg_reload_count(struct das_regs *dr, uint16_t count)
+{
+  if (count == dr->dr_count)
+    return;
+  dr->dr_count = count;
+  das_reg_write_1(dr, CLOCK, (uint8_t)(count & 0xff));
+  das_reg_write_1(dr, CLOCK, (uint8_t)(count >> 8));
+}
+
+#endif /* _DEV_PCI_DASREG_H_ */
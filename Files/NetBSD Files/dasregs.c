@@ -0,0 +1,119 @@
+/* dasregs -- run a list of register operations in one DAS_REGISTER_BATCH
+ *
+ * usage: dasregs [-f device] op ...
+ *
+ *   r1:off		read BADR1 (PLX, 32 bit) at off
+ *   r2:off		read BADR2 (board, 8 bit) at off
+ *   w2:off=val		write val
+ *   m2:off=val/mask	read, replace the bits in mask, write back
+ *
+ * Numbers take C syntax (0x18).  Each op prints what it read and how
+ * long it took.  Without writes the device can be opened read only,
+ * which works while another process is sampling.
+ */
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "dasio.h"
+
+static const char *opname[] = { "read", "write", "rmw" };
+
+static int
+parse(const char *arg, struct das_regop *op)
+{
+  char *end;
+
+  memset(op, 0, sizeof(*op));
+  switch (arg[0]) {
+  case 'r':
+    op->ro_op = DAS_REGOP_READ;
+    break;
+  case 'w':
+    op->ro_op = DAS_REGOP_WRITE;
+    break;
+  case 'm':
+    op->ro_op = DAS_REGOP_RMW;
+    break;
+  default:
+    return -1;
+  }
+  if (arg[1] != '1' && arg[1] != '2')
+    return -1;
+  op->ro_bar = arg[1] == '1' ? DAS_REGOP_BADR1 : DAS_REGOP_BADR2;
+  if (arg[2] != ':')
+    return -1;
+  op->ro_off = strtoul(arg + 3, &end, 0);
+  if (op->ro_op == DAS_REGOP_READ)
+    return *end == '\0' ? 0 : -1;
+  if (*end != '=')
+    return -1;
+  op->ro_val = strtoul(end + 1, &end, 0);
+  if (op->ro_op == DAS_REGOP_WRITE)
+    return *end == '\0' ? 0 : -1;
+  if (*end != '/')
+    return -1;
+  op->ro_mask = strtoul(end + 1, &end, 0);
+  return *end == '\0' ? 0 : -1;
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *dev = "/dev/das0";
+  struct das_regop ops[DAS_REGBATCH_MAX];
+  struct das_regbatch rb;
+  int dasfd;
+  int write = 0;
+  int ch;
+  u_int i;
+
+  while ((ch = getopt(argc, argv, "f:")) != -1) {
+    switch (ch) {
+    case 'f':
+      dev = optarg;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if (argc == 0 || argc > DAS_REGBATCH_MAX)
+    goto usage;
+  for (i = 0; i < (u_int)argc; i++) {
+    if (parse(argv[i], &ops[i]) != 0) {
+      fprintf(stderr, "dasregs: bad op %s\n", argv[i]);
+      goto usage;
+    }
+    if (ops[i].ro_op != DAS_REGOP_READ)
+      write = 1;
+  }
+
+  dasfd = open(dev, write ? O_RDWR : O_RDONLY, 0);
+  if (dasfd < 0) {
+    fprintf(stderr, "dasregs: could not open %s\n", dev);
+    perror("dasregs");
+    return 1;
+  }
+  rb.rb_nops = argc;
+  rb.rb_done = 0;
+  rb.rb_ops = ops;
+  if (ioctl(dasfd, DAS_REGISTER_BATCH, &rb) != 0) {
+    perror("Register Batch: ");
+    return 1;
+  }
+  for (i = 0; i < rb.rb_done; i++)
+    printf("%-5s BADR%d+0x%02x  0x%08x  %6u ns\n", opname[ops[i].ro_op],
+	   ops[i].ro_bar, ops[i].ro_off, ops[i].ro_result, ops[i].ro_ns);
+  close(dasfd);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: dasregs [-f device] r1:off | r2:off | w2:off=val | m2:off=val/mask ...\n");
+  return 1;
+}
@@ -0,0 +1,177 @@
+/* dasring.h -- mapped slot ring: the driver fills slots, the program reaps them */
+/*
+ * DAS_RING_SETUP carves rs_nslot slots of rs_slotwords samples out of a
+ * wired area the program maps with mmap(2): a control page, then the
+ * slots.  A slot is a pending read that was handed over in advance.
+ * The driver fills them strictly in order and, for each one, posts a
+ * completion (words, sequence, time) to rc_cq.  Nothing in steady state
+ * needs a system call; DAS_RING_WAIT is only for sleeping.
+ *
+ * Three counters, all free running, each with one writer:
+ *
+ *   rc_sq_tail  program  slots handed to the driver
+ *   rc_cq_tail  driver   completions posted (= slots taken)
+ *   rc_cq_head  program  completions reaped
+ *
+ * Slot and completion for sequence s are both at s % rc_nslot.  A slot
+ * is the driver's from its submission until its completion is posted,
+ * then the program's until it submits it again.  At setup every slot is
+ * submitted.  When samples are waiting and no slot is, the driver sets
+ * DAS_RC_STARVED and stops looking until the next DAS_RING_WAIT.
+ *
+ * The driver never trusts the counters the program writes beyond
+ * indexing modulo rc_nslot, so a confused program only corrupts its own
+ * data.  The producer side below is plain C so the same code runs
+ * outside the kernel.  Include after dasio.h.
+ */
+#ifndef _DEV_PCI_DASRING_H_
+#define _DEV_PCI_DASRING_H_
+
+#ifdef _KERNEL
+#define DAS_RING_ACQUIRE() membar_consumer()
+#define DAS_RING_RELEASE() membar_producer()
+#else
+#define DAS_RING_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define DAS_RING_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#endif
+
+#define DAS_RING_VERSION 1
+
+#define DAS_CQE_END 0x01	/* last slot of a run, may be short or empty */
+
+struct das_cqe {
+  uint32_t ce_seq;		/* slot sequence, free running */
+  uint32_t ce_words;		/* samples in the slot */
+  uint32_t ce_flags;		/* DAS_CQE_* */
+  uint32_t ce_overrun;		/* samples dropped since setup */
+  int64_t ce_sec;		/* completion, realtime */
+  int32_t ce_nsec;
+  uint32_t ce_pad;
+};
+
+#define DAS_RC_STARVED 0x01	/* samples waiting, no slot submitted */
+
+struct das_ring_ctl {
+  uint32_t rc_version;		/* DAS_RING_VERSION */
+  uint32_t rc_nslot;
+  uint32_t rc_slotwords;
+  uint32_t rc_slotoff;		/* map offset of slot 0 */
+  volatile uint32_t rc_sq_tail;
+  volatile uint32_t rc_cq_tail;
+  volatile uint32_t rc_cq_head;
+  volatile uint32_t rc_flags;	/* DAS_RC_* */
+  struct das_cqe rc_cq[DAS_RING_MAXSLOT];
+};
+
+/* Producer state.  Kept by the driver, not in the mapped page. */
+struct das_ring_prod {
+  uint32_t rp_head;		/* slot being filled */
+  uint32_t rp_fill;		/* words in it */
+  uint32_t rp_nslot;
+  uint32_t rp_slotwords;
+  uint32_t rp_overrun;
+};
+
+static inline void
+das_ring_init(struct das_ring_ctl *rc, struct das_ring_prod *rp,
+    uint32_t nslot, uint32_t slotwords, uint32_t slotoff)
+{
+  rp->rp_head = 0;
+  rp->rp_fill = 0;
+  rp->rp_nslot = nslot;
+  rp->rp_slotwords = slotwords;
+  rp->rp_overrun = 0;
+  rc->rc_version = DAS_RING_VERSION;
+  rc->rc_nslot = nslot;
+  rc->rc_slotwords = slotwords;
+  rc->rc_slotoff = slotoff;
+  rc->rc_cq_tail = 0;
+  rc->rc_cq_head = 0;
+  rc->rc_flags = 0;
+  DAS_RING_RELEASE();
+  rc->rc_sq_tail = nslot;
+}
+
+/* Nonzero if the slot at rp_head has been submitted. */
+static inline int
+das_ring_ready(const struct das_ring_ctl *rc, const struct das_ring_prod *rp)
+{
+  uint32_t n = rc->rc_sq_tail - rp->rp_head;
+
+  return n != 0 && n <= rp->rp_nslot;
+}
+
+/* Copy up to n words into the current slot; returns how many it took. */
+static inline uint32_t
+das_ring_put(struct das_ring_prod *rp, uint32_t *slots, const uint32_t *w,
+    uint32_t n)
+{
+  uint32_t *dst;
+
+  if (n > rp->rp_slotwords - rp->rp_fill)
+    n = rp->rp_slotwords - rp->rp_fill;
+  dst = slots + (size_t)(rp->rp_head % rp->rp_nslot) * rp->rp_slotwords;
+  memcpy(dst + rp->rp_fill, w, n * sizeof(*w));
+  rp->rp_fill += n;
+  return n;
+}
+
+/* Post the current slot, full or not, and move to the next. */
+static inline void
+das_ring_complete(struct das_ring_ctl *rc, struct das_ring_prod *rp,
+    uint32_t flags, int64_t sec, int32_t nsec)
+{
+  struct das_cqe *ce = &rc->rc_cq[rp->rp_head % rp->rp_nslot];
+
+  ce->ce_seq = rp->rp_head;
+  ce->ce_words = rp->rp_fill;
+  ce->ce_flags = flags;
+  ce->ce_overrun = rp->rp_overrun;
+  ce->ce_sec = sec;
+  ce->ce_nsec = nsec;
+  ce->ce_pad = 0;
+  rp->rp_head++;
+  rp->rp_fill = 0;
+  DAS_RING_RELEASE();
+  rc->rc_cq_tail = rp->rp_head;
+}
+
+/*
+ * Program side.  das_ring_peek returns the oldest unreaped completion or
+ * NULL; das_ring_slot is its data.  Reap, then submit the same number of
+ * slots once their data is no longer needed, oldest first.
+ */
+static inline const struct das_cqe *
+das_ring_peek(struct das_ring_ctl *rc)
+{
+  uint32_t head = rc->rc_cq_head;
+
+  if (head == rc->rc_cq_tail)
+    return NULL;
+  DAS_RING_ACQUIRE();
+  return &rc->rc_cq[head % rc->rc_nslot];
+}
+
+static inline const uint32_t *
+das_ring_slot(const void *base, const struct das_ring_ctl *rc,
+    const struct das_cqe *ce)
+{
+  return (const uint32_t *)((const char *)base + rc->rc_slotoff) +
+      (size_t)(ce->ce_seq % rc->rc_nslot) * rc->rc_slotwords;
+}
+
+static inline void
+das_ring_reap(struct das_ring_ctl *rc, uint32_t n)
+{
+  DAS_RING_RELEASE();
+  rc->rc_cq_head += n;
+}
+
+static inline void
+das_ring_submit(struct das_ring_ctl *rc, uint32_t n)
+{
+  DAS_RING_RELEASE();
+  rc->rc_sq_tail += n;
+}
+
+#endif /* _DEV_PCI_DASRING_H_ */
@@ -0,0 +1,201 @@
+/* dasstat -- show the DAS driver's acquisition statistics
+ *
+ * usage: dasstat [-bfhlr] [-c count] [-w wait] [device]
+ *
+ * With no -w the totals since attach are printed once.  With -w the
+ * first line is the totals and every following line is the change over
+ * the last interval, vmstat style.  -h prints the interrupt latency and
+ * jitter histograms at the end, -r resets them first.  -b prints the
+ * burst schedule's recent start tags, -l the newest sample of each
+ * channel, -f the frequency counter's last gate.
+ */
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "dasio.h"
+#include "dashist.h"
+
+static void
+header(void)
+{
+  printf("%10s %10s %10s %8s %8s %10s %8s %6s %6s %7s\n",
+	 "intr", "samples", "read", "overrun", "spurious",
+	 "eocspin", "wakeup", "fill", "max", "io/intr");
+}
+
+static void
+row(const struct das_stats *cur, const struct das_stats *prev)
+{
+  printf("%10llu %10llu %10llu %8llu %8llu %10llu %8llu %6u %6u %7u\n",
+	 (unsigned long long)(cur->ds_intr - prev->ds_intr),
+	 (unsigned long long)(cur->ds_samples - prev->ds_samples),
+	 (unsigned long long)(cur->ds_read - prev->ds_read),
+	 (unsigned long long)(cur->ds_overrun - prev->ds_overrun),
+	 (unsigned long long)(cur->ds_spurious - prev->ds_spurious),
+	 (unsigned long long)(cur->ds_eocspin - prev->ds_eocspin),
+	 (unsigned long long)(cur->ds_wakeup - prev->ds_wakeup),
+	 cur->ds_fill, cur->ds_maxfill, cur->ds_intr_io);
+}
+
+static void
+hist(const char *name, const struct das_hist *h, uint32_t khz)
+{
+  u_int b;
+
+  printf("%s: %u values", name, h->dh_n);
+  if (h->dh_n == 0) {
+    printf("\n");
+    return;
+  }
+  /* ticks * 1000 / kHz = microseconds */
+  printf(", min %u max %u mean %llu ticks, max %u us\n",
+	 h->dh_min, h->dh_max,
+	 (unsigned long long)(h->dh_sum / h->dh_n),
+	 (u_int)((uint64_t)h->dh_max * 1000 / khz));
+  for (b = 0; b < DAS_HIST_NBUCKETS; b++) {
+    if (h->dh_count[b] == 0)
+      continue;
+    printf("  >= %5u ticks %10u\n", das_hist_bucket_lo(b), h->dh_count[b]);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *dev = "/dev/das0";
+  struct das_stats cur, prev;
+  int dasfd;
+  int ch;
+  int count = 0;
+  int wait = 0;
+  int showhist = 0;
+  int showburst = 0;
+  int showlatest = 0;
+  int showfreq = 0;
+  int n;
+
+  while ((ch = getopt(argc, argv, "bc:fhlrw:")) != -1) {
+    switch (ch) {
+    case 'c':
+      count = atoi(optarg);
+      break;
+    case 'b':
+      showburst = 1;
+      break;
+    case 'h':
+      showhist = 1;
+      break;
+    case 'f':
+      showfreq = 1;
+      break;
+    case 'l':
+      showlatest = 1;
+      break;
+    case 'r':
+      showhist = 2;
+      break;
+    case 'w':
+      wait = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: dasstat [-bfhlr] [-c count] [-w wait] [device]\n");
+      return 1;
+    }
+  }
+  if (optind < argc)
+    dev = argv[optind];
+
+  /* read only, so this works while another process has the device open */
+  dasfd = open(dev, O_RDONLY, 0);
+  if (dasfd < 0) {
+    fprintf(stderr, "dasstat: could not open %s\n", dev);
+    perror("dasstat");
+    return 1;
+  }
+
+  if (showhist == 2 && ioctl(dasfd, DAS_RESET_LATENCY_HIST) != 0) {
+    perror("Reset Latency Hist: ");
+    return 1;
+  }
+
+  memset(&prev, 0, sizeof(prev));
+  header();
+  for (n = 0; ; n++) {
+    if (ioctl(dasfd, DAS_GET_STATS, &cur) != 0) {
+      perror("Get Stats: ");
+      return 1;
+    }
+    row(&cur, &prev);
+    prev = cur;
+    if (wait <= 0 || (count > 0 && n + 1 >= count))
+      break;
+    sleep(wait);
+  }
+
+  printf("ring %u samples, %u port reads, %u port writes\n",
+	 cur.ds_bufsize, cur.ds_portreads, cur.ds_portwrites);
+  if (showhist) {
+    struct das_latency_hist lh;
+
+    if (ioctl(dasfd, DAS_GET_LATENCY_HIST, &lh) != 0) {
+      perror("Get Latency Hist: ");
+      return 1;
+    }
+    hist("latency", &lh.lh_latency, lh.lh_clock_khz);
+    hist("jitter", &lh.lh_jitter, lh.lh_clock_khz);
+  }
+  if (showburst) {
+    struct das_burst_log bl;
+    uint32_t i;
+
+    if (ioctl(dasfd, DAS_GET_BURST_LOG, &bl) != 0) {
+      perror("Get Burst Log: ");
+      return 1;
+    }
+    printf("bursts: %u skipped\n", bl.bl_skipped);
+    for (i = 0; i < bl.bl_n; i++)
+      printf("  #%-6u %lld.%09d  first %u  count %u\n",
+	     bl.bl_tag[i].bt_seq, (long long)bl.bl_tag[i].bt_sec,
+	     bl.bl_tag[i].bt_nsec, bl.bl_tag[i].bt_first,
+	     bl.bl_tag[i].bt_count);
+  }
+  if (showlatest) {
+    struct das_latest_snap ls;
+    uint32_t i;
+
+    if (ioctl(dasfd, DAS_GET_LATEST, &ls) != 0) {
+      perror("Get Latest: ");
+      return 1;
+    }
+    for (i = 0; i < DAS_NCHAN; i++) {
+      if (ls.ls_chan[i].dv_seq == 0)
+	continue;
+      printf("  ch%u %4u  sample %u  %lld.%09d\n", i,
+	     ls.ls_chan[i].dv_sample & 0xfff, ls.ls_chan[i].dv_nsamp,
+	     (long long)ls.ls_chan[i].dv_sec, ls.ls_chan[i].dv_nsec);
+    }
+  }
+  if (showfreq) {
+    struct das_freq_val fv;
+
+    if (ioctl(dasfd, DAS_GET_FREQ, &fv) != 0) {
+      perror("Get Freq: ");
+      return 1;
+    }
+    if (fv.fv_seq == 0)
+      printf("counter %u: no gate yet\n", fv.fv_counter);
+    else
+      printf("counter %u: %u edges in %llu ns, %llu.%03llu Hz, period %llu ns\n",
+	     fv.fv_counter, fv.fv_events, (unsigned long long)fv.fv_ns,
+	     (unsigned long long)(fv.fv_mhz / 1000),
+	     (unsigned long long)(fv.fv_mhz % 1000),
+	     (unsigned long long)fv.fv_period_ns);
+  }
+  close(dasfd);
+  return 0;
+}
@@ -0,0 +1,108 @@
+/* dasstream.h -- split a DAS_FMT_RECORDS read stream into samples and records */
+/*
+ * Feed it whatever read(2) returned, in order, in buffers of any size.
+ * Runs of samples go to the sample callback as pointers into the
+ * caller's buffer, so nothing is copied or allocated on the sample path.
+ * A record goes to the record callback with its header and a pointer to
+ * its payload; that points into the caller's buffer too, unless the
+ * record was split across two feeds, in which case its payload is put
+ * back together in the struct das_stream.
+ *
+ * Finding the next record is an OR over four words at a time looking for
+ * DAS_REC_FLAG, which sample words never have.  Unknown record types are
+ * passed on like any other: the length in the header is all the parser
+ * needs.
+ *
+ * Userland only.  Include after dasio.h and <string.h>.
+ */
+#ifndef _DEV_PCI_DASSTREAM_H_
+#define _DEV_PCI_DASSTREAM_H_
+
+/* Return 0 to go on; anything else ends the feed and is returned by it. */
+typedef int das_stream_sample_fn(void *, const uint32_t *, size_t);
+typedef int das_stream_record_fn(void *, uint32_t, const uint32_t *);
+
+struct das_stream {
+  uint32_t ss_hdr;		/* record being put back together, 0 if none */
+  uint32_t ss_have;		/* payload words of it so far */
+  uint64_t ss_samples;		/* sample words seen */
+  uint64_t ss_records;		/* records seen */
+  uint32_t ss_payload[255];	/* DAS_REC_LEN is 8 bits */
+};
+
+static inline void
+das_stream_init(struct das_stream *st)
+{
+  st->ss_hdr = 0;
+  st->ss_have = 0;
+  st->ss_samples = 0;
+  st->ss_records = 0;
+}
+
+/* Number of sample words before the first record header in w[0..n). */
+static inline size_t
+das_stream_scan(const uint32_t *w, size_t n)
+{
+  size_t i = 0;
+
+  while (i + 4 <= n &&
+      ((w[i] | w[i + 1] | w[i + 2] | w[i + 3]) & DAS_REC_FLAG) == 0)
+    i += 4;
+  while (i < n && (w[i] & DAS_REC_FLAG) == 0)
+    i++;
+  return i;
+}
+
+static inline int
+das_stream_feed(struct das_stream *st, const uint32_t *w, size_t n,
+    das_stream_sample_fn *sfn, das_stream_record_fn *rfn, void *arg)
+{
+  size_t i = 0, run, len;
+  uint32_t hdr;
+  int r;
+
+  // finish a record the last buffer cut short
+  if (st->ss_hdr != 0) {
+    len = DAS_REC_LEN(st->ss_hdr) - st->ss_have;
+    if (len > n) {
+      memcpy(st->ss_payload + st->ss_have, w, n * sizeof(*w));
+      st->ss_have += n;
+      return 0;
+    }
+    memcpy(st->ss_payload + st->ss_have, w, len * sizeof(*w));
+    hdr = st->ss_hdr;
+    st->ss_hdr = 0;
+    st->ss_have = 0;
+    st->ss_records++;
+    i = len;
+    if (rfn != NULL && (r = rfn(arg, hdr, st->ss_payload)) != 0)
+      return r;
+  }
+  while (i < n) {
+    run = das_stream_scan(w + i, n - i);
+    if (run != 0) {
+      st->ss_samples += run;
+      if (sfn != NULL && (r = sfn(arg, w + i, run)) != 0)
+	return r;
+      i += run;
+      if (i == n)
+	break;
+    }
+    hdr = w[i++];
+    len = DAS_REC_LEN(hdr);
+    if (len > n - i) {
+      // the rest of the payload comes with the next buffer
+      st->ss_hdr = hdr;
+      st->ss_have = n - i;
+      memcpy(st->ss_payload, w + i, (n - i) * sizeof(*w));
+      return 0;
+    }
+    st->ss_records++;
+    if (rfn != NULL && (r = rfn(arg, hdr, w + i)) != 0)
+      return r;
+    i += len;
+  }
+  return 0;
+}
+
+#endif /* _DEV_PCI_DASSTREAM_H_ */
@@ -0,0 +1,155 @@
+/* dastrace -- fetch and decode the driver's trace flight recorder
+ *
+ * usage: dastrace [-w file] [device]
+ *        dastrace -r file
+ *
+ * Prints every intact record, all CPUs merged in time order, with
+ * times in seconds since the oldest one.  -w saves the raw buffers
+ * instead; -r decodes a saved dump, which may also come from the
+ * Windows driver's IOCTL_DAS_GET_TRACE, since the format is the same.
+ */
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dasio.h"
+#include "dastrace.h"
+
+#define MAXCPU 256
+
+static int
+byns(const void *a, const void *b)
+{
+  const struct das_trace_rec *x = a, *y = b;
+
+  return x->tr_ns < y->tr_ns ? -1 : x->tr_ns > y->tr_ns;
+}
+
+static int
+decode(const char *dump, size_t len)
+{
+  struct das_trace_hdr th;
+  const struct das_trace_cpu *tc;
+  struct das_trace_rec *rec;
+  uint64_t lost, nlost = 0, t0;
+  size_t n = 0, i;
+  uint32_t c;
+
+  if (len < sizeof(th)) {
+    fprintf(stderr, "dastrace: short dump\n");
+    return 1;
+  }
+  memcpy(&th, dump, sizeof(th));
+  if (th.th_magic != DAS_TRACE_MAGIC || th.th_version != DAS_TRACE_VERSION ||
+      th.th_nrec != DAS_TRACE_NREC ||
+      len < sizeof(th) + (size_t)th.th_ncpu * sizeof(*tc)) {
+    fprintf(stderr, "dastrace: not a trace dump this version can read\n");
+    return 1;
+  }
+  tc = (const struct das_trace_cpu *)(dump + sizeof(th));
+  rec = malloc((size_t)th.th_ncpu * DAS_TRACE_NREC * sizeof(*rec) + 1);
+  if (rec == NULL) {
+    perror("dastrace");
+    return 1;
+  }
+  for (c = 0; c < th.th_ncpu; c++) {
+    n += das_trace_collect(&tc[c], rec + n, &lost);
+    nlost += lost;
+  }
+  qsort(rec, n, sizeof(*rec), byns);
+  t0 = n != 0 ? rec[0].tr_ns : 0;
+  for (i = 0; i < n; i++) {
+    printf("%llu.%09llu cpu%-3u %-8s %#llx %#llx\n",
+	   (unsigned long long)((rec[i].tr_ns - t0) / 1000000000),
+	   (unsigned long long)((rec[i].tr_ns - t0) % 1000000000),
+	   rec[i].tr_cpu,
+	   rec[i].tr_ev <= DAS_TEV_MAX ? das_trace_names[rec[i].tr_ev] : "?",
+	   (unsigned long long)rec[i].tr_a0, (unsigned long long)rec[i].tr_a1);
+  }
+  printf("%zu records on %u cpus, %llu overwritten or torn\n",
+	 n, th.th_ncpu, (unsigned long long)nlost);
+  free(rec);
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *dev = "/dev/das0";
+  const char *in = NULL, *out = NULL;
+  struct das_trace_get tg;
+  char *dump;
+  size_t len;
+  FILE *f;
+  int dasfd, ch, r;
+
+  while ((ch = getopt(argc, argv, "r:w:")) != -1) {
+    switch (ch) {
+    case 'r':
+      in = optarg;
+      break;
+    case 'w':
+      out = optarg;
+      break;
+    default:
+      fprintf(stderr, "usage: dastrace [-w file] [device]\n"
+	      "       dastrace -r file\n");
+      return 1;
+    }
+  }
+  if (optind < argc)
+    dev = argv[optind];
+
+  len = sizeof(struct das_trace_hdr) + MAXCPU * sizeof(struct das_trace_cpu);
+  dump = malloc(len);
+  if (dump == NULL) {
+    perror("dastrace");
+    return 1;
+  }
+
+  if (in != NULL) {
+    if ((f = fopen(in, "rb")) == NULL) {
+      perror(in);
+      return 1;
+    }
+    len = fread(dump, 1, len, f);
+    fclose(f);
+    return decode(dump, len);
+  }
+
+  /* read only, so this works while another process has the device open */
+  dasfd = open(dev, O_RDONLY, 0);
+  if (dasfd < 0) {
+    fprintf(stderr, "dastrace: could not open %s\n", dev);
+    perror("dastrace");
+    return 1;
+  }
+  memset(&tg, 0, sizeof(tg));
+  tg.tg_buf = dump;
+  tg.tg_len = len;
+  if (ioctl(dasfd, DAS_GET_TRACE, &tg) != 0) {
+    perror("Get Trace: ");
+    return 1;
+  }
+  close(dasfd);
+  len = sizeof(struct das_trace_hdr) +
+      (size_t)((struct das_trace_hdr *)dump)->th_ncpu * sizeof(struct das_trace_cpu);
+
+  if (out == NULL)
+    return decode(dump, len);
+  if ((f = fopen(out, "wb")) == NULL) {
+    perror(out);
+    return 1;
+  }
+  r = fwrite(dump, 1, len, f) != len;
+  if (fclose(f) != 0 || r) {
+    perror(out);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,239 @@
+/* dastrace.h -- binary event trace for both drivers, decoded offline */
+/*
+ * Trace points are DAS_TRACE_STATE (open, close, ioctls, start, stop,
+ * overruns), DAS_TRACE_IO (each read) and DAS_TRACE_INTR (each
+ * interrupt and DPC).  Anything above DAS_TRACE_LEVEL compiles to
+ * nothing, so the default build leaves the interrupt path untouched.
+ *
+ * An enabled trace point formats nothing.  It hands an event number and
+ * two integers to the platform backend (an SDT probe on NetBSD, WPP on
+ * Windows) and stores the same three in a per-CPU flight recorder:
+ * reserve a slot with an atomic increment, which is uncontended since
+ * only this CPU uses the buffer, fill it, then write its sequence last.
+ * The buffer wraps; a reader keeps only records whose sequence matches
+ * their slot, both before and after it copies the rest, which drops
+ * anything overwritten or half written.  The drivers take the snapshot
+ * record by record with das_trace_snap, so a dump never holds a record
+ * mixing two writes under one valid sequence.  The buffers are fetched with DAS_GET_TRACE (IOCTL_DAS_GET_TRACE on
+ * Windows) as a struct das_trace_hdr followed by th_ncpu struct
+ * das_trace_cpu, and dastrace(1) turns them into text.
+ *
+ * The includer defines DAS_TRACE_BUF (the struct das_trace_cpu array,
+ * or NULL), DAS_TRACE_NCPU and DAS_TRACE_BACKEND(ev, a0, a1) before the
+ * first trace point.  The NetBSD and Windows kernels get their atomic,
+ * barrier, CPU and clock hooks here; elsewhere they are C11 builtins,
+ * CPU 0 and CLOCK_MONOTONIC, so include <time.h> first.
+ */
+#ifndef _DEV_PCI_DASTRACE_H_
+#define _DEV_PCI_DASTRACE_H_
+
+#define DAS_TL_OFF 0
+#define DAS_TL_STATE 1
+#define DAS_TL_IO 2
+#define DAS_TL_INTR 3
+
+#ifndef DAS_TRACE_LEVEL
+#define DAS_TRACE_LEVEL DAS_TL_STATE
+#endif
+
+/* Events: a0, a1 */
+#define DAS_TEV_OPEN 1		/* open flags, error */
+#define DAS_TEV_CLOSE 2		/* 0, 0 */
+#define DAS_TEV_IOCTL 3		/* command, 0 */
+#define DAS_TEV_BADIOCTL 4	/* command, 0 */
+#define DAS_TEV_START 5		/* rate, channel */
+#define DAS_TEV_STOP 6		/* samples produced, 0 */
+#define DAS_TEV_OVERRUN 7	/* producer index, consumer index */
+#define DAS_TEV_READ 8		/* samples copied, consumer index before */
+#define DAS_TEV_INTR 9		/* CTR1 status, producer index */
+#define DAS_TEV_DPC 10		/* samples drained, 0 */
+#define DAS_TEV_MAX 10
+
+#define DAS_TRACE_NREC 1024	/* records per CPU, a power of two */
+#define DAS_TRACE_MAGIC 0x44415354	/* "DAST" */
+#define DAS_TRACE_VERSION 1
+
+struct das_trace_rec {
+  volatile uint32_t tr_seq;	/* slot sequence + 1, written last */
+  uint16_t tr_ev;
+  uint16_t tr_cpu;
+  uint64_t tr_ns;		/* monotonic */
+  uint64_t tr_a0;
+  uint64_t tr_a1;
+};
+
+struct das_trace_cpu {
+  volatile uint32_t tc_next;	/* slots reserved, free running */
+  uint32_t tc_pad[15];
+  struct das_trace_rec tc_rec[DAS_TRACE_NREC];
+};
+
+struct das_trace_hdr {
+  uint32_t th_magic;		/* DAS_TRACE_MAGIC */
+  uint32_t th_version;		/* DAS_TRACE_VERSION */
+  uint32_t th_ncpu;		/* buffers that follow */
+  uint32_t th_nrec;		/* DAS_TRACE_NREC */
+};
+
+#if defined(_KERNEL)
+#define DAS_TRACE_INC(p) atomic_inc_32_nv(p)
+#define DAS_TRACE_RELEASE() membar_producer()
+#define DAS_TRACE_ACQUIRE() membar_consumer()
+#define DAS_TRACE_CPU() cpu_index(curcpu())
+#define DAS_TRACE_NOW() das_trace_ns()
+
+static inline uint64_t
+das_trace_ns(void)
+{
+  struct timespec ts;
+
+  nanouptime(&ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#elif defined(_KERNEL_MODE)
+#define DAS_TRACE_INC(p) ((uint32_t)InterlockedIncrement((volatile LONG *)(p)))
+#define DAS_TRACE_RELEASE() KeMemoryBarrier()
+#define DAS_TRACE_ACQUIRE() KeMemoryBarrier()
+#define DAS_TRACE_CPU() KeGetCurrentProcessorNumberEx(NULL)
+#define DAS_TRACE_NOW() das_trace_ns()
+
+static inline uint64_t
+das_trace_ns(void)
+{
+  ULONG64 qpc;
+
+  return KeQueryInterruptTimePrecise(&qpc) * 100;
+}
+#else
+#define DAS_TRACE_INC(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define DAS_TRACE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#ifndef DAS_TRACE_ACQUIRE	/* a test steps in between a copy's reads */
+#define DAS_TRACE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+#define DAS_TRACE_CPU() 0
+#define DAS_TRACE_NOW() das_trace_ns()
+
+static inline uint64_t
+das_trace_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+static inline void
+das_trace_put(struct das_trace_cpu *buf, uint32_t ncpu, uint32_t cpu,
+    uint16_t ev, uint64_t a0, uint64_t a1)
+{
+  struct das_trace_cpu *tc = &buf[cpu % ncpu];
+  uint32_t seq = DAS_TRACE_INC(&tc->tc_next) - 1;
+  struct das_trace_rec *tr = &tc->tc_rec[seq & (DAS_TRACE_NREC - 1)];
+
+  tr->tr_seq = 0;
+  DAS_TRACE_RELEASE();
+  tr->tr_ev = ev;
+  tr->tr_cpu = (uint16_t)cpu;
+  tr->tr_ns = DAS_TRACE_NOW();
+  tr->tr_a0 = a0;
+  tr->tr_a1 = a1;
+  DAS_TRACE_RELEASE();
+  tr->tr_seq = seq + 1;
+}
+
+/*
+ * Copy one record while it may be rewritten: read its sequence, then the
+ * rest, then the sequence again.  Returns the sequence, or 0 when the
+ * record was half written or changed during the copy.
+ */
+static inline uint32_t
+das_trace_copy(struct das_trace_rec *dst, const struct das_trace_rec *src)
+{
+  uint32_t seq = src->tr_seq;
+
+  DAS_TRACE_ACQUIRE();
+  dst->tr_ev = src->tr_ev;
+  dst->tr_cpu = src->tr_cpu;
+  dst->tr_ns = src->tr_ns;
+  dst->tr_a0 = src->tr_a0;
+  dst->tr_a1 = src->tr_a1;
+  DAS_TRACE_ACQUIRE();
+  if (src->tr_seq != seq)
+    seq = 0;
+  dst->tr_seq = seq;
+  return seq;
+}
+
+/* Snapshot one CPU's live buffer for a dump; torn records get sequence 0 */
+static inline void
+das_trace_snap(struct das_trace_cpu *dst, const struct das_trace_cpu *src)
+{
+  uint32_t i;
+
+  dst->tc_next = src->tc_next;
+  for (i = 0; i < sizeof(dst->tc_pad) / sizeof(dst->tc_pad[0]); i++)
+    dst->tc_pad[i] = 0;
+  DAS_TRACE_ACQUIRE();
+  for (i = 0; i < DAS_TRACE_NREC; i++)
+    das_trace_copy(&dst->tc_rec[i], &src->tc_rec[i]);
+}
+
+#define DAS_TRACE_EMIT(ev, a0, a1) do {				\
+  DAS_TRACE_BACKEND((ev), (a0), (a1));					\
+  if ((DAS_TRACE_BUF) != NULL)						\
+    das_trace_put((DAS_TRACE_BUF), (DAS_TRACE_NCPU), DAS_TRACE_CPU(),	\
+	(ev), (uint64_t)(a0), (uint64_t)(a1));				\
+} while (0)
+
+#if DAS_TRACE_LEVEL >= DAS_TL_STATE
+#define DAS_TRACE_STATE(ev, a0, a1) DAS_TRACE_EMIT(ev, a0, a1)
+#else
+#define DAS_TRACE_STATE(ev, a0, a1) do { } while (0)
+#endif
+#if DAS_TRACE_LEVEL >= DAS_TL_IO
+#define DAS_TRACE_IO(ev, a0, a1) DAS_TRACE_EMIT(ev, a0, a1)
+#else
+#define DAS_TRACE_IO(ev, a0, a1) do { } while (0)
+#endif
+#if DAS_TRACE_LEVEL >= DAS_TL_INTR
+#define DAS_TRACE_INTR(ev, a0, a1) DAS_TRACE_EMIT(ev, a0, a1)
+#else
+#define DAS_TRACE_INTR(ev, a0, a1) do { } while (0)
+#endif
+
+#if !defined(_KERNEL) && !defined(_KERNEL_MODE)
+static const char *const das_trace_names[DAS_TEV_MAX + 1] = {
+  "?", "open", "close", "ioctl", "badioctl", "start", "stop", "overrun",
+  "read", "intr", "dpc",
+};
+
+/*
+ * Copy the intact records of one CPU's buffer to out, oldest first;
+ * returns how many.  *lost gets the records overwritten before the
+ * buffer was fetched plus any caught half written.  tc may be a dump or
+ * a live buffer.
+ */
+static inline size_t
+das_trace_collect(const struct das_trace_cpu *tc, struct das_trace_rec *out,
+    uint64_t *lost)
+{
+  uint32_t next = tc->tc_next, seq, first;
+  size_t n = 0;
+
+  DAS_TRACE_ACQUIRE();
+  first = next > DAS_TRACE_NREC ? next - DAS_TRACE_NREC : 0;
+  *lost = first;
+  for (seq = first; seq != next; seq++) {
+    if (das_trace_copy(&out[n], &tc->tc_rec[seq & (DAS_TRACE_NREC - 1)]) !=
+	seq + 1) {
+      (*lost)++;
+      continue;
+    }
+    n++;
+  }
+  return n;
+}
+#endif
+
+#endif /* _DEV_PCI_DASTRACE_H_ */
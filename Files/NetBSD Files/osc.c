@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/* Largest DAS_START_COUNT run option 11 will hold in memory */
+#define MAX_COUNT (1 << 20)
+
 int
 main()
 {
@@ -46,11 +49,12 @@ main()
       printf("8.  Osciliscope (DANGER)\n");
       printf("9.  Write Data to File\n");
       printf("10. Exit\n");
+      printf("11. Capture Exactly N Samples\n");
       printf("Select Option: ");
       s = scanf("%d", &option);
 
       if (s < 1) {
-	option = 11;
+	option = 0;
 	while (fgetc(stdin) != '\n' && !feof(stdin)) /* spin! */;
       }
       
@@ -119,6 +123,33 @@ main()
 	case 10:
 	  run = 0;
 	  break;
+
+	case 11:
+	  /* the driver stops itself after the last one; read until EOF */
+	  printf("How many data points[1-%d]? ", MAX_COUNT);
+	  if(scanf("%d", &data) != 1 || data <= 0 || data > MAX_COUNT) {
+	    printf("Count must be 1 to %d\n", MAX_COUNT);
+	    break;
+	  }
+	  /* the buffer first, so a failed one never leaves a run going */
+	  buffer = (int *)malloc(sizeof(int) * data);
+	  if(buffer == NULL) {
+	    perror("Start Count: ");
+	    break;
+	  }
+	  if( ioctl(dasfd, DAS_START_COUNT, &data) != 0) {
+	    perror("Start Count: ");
+	    free(buffer);
+	    break;
+	  }
+	  length = 0;
+	  while((n = read(dasfd, buffer + length, (data - length) * sizeof(int))) > 0)
+	    length += n / sizeof(int);
+	  for(i = 0; i < length; i++)
+	    printf("Time: %d  Value:0x%x\n", buffer[i]>>16, buffer[i]&0xffff);
+	  printf("Actually read %d\n", length);
+	  free(buffer);
+	  break;
 	  
 	case 8:
 	  printf("You will HAVE to press CTRL-C to exit this mode!\n");
@@ -57,7 +57,7 @@ Return Value:
         &deviceConfig,
         das1EvtDeviceCreateFile,
         das1EvtDeviceClose,
-        WDF_NO_EVENT_CALLBACK // No cleanup callback function
+        das1EvtDeviceCleanup // unmaps the sample ring in the closing process
     );
     WdfDeviceInitSetFileObjectConfig(
         DeviceInit,
@@ -66,6 +66,11 @@ Return Value:
     );
 
 
+    // reads go straight to the caller's pages; the ring mapping must
+    // be set up in the caller's process
+    WdfDeviceInitSetIoType(DeviceInit, WdfDeviceIoDirect);
+    WdfDeviceInitSetIoInCallerContextCallback(DeviceInit, das1EvtIoInCallerContext);
+
     status = WdfDeviceCreate(&DeviceInit, &deviceAttributes, &device);
 
     if (NT_SUCCESS(status)) {
@@ -85,17 +90,29 @@ Return Value:
         //
         deviceContext->DasBufferPointer = 0;
         deviceContext->DasBufferInterruptPointer = 0;
-        deviceContext->OutputBufferPosition = 0;
+        deviceContext->DasBufferReaderPointer = 0;
         deviceContext->isOpen = 0;
-        deviceContext->readWaiting = FALSE;
         deviceContext->isrRequest = FALSE;
         deviceContext->rate = DAS_DEFAULT_RATE;
         deviceContext->channel = DAS_DEFAULT_CHANNEL;
-        deviceContext->DasSample = 0;
-        deviceContext->clockValue = 0;
-        deviceContext->Length = 0;
-        deviceContext->Request = NULL;
+        das1IsrRingReset(&deviceContext->IsrRing);
         deviceContext->samp = 0;
+        deviceContext->ControlShadow = 0;
+        deviceContext->ClockShadow = 0;
+        deviceContext->PortReads = 0;
+        deviceContext->PortWrites = 0;
+        deviceContext->ReadTimerArmed = FALSE;
+        deviceContext->ReadWatermark = DAS_READ_WATERMARK;
+        deviceContext->ReadTimeout = DAS_READ_TIMEOUT_MS;
+        deviceContext->ReadNeed = MAXULONG;
+        deviceContext->ReadOverruns = 0;
+        deviceContext->MapControl = NULL;
+        deviceContext->MapData = NULL;
+        deviceContext->MapMdl = NULL;
+        deviceContext->MapUser = NULL;
+        deviceContext->MapProcess = NULL;
+        deviceContext->MapEvent = NULL;
+        deviceContext->MapFile = NULL;
         int size = DAS_BUFFER_SIZE;
         for (int i = 0; i < size + 1; i++)
             deviceContext->DasSampleBuffer[i] = 0;
@@ -20,6 +20,12 @@ Environment:
 #include "driver.h"
 #include "driver.tmh"
 #include "wdasio.h"
+#include "wdasreg.h"
+#include "wdastrace.h"
+
+// per-CPU trace buffers, NULL when not tracing
+struct das_trace_cpu *das1TraceBuf;
+ULONG das1TraceNcpu;
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text (INIT, DriverEntry)
@@ -70,6 +76,19 @@ Return Value:
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+#if DAS_TRACE_LEVEL > DAS_TL_OFF
+    //
+    // The flight recorder is touched from the ISR, so it is nonpaged.
+    // Without it the trace points still go to WPP.
+    //
+    das1TraceNcpu = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    das1TraceBuf = ExAllocatePoolWithTag(NonPagedPoolNx,
+        das1TraceNcpu * sizeof(struct das_trace_cpu), 'tsaD');
+    if (das1TraceBuf != NULL) {
+        RtlZeroMemory(das1TraceBuf, das1TraceNcpu * sizeof(struct das_trace_cpu));
+    }
+#endif
+
 
     //
     // Register a cleanup callback so that we can call WPP_CLEANUP when
@@ -91,6 +110,10 @@ Return Value:
 
     if (!NT_SUCCESS(status)) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDriverCreate failed %!STATUS!", status);
+        if (das1TraceBuf != NULL) {
+            ExFreePoolWithTag(das1TraceBuf, 'tsaD');
+            das1TraceBuf = NULL;
+        }
         WPP_CLEANUP(DriverObject);
         return status;
     }
@@ -177,12 +200,30 @@ Return Value:
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+    if (das1TraceBuf != NULL) {
+        ExFreePoolWithTag(das1TraceBuf, 'tsaD');
+        das1TraceBuf = NULL;
+    }
+
     //
     // Stop WPP Tracing
     //
     WPP_CLEANUP(WdfDriverWdmGetDriverObject((WDFDRIVER)DriverObject));
 }
 
+VOID
+das1TraceWpp(
+    _In_ USHORT Event,
+    _In_ ULONG64 A0,
+    _In_ ULONG64 A1
+    )
+/*++
+* Live backend for the trace points in wdastrace.h
+--*/
+{
+    TraceEvents(TRACE_LEVEL_VERBOSE, MYDRIVER_ALL_INFO, "das event %u %I64x %I64x", Event, A0, A1);
+}
+
 VOID
 das1EvtDeviceCreateFile(
     WDFDEVICE Device,
@@ -194,32 +235,21 @@ das1EvtDeviceCreateFile(
 {
     UNREFERENCED_PARAMETER(FileObject);
     PDEVICE_CONTEXT context = DeviceGetContext(Device);
-    DbgPrint("attempting to open with: %d\n", context->isOpen);
     if (!context->isOpen) {
         context->isOpen = 1;
-        KdPrint(("isOpen: %d\n",context->isOpen));
-        PUCHAR controlReg = context->BADR2 + DAS_CONTROL_REGISTER;
-        PUCHAR clockReg = context->BADR2 + DAS_CLOCK_CONTROL_REGISTER;
-        PUCHAR cnter2 = context->BADR2 + DAS_CLOCK_REGISTER;
-        UCHAR clockCMD = DAS_CLOCK_INITIALIZE_CONTROL_WORD;
-        WRITE_PORT_UCHAR(clockReg, clockCMD);
-
         ULONG initialClock = (DAS_DEFAULT_RATE*DAS_CLOCK_SPEED)/1000;
-        UCHAR commandLow, commandHigh;
-        commandHigh = (UCHAR)(initialClock >> 8);
-        commandLow = (UCHAR)(initialClock & 0xff);
-        WRITE_PORT_UCHAR(cnter2, commandHigh);
-        WRITE_PORT_UCHAR(cnter2, commandLow);
-        UCHAR command = READ_PORT_UCHAR(controlReg);
-        DbgPrint("before change %d\n", command);
-        command = (8 & ~((UCHAR)7));
-        command = command | context->channel;
-        DbgPrint("after change %d\n", command);
-        WRITE_PORT_UCHAR(controlReg, command);
-
+        // interrupts on, sampling off; nothing to read back first
+        UCHAR command = DAS_CONTROL_INTE | context->channel;
+        WdfInterruptAcquireLock(context->DasInterrupt);
+        das1RegSetClock(context, (USHORT)initialClock);
+        das1RegSetControl(context, command);
+        WdfInterruptReleaseLock(context->DasInterrupt);
+
+        DAS_TRACE_STATE(DAS_TEV_OPEN, 0, STATUS_SUCCESS);
         WdfRequestComplete(Request, STATUS_SUCCESS);
     }
     else {
+        DAS_TRACE_STATE(DAS_TEV_OPEN, 0, STATUS_OPEN_FAILED);
         WdfRequestComplete(Request, STATUS_OPEN_FAILED);
     }
 }
@@ -244,7 +274,7 @@ das1EvtD0Entry(
     //Initial Values
     DeviceContext->DasBufferInterruptPointer = 0;
     DeviceContext->DasBufferReaderPointer = 0;
-    DeviceContext->DasSample = 0;
+    das1IsrRingReset(&DeviceContext->IsrRing);
 
     ULONG Command;
     PULONG Address;
@@ -271,6 +301,18 @@ das1EvtD0Entry(
     return STATUS_SUCCESS;
 }
 
+VOID
+das1EvtDeviceCleanup(
+    WDFFILEOBJECT FileObject)
+/*++
+* Last handle closed: runs in the closing process,
+* so a ring it mapped can be taken down
+--*/
+{
+    PDEVICE_CONTEXT context = DeviceGetContext(WdfFileObjectGetDevice(FileObject));
+    das1UnmapRing(context, FileObject);
+}
+
 VOID
 das1EvtDeviceClose(
     WDFFILEOBJECT FileObject)
@@ -281,6 +323,7 @@ das1EvtDeviceClose(
     WDFDEVICE dev = WdfFileObjectGetDevice(FileObject);
     PDEVICE_CONTEXT context = DeviceGetContext(dev);
     context->isOpen = 0;
+    DAS_TRACE_STATE(DAS_TEV_CLOSE, 0, 0);
 
 }
 
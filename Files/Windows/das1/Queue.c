@@ -17,6 +17,10 @@ Environment:
 #include "driver.h"
 #include "queue.tmh"
 #include "wdasio.h"
+#include "wdasreg.h"
+#include "wdasread.h"
+#include "wdasroute.h"
+#include "wdastrace.h"
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text (PAGE, das1QueueInitialize)
@@ -34,9 +38,13 @@ Routine Description:
      The I/O dispatch callbacks for the frameworks device object
      are configured in this function.
 
-     A single default I/O Queue is configured for parallel request
-     processing, and a driver context memory allocation is created
-     to hold our structure QUEUE_CONTEXT.
+     The default I/O Queue is configured for parallel request
+     processing.  It completes status IOCTLs itself and forwards the
+     rest to a sequential configuration queue (see wdasroute.h).
+
+     Reads are dispatched to their own sequential queue, which forwards
+     them in order to a manual queue where they wait for samples; the
+     read lock and timer are created here as well.
 
 Arguments:
 
@@ -51,6 +59,9 @@ Return Value:
     WDFQUEUE queue;
     NTSTATUS status;
     WDF_IO_QUEUE_CONFIG queueConfig;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    WDF_TIMER_CONFIG timerConfig;
+    PDEVICE_CONTEXT context = DeviceGetContext(Device);
 
     PAGED_CODE();
 
@@ -61,12 +72,11 @@ Return Value:
     //
     WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(
          &queueConfig,
-        WdfIoQueueDispatchSequential
+        WdfIoQueueDispatchParallel
         );
     
-    queueConfig.EvtIoDeviceControl = das1EvtIoDeviceControl;
+    queueConfig.EvtIoDeviceControl = das1EvtIoControlRoute;
     queueConfig.EvtIoStop = das1EvtIoStop;
-    queueConfig.EvtIoRead = das1EvtDeviceRead;
     queueConfig.EvtIoWrite = das1EvtDevieWrite;
 
 
@@ -83,9 +93,108 @@ Return Value:
         return status;
     }
 
+    WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchSequential);
+    queueConfig.EvtIoDeviceControl = das1EvtIoDeviceControl;
+    queueConfig.EvtIoStop = das1EvtIoStop;
+    status = WdfIoQueueCreate(
+                 Device,
+                 &queueConfig,
+                 WDF_NO_OBJECT_ATTRIBUTES,
+                 &context->ConfigQueue
+                 );
+    if(!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfIoQueueCreate failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchSequential);
+    queueConfig.EvtIoRead = das1EvtDeviceRead;
+    status = WdfIoQueueCreate(
+                 Device,
+                 &queueConfig,
+                 WDF_NO_OBJECT_ATTRIBUTES,
+                 &queue
+                 );
+    if(NT_SUCCESS(status)) {
+        status = WdfDeviceConfigureRequestDispatching(Device, queue, WdfRequestTypeRead);
+    }
+    if(!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "read queue setup failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
+    status = WdfIoQueueCreate(
+                 Device,
+                 &queueConfig,
+                 WDF_NO_OBJECT_ATTRIBUTES,
+                 &context->ReadQueue
+                 );
+    if(!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfIoQueueCreate failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+    status = WdfSpinLockCreate(&attributes, &context->ReadLock);
+    if(!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfSpinLockCreate failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_TIMER_CONFIG_INIT(&timerConfig, das1EvtReadTimer);
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+    status = WdfTimerCreate(&timerConfig, &attributes, &context->ReadTimer);
+    if(!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfTimerCreate failed %!STATUS!", status);
+        return status;
+    }
+
     return status;
 }
 
+VOID
+das1EvtIoControlRoute(
+    _In_ WDFQUEUE Queue,
+    _In_ WDFREQUEST Request,
+    _In_ size_t OutputBufferLength,
+    _In_ size_t InputBufferLength,
+    _In_ ULONG IoControlCode
+    )
+/*++
+
+Routine Description:
+
+    IRP_MJ_DEVICE_CONTROL on the parallel default queue.  Status
+    queries are handled here and now; configuration requests are
+    forwarded to the sequential configuration queue.
+
+--*/
+{
+    PDEVICE_CONTEXT context = DeviceGetContext(WdfIoQueueGetDevice(Queue));
+    NTSTATUS status;
+
+    DAS_TRACE_STATE(DAS_TEV_IOCTL, IoControlCode, 0);
+    switch (das1Route(IoControlCode)) {
+    case DAS_ROUTE_STATUS:
+        das1EvtIoDeviceControl(Queue, Request, OutputBufferLength, InputBufferLength, IoControlCode);
+        break;
+    case DAS_ROUTE_CONFIG:
+        status = WdfRequestForwardToIoQueue(Request, context->ConfigQueue);
+        if (!NT_SUCCESS(status)) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoControlRoute failed %!STATUS!", status);
+            WdfRequestComplete(Request, status);
+        }
+        break;
+    default:
+        DAS_TRACE_STATE(DAS_TEV_BADIOCTL, IoControlCode, 0);
+        WdfRequestComplete(Request, STATUS_INVALID_DEVICE_REQUEST);
+        break;
+    }
+}
+
 VOID
 das1EvtIoDeviceControl(
     _In_ WDFQUEUE Queue,
@@ -130,55 +239,46 @@ Return Value:
     PDEVICE_CONTEXT context = DeviceGetContext(device);
     int clock_command,
         holder;
-    PUCHAR address,
-        clock_control_reg,
-        clock_reg;
-    UCHAR sample_cmd = 0,
-        clock_command_low,
-        clock_command_high,
-        stat_reg,
-        clock_control;
+    UCHAR stat_reg;
+    PDAS_REGOP ops;
+    DAS_REGOP op;
+    struct das_trace_hdr *hdr;
+    size_t length;
+    ULONG count, value, i;
     WdfRequestSetInformation(Request, OutputBufferLength);
     // Main Function
     // Check IOCTL value
     // Switch Statemnt
-    DbgPrint("EnteringIOCTL\n");
     switch (IoControlCode) {
     case IOCTL_DAS_START_SAMPLING:
         // Send start sampling command
-        sample_cmd = 24|context->channel;
-        context->samp = 1;
         context->DasBufferPointer = 0;
-        address = context->BADR2 +DAS_CONTROL_REGISTER;
         //write sample command to hardware
-        WRITE_PORT_UCHAR(
-            address,//PUCHAR port
-            sample_cmd
-        );
+        // the ISR rewrites the shadow on every interrupt, so hold it off
+        WdfInterruptAcquireLock(context->DasInterrupt);
+        context->samp = 1;
+        das1RegSetControl(context, DAS_CONTROL_INTE | DAS_CONTROL_OP1 | context->channel);
+        WdfInterruptReleaseLock(context->DasInterrupt);
+        DAS_TRACE_STATE(DAS_TEV_START, context->rate, context->channel);
         break;
     case IOCTL_DAS_STOP_SAMPLING:
-        context->samp = 0;
-        sample_cmd = 8 | context->channel;
-        address = context->BADR2 + DAS_CONTROL_REGISTER;
         //write sample command to hw
-        WRITE_PORT_UCHAR(
-            address,//PUCHAR port
-            sample_cmd
-        );
+        WdfInterruptAcquireLock(context->DasInterrupt);
+        context->samp = 0;
+        das1RegSetControl(context, DAS_CONTROL_INTE | context->channel);
+        WdfInterruptReleaseLock(context->DasInterrupt);
         // Send Stop sampling command
+        // nothing more is coming, so pending reads get what is left
+        das1ReadService(context, DAS_READ_FLUSH);
+        DAS_TRACE_STATE(DAS_TEV_STOP, context->IsrRing.Head, 0);
         break;
     case IOCTL_DAS_GET_CHANNEL:
         // Return the current channel of sampling
-        address = context->BADR2 +DAS_CONTROL_REGISTER;
-        //read from bus
-        stat_reg = READ_PORT_UCHAR(
-            address
-        );
-        //bit stuff to get channel
-        stat_reg = stat_reg&7;
+        // from the shadow, the control register is not read back
+        stat_reg = das1RegChannel(context);
         //context->outputBuffer = (ULONG)stat_reg;
-        DbgPrint("in get channel %d\n", stat_reg);
-        context->Register = stat_reg;
+        // a local: GET_CHANNEL runs in parallel with itself
+        value = stat_reg;
         //write to user space
         //SIZE_T length;
         //PVOID userSpace;
@@ -189,23 +289,18 @@ Return Value:
             return;
         }
         //ProbeForRead(context->outputBuffer, length, 0);
-        DbgPrint("found mem\n");
-        status = WdfMemoryCopyFromBuffer(user_memory, 0, &context->Register, OutputBufferLength);
+        status = WdfMemoryCopyFromBuffer(user_memory, 0, &value,
+            OutputBufferLength < sizeof(value) ? OutputBufferLength : sizeof(value));
         //RtlCopyMemory(userSpace, &context->Register, length);
         //RtlCopyMemory(&context->Register, context->outputBuffer, length);
         //DbgPrint("memoint: %ld\n", context->outputBuffer);
-        DbgPrint("wrote: %d\n", context->Register);
         if (!NT_SUCCESS(status)) {
             TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
             return;
         }
-
-        DbgPrint("wrote to user\n");
         break;
     case IOCTL_DAS_SET_CHANNEL:
         // set the current channel of sampling
-        address = context->BADR2 + DAS_CONTROL_REGISTER;
-        stat_reg = READ_PORT_UCHAR(address);
         status = WdfRequestRetrieveInputMemory(Request, &user_memory);
         if (!NT_SUCCESS(status)) {
             TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
@@ -216,17 +311,12 @@ Return Value:
             TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
             return;
         }
-        //stat_reg = (stat_reg & ((UCHAR)~7)) | context->channel;
-        if (context->samp == 1) {
-            stat_reg = 24 | context->channel;
-        }
-        else {
-            stat_reg = 8 | context->channel;
-        }
-        WRITE_PORT_UCHAR(
-            address,
-            stat_reg
-        );
+        // swap the channel into the shadow, INTE and OP1 stay as they are;
+        // the ISR's own read-modify-write of the shadow must not interleave
+        WdfInterruptAcquireLock(context->DasInterrupt);
+        stat_reg = (context->ControlShadow & ~DAS_CONTROL_MUX) | context->channel;
+        das1RegSetControl(context, stat_reg);
+        WdfInterruptReleaseLock(context->DasInterrupt);
         break;
     case IOCTL_DAS_GET_RATE:
         // return the current rate of the clock
@@ -245,43 +335,130 @@ Return Value:
     case IOCTL_DAS_SET_RATE:
         // Set the clock rate
         // maximum 1588
-        holder = context->rate;
         status = WdfRequestRetrieveInputMemory(Request, &user_memory);
         if (!NT_SUCCESS(status)) {
             TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
             return;
         }
-        status = WdfMemoryCopyToBuffer(user_memory, 0, &context->rate, sizeof(int));
+        status = WdfMemoryCopyToBuffer(user_memory, 0, &holder, sizeof(int));
         if (!NT_SUCCESS(status)) {
             TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
             return;
         }
-        if (context->rate > 1588) {
-            context->rate = holder;
-        }
-        else
-        {
+        // checked before it is stored: GET_RATE and the DPC read it unlocked
+        if (holder >= 0 && holder <= 1588) {
             // Do some magic here
-            clock_command = context->rate;
-            clock_command = (clock_command * DAS_CLOCK_SPEED);
-            clock_command_high = (UCHAR)(clock_command >> 8);
-            clock_command_low = (UCHAR)(clock_command & 0xff);
-            clock_control = DAS_CLOCK_INITIALIZE_CONTROL_WORD;
-            clock_control_reg = context->BADR2 + DAS_CLOCK_CONTROL_REGISTER;
-            clock_reg = context->BADR2 + DAS_CLOCK_REGISTER;
-            WRITE_PORT_UCHAR(clock_control_reg, clock_control);
-            WRITE_PORT_UCHAR(clock_reg, clock_command_low);
-            WRITE_PORT_UCHAR(clock_reg, clock_command_high);
+            clock_command = holder;
+            clock_command = (clock_command * DAS_CLOCK_SPEED) / 1000;
+            // the ISR latches counter 2 through the same control port
+            WdfInterruptAcquireLock(context->DasInterrupt);
+            context->rate = holder;
+            das1RegSetClock(context, (USHORT)clock_command);
+            WdfInterruptReleaseLock(context->DasInterrupt);
         }
         break;
 
     // Developer IOCTL CMDS
     case IOCTL_DAS_GET_REGISTER:
+        // a one entry batch: BADR2 offset in, value out
+        status = WdfRequestRetrieveInputMemory(Request, &user_memory);
+        if (NT_SUCCESS(status)) {
+            status = WdfMemoryCopyToBuffer(user_memory, 0, &holder, sizeof(int));
+        }
+        if (!NT_SUCCESS(status)) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
+            WdfRequestComplete(Request, status);
+            return;
+        }
+        RtlZeroMemory(&op, sizeof(op));
+        op.Op = DAS_REGOP_READ;
+        op.Bar = DAS_REGOP_BADR2;
+        op.Offset = (USHORT)holder;
+        if (holder < 0 || holder > 0xffff || !das1RegBatchCheck(&op, 1)) {
+            WdfRequestComplete(Request, STATUS_INVALID_PARAMETER);
+            return;
+        }
+        das1RegBatch(context, &op, 1);
+        holder = (int)op.Result;
+        status = WdfRequestRetrieveOutputMemory(Request, &user_memory);
+        if (NT_SUCCESS(status)) {
+            status = WdfMemoryCopyFromBuffer(user_memory, 0, &holder, sizeof(int));
+        }
+        if (!NT_SUCCESS(status)) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
+            WdfRequestComplete(Request, status);
+            return;
+        }
         break;
     case IOCTL_DAS_SET_REGISTER:
+        // (regno << 16) | data
+        status = WdfRequestRetrieveInputMemory(Request, &user_memory);
+        if (NT_SUCCESS(status)) {
+            status = WdfMemoryCopyToBuffer(user_memory, 0, &holder, sizeof(int));
+        }
+        if (!NT_SUCCESS(status)) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
+            WdfRequestComplete(Request, status);
+            return;
+        }
+        RtlZeroMemory(&op, sizeof(op));
+        op.Op = DAS_REGOP_WRITE;
+        op.Bar = DAS_REGOP_BADR2;
+        op.Offset = (USHORT)((holder >> 16) & 0xffff);
+        op.Value = holder & 0xff;
+        if (!das1RegBatchCheck(&op, 1)) {
+            WdfRequestComplete(Request, STATUS_INVALID_PARAMETER);
+            return;
+        }
+        das1RegBatch(context, &op, 1);
         break;
+    case IOCTL_DAS_REGISTER_BATCH:
+        // buffered: the list is run in place and returned in the same buffer
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(DAS_REGOP), (PVOID *)&ops, &length);
+        if (!NT_SUCCESS(status)) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
+            WdfRequestComplete(Request, status);
+            return;
+        }
+        count = (ULONG)(length / sizeof(DAS_REGOP));
+        if (OutputBufferLength < count * sizeof(DAS_REGOP) || !das1RegBatchCheck(ops, count)) {
+            WdfRequestComplete(Request, STATUS_INVALID_PARAMETER);
+            return;
+        }
+        das1RegBatch(context, ops, count);
+        WdfRequestCompleteWithInformation(Request, STATUS_SUCCESS, count * sizeof(DAS_REGOP));
+        return;
+    case IOCTL_DAS_GET_TRACE:
+        // a snapshot taken record by record while tracing goes on;
+        // das_trace_snap zeroes the sequence of any record rewritten
+        // during the copy, and the decoder drops it
+        if (das1TraceBuf == NULL) {
+            WdfRequestComplete(Request, STATUS_NOT_SUPPORTED);
+            return;
+        }
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(*hdr), (PVOID *)&hdr, &length);
+        if (!NT_SUCCESS(status)) {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
+            WdfRequestComplete(Request, status);
+            return;
+        }
+        count = (ULONG)((length - sizeof(*hdr)) / sizeof(struct das_trace_cpu));
+        if (count > das1TraceNcpu) {
+            count = das1TraceNcpu;
+        }
+        hdr->th_magic = DAS_TRACE_MAGIC;
+        hdr->th_version = DAS_TRACE_VERSION;
+        hdr->th_ncpu = count;
+        hdr->th_nrec = DAS_TRACE_NREC;
+        for (i = 0; i < count; i++) {
+            das_trace_snap((struct das_trace_cpu *)(hdr + 1) + i, &das1TraceBuf[i]);
+        }
+        WdfRequestCompleteWithInformation(Request, STATUS_SUCCESS,
+            sizeof(*hdr) + count * sizeof(struct das_trace_cpu));
+        return;
     default:
-        KdPrint(("Invalid IOCTL\n"));
+        DAS_TRACE_STATE(DAS_TEV_BADIOCTL, IoControlCode, 0);
+        WdfRequestComplete(Request, STATUS_INVALID_DEVICE_REQUEST);
         return;
     }
     WdfRequestComplete(Request, STATUS_SUCCESS);
@@ -364,12 +541,116 @@ Return Value:
     return;
 }
 
-VOID 
-das1EvtDeviceRead(WDFQUEUE Queue, WDFREQUEST Request, size_t Length) 
+VOID
+das1ReadService(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ ULONG Mode
+    )
+/*++
+    Routine Description:
+        Completes pending reads from the sample ring, oldest first, for
+        as long as the one at the head of the read queue is ready (see
+        wdasread.h).  Data is copied under ReadLock; the requests are
+        completed after it is dropped, up to DAS_READ_BATCH at a time.
+        If a read is left waiting the read timer is started.  While the
+        ring is mapped nothing more comes into the sample ring, so reads
+        are flushed as if sampling had stopped.
+
+        Called from the read callback, the DPC and the read timer.
+
+    Arguments:
+
+        Context - device context
+
+        Mode - DAS_READ_WAIT, DAS_READ_EXPIRED or DAS_READ_FLUSH
+
+    Return value:
+        Void
+--*/
+{
+    WDFREQUEST done[DAS_READ_BATCH];
+    NTSTATUS doneStatus[DAS_READ_BATCH];
+    ULONG_PTR doneLength[DAS_READ_BATCH];
+    WDFREQUEST found, request;
+    WDF_REQUEST_PARAMETERS params;
+    NTSTATUS status;
+    PVOID buffer;
+    size_t length;
+    ULONG size = DAS_BUFFER_SIZE;
+    ULONG n, i, avail, want, take;
+    BOOLEAN arm;
+
+    do {
+        n = 0;
+        arm = FALSE;
+        WdfSpinLockAcquire(Context->ReadLock);
+        if (!Context->samp || Context->MapControl != NULL) {
+            Mode = DAS_READ_FLUSH;
+        }
+        Context->ReadNeed = MAXULONG;
+        while (n < DAS_READ_BATCH) {
+            WDF_REQUEST_PARAMETERS_INIT(&params);
+            status = WdfIoQueueFindRequest(Context->ReadQueue, NULL, NULL, &params, &found);
+            if (!NT_SUCCESS(status)) {
+                break;
+            }
+            avail = das1RingCount(Context->DasBufferInterruptPointer,
+                Context->DasBufferReaderPointer, size);
+            want = (ULONG)(params.Parameters.Read.Length / sizeof(ULONG));
+            if (!das1ReadTake(avail, want, Context->ReadWatermark, Mode, &take)) {
+                WdfObjectDereference(found);
+                Context->ReadNeed = das1ReadNeed(want, Context->ReadWatermark);
+                if (!Context->ReadTimerArmed) {
+                    Context->ReadTimerArmed = TRUE;
+                    arm = TRUE;
+                }
+                break;
+            }
+            status = WdfIoQueueRetrieveFoundRequest(Context->ReadQueue, found, &request);
+            WdfObjectDereference(found);
+            if (!NT_SUCCESS(status)) {
+                // cancelled since it was found, look again
+                continue;
+            }
+            status = WdfRequestRetrieveOutputBuffer(request, sizeof(ULONG), &buffer, &length);
+            if (NT_SUCCESS(status)) {
+                DAS_TRACE_IO(DAS_TEV_READ, take, Context->DasBufferReaderPointer);
+                das1RingCopyOut(Context->DasSampleBuffer, size,
+                    &Context->DasBufferReaderPointer, (PULONG)buffer, take);
+            }
+            else {
+                take = 0;
+            }
+            done[n] = request;
+            doneStatus[n] = status;
+            doneLength[n] = take * sizeof(ULONG);
+            n++;
+        }
+        WdfSpinLockRelease(Context->ReadLock);
+
+        if (arm) {
+            WdfTimerStart(Context->ReadTimer, WDF_REL_TIMEOUT_IN_MS(Context->ReadTimeout));
+        }
+        for (i = 0; i < n; i++) {
+            WdfRequestCompleteWithInformation(done[i], doneStatus[i], doneLength[i]);
+        }
+    } while (n == DAS_READ_BATCH);
+}
+
+VOID
+das1EvtDeviceRead(WDFQUEUE Queue, WDFREQUEST Request, size_t Length)
 /*++
     Routine Description:
         Handles WDF read requests
 
+        Every read goes to the manual read queue, so any number can be
+        outstanding.  It completes, in order, when the ring holds all
+        of it or the watermark, when the read timer expires with
+        anything buffered, or when sampling stops.  Reads shorter than
+        one sample complete at once with nothing, and none are taken
+        while the sample ring is mapped.  The device does direct I/O, so
+        samples are copied once, into the caller's locked pages.
+
     Arguments:
 
         Queue -  Handle to the framework queue object that is associated with the
@@ -381,198 +662,239 @@ das1EvtDeviceRead(WDFQUEUE Queue, WDFREQUEST Request, size_t Length)
 
     Return value:
         Void
-
-    A4 VERSION OF CODE WILL DIFFER FROM FINAL CODE
-    IN A4 DEVICE CONTEXT CONTAINS A BUFFER OF 10 SAMPLES
-    THE CALL TO IOCTL START SAMPLE WILL SET THE BUFFER POINTER TO THE FIRST VALUE
-    READ WILL ALLOW USER TO READ THE 10 SAMPLES
-    ONE AT A TIME OR ALL AT ONCE AS REQUESTED
 --*/
 {
+    PDEVICE_CONTEXT context = DeviceGetContext(WdfIoQueueGetDevice(Queue));
+    NTSTATUS status;
 
-    if (Length <= 0) {
-        WdfRequestComplete(Request, STATUS_SUCCESS);
+    if (Length < sizeof(ULONG)) {
+        WdfRequestCompleteWithInformation(Request, STATUS_SUCCESS, 0);
+        return;
     }
-    NTSTATUS status=0;
-    WDFMEMORY user_memory;
-    WDFDEVICE device = WdfIoQueueGetDevice(Queue);
-    PDEVICE_CONTEXT context = DeviceGetContext(device);
-    PULONG buffer = context->DasSampleBuffer;
-    ULONG space = 0;
-    ULONG size = DAS_BUFFER_SIZE;
-    ULONG toRead = (ULONG)Length;
-
-    //space = context->DasBufferInterruptPointer > context->DasBufferReaderPointer ?
-    //    (context->DasBufferInterruptPointer-context->DasBufferReaderPointer)*sizeof(int) :
-    //    ((size-context->DasBufferReaderPointer) + context->DasBufferInterruptPointer)*sizeof(int);
+    if (context->MapControl != NULL) {
+        WdfRequestComplete(Request, STATUS_DEVICE_BUSY);
+        return;
+    }
+    status = WdfRequestForwardToIoQueue(Request, context->ReadQueue);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtDeviceRead failed %!STATUS!", status);
+        WdfRequestComplete(Request, status);
+        return;
+    }
+    das1ReadService(context, DAS_READ_WAIT);
+}
 
-    //toRead = toRead > space ?
-    //    space : toRead;
+VOID
+das1EvtReadTimer(WDFTIMER Timer)
+/*++
+* Read timeout: pending reads take whatever is buffered
+--*/
+{
+    PDEVICE_CONTEXT context = DeviceGetContext(WdfTimerGetParentObject(Timer));
 
-    //if (context->DasBufferInterruptPointer > context->DasBufferReaderPointer) {
+    WdfSpinLockAcquire(context->ReadLock);
+    context->ReadTimerArmed = FALSE;
+    WdfSpinLockRelease(context->ReadLock);
+    das1ReadService(context, DAS_READ_EXPIRED);
+}
 
-    //}
-    //else {
-    //    ULONG UpperRead, LowerRead;
-    //    UpperRead = (size - context->DasBufferReaderPointer) * sizeof(int);
-    //    LowerRead = (toRead - UpperRead);
-    //}
+VOID
+das1EvtIoInCallerContext(WDFDEVICE Device, WDFREQUEST Request)
+/*++
+* Every request passes through here in the caller's thread.
+* Mapping and unmapping the sample ring must happen in the caller's
+* process, so those two are done here; the rest go on to the queues.
+--*/
+{
+    PDEVICE_CONTEXT context = DeviceGetContext(Device);
+    WDF_REQUEST_PARAMETERS params;
+    NTSTATUS status;
 
-    if (context->DasBufferInterruptPointer == context->DasBufferReaderPointer) {
-        WdfRequestSetInformation(Request, 0);
-        WdfRequestComplete(Request, STATUS_SUCCESS);
-        return;
+    WDF_REQUEST_PARAMETERS_INIT(&params);
+    WdfRequestGetParameters(Request, &params);
+    if (params.Type == WdfRequestTypeDeviceControl) {
+        switch (params.Parameters.DeviceIoControl.IoControlCode) {
+        case IOCTL_DAS_MAP_RING:
+            status = das1MapRing(context, Request);
+            WdfRequestCompleteWithInformation(Request, status,
+                NT_SUCCESS(status) ? sizeof(DAS_MAP_RING) : 0);
+            return;
+        case IOCTL_DAS_UNMAP_RING:
+            status = das1UnmapRing(context, WdfRequestGetFileObject(Request));
+            WdfRequestComplete(Request, status);
+            return;
+        }
     }
-    DbgPrint("Int in read: %d\nRead in read: %d\n", context->DasBufferInterruptPointer, context->DasBufferReaderPointer);
-        if(context->DasBufferInterruptPointer >= context->DasBufferReaderPointer){
-            //something in buffer
-            space = context->DasBufferInterruptPointer - context->DasBufferReaderPointer;
-            status = WdfRequestRetrieveOutputMemory(Request, &user_memory);
-            if(space >= Length/4){
-                DbgPrint("Case1\n");
-                //can complete read
-                if (!NT_SUCCESS(status)) {
-                    TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                    return;
-                }
-                status = WdfMemoryCopyFromBuffer(user_memory, 0, buffer+context->DasBufferReaderPointer, Length);
-                if (!NT_SUCCESS(status)) {
-                    TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                    return;
-                }
+    status = WdfDeviceEnqueueRequest(Device, Request);
+    if (!NT_SUCCESS(status)) {
+        WdfRequestComplete(Request, status);
+    }
+}
 
-                context->DasBufferReaderPointer += (ULONG)Length/4;
-                if (context->DasBufferReaderPointer >= size)
-                    context->DasBufferReaderPointer = 0;
-
-                WdfRequestSetInformation(Request, Length);
-                WdfRequestComplete(Request, STATUS_SUCCESS);
-                return;
-            }else{
-                DbgPrint("case2\n");
-                //partial complete read
-                if (!NT_SUCCESS(status)) {
-                    TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                    return;
-                }
-                status = WdfMemoryCopyFromBuffer(user_memory, 0, buffer+context->DasBufferReaderPointer, space * sizeof(int));
-                if (!NT_SUCCESS(status)) {
-                    TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                    return;
-                }
-                context->DasBufferReaderPointer += (ULONG)space;
-                if (context->DasBufferReaderPointer >= size)
-                    context->DasBufferReaderPointer = 0;
-                if(context->samp){
-                    context->Length = (ULONG)Length - (ULONG)(space*4);
-                    context->Request = Request;
-                    context->OutputBufferPosition = (ULONG)space;
-                    context->readWaiting = TRUE;
-                    return; 
-                }
-                WdfRequestSetInformation(Request, space);
-            }
-        }
-        if(context->DasBufferInterruptPointer < context->DasBufferReaderPointer){
-            space = size - (context->DasBufferReaderPointer - context->DasBufferInterruptPointer);
-            toRead = toRead/4 < space ? toRead : space*4;
-            ULONG upperRead, lowerRead,upper4,lower4;
-            status = WdfRequestRetrieveOutputMemory(Request, &user_memory);
-            if(toRead/4 > (size - context->DasBufferReaderPointer)){
-                
-                upperRead = size - context->DasBufferReaderPointer;
-                lowerRead = toRead/4 - upperRead;
-                upper4 = upperRead *4;
-                lower4 = upperRead *4;
-                if(space >= Length/4){
-                    DbgPrint("case3\n");
-                    //can complete read
-                    status = WdfMemoryCopyFromBuffer(user_memory, 0, buffer+context->DasBufferReaderPointer, upper4);
-                    if (!NT_SUCCESS(status)) {
-                        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                        return;
-                    }
-                    status = WdfMemoryCopyFromBuffer(user_memory, 0, buffer, lower4);
-                    if (!NT_SUCCESS(status)) {
-                        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                        return;
-                    }
-                    context->DasBufferReaderPointer = (ULONG)(lowerRead);
-                    if (context->DasBufferReaderPointer >= size)
-                        context->DasBufferReaderPointer = 0;
-
-                    WdfRequestSetInformation(Request, Length);
-                }else{
-                //partial complete read
-                    DbgPrint("case4\n");
-
-                    status = WdfMemoryCopyFromBuffer(user_memory, 0, buffer+context->DasBufferReaderPointer, upper4);
-                    if (!NT_SUCCESS(status)) {
-                        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                        return;
-                    }
-                    status = WdfMemoryCopyFromBuffer(user_memory, 0, buffer, lower4);
-                    if (!NT_SUCCESS(status)) {
-                        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                        return;
-                    }
-                    context->DasBufferReaderPointer = lowerRead;
-                    if (context->DasBufferReaderPointer >= size)
-                        context->DasBufferReaderPointer = 0;
-                    if(context->samp){
-                        context->Length = (ULONG)Length - (ULONG)(space*4);
-                        context->Request = Request;
-                        context->OutputBufferPosition = (ULONG)space;
-                        context->readWaiting = TRUE;
-                        return; 
-
-                    }
-                    WdfRequestSetInformation(Request, space);
-                }
+NTSTATUS
+das1MapRing(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFREQUEST Request
+    )
+/*++
+    Routine Description:
+        IOCTL_DAS_MAP_RING, in the caller's context.  Allocates the
+        control page and ring as zeroed pages, maps them into the
+        caller and into system space, and switches the DPC over to
+        them.  Reads still pending get what the sample ring holds.
 
-            }
-            if(space  >= Length/4){
-                //can complete read
-                DbgPrint("start case 5\n");
-                status = WdfMemoryCopyFromBuffer(user_memory, 0, buffer +context->DasBufferReaderPointer, Length);
-                if (!NT_SUCCESS(status)) {
-                    DbgPrint("status: %d\n", status);
-                    TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                    return;
-                }
-                context->DasBufferReaderPointer += (ULONG)(Length/4);
-                if (context->DasBufferReaderPointer >= size)
-                    context->DasBufferReaderPointer = 0;
-                DbgPrint("case5\n");
-                WdfRequestSetInformation(Request, Length);
-            }else{
-                //partial complete read
-                  DbgPrint("case6\n");
-
-                status = WdfMemoryCopyFromBuffer(user_memory, 0, buffer+context->DasBufferReaderPointer, space* 4 );
-                if (!NT_SUCCESS(status)) {
-                    TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-                    return;
-                }
-                context->DasBufferReaderPointer += (ULONG)space;
-                if (context->DasBufferReaderPointer >= size)
-                    context->DasBufferReaderPointer = 0;
-                  if(context->samp){
-                    context->Length = (ULONG)Length - (ULONG)(space*4);
-                    context->Request = Request;
-                    context->OutputBufferPosition = space;
-                    context->readWaiting = TRUE;
-                    return; 
-
-                  }
-                WdfRequestSetInformation(Request, space);
-                
-            }
+    Return value:
+        STATUS_DEVICE_BUSY if a ring is already mapped
+--*/
+{
+    PDAS_MAP_RING map;
+    PHYSICAL_ADDRESS low, high, skip;
+    PKEVENT event = NULL;
+    PMDL mdl;
+    PVOID kernel, user = NULL;
+    ULONG words;
+    NTSTATUS status;
 
+    // buffered: input and output are the same system buffer
+    status = WdfRequestRetrieveOutputBuffer(Request, sizeof(*map), (PVOID *)&map, NULL);
+    if (NT_SUCCESS(status)) {
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(*map), (PVOID *)&map, NULL);
+    }
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+    words = map->Words;
+    if (words < DAS_MAP_MIN_WORDS || words > DAS_MAP_MAX_WORDS || (words & (words - 1)) != 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+    if (map->Event != 0) {
+        status = ObReferenceObjectByHandle((HANDLE)(ULONG_PTR)map->Event, EVENT_MODIFY_STATE,
+            *ExEventObjectType, UserMode, (PVOID *)&event, NULL);
+        if (!NT_SUCCESS(status)) {
+            return status;
         }
-        DbgPrint("completion in read\n");
-    WdfRequestComplete(Request, STATUS_SUCCESS);
-    return;
+    }
+
+    low.QuadPart = 0;
+    high.QuadPart = -1;
+    skip.QuadPart = 0;
+    mdl = MmAllocatePagesForMdlEx(low, high, skip, DAS_MAP_DATA_OFFSET + (SIZE_T)words * sizeof(ULONG),
+        MmCached, MM_ALLOCATE_FULLY_REQUIRED);
+    if (mdl == NULL) {
+        status = STATUS_INSUFFICIENT_RESOURCES;
+        goto fail;
+    }
+    kernel = MmGetSystemAddressForMdlSafe(mdl, NormalPagePriority | MdlMappingNoExecute);
+    if (kernel == NULL) {
+        status = STATUS_INSUFFICIENT_RESOURCES;
+        goto freepages;
+    }
+    __try {
+        user = MmMapLockedPagesSpecifyCache(mdl, UserMode, MmCached, NULL, FALSE,
+            NormalPagePriority | MdlMappingNoExecute);
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER) {
+        user = NULL;
+    }
+    if (user == NULL) {
+        status = STATUS_INSUFFICIENT_RESOURCES;
+        goto unmapkernel;
+    }
+
+    WdfSpinLockAcquire(Context->ReadLock);
+    if (Context->MapMdl != NULL) {
+        WdfSpinLockRelease(Context->ReadLock);
+        status = STATUS_DEVICE_BUSY;
+        MmUnmapLockedPages(user, mdl);
+        goto unmapkernel;
+    }
+    das1MapInit((PDAS_MAP_CONTROL)kernel, &Context->MapProd, words);
+    Context->MapData = (PULONG)((PUCHAR)kernel + DAS_MAP_DATA_OFFSET);
+    Context->MapMdl = mdl;
+    Context->MapUser = user;
+    Context->MapProcess = PsGetCurrentProcess();
+    ObReferenceObject(Context->MapProcess);
+    Context->MapEvent = event;
+    Context->MapFile = WdfRequestGetFileObject(Request);
+    Context->MapControl = (PDAS_MAP_CONTROL)kernel;
+    WdfSpinLockRelease(Context->ReadLock);
+
+    das1ReadService(Context, DAS_READ_FLUSH);
+    map->Address = (ULONG64)(ULONG_PTR)user;
+    return STATUS_SUCCESS;
+
+unmapkernel:
+    MmUnmapLockedPages(kernel, mdl);
+freepages:
+    MmFreePagesFromMdl(mdl);
+    ExFreePool(mdl);
+fail:
+    if (event != NULL) {
+        ObDereferenceObject(event);
+    }
+    return status;
+}
+
+NTSTATUS
+das1UnmapRing(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFFILEOBJECT File
+    )
+/*++
+    Routine Description:
+        Takes down the ring File mapped, from IOCTL_DAS_UNMAP_RING or
+        file cleanup.  The DPC stops using it before it goes away, and
+        the sample ring starts again empty.  The user mapping is removed
+        in the process that made it.
+
+    Return value:
+        STATUS_INVALID_DEVICE_STATE if File has no ring mapped
+--*/
+{
+    PDAS_MAP_CONTROL control;
+    PMDL mdl;
+    PVOID user;
+    PEPROCESS process;
+    PKEVENT event;
+    KAPC_STATE apc;
+    BOOLEAN attach;
+
+    WdfSpinLockAcquire(Context->ReadLock);
+    if (Context->MapControl == NULL || Context->MapFile != File) {
+        WdfSpinLockRelease(Context->ReadLock);
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+    control = Context->MapControl;
+    mdl = Context->MapMdl;
+    user = Context->MapUser;
+    process = Context->MapProcess;
+    event = Context->MapEvent;
+    Context->MapControl = NULL;
+    Context->MapData = NULL;
+    Context->MapMdl = NULL;
+    Context->MapUser = NULL;
+    Context->MapProcess = NULL;
+    Context->MapEvent = NULL;
+    Context->MapFile = NULL;
+    Context->DasBufferReaderPointer = Context->DasBufferInterruptPointer;
+    WdfSpinLockRelease(Context->ReadLock);
+
+    attach = PsGetCurrentProcess() != process;
+    if (attach) {
+        KeStackAttachProcess(process, &apc);
+    }
+    MmUnmapLockedPages(user, mdl);
+    if (attach) {
+        KeUnstackDetachProcess(&apc);
+    }
+    MmUnmapLockedPages(control, mdl);
+    MmFreePagesFromMdl(mdl);
+    ExFreePool(mdl);
+    ObDereferenceObject(process);
+    if (event != NULL) {
+        ObDereferenceObject(event);
+    }
+    return STATUS_SUCCESS;
 }
 
 VOID
@@ -593,32 +915,38 @@ dasEvtInterruptIsr(WDFINTERRUPT Interrupt, ULONG MessageID)
 /*++
 * interrupt method will check if EOC
 * then, 
-* immediately call the dpc object associated with this device
-* Therefore completing its request and exiting interrupt mode
+* post the raw sample to the ISR ring and queue the DPC,
+* which is a no-op if it is already queued
 --*/
 {
     UNREFERENCED_PARAMETER(MessageID);
 
     PDEVICE_CONTEXT context = DeviceGetContext(WdfInterruptGetDevice(Interrupt));
-    PUCHAR address = context->BADR2 + DAS_CONTROL_REGISTER;
-    UCHAR word = READ_PORT_UCHAR(address);
+    ULONG clock, sample;
+    // the only control register read: interrupt bit and EOC together
+    UCHAR word = das1RegRead(context, DAS_CONTROL_REGISTER);
+    DAS_TRACE_INTR(DAS_TEV_INTR, word, context->IsrRing.Head);
     if ((word & 8) == 8) {
-        context->samp == 0 ?
-            WRITE_PORT_UCHAR(address, (word&~8)) : WRITE_PORT_UCHAR(address, ((word|16)|8));
+        // if not samping... write back control word w/int off : write back control sample on
+        // built from the shadow, not from the bits just read
+        if (context->samp == 0) {
+            das1RegSetControl(context, context->ControlShadow & ~DAS_CONTROL_INTE);
+        }
+        else {
+            das1RegSetControl(context, context->ControlShadow | DAS_CONTROL_OP1 | DAS_CONTROL_INTE);
+        }
         if ((DAS_EOC & word) != DAS_EOC) {
-            // if not samping... write back control word w/int off : write back control sample on
             // Read Clock Value
-            context->clockValue = READ_PORT_UCHAR(context->BADR2 + DAS_CLOCK_REGISTER);
+            clock = das1RegRead(context, DAS_CLOCK_REGISTER);
             // Read Sample high and low
-            context->DasSample = READ_PORT_UCHAR(context->BADR2 + DAS_SAMPLE_HIGH_BITS_REGISTER);
-            DbgPrint("das first reg: %ld\n", context->DasSample);
-            context->DasSample = (context->DasSample>>4)|((READ_PORT_UCHAR(context->BADR2 + DAS_SAMPLE_LOW_BITS_REGISTER)<<4));
-            DbgPrint("das: %ld\n", context->DasSample);
+            sample = das1RegRead(context, DAS_SAMPLE_HIGH_BITS_REGISTER);
+            sample = (sample>>4)|(das1RegRead(context, DAS_SAMPLE_LOW_BITS_REGISTER)<<4);
             // Start next conversion
-            WRITE_PORT_UCHAR(context->BADR2 + DAS_SAMPLE_LOW_BITS_REGISTER, word);
+            das1RegWrite(context, DAS_SAMPLE_LOW_BITS_REGISTER, context->ControlShadow);
             // Latch Clock
-            WRITE_PORT_UCHAR(context->BADR2 + DAS_CLOCK_CONTROL_REGISTER, DAS_CLOCK_LATCH);
-            // Call Dpc
+            das1RegWrite(context, DAS_CLOCK_CONTROL_REGISTER, DAS_CLOCK_LATCH);
+            // hand it over; a full ring drops it and counts it
+            das1IsrRingPut(&context->IsrRing, clock << 16 | sample);
             WdfInterruptQueueDpcForIsr(Interrupt);
             return TRUE;
         }
@@ -630,104 +958,55 @@ dasEvtInterruptIsr(WDFINTERRUPT Interrupt, ULONG MessageID)
 VOID
 dasEvtInterruptDpc(WDFINTERRUPT Interrupt, WDFOBJECT AssociatedObject)
 /*++
-* * DPC will handle actual logic
-* - perform operation
-* - latch clock and call next conversion
+* * DPC moves everything in the ISR ring to the sample ring in one pass
+* - stamps each sample with its time offset
+* - then completes any reads that are now ready
 --*/
 {
     UNREFERENCED_PARAMETER(AssociatedObject);
-    DbgPrint("IN the DPC\n");
     PDEVICE_CONTEXT context = DeviceGetContext(WdfInterruptGetDevice(Interrupt));
     PULONG Buffer = context->DasSampleBuffer;
-    int BufferSize = DAS_BUFFER_SIZE;
-    // time offset math
-    ULONG timeOffset = context->clockValue;
-    timeOffset = context->rate - timeOffset;
-    timeOffset = timeOffset * 1000;
-    timeOffset = timeOffset / DAS_CLOCK_SPEED;
-    // sample math
-    DbgPrint("int point: %d\n", context->DasBufferInterruptPointer);
-    DbgPrint("Read Point: %d\n", context->DasBufferReaderPointer);
-    ULONG FullData = timeOffset << 16 | context->DasSample;
-    Buffer[context->DasBufferInterruptPointer] = FullData;
-    context->DasBufferInterruptPointer++;
-    if (context->DasBufferInterruptPointer >= (ULONG)BufferSize)
-        context->DasBufferInterruptPointer = 0;
-    if (context->DasBufferInterruptPointer == context->DasBufferReaderPointer) {
-        context->DasBufferReaderPointer++;
-        if (context->DasBufferReaderPointer >= (ULONG)BufferSize)
-            context->DasBufferReaderPointer = 0;
-    }
-    
-    // needs read
-    if (context->readWaiting == TRUE) {
-        // do more
-        WDFREQUEST Request = context->Request;
-        WDFMEMORY user_memory;
-        NTSTATUS status = WdfRequestRetrieveOutputMemory(Request, &user_memory);
-        if (!NT_SUCCESS(status)) {
-            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtInterruptDpc failed %!STATUS!", status);
-            return;
-        }
+    ULONG size = DAS_BUFFER_SIZE;
+    ULONG n, i, raw, timeOffset, word;
+    BOOLEAN ready = FALSE;
 
-        ULONG ToRead = context->Length;
-        int InterruptPointer = context->DasBufferInterruptPointer;
-        int ReadPointer = context->DasBufferPointer;
-
-        ULONG Space = InterruptPointer > ReadPointer ?
-            (ULONG)(InterruptPointer - ReadPointer-1) : (ULONG)((BufferSize - ReadPointer) + InterruptPointer-1);
-        Space = Space * 4;
-        ToRead = ToRead > Space ?
-            Space : ToRead;
-        if (ToRead < (ULONG)(BufferSize - ReadPointer)*sizeof(int)) {
-            status = WdfMemoryCopyFromBuffer(user_memory,
-                context->OutputBufferPosition,
-                Buffer+(ULONG)ReadPointer,
-                ToRead);
-            ReadPointer += (ToRead/sizeof(int));
-            context->OutputBufferPosition += (ToRead/sizeof(int));
-            if (ReadPointer >= BufferSize) {
-                ReadPointer = 0;
-            }
-            context->Length -= ToRead;
+    n = das1IsrRingAvail(&context->IsrRing);
+    if (n == 0) {
+        return;
+    }
+    DAS_TRACE_INTR(DAS_TEV_DPC, n, 0);
+    WdfSpinLockAcquire(context->ReadLock);
+    for (i = 0; i < n; i++) {
+        raw = das1IsrRingWord(&context->IsrRing, i);
+        // time offset math
+        timeOffset = context->rate - (raw >> 16);
+        timeOffset = timeOffset * 1000;
+        timeOffset = timeOffset / DAS_CLOCK_SPEED;
+        // sample math
+        word = timeOffset << 16 | (raw & 0xffff);
+        if (context->MapControl != NULL) {
+            das1MapPut(context->MapControl, &context->MapProd, context->MapData, word);
         }
-        else {
-            ULONG UpperRead, LowerRead;
-            UpperRead = (ULONG)(BufferSize - ReadPointer)*sizeof(int);
-            LowerRead = ToRead - UpperRead;
-            status = WdfMemoryCopyFromBuffer(user_memory,
-                context->OutputBufferPosition,
-                Buffer + (UINT16)ReadPointer,
-                UpperRead);
-            context->OutputBufferPosition += (UpperRead/sizeof(int));
-            context->Length -= (UpperRead/sizeof(int));
-            ReadPointer = 0;
-            status = WdfMemoryCopyFromBuffer(user_memory,
-                context->OutputBufferPosition,
-                Buffer + (UINT16)ReadPointer,
-                LowerRead);
-            context->OutputBufferPosition += (LowerRead/sizeof(int));
-            context->Length -= (LowerRead / sizeof(int));
-            ReadPointer = (LowerRead / sizeof(int));
-        }
-        if (ReadPointer >= BufferSize)
-            ReadPointer = 0;
-        context->DasBufferPointer = ReadPointer;
-        
-        if (!NT_SUCCESS(status)) {
-            TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "das1EvtIoDeviceControl failed %!STATUS!", status);
-            return;
+        else if (das1RingPut(Buffer, size, &context->DasBufferInterruptPointer,
+                &context->DasBufferReaderPointer, word)) {
+            context->ReadOverruns++;
+            DAS_TRACE_STATE(DAS_TEV_OVERRUN, context->DasBufferInterruptPointer,
+                context->DasBufferReaderPointer);
         }
-        context->readWaiting = FALSE;
-        DbgPrint("Im completing in the dpc\n");
-        if (Request != NULL) {
-
-            WdfRequestSetInformation(Request, context->OutputBufferPosition);
-            WdfRequestComplete(Request, STATUS_SUCCESS);
+    }
+    if (context->MapControl != NULL) {
+        if (das1MapPublish(context->MapControl, &context->MapProd) && context->MapEvent != NULL) {
+            KeSetEvent(context->MapEvent, IO_NO_INCREMENT, FALSE);
         }
-        
-
     }
-
-
-}
\ No newline at end of file
+    else {
+        // only go to the read queue once the head read can be completed
+        ready = das1RingCount(context->DasBufferInterruptPointer,
+            context->DasBufferReaderPointer, size) >= context->ReadNeed;
+    }
+    WdfSpinLockRelease(context->ReadLock);
+    das1IsrRingConsume(&context->IsrRing, n);
+    if (ready) {
+        das1ReadService(context, DAS_READ_WAIT);
+    }
+}
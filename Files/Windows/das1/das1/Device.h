@@ -17,6 +17,8 @@ Environment:
 #include "public.h"
 #include "wdm.h"
 #include "wdasio.h"
+#include "wdasisr.h"
+#include "wdasmap.h"
 EXTERN_C_START
 
 //
@@ -27,24 +29,41 @@ typedef struct _DEVICE_CONTEXT
 {
     ULONG DasSampleBuffer[2000];
     ULONG DasBufferPointer;
-    ULONG clockValue,
-        Length,
-        rate;
+    ULONG rate;
     BOOLEAN isOpen;
-    BOOLEAN readWaiting;
     BOOLEAN isrRequest;
     PULONG BADR1;
     PUCHAR BADR2;
     UCHAR samp,
         channel;
     ULONG DasBufferInterruptPointer,
-        DasBufferReaderPointer,
-        OutputBufferPosition;
-    WDFREQUEST Request;
-    UINT16 DasSample;
+        DasBufferReaderPointer;
+    DAS_ISR_RING IsrRing;   // raw samples, ISR to DPC
     WDFINTERRUPT DasInterrupt;
-    ULONG Register;
     PUINT32 outputBuffer;
+    // The shadows and the clock control port are the ISR's; anything else
+    // that writes them holds the interrupt lock (WdfInterruptAcquireLock).
+    UCHAR ControlShadow;    // last value written to the control register
+    USHORT ClockShadow;     // last counter 2 reload
+    ULONG PortReads,
+        PortWrites;
+    WDFQUEUE ConfigQueue;   // IOCTLs that change state, sequential
+    WDFQUEUE ReadQueue;     // pending reads, manual dispatch
+    WDFSPINLOCK ReadLock;   // the ring pointers and the Read fields below
+    WDFTIMER ReadTimer;
+    BOOLEAN ReadTimerArmed;
+    ULONG ReadWatermark,
+        ReadTimeout,        // milliseconds
+        ReadNeed,           // ring words that make the head read ready
+        ReadOverruns;
+    PDAS_MAP_CONTROL MapControl;    // NULL unless mapped; under ReadLock
+    PULONG MapData;
+    DAS_MAP_PROD MapProd;
+    PMDL MapMdl;
+    PVOID MapUser;                  // the mapping in MapProcess
+    PEPROCESS MapProcess;
+    PKEVENT MapEvent;
+    WDFFILEOBJECT MapFile;
 
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
@@ -32,6 +32,7 @@ DRIVER_INITIALIZE DriverEntry;
 EVT_WDF_DRIVER_DEVICE_ADD das1EvtDeviceAdd;
 EVT_WDF_OBJECT_CONTEXT_CLEANUP das1EvtDriverContextCleanup;
 EVT_WDF_FILE_CLOSE das1EvtDeviceClose;
+EVT_WDF_FILE_CLEANUP das1EvtDeviceCleanup;
 EVT_WDF_DEVICE_FILE_CREATE das1EvtDeviceCreateFile;
 EVT_WDF_DEVICE_PREPARE_HARDWARE das1EvtPrepareHardware;
 EVT_WDF_DEVICE_D0_ENTRY das1EvtD0Entry;
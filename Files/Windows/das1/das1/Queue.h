@@ -33,14 +33,35 @@ das1QueueInitialize(
     _In_ WDFDEVICE Device
     );
 
+VOID
+das1ReadService(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ ULONG Mode
+    );
+
+NTSTATUS
+das1MapRing(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFREQUEST Request
+    );
+
+NTSTATUS
+das1UnmapRing(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFFILEOBJECT File
+    );
+
 //
 // Events from the IoQueue object
 //
 EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL das1EvtIoDeviceControl;
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL das1EvtIoControlRoute;
 EVT_WDF_IO_QUEUE_IO_STOP das1EvtIoStop;
 EVT_WDF_IO_QUEUE_IO_READ das1EvtDeviceRead;
 EVT_WDF_IO_QUEUE_IO_WRITE das1EvtDevieWrite;
 EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL das1EvtIoDeviceControl;
 EVT_WDF_INTERRUPT_ISR dasEvtInterruptIsr;
 EVT_WDF_INTERRUPT_DPC dasEvtInterruptDpc;
+EVT_WDF_TIMER das1EvtReadTimer;
+EVT_WDF_IO_IN_CALLER_CONTEXT das1EvtIoInCallerContext;
 EXTERN_C_END
@@ -0,0 +1,109 @@
+/*++
+
+Module Name:
+
+    wdasisr.h
+
+Abstract:
+
+    Raw sample ring from the ISR to the DPC.
+
+    The ISR is the only writer of Head and the DPC the only writer of
+    Tail, so neither takes a lock: each publishes its counter after a
+    barrier.  Both counters run free and the size is a power of two.
+    The ISR never waits; if the DPC has fallen a whole ring behind the
+    new sample is dropped and counted.  A DPC takes everything posted
+    before it started, so one DPC can stand for any number of
+    interrupts.
+
+    Entries are (counter 2 low byte << 16) | 12 bit sample, as read.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#if !defined(__WDASISR_H__)
+#define __WDASISR_H__
+
+#define DAS_ISR_RING_SIZE 256
+
+typedef struct _DAS_ISR_RING {
+    volatile ULONG Head;    // written by the ISR
+    volatile ULONG Tail;    // written by the DPC
+    ULONG Dropped;          // written by the ISR
+    ULONG Word[DAS_ISR_RING_SIZE];
+} DAS_ISR_RING, *PDAS_ISR_RING;
+
+FORCEINLINE
+VOID
+das1IsrRingReset(
+    _Out_ PDAS_ISR_RING Ring
+    )
+{
+    Ring->Head = 0;
+    Ring->Tail = 0;
+    Ring->Dropped = 0;
+}
+
+FORCEINLINE
+BOOLEAN
+das1IsrRingPut(
+    _Inout_ PDAS_ISR_RING Ring,
+    _In_ ULONG Word
+    )
+/*++
+    ISR side.  FALSE if the ring was full and Word was dropped.
+--*/
+{
+    ULONG head = Ring->Head;
+
+    if (head - Ring->Tail >= DAS_ISR_RING_SIZE) {
+        Ring->Dropped++;
+        return FALSE;
+    }
+    Ring->Word[head & (DAS_ISR_RING_SIZE - 1)] = Word;
+    KeMemoryBarrier();
+    Ring->Head = head + 1;
+    return TRUE;
+}
+
+FORCEINLINE
+ULONG
+das1IsrRingAvail(
+    _In_ PDAS_ISR_RING Ring
+    )
+/*++
+    DPC side.  Entries posted so far; they can be read with
+    das1IsrRingWord until das1IsrRingConsume gives them back.
+--*/
+{
+    ULONG n = Ring->Head - Ring->Tail;
+
+    KeMemoryBarrier();
+    return n;
+}
+
+FORCEINLINE
+ULONG
+das1IsrRingWord(
+    _In_ PDAS_ISR_RING Ring,
+    _In_ ULONG Index
+    )
+{
+    return Ring->Word[(Ring->Tail + Index) & (DAS_ISR_RING_SIZE - 1)];
+}
+
+FORCEINLINE
+VOID
+das1IsrRingConsume(
+    _Inout_ PDAS_ISR_RING Ring,
+    _In_ ULONG Count
+    )
+{
+    KeMemoryBarrier();
+    Ring->Tail += Count;
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*++
+
+Module Name:
+
+    wdasroute.h
+
+Abstract:
+
+    Which queue handles each IOCTL.
+
+    Status queries only read the device context, so they are completed
+    straight from the parallel default queue and never wait behind a
+    reconfiguration or a read.  Anything that touches the hardware or
+    changes the acquisition goes to the sequential configuration queue,
+    one at a time, in arrival order.  Codes not in the table are
+    refused before any handler sees them.
+
+    Plain data and a lookup, no framework calls.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#if !defined(__WDASROUTE_H__)
+#define __WDASROUTE_H__
+
+#define DAS_ROUTE_INVALID 0
+#define DAS_ROUTE_STATUS 1      // completed on the parallel default queue
+#define DAS_ROUTE_CONFIG 2      // forwarded to the sequential config queue
+
+typedef struct _DAS_ROUTE {
+    ULONG IoControlCode;
+    ULONG Route;
+} DAS_ROUTE;
+
+static const DAS_ROUTE das1Routes[] = {
+    { IOCTL_DAS_START_SAMPLING, DAS_ROUTE_CONFIG },
+    { IOCTL_DAS_STOP_SAMPLING, DAS_ROUTE_CONFIG },
+    { IOCTL_DAS_SET_RATE, DAS_ROUTE_CONFIG },
+    { IOCTL_DAS_GET_RATE, DAS_ROUTE_STATUS },
+    { IOCTL_DAS_SET_CHANNEL, DAS_ROUTE_CONFIG },
+    { IOCTL_DAS_GET_CHANNEL, DAS_ROUTE_STATUS },
+    { IOCTL_DAS_GET_REGISTER, DAS_ROUTE_CONFIG },
+    { IOCTL_DAS_SET_REGISTER, DAS_ROUTE_CONFIG },
+    { IOCTL_DAS_REGISTER_BATCH, DAS_ROUTE_CONFIG },
+    { IOCTL_DAS_GET_TRACE, DAS_ROUTE_STATUS },
+};
+
+FORCEINLINE
+ULONG
+das1Route(
+    _In_ ULONG IoControlCode
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < sizeof(das1Routes) / sizeof(das1Routes[0]); i++) {
+        if (das1Routes[i].IoControlCode == IoControlCode) {
+            return das1Routes[i].Route;
+        }
+    }
+    return DAS_ROUTE_INVALID;
+}
+
+#endif
@@ -58,10 +58,97 @@ Phil Nelson, Spring 2004
 #define IOCTL_DAS_SET_REGISTER \
     CTL_CODE( DAS_TYPE, 0xFF7, METHOD_BUFFERED, FILE_WRITE_ACCESS )
 
+//
+// Register command list.  The input buffer is an array of DAS_REGOP, run
+// in order; the output buffer gets the same array back with Result and
+// Nanoseconds filled in.  The whole list is checked before any of it
+// runs.  BADR1 is the PLX bridge (32 bit, offsets 0-0x7c), BADR2 the
+// board (8 bit, offsets 0-7).  Control register writes go through the
+// driver's shadow.
+//
+#define IOCTL_DAS_REGISTER_BATCH \
+    CTL_CODE( DAS_TYPE, 0xFF8, METHOD_BUFFERED, FILE_WRITE_ACCESS | \
+              FILE_READ_ACCESS )
+
+#define DAS_REGOP_READ 0
+#define DAS_REGOP_WRITE 1
+#define DAS_REGOP_RMW 2         // new = (old & ~Mask) | (Value & Mask)
+#define DAS_REGOP_BADR1 1
+#define DAS_REGOP_BADR2 2
+#define DAS_REGBATCH_MAX 256
+
+typedef struct _DAS_REGOP {
+    UCHAR Op;                   // DAS_REGOP_READ, _WRITE, _RMW
+    UCHAR Bar;                  // DAS_REGOP_BADR1 or _BADR2
+    USHORT Offset;
+    ULONG Mask;                 // RMW: bits to change
+    ULONG Value;                // WRITE, RMW: value to write
+    ULONG Result;               // out: value read (RMW: before the write)
+    ULONG Nanoseconds;          // out: time this op took
+} DAS_REGOP, *PDAS_REGOP;
+
+//
+// Mapped sample ring.  IOCTL_DAS_MAP_RING maps a control page followed
+// by a ring of Words samples, in the same packed format read returns,
+// into the calling process.  While it is mapped every sample goes to it
+// and reads fail.  The driver writes Head, the program writes Tail, both
+// free running; Words is a power of two.  A program about to sleep sets
+// WakeAt, the samples it wants, and Waiting, and checks Head once more;
+// the driver clears Waiting and sets the event passed in Event once that
+// many are in the ring, or the ring is full.  IOCTL_DAS_UNMAP_RING, or
+// closing the handle, takes it away.  wdasmap.h has the helpers for both
+// sides.
+//
+#define IOCTL_DAS_MAP_RING \
+    CTL_CODE( DAS_TYPE, 0xFF9, METHOD_BUFFERED, FILE_READ_ACCESS )
+
+#define IOCTL_DAS_UNMAP_RING \
+    CTL_CODE( DAS_TYPE, 0xFFA, METHOD_BUFFERED, FILE_READ_ACCESS )
+
+//
+// The trace flight recorder: the output buffer gets a struct
+// das_trace_hdr and then as many per-CPU buffers as fit, the same
+// layout as DAS_GET_TRACE on NetBSD, so dastrace -r decodes it.
+// Information is the byte count written.
+//
+#define IOCTL_DAS_GET_TRACE \
+    CTL_CODE( DAS_TYPE, 0xFFB, METHOD_OUT_DIRECT, FILE_READ_ACCESS )
+
+#define DAS_MAP_VERSION 2         // 2: WakeAt
+#define DAS_MAP_MIN_WORDS 1024
+#define DAS_MAP_MAX_WORDS (1024 * 1024)
+#define DAS_MAP_DATA_OFFSET 4096    // the ring starts a page after the control
+
+typedef struct _DAS_MAP_RING {
+    ULONG Words;                // in: power of two, MIN to MAX
+    ULONG Reserved;
+    ULONG64 Event;              // in: event HANDLE, or 0 to poll
+    ULONG64 Address;            // out: control page in the caller
+} DAS_MAP_RING, *PDAS_MAP_RING;
+
+// Head and Tail each get a cache line
+typedef struct _DAS_MAP_CONTROL {
+    ULONG Version;              // DAS_MAP_VERSION
+    ULONG Words;
+    ULONG DataOffset;           // DAS_MAP_DATA_OFFSET
+    ULONG Pad0[13];
+    volatile ULONG Head;        // driver: samples written
+    volatile ULONG Overruns;    // driver: samples dropped, ring full
+    ULONG Pad1[14];
+    volatile ULONG Tail;        // program: samples consumed
+    volatile ULONG Waiting;     // program: set before sleeping on Event
+    volatile ULONG WakeAt;      // program: samples to wait for, 0 is 1
+    ULONG Pad2[13];
+} DAS_MAP_CONTROL, *PDAS_MAP_CONTROL;
+
 // Define default state
 #define DAS_DEFAULT_RATE 1588
 #define DAS_DEFAULT_CHANNEL 2
-#define DAS_BUFFER_SIZE 1000;
+#define DAS_BUFFER_SIZE 1000
+// Pending reads complete once this many samples are buffered (or the
+// request is full), or after the timeout with whatever there is
+#define DAS_READ_WATERMARK 64
+#define DAS_READ_TIMEOUT_MS 10
 // Define register locations
 #define DAS_SAMPLE_HIGH_BITS_REGISTER 0x00
 #define DAS_SAMPLE_LOW_BITS_REGISTER 0x01
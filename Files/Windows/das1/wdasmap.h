@@ -0,0 +1,185 @@
+/*++
+
+Module Name:
+
+    wdasmap.h
+
+Abstract:
+
+    Both sides of the mapped sample ring (IOCTL_DAS_MAP_RING).
+
+    The driver keeps its own head and ring size in DAS_MAP_PROD and only
+    ever reads Tail and Waiting from the shared page, indexing with its
+    own mask, so a program that scribbles on the page only spoils its
+    own samples.  Samples are put one at a time and published once per
+    DPC; the event is set only once the ring holds the WakeAt samples the
+    program asked for, so a DPC of a sample or two does not wake it.
+
+    The program side takes what is there as at most two spans, gives it
+    back with das1MapConsume, and sleeps on its event only after
+    das1MapPrepareWait says the ring still holds fewer than it wants.
+
+    Included by the driver and by programs; it needs only wdasio.h.
+
+Environment:
+
+    Kernel-mode Driver Framework and user mode
+
+--*/
+
+#if !defined(__WDASMAP_H__)
+#define __WDASMAP_H__
+
+#if defined(_KERNEL_MODE)
+#define DAS_MAP_BARRIER() KeMemoryBarrier()
+#else
+#define DAS_MAP_BARRIER() MemoryBarrier()
+#endif
+
+typedef struct _DAS_MAP_PROD {
+    ULONG Head;
+    ULONG Words;
+    ULONG Overruns;
+} DAS_MAP_PROD, *PDAS_MAP_PROD;
+
+FORCEINLINE
+VOID
+das1MapInit(
+    _Out_ PDAS_MAP_CONTROL Control,
+    _Out_ PDAS_MAP_PROD Prod,
+    _In_ ULONG Words
+    )
+{
+    RtlZeroMemory(Control, sizeof(*Control));
+    Control->Version = DAS_MAP_VERSION;
+    Control->Words = Words;
+    Control->DataOffset = DAS_MAP_DATA_OFFSET;
+    Prod->Head = 0;
+    Prod->Words = Words;
+    Prod->Overruns = 0;
+}
+
+FORCEINLINE
+BOOLEAN
+das1MapPut(
+    _In_ PDAS_MAP_CONTROL Control,
+    _Inout_ PDAS_MAP_PROD Prod,
+    _Inout_ PULONG Data,
+    _In_ ULONG Word
+    )
+/*++
+    Driver side.  FALSE if the ring is full and Word was dropped.
+--*/
+{
+    if (Prod->Head - Control->Tail >= Prod->Words) {
+        Prod->Overruns++;
+        return FALSE;
+    }
+    Data[Prod->Head & (Prod->Words - 1)] = Word;
+    Prod->Head++;
+    return TRUE;
+}
+
+FORCEINLINE
+BOOLEAN
+das1MapPublish(
+    _Inout_ PDAS_MAP_CONTROL Control,
+    _In_ PDAS_MAP_PROD Prod
+    )
+/*++
+    Driver side.  Make everything put so far visible; TRUE if the
+    program is waiting, the ring holds what it asked for, and its event
+    should be set.  A full ring always wakes it.
+--*/
+{
+    ULONG wakeAt;
+
+    DAS_MAP_BARRIER();
+    Control->Head = Prod->Head;
+    Control->Overruns = Prod->Overruns;
+    DAS_MAP_BARRIER();
+    if (Control->Waiting == 0) {
+        return FALSE;
+    }
+    wakeAt = Control->WakeAt;
+    if (wakeAt == 0 || wakeAt > Prod->Words) {
+        wakeAt = wakeAt == 0 ? 1 : Prod->Words;
+    }
+    if (Prod->Head - Control->Tail < wakeAt) {
+        return FALSE;
+    }
+    Control->Waiting = 0;
+    return TRUE;
+}
+
+FORCEINLINE
+ULONG
+das1MapSpans(
+    _In_ PDAS_MAP_CONTROL Control,
+    _In_ const ULONG *Data,
+    _Out_ const ULONG **First,
+    _Out_ PULONG FirstCount,
+    _Out_ const ULONG **Second,
+    _Out_ PULONG SecondCount
+    )
+/*++
+    Program side.  Samples waiting, as the run up to the end of the ring
+    and the run from its start.
+--*/
+{
+    ULONG tail = Control->Tail;
+    ULONG n = Control->Head - tail;
+    ULONG at = tail & (Control->Words - 1);
+
+    DAS_MAP_BARRIER();
+    *First = Data + at;
+    *Second = Data;
+    if (n <= Control->Words - at) {
+        *FirstCount = n;
+        *SecondCount = 0;
+    }
+    else {
+        *FirstCount = Control->Words - at;
+        *SecondCount = n - *FirstCount;
+    }
+    return n;
+}
+
+FORCEINLINE
+VOID
+das1MapConsume(
+    _Inout_ PDAS_MAP_CONTROL Control,
+    _In_ ULONG Count
+    )
+{
+    DAS_MAP_BARRIER();
+    Control->Tail += Count;
+}
+
+FORCEINLINE
+BOOLEAN
+das1MapPrepareWait(
+    _Inout_ PDAS_MAP_CONTROL Control,
+    _In_ ULONG WakeAt
+    )
+/*++
+    Program side.  TRUE if the ring still holds fewer than WakeAt
+    samples and the program may sleep on its event until it does; FALSE
+    if it should look again.  A program that waits without a timeout
+    should ask for no more than the rest of its acquisition.
+--*/
+{
+    if (WakeAt == 0) {
+        WakeAt = 1;
+    }
+    Control->WakeAt = WakeAt;
+    Control->Waiting = 1;
+    DAS_MAP_BARRIER();
+    if (Control->Head - Control->Tail >= WakeAt) {
+        Control->Waiting = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*++
+
+Module Name:
+
+    wdasread.h
+
+Abstract:
+
+    Sample ring and pending-read scheduling for the read path.
+
+    The DPC puts samples into DasSampleBuffer; reads wait in a manual
+    queue until the request at its head is worth completing.  That is
+    when the ring holds everything it asked for, or at least the
+    watermark, or the read timer has expired and there is anything at
+    all.  Once sampling stops every pending read is completed with what
+    is left, possibly nothing.  Ring data is only copied at completion,
+    with at most two span copies, so a request never sits half filled.
+
+    Nothing here calls the framework: the caller holds ReadLock and does
+    the queue work, so the same code runs outside the driver.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#if !defined(__WDASREAD_H__)
+#define __WDASREAD_H__
+
+// How das1ReadTake treats a request the ring cannot fill
+#define DAS_READ_WAIT 0         // leave it below the watermark
+#define DAS_READ_EXPIRED 1      // timer ran out: anything will do
+#define DAS_READ_FLUSH 2        // sampling stopped: complete even if empty
+
+// Requests completed per pass outside the lock
+#define DAS_READ_BATCH 16
+
+FORCEINLINE
+ULONG
+das1RingCount(
+    _In_ ULONG Writer,
+    _In_ ULONG Reader,
+    _In_ ULONG Size
+    )
+{
+    return Writer >= Reader ? Writer - Reader : Size - Reader + Writer;
+}
+
+FORCEINLINE
+BOOLEAN
+das1RingPut(
+    _Inout_updates_(Size) PULONG Buffer,
+    _In_ ULONG Size,
+    _Inout_ PULONG Writer,
+    _Inout_ PULONG Reader,
+    _In_ ULONG Word
+    )
+/*++
+    Store one word.  A full ring drops its oldest word and returns TRUE.
+--*/
+{
+    Buffer[*Writer] = Word;
+    if (++*Writer == Size) {
+        *Writer = 0;
+    }
+    if (*Writer != *Reader) {
+        return FALSE;
+    }
+    if (++*Reader == Size) {
+        *Reader = 0;
+    }
+    return TRUE;
+}
+
+FORCEINLINE
+ULONG
+das1RingSpan(
+    _In_ ULONG Reader,
+    _In_ ULONG Count,
+    _In_ ULONG Size,
+    _Out_ PULONG Second
+    )
+/*++
+    Split Count words from Reader into the run up to the end of the
+    buffer (returned) and the run from its start (*Second).
+--*/
+{
+    ULONG first = Size - Reader;
+
+    if (Count <= first) {
+        *Second = 0;
+        return Count;
+    }
+    *Second = Count - first;
+    return first;
+}
+
+FORCEINLINE
+VOID
+das1RingCopyOut(
+    _In_reads_(Size) const ULONG *Buffer,
+    _In_ ULONG Size,
+    _Inout_ PULONG Reader,
+    _Out_writes_(Count) PULONG Dest,
+    _In_ ULONG Count
+    )
+{
+    ULONG first, second;
+
+    first = das1RingSpan(*Reader, Count, Size, &second);
+    RtlCopyMemory(Dest, Buffer + *Reader, first * sizeof(ULONG));
+    if (second != 0) {
+        RtlCopyMemory(Dest + first, Buffer, second * sizeof(ULONG));
+    }
+    *Reader = second != 0 ? second : *Reader + first;
+    if (*Reader == Size) {
+        *Reader = 0;
+    }
+}
+
+FORCEINLINE
+ULONG
+das1ReadNeed(
+    _In_ ULONG Want,
+    _In_ ULONG Watermark
+    )
+/*++
+    Words the ring must hold before a request for Want words is ready.
+--*/
+{
+    if (Watermark == 0) {
+        Watermark = 1;
+    }
+    return Want < Watermark ? Want : Watermark;
+}
+
+FORCEINLINE
+BOOLEAN
+das1ReadTake(
+    _In_ ULONG Avail,
+    _In_ ULONG Want,
+    _In_ ULONG Watermark,
+    _In_ ULONG Mode,
+    _Out_ PULONG Take
+    )
+/*++
+    TRUE if the request for Want words should be completed now, with
+    *Take words.
+--*/
+{
+    *Take = Avail < Want ? Avail : Want;
+    if (Avail >= das1ReadNeed(Want, Watermark)) {
+        return TRUE;
+    }
+    if (Mode == DAS_READ_EXPIRED) {
+        return Avail != 0;
+    }
+    return Mode == DAS_READ_FLUSH;
+}
+
+#endif
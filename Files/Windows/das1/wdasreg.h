@@ -0,0 +1,200 @@
+/*++
+
+Module Name:
+
+    wdasreg.h
+
+Abstract:
+
+    Port access helpers for the PCI-DAS08 BADR2 registers.
+
+    The control register and the counter 2 reload are treated as write
+    only: the last value written is kept in the device context so the
+    ISR and IOCTL paths never read the port back to rebuild a control
+    word.  Every access is counted in PortReads/PortWrites.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#if !defined(__WDASREG_H__)
+#define __WDASREG_H__
+
+// Control register bits
+#define DAS_CONTROL_MUX 0x07
+#define DAS_CONTROL_INTE 0x08
+#define DAS_CONTROL_OP1 0x10
+
+FORCEINLINE
+UCHAR
+das1RegRead(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ ULONG Offset
+    )
+{
+    Context->PortReads++;
+    return READ_PORT_UCHAR(Context->BADR2 + Offset);
+}
+
+FORCEINLINE
+VOID
+das1RegWrite(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ ULONG Offset,
+    _In_ UCHAR Value
+    )
+{
+    Context->PortWrites++;
+    WRITE_PORT_UCHAR(Context->BADR2 + Offset, Value);
+}
+
+FORCEINLINE
+VOID
+das1RegSetControl(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ UCHAR Value
+    )
+/*++
+    Write the control register and remember what was written.  Outside
+    the ISR, call it with the interrupt lock held.
+--*/
+{
+    Context->ControlShadow = Value;
+    das1RegWrite(Context, DAS_CONTROL_REGISTER, Value);
+}
+
+FORCEINLINE
+UCHAR
+das1RegChannel(
+    _In_ PDEVICE_CONTEXT Context
+    )
+{
+    return Context->ControlShadow & DAS_CONTROL_MUX;
+}
+
+FORCEINLINE
+VOID
+das1RegSetClock(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ USHORT Count
+    )
+/*++
+    Program counter 2: control word, then low byte, then high byte.
+--*/
+{
+    Context->ClockShadow = Count;
+    das1RegWrite(Context, DAS_CLOCK_CONTROL_REGISTER, DAS_CLOCK_INITIALIZE_CONTROL_WORD);
+    das1RegWrite(Context, DAS_CLOCK_REGISTER, (UCHAR)(Count & 0xff));
+    das1RegWrite(Context, DAS_CLOCK_REGISTER, (UCHAR)(Count >> 8));
+}
+
+FORCEINLINE
+BOOLEAN
+das1RegBatchCheck(
+    _In_reads_(Count) const DAS_REGOP *Ops,
+    _In_ ULONG Count
+    )
+/*++
+    TRUE if every entry names a valid op, BAR and offset.
+--*/
+{
+    ULONG i;
+
+    if (Count > DAS_REGBATCH_MAX) {
+        return FALSE;
+    }
+    for (i = 0; i < Count; i++) {
+        if (Ops[i].Op > DAS_REGOP_RMW) {
+            return FALSE;
+        }
+        if (Ops[i].Bar == DAS_REGOP_BADR1) {
+            if (Ops[i].Offset >= 0x80 || (Ops[i].Offset & 3) != 0) {
+                return FALSE;
+            }
+        }
+        else if (Ops[i].Bar == DAS_REGOP_BADR2) {
+            if (Ops[i].Offset >= 0x08) {
+                return FALSE;
+            }
+        }
+        else {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+FORCEINLINE
+ULONG
+das1RegBatchRead(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ UCHAR Bar,
+    _In_ USHORT Offset
+    )
+{
+    if (Bar == DAS_REGOP_BADR1) {
+        Context->PortReads++;
+        return READ_PORT_ULONG((PULONG)((PUCHAR)Context->BADR1 + Offset));
+    }
+    return das1RegRead(Context, Offset);
+}
+
+FORCEINLINE
+VOID
+das1RegBatchWrite(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ UCHAR Bar,
+    _In_ USHORT Offset,
+    _In_ ULONG Value
+    )
+{
+    if (Bar == DAS_REGOP_BADR1) {
+        Context->PortWrites++;
+        WRITE_PORT_ULONG((PULONG)((PUCHAR)Context->BADR1 + Offset), Value);
+    }
+    else if (Offset == DAS_CONTROL_REGISTER) {
+        das1RegSetControl(Context, (UCHAR)Value);
+    }
+    else {
+        das1RegWrite(Context, Offset, (UCHAR)Value);
+    }
+}
+
+FORCEINLINE
+VOID
+das1RegBatch(
+    _In_ PDEVICE_CONTEXT Context,
+    _Inout_updates_(Count) PDAS_REGOP Ops,
+    _In_ ULONG Count
+    )
+/*++
+    Run a checked command list in order.  Each op is timed from the end
+    of the one before with the performance counter.
+--*/
+{
+    LARGE_INTEGER freq, t0, t1;
+    ULONG i, v;
+
+    t0 = KeQueryPerformanceCounter(&freq);
+    for (i = 0; i < Count; i++) {
+        v = 0;
+        if (Ops[i].Op != DAS_REGOP_WRITE) {
+            v = das1RegBatchRead(Context, Ops[i].Bar, Ops[i].Offset);
+        }
+        Ops[i].Result = v;
+        if (Ops[i].Op == DAS_REGOP_WRITE) {
+            das1RegBatchWrite(Context, Ops[i].Bar, Ops[i].Offset, Ops[i].Value);
+        }
+        else if (Ops[i].Op == DAS_REGOP_RMW) {
+            das1RegBatchWrite(Context, Ops[i].Bar, Ops[i].Offset,
+                (v & ~Ops[i].Mask) | (Ops[i].Value & Ops[i].Mask));
+        }
+        t1 = KeQueryPerformanceCounter(NULL);
+        Ops[i].Nanoseconds = (ULONG)((t1.QuadPart - t0.QuadPart) * 1000000000 / freq.QuadPart);
+        t0 = t1;
+    }
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*++
+
+Module Name:
+
+    wdastrace.h
+
+Abstract:
+
+    The trace points shared with the NetBSD driver (dastrace.h, found
+    through the project's include path), bound to this driver.
+
+    The per-CPU flight recorder is allocated nonpaged in DriverEntry,
+    one buffer per active processor, and read back with
+    IOCTL_DAS_GET_TRACE.  Each trace point also goes to WPP through
+    das1TraceWpp, so a live session sees the same events.  The trace
+    level is DAS_TRACE_LEVEL; the interrupt path is traced only at
+    DAS_TL_INTR.
+
+Environment:
+
+    Kernel-mode Driver Framework
+
+--*/
+
+#if !defined(__WDASTRACE_H__)
+#define __WDASTRACE_H__
+
+#include <stdint.h>
+
+struct das_trace_cpu;
+
+extern struct das_trace_cpu *das1TraceBuf;
+extern ULONG das1TraceNcpu;
+
+VOID
+das1TraceWpp(
+    _In_ USHORT Event,
+    _In_ ULONG64 A0,
+    _In_ ULONG64 A1
+    );
+
+#define DAS_TRACE_BUF das1TraceBuf
+#define DAS_TRACE_NCPU das1TraceNcpu
+#define DAS_TRACE_BACKEND(ev, a0, a1) das1TraceWpp((ev), (ULONG64)(a0), (ULONG64)(a1))
+
+#include "dastrace.h"
+
+#endif